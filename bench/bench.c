@@ -0,0 +1,579 @@
+/*
+ * bench.c
+ *
+ * Benchmark harness for the scan kernels, for tracking performance per
+ * instruction-set variant.
+ *
+ *	bench [--impl name] [--kernel name] [--cpu n] [--max-bytes n]
+ *		  [--samples n] [--counters] [--csv file] [--json file]
+ *
+ * Each kernel is timed over array sizes from 16 bytes to beyond the last
+ * level cache, with the key at a controlled position: the first, middle or
+ * last element, or absent.  The rest of the array never holds the key, so
+ * a search really scans up to the hit.  Timing uses the cycle counter
+ * (rdtsc, or cntvct_el0 on Arm) calibrated against CLOCK_MONOTONIC, on a
+ * thread pinned to one CPU.  Calls are batched so that each sample takes a
+ * few microseconds, and each configuration reports the median, 99th
+ * percentile and minimum time per call over its samples, plus GB/s at the
+ * median for the bytes up to the hit.  Caches are warm, except for arrays
+ * too large to fit in them.
+ *
+ * With --counters, and a library built with PERF_COUNTERS=1, each
+ * configuration also gets a pass with the hardware counters of simd_perf.c
+ * read around every call, reported per call along with the IPC.  That pass
+ * is separate from the timed samples, whose calls are not instrumented.
+ *
+ * Without --impl every variant the CPU supports is measured.  A table goes
+ * to stdout; --csv and --json write the same results in machine-readable
+ * form.
+ */
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "simd.h"
+
+/* the byte the key is made of; the array holds every other byte value */
+#define BENCH_KEY_BYTE		0xA5
+
+/* smallest and default largest array, and the step between sizes */
+#define BENCH_MIN_BYTES		16
+#define BENCH_MIN_MAX_BYTES	(64 * 1024 * 1024)
+#define BENCH_SIZE_STEP		4
+
+/* each sample batches enough calls to take about this long */
+#define BENCH_SAMPLE_NS		5000.0
+
+/* time to spend on one configuration, and the fewest samples to take */
+#define BENCH_CONFIG_NS		50e6
+#define BENCH_MIN_SAMPLES	7
+#define BENCH_DEFAULT_SAMPLES	51
+
+typedef uint64 (*BenchFn) (void *base, uint32 nelem, uint64 key);
+
+typedef struct BenchKernel
+{
+	const char *name;
+	uint32		elem_size;
+	BenchFn		run;
+} BenchKernel;
+
+typedef struct BenchResult
+{
+	const char *impl;
+	const char *kernel;
+	uint32		elem_size;
+	uint64		bytes;
+	const char *hit;
+	uint32		nsamples;
+	uint64		reps;
+	double		median_ns;
+	double		p99_ns;
+	double		min_ns;
+	double		gbps;
+
+	/* per call, from the --counters pass */
+	bool		counted;
+	double		cycles;
+	double		ipc;
+	double		l1d_misses;
+	double		llc_misses;
+	double		branch_misses;
+} BenchResult;
+
+static uint64
+bench_lfind8(void *base, uint32 nelem, uint64 key)
+{
+	return lfind8((uint8) key, base, nelem);
+}
+
+static uint64
+bench_lfind16(void *base, uint32 nelem, uint64 key)
+{
+	return lfind16((uint16) key, base, nelem);
+}
+
+static uint64
+bench_lfind32(void *base, uint32 nelem, uint64 key)
+{
+	return lfind32((uint32) key, base, nelem);
+}
+
+static uint64
+bench_lfind64(void *base, uint32 nelem, uint64 key)
+{
+	return lfind64(key, base, nelem);
+}
+
+static uint64
+bench_lfind32_index(void *base, uint32 nelem, uint64 key)
+{
+	return lfind32_index((uint32) key, base, nelem);
+}
+
+static uint64
+bench_lfind8_count(void *base, uint32 nelem, uint64 key)
+{
+	return lfind8_count((uint8) key, base, nelem);
+}
+
+static uint64
+bench_lfind32_count(void *base, uint32 nelem, uint64 key)
+{
+	return lfind32_count((uint32) key, base, nelem);
+}
+
+static uint64
+bench_memchr(void *base, uint32 nelem, uint64 key)
+{
+	return simd_memchr(base, (int) key, nelem) != NULL;
+}
+
+static const BenchKernel bench_kernels[] = {
+	{"lfind8", sizeof(uint8), bench_lfind8},
+	{"lfind16", sizeof(uint16), bench_lfind16},
+	{"lfind32", sizeof(uint32), bench_lfind32},
+	{"lfind64", sizeof(uint64), bench_lfind64},
+	{"lfind32_index", sizeof(uint32), bench_lfind32_index},
+	{"lfind8_count", sizeof(uint8), bench_lfind8_count},
+	{"lfind32_count", sizeof(uint32), bench_lfind32_count},
+	{"simd_memchr", sizeof(uint8), bench_memchr},
+};
+
+/* same list as the functional tests; unsupported ones are skipped */
+static const char *const bench_impls[] = {
+	"sse2", "avx2", "avx512", "neon", "sve", "sve2"
+};
+
+/* where the key goes; "miss" leaves it out */
+static const char *const bench_hits[] = {"first", "middle", "last", "miss"};
+
+#define lengthof(array) (sizeof(array) / sizeof((array)[0]))
+
+static const char *bench_timer_name;
+static bool bench_counters = false;
+static double bench_ticks_per_ns;
+
+static inline uint64
+bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	/* keep earlier instructions from drifting past the read */
+	_mm_lfence();
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64		ticks;
+
+	__asm__ volatile("isb; mrs %0, cntvct_el0" : "=r" (ticks));
+	return ticks;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64) ts.tv_sec * 1000000000 + (uint64) ts.tv_nsec;
+#endif
+}
+
+static double
+bench_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* measure the counter's rate against the monotonic clock over ~100ms */
+static void
+bench_calibrate(void)
+{
+	double		start_ns = bench_monotonic_ns();
+	uint64		start = bench_ticks();
+	double		ns;
+
+	do
+		ns = bench_monotonic_ns() - start_ns;
+	while (ns < 100e6);
+
+	bench_ticks_per_ns = (double) (bench_ticks() - start) / ns;
+#if defined(__x86_64__) || defined(__i386__)
+	bench_timer_name = "rdtsc";
+#elif defined(__aarch64__)
+	bench_timer_name = "cntvct_el0";
+#else
+	bench_timer_name = "clock_gettime";
+#endif
+}
+
+static uint64
+bench_llc_bytes(void)
+{
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	long		size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+	if (size > 0)
+		return (uint64) size;
+#endif
+	return 32 * 1024 * 1024;
+}
+
+static int
+bench_compare_double(const void *a, const void *b)
+{
+	double		x = *(const double *) a;
+	double		y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* store 'key' as the element at 'index' of an array of 'elem_size' elements */
+static void
+bench_put(uint8 *base, uint32 elem_size, uint32 index, uint64 key)
+{
+	memcpy(base + (size_t) index * elem_size, &key, elem_size);
+}
+
+/*
+ * Time 'kernel' on the first 'bytes' bytes of 'buf', with the key placed
+ * according to 'hit'.
+ */
+static void
+bench_run(const BenchKernel *kernel, uint8 *buf, uint64 bytes, uint32 hit,
+		  uint32 max_samples, BenchResult *result)
+{
+	uint32		nelem = (uint32) (bytes / kernel->elem_size);
+	uint64		key = 0;
+	uint32		pos = 0;
+	uint8		saved[sizeof(uint64)];
+	double	   *samples = malloc(max_samples * sizeof(double));
+	volatile uint64 sink = 0;
+	uint64		reps;
+	uint64		start;
+	uint32		nsamples;
+	uint32		s;
+	double		call_ns;
+
+	memset(&key, BENCH_KEY_BYTE, kernel->elem_size);
+	if (hit == 0)
+		pos = 0;
+	else if (hit == 1)
+		pos = nelem / 2;
+	else
+		pos = nelem - 1;
+
+	memcpy(saved, buf + (size_t) pos * kernel->elem_size, kernel->elem_size);
+	if (hit < 3)
+		bench_put(buf, kernel->elem_size, pos, key);
+
+	/* warm up, and estimate the time per call to size the batches */
+	reps = 0;
+	start = bench_ticks();
+	do
+	{
+		sink += kernel->run(buf, nelem, key);
+		reps++;
+	} while ((bench_ticks() - start) / bench_ticks_per_ns < 1e6 || reps < 2);
+	call_ns = (bench_ticks() - start) / bench_ticks_per_ns / reps;
+
+	reps = (uint64) (BENCH_SAMPLE_NS / call_ns) + 1;
+	nsamples = (uint32) (BENCH_CONFIG_NS / (call_ns * reps));
+	if (nsamples > max_samples)
+		nsamples = max_samples;
+	if (nsamples < BENCH_MIN_SAMPLES)
+		nsamples = BENCH_MIN_SAMPLES;
+
+	for (s = 0; s < nsamples; s++)
+	{
+		uint64		r;
+
+		start = bench_ticks();
+		for (r = 0; r < reps; r++)
+			sink += kernel->run(buf, nelem, key);
+		samples[s] = (bench_ticks() - start) / bench_ticks_per_ns / reps;
+	}
+
+	/* an extra, untimed pass with the counters read around every call */
+	result->counted = false;
+	if (bench_counters)
+	{
+		SimdPerfCounters counters[4];
+		uint32		n;
+		uint32		c;
+
+		simd_perf_reset();
+		simd_perf_enable(1);
+		for (s = 0; s < reps; s++)
+			sink += kernel->run(buf, nelem, key);
+		simd_perf_disable();
+
+		n = simd_perf_read(counters, lengthof(counters));
+		for (c = 0; c < n && c < lengthof(counters); c++)
+		{
+			const SimdPerfCounters *pc = &counters[c];
+			double		sampled = (double) pc->sampled;
+
+			if (strcmp(pc->kernel, kernel->name) != 0 || pc->sampled == 0)
+				continue;
+			result->counted = true;
+			result->cycles = pc->cycles / sampled;
+			result->ipc = pc->cycles > 0 ? (double) pc->instructions / pc->cycles : 0.0;
+			result->l1d_misses = pc->l1d_misses / sampled;
+			result->llc_misses = pc->llc_misses / sampled;
+			result->branch_misses = pc->branch_misses / sampled;
+		}
+	}
+	(void) sink;
+
+	memcpy(buf + (size_t) pos * kernel->elem_size, saved, kernel->elem_size);
+
+	qsort(samples, nsamples, sizeof(double), bench_compare_double);
+	result->kernel = kernel->name;
+	result->elem_size = kernel->elem_size;
+	result->bytes = (uint64) nelem * kernel->elem_size;
+	result->hit = bench_hits[hit];
+	result->nsamples = nsamples;
+	result->reps = reps;
+	result->median_ns = samples[nsamples / 2];
+	result->p99_ns = samples[(nsamples * 99 + 99) / 100 - 1];
+	result->min_ns = samples[0];
+	result->gbps = (hit < 3 ? (double) (pos + 1) * kernel->elem_size :
+					(double) result->bytes) / result->median_ns;
+	free(samples);
+}
+
+static void
+bench_write_csv(FILE *f, const BenchResult *results, uint32 nresults)
+{
+	uint32		i;
+
+	fprintf(f, "impl,kernel,elem_size,bytes,hit,samples,reps,median_ns,p99_ns,min_ns,gbps,"
+			"cycles,ipc,l1d_misses,llc_misses,branch_misses\n");
+	for (i = 0; i < nresults; i++)
+	{
+		const BenchResult *r = &results[i];
+
+		fprintf(f, "%s,%s,%u,%llu,%s,%u,%llu,%.3f,%.3f,%.3f,%.3f",
+				r->impl, r->kernel, r->elem_size, r->bytes, r->hit,
+				r->nsamples, r->reps, r->median_ns, r->p99_ns, r->min_ns,
+				r->gbps);
+		if (r->counted)
+			fprintf(f, ",%.1f,%.3f,%.2f,%.2f,%.2f\n", r->cycles, r->ipc,
+					r->l1d_misses, r->llc_misses, r->branch_misses);
+		else
+			fprintf(f, ",,,,,\n");
+	}
+}
+
+static void
+bench_write_json(FILE *f, const BenchResult *results, uint32 nresults)
+{
+	uint32		i;
+
+	fprintf(f, "{\n  \"timer\": \"%s\",\n  \"ticks_per_ns\": %.6f,\n"
+			"  \"llc_bytes\": %llu,\n  \"results\": [\n",
+			bench_timer_name, bench_ticks_per_ns, bench_llc_bytes());
+	for (i = 0; i < nresults; i++)
+	{
+		const BenchResult *r = &results[i];
+
+		fprintf(f, "    {\"impl\": \"%s\", \"kernel\": \"%s\", \"elem_size\": %u, "
+				"\"bytes\": %llu, \"hit\": \"%s\", \"samples\": %u, \"reps\": %llu, "
+				"\"median_ns\": %.3f, \"p99_ns\": %.3f, \"min_ns\": %.3f, "
+				"\"gbps\": %.3f",
+				r->impl, r->kernel, r->elem_size, r->bytes, r->hit,
+				r->nsamples, r->reps, r->median_ns, r->p99_ns, r->min_ns,
+				r->gbps);
+		if (r->counted)
+			fprintf(f, ", \"cycles\": %.1f, \"ipc\": %.3f, \"l1d_misses\": %.2f, "
+					"\"llc_misses\": %.2f, \"branch_misses\": %.2f",
+					r->cycles, r->ipc, r->l1d_misses, r->llc_misses,
+					r->branch_misses);
+		fprintf(f, "}%s\n", i + 1 < nresults ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+}
+
+/* open 'path' and write the results with 'write'; returns false on failure */
+static bool
+bench_save(const char *path, void (*write) (FILE *, const BenchResult *, uint32),
+		   const BenchResult *results, uint32 nresults)
+{
+	FILE	   *f = fopen(path, "w");
+
+	if (f == NULL)
+	{
+		perror(path);
+		return false;
+	}
+	write(f, results, nresults);
+	if (fclose(f) != 0)
+	{
+		perror(path);
+		return false;
+	}
+	return true;
+}
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr,
+			"usage: %s [--impl name] [--kernel name] [--cpu n] [--max-bytes n]\n"
+			"          [--samples n] [--counters] [--csv file] [--json file]\n", progname);
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *only_impl = NULL;
+	const char *only_kernel = NULL;
+	const char *csv_path = NULL;
+	const char *json_path = NULL;
+	uint64		max_bytes = bench_llc_bytes() * 4;
+	uint32		max_samples = BENCH_DEFAULT_SAMPLES;
+	int			cpu = -1;
+	BenchResult *results;
+	uint32		nresults = 0;
+	uint32		maxresults;
+	uint8	   *buf;
+	uint64		bytes;
+	uint64		i;
+	uint32		nsizes = 0;
+	uint32		m;
+	cpu_set_t	cpus;
+	int			arg;
+
+	for (arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "--counters") == 0)
+		{
+			bench_counters = true;
+			continue;
+		}
+		if (arg + 1 >= argc)
+			usage(argv[0]);
+		if (strcmp(argv[arg], "--impl") == 0)
+			only_impl = argv[++arg];
+		else if (strcmp(argv[arg], "--kernel") == 0)
+			only_kernel = argv[++arg];
+		else if (strcmp(argv[arg], "--cpu") == 0)
+			cpu = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "--max-bytes") == 0)
+			max_bytes = strtoull(argv[++arg], NULL, 0);
+		else if (strcmp(argv[arg], "--samples") == 0)
+			max_samples = (uint32) atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "--csv") == 0)
+			csv_path = argv[++arg];
+		else if (strcmp(argv[arg], "--json") == 0)
+			json_path = argv[++arg];
+		else
+			usage(argv[0]);
+	}
+	if (max_bytes < BENCH_MIN_MAX_BYTES)
+		max_bytes = BENCH_MIN_MAX_BYTES;
+	if (max_samples < BENCH_MIN_SAMPLES)
+		max_samples = BENCH_MIN_SAMPLES;
+
+	/* stay on one CPU, so that migrations don't show up as outliers */
+	if (cpu < 0)
+		cpu = sched_getcpu();
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+		perror("sched_setaffinity");
+
+	bench_calibrate();
+
+	if (bench_counters && simd_perf_enable(1) < 0)
+	{
+		fprintf(stderr, "--counters needs a library built with PERF_COUNTERS=1\n");
+		return 2;
+	}
+	simd_perf_disable();
+
+	/* every byte value but the key's, so no element equals a key */
+	if (posix_memalign((void **) &buf, 64, max_bytes) != 0)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 2;
+	}
+	srand(42);
+	for (i = 0; i < max_bytes; i++)
+	{
+		buf[i] = (uint8) (rand() % 255);
+		if (buf[i] >= BENCH_KEY_BYTE)
+			buf[i]++;
+	}
+
+	for (bytes = BENCH_MIN_BYTES; bytes <= max_bytes; bytes *= BENCH_SIZE_STEP)
+		nsizes++;
+	maxresults = lengthof(bench_impls) * lengthof(bench_kernels) * nsizes *
+		lengthof(bench_hits);
+	results = malloc(maxresults * sizeof(BenchResult));
+
+	printf("timer %s at %.3f ticks/ns, pinned to CPU %d, LLC %llu bytes\n",
+		   bench_timer_name, bench_ticks_per_ns, cpu, bench_llc_bytes());
+	printf("%-7s %-14s %10s %-6s %12s %12s %12s %9s%s\n",
+		   "impl", "kernel", "bytes", "hit", "median ns", "p99 ns", "min ns", "GB/s",
+		   bench_counters ? "     cycles   IPC  L1D miss  LLC miss   br miss" : "");
+
+	for (m = 0; m < lengthof(bench_impls); m++)
+	{
+		uint32		k;
+
+		if (only_impl != NULL && strcmp(only_impl, bench_impls[m]) != 0)
+			continue;
+		if (!simd_set_impl(bench_impls[m]))
+			continue;
+
+		for (k = 0; k < lengthof(bench_kernels); k++)
+		{
+			if (only_kernel != NULL && strcmp(only_kernel, bench_kernels[k].name) != 0)
+				continue;
+
+			for (bytes = BENCH_MIN_BYTES; bytes <= max_bytes; bytes *= BENCH_SIZE_STEP)
+			{
+				uint32		hit;
+
+				for (hit = 0; hit < lengthof(bench_hits); hit++)
+				{
+					BenchResult *r = &results[nresults++];
+
+					bench_run(&bench_kernels[k], buf, bytes, hit, max_samples, r);
+					r->impl = bench_impls[m];
+					printf("%-7s %-14s %10llu %-6s %12.2f %12.2f %12.2f %9.2f",
+						   r->impl, r->kernel, r->bytes, r->hit, r->median_ns,
+						   r->p99_ns, r->min_ns, r->gbps);
+					if (r->counted)
+						printf(" %10.0f %5.2f %9.2f %9.2f %9.2f", r->cycles, r->ipc,
+							   r->l1d_misses, r->llc_misses, r->branch_misses);
+					printf("\n");
+				}
+			}
+		}
+	}
+
+	if (nresults == 0)
+	{
+		fprintf(stderr, "nothing to benchmark\n");
+		return 2;
+	}
+	if (csv_path != NULL && !bench_save(csv_path, bench_write_csv, results, nresults))
+		return 2;
+	if (json_path != NULL && !bench_save(json_path, bench_write_json, results, nresults))
+		return 2;
+
+	free(results);
+	free(buf);
+	return 0;
+}
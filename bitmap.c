@@ -0,0 +1,238 @@
+/*
+ * bitmap.c
+ *
+ * Combinators over bitmaps of any length, such as those written by the
+ * _mask and _batch kernels: AND, OR, XOR and AND NOT of two bitmaps, a
+ * population count, and a test for any bit set that stops at the first
+ * one.  Like lfind.c this is compiled once per instruction-set variant; the
+ * exported functions live in simd_dispatch.c.
+ *
+ * The combinators never write past 'nbytes', so the last partial vector is
+ * done a 64-bit word and then a byte at a time rather than by reloading an
+ * overlapping vector, which would redo bytes that may already have been
+ * overwritten when the output is one of the inputs.
+ */
+#include "simd_internal.h"
+
+/*
+ * Define a combinator.  'vop' combines two vectors and 'sop' two words or
+ * bytes, as an expression in 'x' and 'y'.  Four vectors are loaded from
+ * each input before anything is stored, which is safe when 'out' is 'a' or
+ * 'b' since every byte only depends on the bytes at the same offset.
+ */
+#define BITMAP_DEFINE_COMBINE(name, vop, sop) \
+uint8 * \
+SIMD_FN(name)(uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes) \
+{ \
+	size_t		i = 0; \
+\
+	for (; nbytes - i >= 4 * sizeof(Vector8); i += 4 * sizeof(Vector8)) \
+	{ \
+		Vector8		a1, \
+					a2, \
+					a3, \
+					a4; \
+		Vector8		b1, \
+					b2, \
+					b3, \
+					b4; \
+\
+		vector8_load(&a1, &a[i]); \
+		vector8_load(&a2, &a[i + sizeof(Vector8)]); \
+		vector8_load(&a3, &a[i + 2 * sizeof(Vector8)]); \
+		vector8_load(&a4, &a[i + 3 * sizeof(Vector8)]); \
+		vector8_load(&b1, &b[i]); \
+		vector8_load(&b2, &b[i + sizeof(Vector8)]); \
+		vector8_load(&b3, &b[i + 2 * sizeof(Vector8)]); \
+		vector8_load(&b4, &b[i + 3 * sizeof(Vector8)]); \
+		vector8_store(&out[i], vop(a1, b1)); \
+		vector8_store(&out[i + sizeof(Vector8)], vop(a2, b2)); \
+		vector8_store(&out[i + 2 * sizeof(Vector8)], vop(a3, b3)); \
+		vector8_store(&out[i + 3 * sizeof(Vector8)], vop(a4, b4)); \
+	} \
+\
+	for (; nbytes - i >= sizeof(Vector8); i += sizeof(Vector8)) \
+	{ \
+		Vector8		a1; \
+		Vector8		b1; \
+\
+		vector8_load(&a1, &a[i]); \
+		vector8_load(&b1, &b[i]); \
+		vector8_store(&out[i], vop(a1, b1)); \
+	} \
+\
+	for (; nbytes - i >= sizeof(uint64); i += sizeof(uint64)) \
+	{ \
+		uint64		x; \
+		uint64		y; \
+\
+		memcpy(&x, &a[i], sizeof(x)); \
+		memcpy(&y, &b[i], sizeof(y)); \
+		x = sop; \
+		memcpy(&out[i], &x, sizeof(x)); \
+	} \
+\
+	for (; i < nbytes; i++) \
+	{ \
+		uint8		x = a[i]; \
+		uint8		y = b[i]; \
+\
+		out[i] = (uint8) (sop); \
+	} \
+\
+	return out; \
+}
+
+/*
+ * simd_bitmap_and / simd_bitmap_or / simd_bitmap_xor / simd_bitmap_andnot
+ *
+ * Set 'out[0 .. nbytes-1]' to a & b, a | b, a ^ b or a & ~b, and return
+ * 'out'.  'out' may be 'a' or 'b', but must not overlap them otherwise.
+ */
+BITMAP_DEFINE_COMBINE(simd_bitmap_and, vector8_and, x & y)
+BITMAP_DEFINE_COMBINE(simd_bitmap_or, vector8_or, x | y)
+BITMAP_DEFINE_COMBINE(simd_bitmap_xor, vector8_xor, x ^ y)
+BITMAP_DEFINE_COMBINE(simd_bitmap_andnot, vector8_andnot, x & ~y)
+
+#ifdef VECTOR8_HAS_LOOKUP
+
+/* number of bits set in each 4-bit value */
+static const uint8 bitmap_nibble_popcount[16] = {
+	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+#endif
+
+/*
+ * Return the bit count of each byte of 'v', 0 to 8: by looking up each
+ * nibble where there are table lookups, otherwise by adding adjacent bits,
+ * pairs and nibbles in place.
+ */
+static inline Vector8
+bitmap_popcount_bytes(const Vector8 v)
+{
+#ifdef VECTOR8_HAS_LOOKUP
+	Vector8		lut;
+
+	vector8_load_lut(&lut, bitmap_nibble_popcount);
+	return vector8_add(vector8_lookup(lut, vector8_and(v, vector8_broadcast(0x0F))),
+					   vector8_lookup(lut, vector8_shift_right(v, 4)));
+#else
+	Vector8		x;
+
+	x = vector8_sub(v, vector8_and(vector8_shift_right(v, 1), vector8_broadcast(0x55)));
+	x = vector8_add(vector8_and(x, vector8_broadcast(0x33)),
+					vector8_and(vector8_shift_right(x, 2), vector8_broadcast(0x33)));
+	return vector8_and(vector8_add(x, vector8_shift_right(x, 4)), vector8_broadcast(0x0F));
+#endif
+}
+
+/*
+ * simd_bitmap_count
+ *
+ * Return the number of bits set in 'bitmap[0 .. nbytes-1]'.  The byte
+ * counts of four vectors, at most 32 each, are added before they are summed
+ * into 64-bit lanes.
+ */
+uint64
+SIMD_FN(simd_bitmap_count)(const uint8 *bitmap, size_t nbytes)
+{
+	Vector64	acc = vector64_broadcast(0);
+	uint64		lanes[sizeof(Vector64) / sizeof(uint64)];
+	uint64		count = 0;
+	size_t		i = 0;
+	uint32		j;
+
+	for (; nbytes - i >= 4 * sizeof(Vector8); i += 4 * sizeof(Vector8))
+	{
+		Vector8		v1,
+					v2,
+					v3,
+					v4;
+		Vector8		counts;
+
+		vector8_load(&v1, &bitmap[i]);
+		vector8_load(&v2, &bitmap[i + sizeof(Vector8)]);
+		vector8_load(&v3, &bitmap[i + 2 * sizeof(Vector8)]);
+		vector8_load(&v4, &bitmap[i + 3 * sizeof(Vector8)]);
+		counts = vector8_add(vector8_add(bitmap_popcount_bytes(v1),
+										 bitmap_popcount_bytes(v2)),
+							 vector8_add(bitmap_popcount_bytes(v3),
+										 bitmap_popcount_bytes(v4)));
+		acc = vector64_add(acc, vector8_sum64(counts));
+	}
+
+	for (; nbytes - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		Vector8		v;
+
+		vector8_load(&v, &bitmap[i]);
+		acc = vector64_add(acc, vector8_sum64(bitmap_popcount_bytes(v)));
+	}
+
+	memcpy(lanes, &acc, sizeof(lanes));
+	for (j = 0; j < sizeof(lanes) / sizeof(lanes[0]); j++)
+		count += lanes[j];
+
+	/* the rest a word, then a byte, at a time */
+	for (; nbytes - i >= sizeof(uint64); i += sizeof(uint64))
+	{
+		uint64		word;
+
+		memcpy(&word, &bitmap[i], sizeof(word));
+		count += __builtin_popcountll(word);
+	}
+	for (; i < nbytes; i++)
+		count += __builtin_popcount(bitmap[i]);
+
+	return count;
+}
+
+/*
+ * simd_bitmap_any
+ *
+ * Return true if any bit of 'bitmap[0 .. nbytes-1]' is set, stopping at the
+ * first vector that has one.
+ */
+bool
+SIMD_FN(simd_bitmap_any)(const uint8 *bitmap, size_t nbytes)
+{
+	size_t		i = 0;
+
+	for (; nbytes - i >= 4 * sizeof(Vector8); i += 4 * sizeof(Vector8))
+	{
+		Vector8		v1,
+					v2,
+					v3,
+					v4;
+
+		vector8_load(&v1, &bitmap[i]);
+		vector8_load(&v2, &bitmap[i + sizeof(Vector8)]);
+		vector8_load(&v3, &bitmap[i + 2 * sizeof(Vector8)]);
+		vector8_load(&v4, &bitmap[i + 3 * sizeof(Vector8)]);
+		if (!vector8_is_zero(vector8_or(vector8_or(v1, v2), vector8_or(v3, v4))))
+			return true;
+	}
+
+	for (; nbytes - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		Vector8		v;
+
+		vector8_load(&v, &bitmap[i]);
+		if (!vector8_is_zero(v))
+			return true;
+	}
+
+	if (i < nbytes)
+	{
+		Vector8		v;
+		uint32		start;
+		uint64		valid;
+
+		/* simd_load_tail8 takes uint32 offsets, so start it at the tail */
+		valid = simd_load_tail8(&v, &bitmap[i], 0, (uint32) (nbytes - i), &start);
+		return (vector8_cmp_mask(vector8_eq(v, vector8_broadcast(0))) & valid) != valid;
+	}
+
+	return false;
+}
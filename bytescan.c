@@ -0,0 +1,401 @@
+/*
+ * bytescan.c
+ *
+ * memchr-style byte scanners.  Like lfind.c this is compiled once per
+ * instruction-set variant; the exported simd_* functions live in
+ * simd_dispatch.c.
+ *
+ * All loads are whole vectors at vector-aligned addresses, and the blocks
+ * of four vectors are aligned to their own size.  The first and last
+ * vectors may include bytes outside the buffer, which are masked off, but
+ * an aligned load never straddles a page boundary, so the scan cannot fault
+ * even though it reads ahead of where the buffer (or, for strlen, the
+ * string) ends.  This is the same argument libc implementations rely on.
+ *
+ * An address sanitizer reports those reads all the same, so when
+ * VECTOR_NO_OVERREAD is defined the scans load whole vectors only from
+ * within the buffer, unaligned, and finish with a partial load; strlen,
+ * which has no length to stay within, is left to libc.
+ */
+#include "simd_internal.h"
+
+/* mask in the vector8_cmp_mask() layout with the first 'nbytes' lanes clear */
+static inline uint64
+bytescan_skip_head(uint64 mask, uint32 nbytes)
+{
+	return mask & ~simd_mask_prefix(nbytes);
+}
+
+/*
+ * Return a compare result with all bits set in each byte of 'chunk' that
+ * equals one of the 'nneedles' (1 to 3) broadcast needles.  'nneedles' is a
+ * constant in every caller, so the loop disappears after inlining.
+ */
+static inline Vector8
+bytescan_match(const Vector8 chunk, const Vector8 *needles, int nneedles)
+{
+	Vector8		result = vector8_eq(chunk, needles[0]);
+	int			j;
+
+	for (j = 1; j < nneedles; j++)
+		result = vector8_or(result, vector8_eq(chunk, needles[j]));
+
+	return result;
+}
+
+#ifdef VECTOR_NO_OVERREAD
+
+/*
+ * Return a pointer to the first byte among 's[0 .. n-1]' that matches one of
+ * the needles, or NULL if there is none.
+ */
+static inline const uint8 *
+bytescan_forward(const uint8 *s, size_t n, const Vector8 *needles, int nneedles)
+{
+	Vector8		chunk;
+	uint64		mask;
+	size_t		i;
+
+	for (i = 0; n - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		vector8_load(&chunk, &s[i]);
+		mask = vector8_cmp_mask(bytescan_match(chunk, needles, nneedles));
+		if (mask != 0)
+			return &s[i] + simd_mask_first_byte(mask);
+	}
+
+	if (i < n)
+	{
+		vector8_load_partial(&chunk, &s[i], (uint32) (n - i));
+		mask = vector8_cmp_mask(bytescan_match(chunk, needles, nneedles)) &
+			simd_mask_prefix((uint32) (n - i));
+		if (mask != 0)
+			return &s[i] + simd_mask_first_byte(mask);
+	}
+
+	return NULL;
+}
+
+#else
+
+/*
+ * Return a pointer to the first byte among 's[0 .. n-1]' that matches one of
+ * the needles, or NULL if there is none.  strlen passes SIZE_MAX for 'n'.
+ */
+static inline const uint8 *
+bytescan_forward(const uint8 *s, size_t n, const Vector8 *needles, int nneedles)
+{
+	const uint32 head = (uint32) ((uintptr_t) s & (sizeof(Vector8) - 1));
+	const uint8 *p = s - head;
+	Vector8		chunk;
+	uint64		mask;
+
+	if (n == 0)
+		return NULL;
+
+	/*
+	 * The first aligned vector, ignoring the bytes before 's' and, for a
+	 * short buffer, those after its end.
+	 */
+	vector8_load(&chunk, p);
+	mask = bytescan_skip_head(vector8_cmp_mask(bytescan_match(chunk, needles, nneedles)),
+							  head);
+	if (n < sizeof(Vector8) - head)
+		mask &= simd_mask_prefix(head + (uint32) n);
+	if (mask != 0)
+		return p + simd_mask_first_byte(mask);
+	if (n <= sizeof(Vector8) - head)
+		return NULL;
+
+	/* 'n' now counts the bytes from 'p' on */
+	n -= sizeof(Vector8) - head;
+	p += sizeof(Vector8);
+
+	/*
+	 * Single vectors up to a four-vector boundary, so that the blocks below
+	 * can't cross a page boundary either.
+	 */
+	while (n >= sizeof(Vector8) &&
+		   ((uintptr_t) p & (4 * sizeof(Vector8) - 1)) != 0)
+	{
+		vector8_load(&chunk, p);
+		mask = vector8_cmp_mask(bytescan_match(chunk, needles, nneedles));
+		if (mask != 0)
+			return p + simd_mask_first_byte(mask);
+
+		n -= sizeof(Vector8);
+		p += sizeof(Vector8);
+	}
+
+	/* blocks of four vectors, as in lfind32 */
+	while (n >= 4 * sizeof(Vector8))
+	{
+		Vector8		chunk1,
+					chunk2,
+					chunk3,
+					chunk4,
+					result1,
+					result2,
+					result3,
+					result4;
+
+		vector8_load(&chunk1, p);
+		vector8_load(&chunk2, p + sizeof(Vector8));
+		vector8_load(&chunk3, p + sizeof(Vector8) * 2);
+		vector8_load(&chunk4, p + sizeof(Vector8) * 3);
+
+		result1 = bytescan_match(chunk1, needles, nneedles);
+		result2 = bytescan_match(chunk2, needles, nneedles);
+		result3 = bytescan_match(chunk3, needles, nneedles);
+		result4 = bytescan_match(chunk4, needles, nneedles);
+
+		if (vector8_is_highbit_set(vector8_or(vector8_or(result1, result2),
+											  vector8_or(result3, result4))))
+		{
+			if ((mask = vector8_cmp_mask(result1)) != 0)
+				return p + simd_mask_first_byte(mask);
+			if ((mask = vector8_cmp_mask(result2)) != 0)
+				return p + sizeof(Vector8) + simd_mask_first_byte(mask);
+			if ((mask = vector8_cmp_mask(result3)) != 0)
+				return p + sizeof(Vector8) * 2 + simd_mask_first_byte(mask);
+			mask = vector8_cmp_mask(result4);
+			return p + sizeof(Vector8) * 3 + simd_mask_first_byte(mask);
+		}
+
+		n -= 4 * sizeof(Vector8);
+		p += 4 * sizeof(Vector8);
+	}
+
+	/* then single vectors, the last one masked to the end of the buffer */
+	while (n > 0)
+	{
+		vector8_load(&chunk, p);
+		mask = vector8_cmp_mask(bytescan_match(chunk, needles, nneedles));
+		if (n < sizeof(Vector8))
+		{
+			mask &= simd_mask_prefix((uint32) n);
+			n = sizeof(Vector8);
+		}
+		if (mask != 0)
+			return p + simd_mask_first_byte(mask);
+
+		n -= sizeof(Vector8);
+		p += sizeof(Vector8);
+	}
+
+	return NULL;
+}
+
+#endif
+
+/*
+ * simd_memchr
+ *
+ * Same as memchr(3): return a pointer to the first byte equal to
+ * (unsigned char) 'c' in the first 'n' bytes of 's', or NULL.
+ */
+void *
+SIMD_FN(simd_memchr)(const void *s, int c, size_t n)
+{
+	Vector8		needles[1];
+
+	needles[0] = vector8_broadcast((uint8) c);
+
+	return (void *) bytescan_forward(s, n, needles, 1);
+}
+
+/*
+ * simd_memchr2 / simd_memchr3
+ *
+ * Like simd_memchr, but find the first byte equal to any of two or three
+ * values.
+ */
+void *
+SIMD_FN(simd_memchr2)(const void *s, int c1, int c2, size_t n)
+{
+	Vector8		needles[2];
+
+	needles[0] = vector8_broadcast((uint8) c1);
+	needles[1] = vector8_broadcast((uint8) c2);
+
+	return (void *) bytescan_forward(s, n, needles, 2);
+}
+
+void *
+SIMD_FN(simd_memchr3)(const void *s, int c1, int c2, int c3, size_t n)
+{
+	Vector8		needles[3];
+
+	needles[0] = vector8_broadcast((uint8) c1);
+	needles[1] = vector8_broadcast((uint8) c2);
+	needles[2] = vector8_broadcast((uint8) c3);
+
+	return (void *) bytescan_forward(s, n, needles, 3);
+}
+
+/*
+ * simd_strlen
+ *
+ * Same as strlen(3).  The string's end is found with aligned loads only,
+ * so reading ahead of the terminator never touches the next page.
+ */
+size_t
+SIMD_FN(simd_strlen)(const char *s)
+{
+#ifdef VECTOR_NO_OVERREAD
+	return strlen(s);
+#else
+	Vector8		needles[1];
+
+	needles[0] = vector8_broadcast(0);
+
+	return (size_t) ((const char *) bytescan_forward((const uint8 *) s, SIZE_MAX,
+													 needles, 1) - s);
+#endif
+}
+
+/*
+ * simd_memrchr
+ *
+ * Same as the GNU memrchr(3): return a pointer to the last byte equal to
+ * (unsigned char) 'c' in the first 'n' bytes of 's', or NULL.  Scans
+ * backwards from the aligned vector holding the last byte.
+ */
+void *
+SIMD_FN(simd_memrchr)(const void *s, int c, size_t n)
+{
+	const uint8 *start = s;
+	const Vector8 key = vector8_broadcast((uint8) c);
+	const uint8 *p;
+	Vector8		chunk;
+	uint64		mask;
+
+	if (n == 0)
+		return NULL;
+
+#ifdef VECTOR_NO_OVERREAD
+	/* whole vectors back from the end, then a partial one at 's' */
+	for (; n >= sizeof(Vector8); n -= sizeof(Vector8))
+	{
+		p = start + n - sizeof(Vector8);
+		vector8_load(&chunk, p);
+		mask = vector8_eq_mask(chunk, key);
+		if (mask != 0)
+			return (void *) (p + simd_mask_last_byte(mask));
+	}
+	if (n == 0)
+		return NULL;
+	vector8_load_partial(&chunk, start, (uint32) n);
+	mask = vector8_eq_mask(chunk, key) & simd_mask_prefix((uint32) n);
+	if (mask != 0)
+		return (void *) (start + simd_mask_last_byte(mask));
+
+	return NULL;
+#else
+	/* the aligned vector holding the last byte, minus any bytes past it */
+	p = (const uint8 *) ((uintptr_t) (start + n - 1) & ~(uintptr_t) (sizeof(Vector8) - 1));
+	vector8_load(&chunk, p);
+	mask = vector8_eq_mask(chunk, key) &
+		simd_mask_prefix((uint32) (start + n - p));
+
+	/* walk back one aligned vector at a time until we pass 's' */
+	while (p > start)
+	{
+		if (mask != 0)
+			return (void *) (p + simd_mask_last_byte(mask));
+
+		p -= sizeof(Vector8);
+		vector8_load(&chunk, p);
+		mask = vector8_eq_mask(chunk, key);
+	}
+
+	/* the vector holding 's' itself, ignoring the bytes before it */
+	mask = bytescan_skip_head(mask, (uint32) (start - p));
+	if (mask != 0)
+		return (void *) (p + simd_mask_last_byte(mask));
+
+	return NULL;
+#endif
+}
+
+/*
+ * lfind_substr
+ *
+ * Return the offset of the first occurrence of the 'nlen' bytes at 'needle'
+ * in the 'hlen' bytes at 'haystack', or LFIND_NOT_FOUND if there is none.
+ * An empty needle matches at offset 0.
+ *
+ * Each vector step considers sizeof(Vector8) candidate offsets at once: one
+ * load compares the needle's first byte at every offset, and a second load,
+ * nlen - 1 bytes further on, compares its last byte.  Only offsets where
+ * both match are verified with memcmp, which for real text is rare.
+ */
+uint32
+SIMD_FN(lfind_substr)(const uint8 *needle, uint32 nlen,
+					  const uint8 *haystack, uint32 hlen)
+{
+	Vector8		first,
+				last;
+	uint32		npos;			/* number of candidate offsets */
+	uint32		i;
+
+	if (nlen == 0)
+		return 0;
+	if (nlen > hlen)
+		return LFIND_NOT_FOUND;
+	if (nlen == 1)
+	{
+		const uint8 *match = SIMD_FN(simd_memchr)(haystack, needle[0], hlen);
+
+		return match != NULL ? (uint32) (match - haystack) : LFIND_NOT_FOUND;
+	}
+
+	first = vector8_broadcast(needle[0]);
+	last = vector8_broadcast(needle[nlen - 1]);
+	npos = hlen - nlen + 1;
+
+	for (i = 0; i < npos; i += sizeof(Vector8))
+	{
+		Vector8		block_first,
+					block_last;
+		uint32		start = i;
+		uint64		valid = ~UINT64_C(0);
+		uint64		mask;
+
+		if (npos - i >= sizeof(Vector8))
+		{
+			vector8_load(&block_first, &haystack[i]);
+			vector8_load(&block_last, &haystack[i + nlen - 1]);
+		}
+		else if (npos >= sizeof(Vector8))
+		{
+			/* last step: the window ending at the last offset, minus overlap */
+			start = npos - sizeof(Vector8);
+			vector8_load(&block_first, &haystack[start]);
+			vector8_load(&block_last, &haystack[start + nlen - 1]);
+			valid = ~simd_mask_prefix(i - start);
+		}
+		else
+		{
+			/* fewer offsets than fill a vector */
+			vector8_load_partial(&block_first, haystack, npos);
+			vector8_load_partial(&block_last, &haystack[nlen - 1], npos);
+			valid = simd_mask_prefix(npos);
+		}
+
+		mask = vector8_eq_mask(block_first, first) &
+			vector8_eq_mask(block_last, last) & valid;
+
+		/* verify the candidates in order */
+		while (mask != 0)
+		{
+			uint32		pos = simd_mask_first_byte(mask);
+
+			if (memcmp(&haystack[start + pos + 1], &needle[1], nlen - 2) == 0)
+				return start + pos;
+			mask &= ~simd_mask_prefix(pos + 1);
+		}
+	}
+
+	return LFIND_NOT_FOUND;
+}
@@ -1,5 +1,17 @@
-#include "simd.h"
+/*
+ * lfind.c
+ *
+ * Linear search kernels.  This file is compiled once per instruction-set
+ * variant (see simd_internal.h); the exported lfind* functions live in
+ * simd_dispatch.c and call the variant chosen for the running CPU.
+ */
+#include "simd_internal.h"
 
+/*
+ * lfind8 and lfind32 align their main loop for arrays of at least this many
+ * vectors; below it the extra head vector costs more than the split loads.
+ */
+#define LFIND_ALIGN_MIN_VECTORS	16
 
 /*
  * lfind8
@@ -8,7 +20,7 @@
  * return false.
  */
 bool
-lfind8(uint8 key, uint8 *base, uint32 nelem)
+SIMD_FN(lfind8)(uint8 key, uint8 *base, uint32 nelem)
 {
 	uint32		i;
 
@@ -16,18 +28,44 @@ lfind8(uint8 key, uint8 *base, uint32 nelem)
 	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
 	Vector8		chunk;
 
-	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	/* huge one-off scans can bypass the caches, see lfind_set_nt_threshold */
+	if (nelem >= simd_nt_threshold)
+		return SIMD_FN(lfind8_nt)(key, base, nelem);
+
+	/* longer arrays: an unaligned head, then aligned loads, see lfind32 */
+	if (nelem >= LFIND_ALIGN_MIN_VECTORS * sizeof(Vector8) &&
+		((uintptr_t) base & (sizeof(Vector8) - 1)) != 0)
 	{
-		vector8_load(&chunk, &base[i]);
+		vector8_load(&chunk, base);
 		if (vector8_has(chunk, key))
 			return true;
+
+		i = sizeof(Vector8) - ((uintptr_t) base & (sizeof(Vector8) - 1));
+		tail_idx = i + ((nelem - i) & ~(sizeof(Vector8) - 1));
+		for (; i < tail_idx; i += sizeof(Vector8))
+		{
+			vector8_load_aligned(&chunk, &base[i]);
+			if (vector8_has(chunk, key))
+				return true;
+		}
+	}
+	else
+	{
+		for (i = 0; i < tail_idx; i += sizeof(Vector8))
+		{
+			vector8_load(&chunk, &base[i]);
+			if (vector8_has(chunk, key))
+				return true;
+		}
 	}
 
-	/* Process the remaining elements one at a time. */
-	for (; i < nelem; i++)
+	/* finish with one partial vector rather than a scalar loop */
+	if (i < nelem)
 	{
-		if (key == base[i])
-			return true;
+		uint32		start;
+		uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+		return (vector8_eq_mask(chunk, vector8_broadcast(key)) & valid) != 0;
 	}
 
 	return false;
@@ -40,7 +78,7 @@ lfind8(uint8 key, uint8 *base, uint32 nelem)
  * 'key', otherwise return false.
  */
 bool
-lfind8_le(uint8 key, uint8 *base, uint32 nelem)
+SIMD_FN(lfind8_le)(uint8 key, uint8 *base, uint32 nelem)
 {
 	uint32		i;
 
@@ -55,11 +93,14 @@ lfind8_le(uint8 key, uint8 *base, uint32 nelem)
 			return true;
 	}
 
-	/* Process the remaining elements one at a time. */
-	for (; i < nelem; i++)
+	/* finish with one partial vector rather than a scalar loop */
+	if (i < nelem)
 	{
-		if (base[i] <= key)
-			return true;
+		uint32		start;
+		uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+		return (vector8_cmp_mask(vector8_le(chunk, vector8_broadcast(key))) &
+				valid) != 0;
 	}
 
 	return false;
@@ -67,10 +108,19 @@ lfind8_le(uint8 key, uint8 *base, uint32 nelem)
 
 
 bool
-lfind32(uint32 key, uint32 *base, uint32 nelem)
+SIMD_FN(lfind32)(uint32 key, uint32 *base, uint32 nelem)
 {
 	uint32		i = 0;
 
+	/*
+	 * Huge one-off scans can bypass the caches, see lfind_set_nt_threshold(),
+	 * if the array is 4-byte aligned: the non-temporal loads need aligned
+	 * vectors, which an array that isn't can never reach.
+	 */
+	if ((size_t) nelem * sizeof(uint32) >= simd_nt_threshold &&
+		((uintptr_t) base & (sizeof(uint32) - 1)) == 0)
+		return SIMD_FN(lfind32_nt)(key, base, nelem);
+
 	/*
 	 * For better instruction-level parallelism, each loop iteration operates
 	 * on a block of four registers.  Testing for SSE2 has showed this is ~40%
@@ -80,10 +130,35 @@ lfind32(uint32 key, uint32 *base, uint32 nelem)
 	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
 	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
 
-	/* round down to multiple of elements per iteration */
-	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+	bool		aligned = false;
 
-	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	/*
+	 * In a misaligned array, every AVX-512 vector straddles two cache lines,
+	 * as do every other AVX2 vector and every fourth SSE2 one.  For longer
+	 * arrays, test the first vector with an unaligned load, and start the
+	 * blocks at the first aligned element after it, so all their loads are
+	 * aligned.  Elements shared by the two are searched twice, which doesn't
+	 * matter for an existence test.  An array that isn't even 4-byte aligned
+	 * can never reach a vector boundary, so it stays unaligned throughout.
+	 */
+	if (nelem >= LFIND_ALIGN_MIN_VECTORS * nelem_per_vector &&
+		((uintptr_t) base & (sizeof(uint32) - 1)) == 0)
+	{
+		uint32		misalign = (uintptr_t) base & (sizeof(Vector32) - 1);
+
+		if (misalign != 0)
+		{
+			Vector32	vals;
+
+			vector32_load(&vals, base);
+			if (vector32_is_highbit_set(vector32_eq(keys, vals)))
+				return true;
+			i = (sizeof(Vector32) - misalign) / sizeof(uint32);
+		}
+		aligned = true;
+	}
+
+	for (; nelem - i >= nelem_per_iteration; i += nelem_per_iteration)
 	{
 		Vector32	vals1,
 					vals2,
@@ -98,10 +173,20 @@ lfind32(uint32 key, uint32 *base, uint32 nelem)
 					result;
 
 		/* load the next block into 4 registers */
-		vector32_load(&vals1, &base[i]);
-		vector32_load(&vals2, &base[i + nelem_per_vector]);
-		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
-		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+		if (aligned)
+		{
+			vector32_load_aligned(&vals1, &base[i]);
+			vector32_load_aligned(&vals2, &base[i + nelem_per_vector]);
+			vector32_load_aligned(&vals3, &base[i + nelem_per_vector * 2]);
+			vector32_load_aligned(&vals4, &base[i + nelem_per_vector * 3]);
+		}
+		else
+		{
+			vector32_load(&vals1, &base[i]);
+			vector32_load(&vals2, &base[i + nelem_per_vector]);
+			vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+			vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+		}
 
 		/* compare each value to the key */
 		result1 = vector32_eq(keys, vals1);
@@ -121,14 +206,1399 @@ lfind32(uint32 key, uint32 *base, uint32 nelem)
 		}
 	}
 
-	/* Process the remaining elements one at a time. */
-	for (; i < nelem; i++)
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
 	{
-		if (key == base[i])
-		{
+		Vector32	vals;
+
+		vector32_load(&vals, &base[i]);
+		if (vector32_is_highbit_set(vector32_eq(keys, vals)))
 			return true;
-		}
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+
+		return (vector32_cmp_mask(vector32_eq(keys, vals)) & valid) != 0;
+	}
+
+	return false;
+}
+
+/*
+ * lfind16
+ *
+ * Return true if there is an element in 'base' that equals 'key', otherwise
+ * return false.  Same four-register structure as lfind32.
+ */
+bool
+SIMD_FN(lfind16)(uint16 key, uint16 *base, uint32 nelem)
+{
+	uint32		i = 0;
+
+	const Vector16 keys = vector16_broadcast(key);	/* load copies of key */
+	const uint32 nelem_per_vector = sizeof(Vector16) / sizeof(uint16);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector16	vals1,
+					vals2,
+					vals3,
+					vals4,
+					result1,
+					result2,
+					result3,
+					result4,
+					tmp1,
+					tmp2,
+					result;
+
+		/* load the next block into 4 registers */
+		vector16_load(&vals1, &base[i]);
+		vector16_load(&vals2, &base[i + nelem_per_vector]);
+		vector16_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector16_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* compare each value to the key */
+		result1 = vector16_eq(keys, vals1);
+		result2 = vector16_eq(keys, vals2);
+		result3 = vector16_eq(keys, vals3);
+		result4 = vector16_eq(keys, vals4);
+
+		/* combine the results into a single variable */
+		tmp1 = vector16_or(result1, result2);
+		tmp2 = vector16_or(result3, result4);
+		result = vector16_or(tmp1, tmp2);
+
+		/* see if there was a match */
+		if (vector16_is_highbit_set(result))
+			return true;
+	}
+
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector16	vals;
+
+		vector16_load(&vals, &base[i]);
+		if (vector16_is_highbit_set(vector16_eq(keys, vals)))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		Vector16	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail16(&vals, base, i, nelem, &start);
+
+		return (vector16_cmp_mask(vector16_eq(keys, vals)) & valid) != 0;
+	}
+
+	return false;
+}
+
+/*
+ * lfind64
+ *
+ * Return true if there is an element in 'base' that equals 'key', otherwise
+ * return false.  Same four-register structure as lfind32.
+ */
+bool
+SIMD_FN(lfind64)(uint64 key, uint64 *base, uint32 nelem)
+{
+	uint32		i = 0;
+
+	const Vector64 keys = vector64_broadcast(key);	/* load copies of key */
+	const uint32 nelem_per_vector = sizeof(Vector64) / sizeof(uint64);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector64	vals1,
+					vals2,
+					vals3,
+					vals4,
+					result1,
+					result2,
+					result3,
+					result4,
+					tmp1,
+					tmp2,
+					result;
+
+		/* load the next block into 4 registers */
+		vector64_load(&vals1, &base[i]);
+		vector64_load(&vals2, &base[i + nelem_per_vector]);
+		vector64_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector64_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* compare each value to the key */
+		result1 = vector64_eq(keys, vals1);
+		result2 = vector64_eq(keys, vals2);
+		result3 = vector64_eq(keys, vals3);
+		result4 = vector64_eq(keys, vals4);
+
+		/* combine the results into a single variable */
+		tmp1 = vector64_or(result1, result2);
+		tmp2 = vector64_or(result3, result4);
+		result = vector64_or(tmp1, tmp2);
+
+		/* see if there was a match */
+		if (vector64_is_highbit_set(result))
+			return true;
+	}
+
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector64	vals;
+
+		vector64_load(&vals, &base[i]);
+		if (vector64_is_highbit_set(vector64_eq(keys, vals)))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		Vector64	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail64(&vals, base, i, nelem, &start);
+
+		return (vector64_cmp_mask(vector64_eq(keys, vals)) & valid) != 0;
+	}
+
+	return false;
+}
+
+
+/*
+ * lfind8_range
+ *
+ * Return true if there is an element 'x' in 'base' with
+ * lo <= x <= lo + span, otherwise return false.  The arithmetic wraps
+ * modulo 2^8: subtracting 'lo' moves the range to [0, span], so a single
+ * unsigned compare answers the question.  That works for signed data too,
+ * which is how the predicates in lfind_range.c are built.
+ */
+bool
+SIMD_FN(lfind8_range)(uint8 lo, uint8 span, uint8 *base, uint32 nelem)
+{
+	uint32		i;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+	const Vector8 los = vector8_broadcast(lo);
+	const Vector8 spans = vector8_broadcast(span);
+	Vector8		chunk;
+
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		vector8_load(&chunk, &base[i]);
+		if (vector8_is_highbit_set(vector8_le(vector8_sub(chunk, los), spans)))
+			return true;
+	}
+
+	/* finish with one partial vector rather than a scalar loop */
+	if (i < nelem)
+	{
+		uint32		start;
+		uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+		return (vector8_cmp_mask(vector8_le(vector8_sub(chunk, los), spans)) &
+				valid) != 0;
+	}
+
+	return false;
+}
+
+/*
+ * lfind16_range
+ *
+ * Like lfind8_range, for 16-bit elements, using the four-register block of
+ * lfind32.
+ */
+bool
+SIMD_FN(lfind16_range)(uint16 lo, uint16 span, uint16 *base, uint32 nelem)
+{
+	uint32		i = 0;
+
+	const Vector16 los = vector16_broadcast(lo);
+	const Vector16 spans = vector16_broadcast(span);
+	const uint32 nelem_per_vector = sizeof(Vector16) / sizeof(uint16);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector16	vals1,
+					vals2,
+					vals3,
+					vals4,
+					result1,
+					result2,
+					result3,
+					result4,
+					tmp1,
+					tmp2,
+					result;
+
+		/* load the next block into 4 registers */
+		vector16_load(&vals1, &base[i]);
+		vector16_load(&vals2, &base[i + nelem_per_vector]);
+		vector16_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector16_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* shift each value down by 'lo' and compare to the span */
+		result1 = vector16_le(vector16_sub(vals1, los), spans);
+		result2 = vector16_le(vector16_sub(vals2, los), spans);
+		result3 = vector16_le(vector16_sub(vals3, los), spans);
+		result4 = vector16_le(vector16_sub(vals4, los), spans);
+
+		/* combine the results into a single variable */
+		tmp1 = vector16_or(result1, result2);
+		tmp2 = vector16_or(result3, result4);
+		result = vector16_or(tmp1, tmp2);
+
+		/* see if there was a match */
+		if (vector16_is_highbit_set(result))
+			return true;
+	}
+
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector16	vals;
+
+		vector16_load(&vals, &base[i]);
+		if (vector16_is_highbit_set(vector16_le(vector16_sub(vals, los), spans)))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		Vector16	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail16(&vals, base, i, nelem, &start);
+
+		return (vector16_cmp_mask(vector16_le(vector16_sub(vals, los), spans)) & valid) != 0;
 	}
 
 	return false;
-}
\ No newline at end of file
+}
+
+/*
+ * lfind32_range
+ *
+ * Like lfind8_range, for 32-bit elements, using the four-register block of
+ * lfind32.
+ */
+bool
+SIMD_FN(lfind32_range)(uint32 lo, uint32 span, uint32 *base, uint32 nelem)
+{
+	uint32		i = 0;
+
+	const Vector32 los = vector32_broadcast(lo);
+	const Vector32 spans = vector32_broadcast(span);
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4,
+					result1,
+					result2,
+					result3,
+					result4,
+					tmp1,
+					tmp2,
+					result;
+
+		/* load the next block into 4 registers */
+		vector32_load(&vals1, &base[i]);
+		vector32_load(&vals2, &base[i + nelem_per_vector]);
+		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* shift each value down by 'lo' and compare to the span */
+		result1 = vector32_le(vector32_sub(vals1, los), spans);
+		result2 = vector32_le(vector32_sub(vals2, los), spans);
+		result3 = vector32_le(vector32_sub(vals3, los), spans);
+		result4 = vector32_le(vector32_sub(vals4, los), spans);
+
+		/* combine the results into a single variable */
+		tmp1 = vector32_or(result1, result2);
+		tmp2 = vector32_or(result3, result4);
+		result = vector32_or(tmp1, tmp2);
+
+		/* see if there was a match */
+		if (vector32_is_highbit_set(result))
+			return true;
+	}
+
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector32	vals;
+
+		vector32_load(&vals, &base[i]);
+		if (vector32_is_highbit_set(vector32_le(vector32_sub(vals, los), spans)))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+
+		return (vector32_cmp_mask(vector32_le(vector32_sub(vals, los), spans)) & valid) != 0;
+	}
+
+	return false;
+}
+
+/*
+ * lfind8_index
+ *
+ * Return the index of the first element in 'base' that equals 'key', or
+ * LFIND_NOT_FOUND if there is none.
+ */
+uint32
+SIMD_FN(lfind8_index)(uint8 key, uint8 *base, uint32 nelem)
+{
+	uint32		i;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+	const Vector8 keys = vector8_broadcast(key);
+	Vector8		chunk;
+
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		uint64		mask;
+
+		vector8_load(&chunk, &base[i]);
+		mask = vector8_eq_mask(chunk, keys);
+		if (mask != 0)
+			return i + simd_mask_first_byte(mask);
+	}
+
+	/* finish with one partial vector rather than a scalar loop */
+	if (i < nelem)
+	{
+		uint32		start;
+		uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+		uint64		mask = vector8_eq_mask(chunk, keys) & valid;
+
+		if (mask != 0)
+			return start + simd_mask_first_byte(mask);
+	}
+
+	return LFIND_NOT_FOUND;
+}
+
+/*
+ * lfind32_index
+ *
+ * Return the index of the first element in 'base' that equals 'key', or
+ * LFIND_NOT_FOUND if there is none.
+ */
+uint32
+SIMD_FN(lfind32_index)(uint32 key, uint32 *base, uint32 nelem)
+{
+	uint32		i = 0;
+
+	/* same four-register block as lfind32 */
+	const Vector32 keys = vector32_broadcast(key);	/* load copies of key */
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4,
+					result1,
+					result2,
+					result3,
+					result4,
+					tmp1,
+					tmp2,
+					result;
+		uint64		mask;
+
+		/* load the next block into 4 registers */
+		vector32_load(&vals1, &base[i]);
+		vector32_load(&vals2, &base[i + nelem_per_vector]);
+		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* compare each value to the key */
+		result1 = vector32_eq(keys, vals1);
+		result2 = vector32_eq(keys, vals2);
+		result3 = vector32_eq(keys, vals3);
+		result4 = vector32_eq(keys, vals4);
+
+		/* combine the results into a single variable */
+		tmp1 = vector32_or(result1, result2);
+		tmp2 = vector32_or(result3, result4);
+		result = vector32_or(tmp1, tmp2);
+
+		/* stay on the fast path unless there was a match */
+		if (!vector32_is_highbit_set(result))
+			continue;
+
+		/*
+		 * Find which register fired from the compare results we already
+		 * have, rather than rescanning the block.
+		 */
+		if ((mask = vector32_cmp_mask(result1)) != 0)
+			return i + simd_mask_first_byte(mask) / sizeof(uint32);
+		if ((mask = vector32_cmp_mask(result2)) != 0)
+			return i + nelem_per_vector +
+				simd_mask_first_byte(mask) / sizeof(uint32);
+		if ((mask = vector32_cmp_mask(result3)) != 0)
+			return i + nelem_per_vector * 2 +
+				simd_mask_first_byte(mask) / sizeof(uint32);
+		mask = vector32_cmp_mask(result4);
+		return i + nelem_per_vector * 3 +
+			simd_mask_first_byte(mask) / sizeof(uint32);
+	}
+
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector32	vals;
+		uint64		mask;
+
+		vector32_load(&vals, &base[i]);
+		if ((mask = vector32_eq_mask(keys, vals)) != 0)
+			return i + simd_mask_first_byte(mask) / sizeof(uint32);
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+		uint64		mask = vector32_eq_mask(keys, vals) & valid;
+
+		if (mask != 0)
+			return start + simd_mask_first_byte(mask) / sizeof(uint32);
+	}
+
+	return LFIND_NOT_FOUND;
+}
+
+/*
+ * lfind8_count
+ *
+ * Return the number of elements in 'base' that equal 'key'.
+ */
+uint32
+SIMD_FN(lfind8_count)(uint8 key, uint8 *base, uint32 nelem)
+{
+	uint32		i;
+	uint32		count = 0;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+	const Vector8 keys = vector8_broadcast(key);
+	Vector8		chunk;
+
+	/* no early exit: every vector contributes its popcount */
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		vector8_load(&chunk, &base[i]);
+		count += simd_mask_count_bytes(vector8_eq_mask(chunk, keys));
+	}
+
+	/* finish with one partial vector rather than a scalar loop */
+	if (i < nelem)
+	{
+		uint32		start;
+		uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+		count += simd_mask_count_bytes(vector8_eq_mask(chunk, keys) & valid);
+	}
+
+	return count;
+}
+
+/*
+ * lfind32_count
+ *
+ * Return the number of elements in 'base' that equal 'key'.
+ */
+uint32
+SIMD_FN(lfind32_count)(uint32 key, uint32 *base, uint32 nelem)
+{
+	uint32		i = 0;
+	uint32		count = 0;
+
+	/* same four-register block as lfind32 */
+	const Vector32 keys = vector32_broadcast(key);	/* load copies of key */
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4;
+		uint32		nbytes;
+
+		/* load the next block into 4 registers */
+		vector32_load(&vals1, &base[i]);
+		vector32_load(&vals2, &base[i + nelem_per_vector]);
+		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* count the matching bytes of each compare result */
+		nbytes = simd_mask_count_bytes(vector32_eq_mask(keys, vals1)) +
+			simd_mask_count_bytes(vector32_eq_mask(keys, vals2)) +
+			simd_mask_count_bytes(vector32_eq_mask(keys, vals3)) +
+			simd_mask_count_bytes(vector32_eq_mask(keys, vals4));
+
+		count += nbytes / sizeof(uint32);
+	}
+
+	/* then single vectors, and one partial vector instead of a scalar loop */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector32	vals;
+
+		vector32_load(&vals, &base[i]);
+		count += simd_mask_count_bytes(vector32_eq_mask(keys, vals)) /
+			sizeof(uint32);
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+
+		count += simd_mask_count_bytes(vector32_eq_mask(keys, vals) & valid) /
+			sizeof(uint32);
+	}
+
+	return count;
+}
+
+/*
+ * lfind8_mask
+ *
+ * Set bit i of 'bitmap' (bit i % 8 of byte i / 8) if base[i] equals 'key',
+ * and clear it otherwise.  Exactly LFIND_BITMAP_BYTES(nelem) bytes are
+ * written.  Returns the number of matches.
+ */
+uint32
+SIMD_FN(lfind8_mask)(uint8 key, uint8 *base, uint32 nelem, uint8 *bitmap)
+{
+	uint32		i;
+	uint32		count = 0;
+	uint64		tail_bits = 0;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+	const Vector8 keys = vector8_broadcast(key);
+	Vector8		chunk;
+
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		uint64		bits;
+
+		vector8_load(&chunk, &base[i]);
+		bits = vector8_bitmask(vector8_eq(chunk, keys));
+		simd_store_bitmask(&bitmap[i / 8], bits, sizeof(Vector8));
+		count += __builtin_popcountll(bits);
+	}
+
+	/*
+	 * Finish with one partial vector rather than a scalar loop.  Shifting
+	 * out the lanes before base[i] drops any overlap with elements already
+	 * done, and the lanes past the end are masked off.
+	 */
+	if (i < nelem)
+	{
+		uint32		start;
+
+		(void) simd_load_tail8(&chunk, base, i, nelem, &start);
+		tail_bits = (vector8_bitmask(vector8_eq(chunk, keys)) >> (i - start)) &
+			((UINT64_C(1) << (nelem - i)) - 1);
+		simd_store_bitmask(&bitmap[i / 8], tail_bits, nelem - i);
+		count += __builtin_popcountll(tail_bits);
+	}
+
+	return count;
+}
+
+/*
+ * lfind32_mask
+ *
+ * Set bit i of 'bitmap' (bit i % 8 of byte i / 8) if base[i] equals 'key',
+ * and clear it otherwise.  Exactly LFIND_BITMAP_BYTES(nelem) bytes are
+ * written.  Returns the number of matches.
+ */
+uint32
+SIMD_FN(lfind32_mask)(uint32 key, uint32 *base, uint32 nelem, uint8 *bitmap)
+{
+	uint32		i = 0;
+	uint32		count = 0;
+	uint64		tail_bits = 0;
+
+	/* same four-register block as lfind32 */
+	const Vector32 keys = vector32_broadcast(key);	/* load copies of key */
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4;
+		uint64		bits;
+
+		/* load the next block into 4 registers */
+		vector32_load(&vals1, &base[i]);
+		vector32_load(&vals2, &base[i + nelem_per_vector]);
+		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/*
+		 * Concatenate the per-register bitmasks.  A block is at most 64
+		 * elements (AVX-512), so it always fits in one word.
+		 */
+		bits = vector32_bitmask(vector32_eq(keys, vals1)) |
+			(vector32_bitmask(vector32_eq(keys, vals2)) << nelem_per_vector) |
+			(vector32_bitmask(vector32_eq(keys, vals3)) << (nelem_per_vector * 2)) |
+			(vector32_bitmask(vector32_eq(keys, vals4)) << (nelem_per_vector * 3));
+
+		simd_store_bitmask(&bitmap[i / 8], bits, nelem_per_iteration);
+		count += __builtin_popcountll(bits);
+	}
+
+	/*
+	 * Then single vectors, and one partial vector as in lfind8_mask.  The
+	 * remainder is less than a block, so its bits fit in one word; storing
+	 * them together keeps the store at a byte boundary.
+	 */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector32	vals;
+
+		vector32_load(&vals, &base[i]);
+		tail_bits |= vector32_bitmask(vector32_eq(keys, vals)) << (i - tail_idx);
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals;
+		uint32		start;
+		uint64		bits;
+
+		(void) simd_load_tail32(&vals, base, i, nelem, &start);
+		bits = (vector32_bitmask(vector32_eq(keys, vals)) >> (i - start)) &
+			((UINT64_C(1) << (nelem - i)) - 1);
+		tail_bits |= bits << (i - tail_idx);
+	}
+
+	simd_store_bitmask(&bitmap[tail_idx / 8], tail_bits, nelem - tail_idx);
+	count += __builtin_popcountll(tail_bits);
+
+	return count;
+}
+
+/*
+ * Most keys the _any variants broadcast at once.  lfind32_any handles larger
+ * key sets in groups of this size; lfind8_any switches to nibble tables.
+ */
+#define LFIND_ANY_MAX_BROADCAST	16
+
+/*
+ * With table lookups available, lfind8_any uses them for byte sets larger
+ * than this, where one compare per key costs more than the fixed-cost
+ * lookup sequence.
+ */
+#define LFIND8_ANY_LOOKUP_MIN	4
+
+/*
+ * lfind8_any
+ *
+ * Return true if any element in 'base' equals any of the 'nkeys' values in
+ * 'keys', otherwise return false.  The array is read only once no matter
+ * how many keys there are.
+ */
+bool
+SIMD_FN(lfind8_any)(const uint8 *keys, uint32 nkeys, uint8 *base, uint32 nelem)
+{
+	uint8		set[256 / 8];
+	uint8		distinct[LFIND_ANY_MAX_BROADCAST];
+	uint32		ndistinct = 0;
+	uint32		i = 0;
+	uint32		j;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+
+	/* collect the distinct keys into a membership bitmap */
+	memset(set, 0, sizeof(set));
+	for (j = 0; j < nkeys; j++)
+	{
+		uint8		c = keys[j];
+
+		if (set[c >> 3] & (1 << (c & 7)))
+			continue;
+		set[c >> 3] |= 1 << (c & 7);
+		if (ndistinct < LFIND_ANY_MAX_BROADCAST)
+			distinct[ndistinct] = c;
+		ndistinct++;
+	}
+
+	if (ndistinct == 0)
+		return false;
+	if (ndistinct == 1)
+		return SIMD_FN(lfind8)(distinct[0], base, nelem);
+
+#ifdef VECTOR8_HAS_LOOKUP
+	if (ndistinct > LFIND8_ANY_LOOKUP_MIN)
+	{
+		ByteSetLuts luts;
+		uint8		row0[16];
+		uint8		row1[16];
+
+		byteset_build_rows(set, row0, row1);
+		byteset_load_luts(&luts, row0, row1);
+		for (i = 0; i < tail_idx; i += sizeof(Vector8))
+		{
+			Vector8		chunk;
+
+			vector8_load(&chunk, &base[i]);
+			if (vector8_is_highbit_set(byteset_match(chunk, &luts)))
+				return true;
+		}
+
+		if (i < nelem)
+		{
+			Vector8		chunk;
+			uint32		start;
+			uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+			return (vector8_cmp_mask(byteset_match(chunk, &luts)) & valid) != 0;
+		}
+		return false;
+	}
+	else
+#endif
+	if (ndistinct <= LFIND_ANY_MAX_BROADCAST)
+	{
+		Vector8		keyvecs[LFIND_ANY_MAX_BROADCAST];
+
+		/* broadcast each key once, then OR the compares per chunk */
+		for (j = 0; j < ndistinct; j++)
+			keyvecs[j] = vector8_broadcast(distinct[j]);
+
+		for (i = 0; i < tail_idx; i += sizeof(Vector8))
+		{
+			Vector8		chunk,
+						result;
+
+			vector8_load(&chunk, &base[i]);
+			result = vector8_eq(chunk, keyvecs[0]);
+			for (j = 1; j < ndistinct; j++)
+				result = vector8_or(result, vector8_eq(chunk, keyvecs[j]));
+
+			if (vector8_is_highbit_set(result))
+				return true;
+		}
+
+		if (i < nelem)
+		{
+			Vector8		chunk,
+						result;
+			uint32		start;
+			uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+			result = vector8_eq(chunk, keyvecs[0]);
+			for (j = 1; j < ndistinct; j++)
+				result = vector8_or(result, vector8_eq(chunk, keyvecs[j]));
+
+			return (vector8_cmp_mask(result) & valid) != 0;
+		}
+		return false;
+	}
+
+	/*
+	 * Without table lookups, big key sets are searched one byte at a time,
+	 * where one bitmap probe per byte beats dozens of compares per vector.
+	 */
+	for (; i < nelem; i++)
+	{
+		if (set[base[i] >> 3] & (1 << (base[i] & 7)))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * lfind32_any
+ *
+ * Return true if any element in 'base' equals any of the 'nkeys' values in
+ * 'keys', otherwise return false.  Up to LFIND_ANY_MAX_BROADCAST keys are
+ * handled in a single pass over the array; larger key sets take one pass
+ * per group of that many keys.
+ */
+bool
+SIMD_FN(lfind32_any)(const uint32 *keys, uint32 nkeys, uint32 *base, uint32 nelem)
+{
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+
+	/* round down to multiple of vector length */
+	const uint32 tail_idx = nelem & ~(nelem_per_vector - 1);
+	uint32		k;
+
+	if (nkeys == 1)
+		return SIMD_FN(lfind32)(keys[0], base, nelem);
+
+	for (k = 0; k < nkeys; k += LFIND_ANY_MAX_BROADCAST)
+	{
+		Vector32	keyvecs[LFIND_ANY_MAX_BROADCAST];
+		uint32		ngroup = nkeys - k;
+		uint32		i;
+		uint32		j;
+
+		if (ngroup > LFIND_ANY_MAX_BROADCAST)
+			ngroup = LFIND_ANY_MAX_BROADCAST;
+
+		/* broadcast each key of the group once */
+		for (j = 0; j < ngroup; j++)
+			keyvecs[j] = vector32_broadcast(keys[k + j]);
+
+		for (i = 0; i < tail_idx; i += nelem_per_vector)
+		{
+			Vector32	vals,
+						result;
+
+			vector32_load(&vals, &base[i]);
+			result = vector32_eq(vals, keyvecs[0]);
+			for (j = 1; j < ngroup; j++)
+				result = vector32_or(result, vector32_eq(vals, keyvecs[j]));
+
+			if (vector32_is_highbit_set(result))
+				return true;
+		}
+
+		/* finish with one partial vector rather than a scalar loop */
+		if (i < nelem)
+		{
+			Vector32	vals,
+						result;
+			uint32		start;
+			uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+
+			result = vector32_eq(vals, keyvecs[0]);
+			for (j = 1; j < ngroup; j++)
+				result = vector32_or(result, vector32_eq(vals, keyvecs[j]));
+
+			if ((vector32_cmp_mask(result) & valid) != 0)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Keys compared against each loaded vector by the _batch variants.  The
+ * independent compares give more instruction-level parallelism than the
+ * four-register blocks of lfind32, from one load instead of four, and the
+ * match test is shared by all of them.  Eight keys plus their results still
+ * fit in the sixteen SSE2/AVX2 registers, give or take a spill.
+ */
+#define LFIND_BATCH_GROUP	8
+
+/*
+ * The first pass over 'base' prefetches this many elements ahead, once the
+ * array is large enough that it may not already be cached.  Later groups of
+ * keys find the array in L1.
+ */
+#define LFIND_BATCH_PREFETCH_DISTANCE	64
+#define LFIND_BATCH_PREFETCH_MIN	1024
+
+/*
+ * Record the first match of each key of a batch group that is still
+ * unresolved.  'results' holds the group's compare results for the vector
+ * starting at element 'i', of which only the lanes in 'valid' count.
+ * Returns the updated bitmask of resolved keys.
+ */
+static inline uint32
+lfind32_batch_record(const Vector32 *results, uint32 i, uint64 valid,
+					 uint32 found, uint32 *indexes)
+{
+	uint32		j;
+
+	for (j = 0; j < LFIND_BATCH_GROUP; j++)
+	{
+		uint64		mask;
+
+		if ((found & (1 << j)) == 0 &&
+			(mask = vector32_cmp_mask(results[j]) & valid) != 0)
+		{
+			indexes[j] = i + simd_mask_first_byte(mask) / sizeof(uint32);
+			found |= 1 << j;
+		}
+	}
+
+	return found;
+}
+
+/*
+ * Search 'base' for one group of LFIND_BATCH_GROUP keys.  Sets indexes[j] to
+ * the position of the first occurrence of keys[j] for every key that is
+ * present, and returns the bitmask of those keys.
+ */
+static inline uint32
+lfind32_batch_group(const uint32 *keys, uint32 *base, uint32 nelem,
+					bool prefetch, uint32 *indexes)
+{
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 all_found = (1 << LFIND_BATCH_GROUP) - 1;
+
+	/* round down to multiple of vector length */
+	const uint32 tail_idx = nelem & ~(nelem_per_vector - 1);
+	Vector32	keyvecs[LFIND_BATCH_GROUP];
+	Vector32	results[LFIND_BATCH_GROUP];
+	Vector32	vals,
+				tmp1,
+				tmp2;
+	uint32		found = 0;
+	uint32		i;
+	uint32		j;
+
+	for (j = 0; j < LFIND_BATCH_GROUP; j++)
+		keyvecs[j] = vector32_broadcast(keys[j]);
+
+	for (i = 0; i < tail_idx; i += nelem_per_vector)
+	{
+		if (prefetch)
+			__builtin_prefetch(&base[i + LFIND_BATCH_PREFETCH_DISTANCE]);
+
+		vector32_load(&vals, &base[i]);
+		for (j = 0; j < LFIND_BATCH_GROUP; j++)
+			results[j] = vector32_eq(vals, keyvecs[j]);
+
+		/* stay on the fast path unless some key matched */
+		tmp1 = vector32_or(vector32_or(results[0], results[1]),
+						   vector32_or(results[2], results[3]));
+		tmp2 = vector32_or(vector32_or(results[4], results[5]),
+						   vector32_or(results[6], results[7]));
+		if (!vector32_is_highbit_set(vector32_or(tmp1, tmp2)))
+			continue;
+
+		found = lfind32_batch_record(results, i, ~UINT64_C(0), found, indexes);
+		if (found == all_found)
+			return found;
+	}
+
+	/* finish with one partial vector rather than a scalar loop */
+	if (i < nelem)
+	{
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+
+		for (j = 0; j < LFIND_BATCH_GROUP; j++)
+			results[j] = vector32_eq(vals, keyvecs[j]);
+
+		found = lfind32_batch_record(results, start, valid, found, indexes);
+	}
+
+	return found;
+}
+
+/*
+ * Copy the next group of keys, repeating the last key to fill a short final
+ * group.  Returns the number of real keys in the group.
+ */
+static inline uint32
+lfind32_batch_keys(const uint32 *keys, uint32 nkeys, uint32 k, uint32 *group)
+{
+	uint32		ngroup = nkeys - k;
+	uint32		j;
+
+	if (ngroup > LFIND_BATCH_GROUP)
+		ngroup = LFIND_BATCH_GROUP;
+
+	for (j = 0; j < LFIND_BATCH_GROUP; j++)
+		group[j] = keys[k + (j < ngroup ? j : ngroup - 1)];
+
+	return ngroup;
+}
+
+/*
+ * lfind32_batch
+ *
+ * Search 'base' for each of the 'nkeys' values in 'keys', and set bit k of
+ * 'bitmap' (LSB first) if keys[k] is present.  Writes
+ * LFIND_BITMAP_BYTES(nkeys) bytes and returns the number of keys found.
+ *
+ * Keys are processed LFIND_BATCH_GROUP at a time, so each vector of 'base'
+ * is loaded once per group rather than once per key.
+ */
+uint32
+SIMD_FN(lfind32_batch)(const uint32 *keys, uint32 nkeys, uint32 *base,
+					   uint32 nelem, uint8 *bitmap)
+{
+	uint32		count = 0;
+	uint32		k;
+
+	memset(bitmap, 0, LFIND_BITMAP_BYTES(nkeys));
+
+	for (k = 0; k < nkeys; k += LFIND_BATCH_GROUP)
+	{
+		uint32		group[LFIND_BATCH_GROUP];
+		uint32		indexes[LFIND_BATCH_GROUP];
+		uint32		ngroup = lfind32_batch_keys(keys, nkeys, k, group);
+		uint32		found;
+		uint32		j;
+
+		found = lfind32_batch_group(group, base, nelem,
+									k == 0 && nelem >= LFIND_BATCH_PREFETCH_MIN,
+									indexes);
+		for (j = 0; j < ngroup; j++)
+		{
+			if (found & (1 << j))
+			{
+				bitmap[(k + j) / 8] |= (uint8) (1 << ((k + j) % 8));
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+/*
+ * lfind32_index_batch
+ *
+ * Set indexes[k] to the index of the first element in 'base' that equals
+ * keys[k], or LFIND_NOT_FOUND if there is none.  Returns the number of keys
+ * found.
+ */
+uint32
+SIMD_FN(lfind32_index_batch)(const uint32 *keys, uint32 nkeys, uint32 *base,
+							 uint32 nelem, uint32 *indexes)
+{
+	uint32		count = 0;
+	uint32		k;
+
+	for (k = 0; k < nkeys; k += LFIND_BATCH_GROUP)
+	{
+		uint32		group[LFIND_BATCH_GROUP];
+		uint32		group_indexes[LFIND_BATCH_GROUP];
+		uint32		ngroup = lfind32_batch_keys(keys, nkeys, k, group);
+		uint32		found;
+		uint32		j;
+
+		found = lfind32_batch_group(group, base, nelem,
+									k == 0 && nelem >= LFIND_BATCH_PREFETCH_MIN,
+									group_indexes);
+		for (j = 0; j < ngroup; j++)
+		{
+			if (found & (1 << j))
+			{
+				indexes[k + j] = group_indexes[j];
+				count++;
+			}
+			else
+				indexes[k + j] = LFIND_NOT_FOUND;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * lfind8_padded
+ *
+ * Like lfind8, for callers that guarantee LFIND_PADDING readable bytes after
+ * the last element.  The final vector is then loaded in full, whatever the
+ * page layout, and the lanes past the end are simply masked off.
+ */
+bool
+SIMD_FN(lfind8_padded)(uint8 key, uint8 *base, uint32 nelem)
+{
+	uint32		i;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+	Vector8		chunk;
+
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		vector8_load(&chunk, &base[i]);
+		if (vector8_has(chunk, key))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		vector8_load(&chunk, &base[i]);
+		return (vector8_eq_mask(chunk, vector8_broadcast(key)) &
+				simd_mask_prefix(nelem - i)) != 0;
+	}
+
+	return false;
+}
+
+/*
+ * lfind32_padded
+ *
+ * Like lfind32, for callers that guarantee LFIND_PADDING readable bytes
+ * after the last element; see lfind8_padded.
+ */
+bool
+SIMD_FN(lfind32_padded)(uint32 key, uint32 *base, uint32 nelem)
+{
+	uint32		i = 0;
+
+	/* same four-register block as lfind32 */
+	const Vector32 keys = vector32_broadcast(key);	/* load copies of key */
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+
+	/* round down to multiple of elements per iteration */
+	const uint32 tail_idx = nelem & ~(nelem_per_iteration - 1);
+
+	for (i = 0; i < tail_idx; i += nelem_per_iteration)
+	{
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4,
+					result;
+
+		/* load the next block into 4 registers */
+		vector32_load(&vals1, &base[i]);
+		vector32_load(&vals2, &base[i + nelem_per_vector]);
+		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		/* compare each value to the key and combine the results */
+		result = vector32_or(vector32_or(vector32_eq(keys, vals1),
+										 vector32_eq(keys, vals2)),
+							 vector32_or(vector32_eq(keys, vals3),
+										 vector32_eq(keys, vals4)));
+
+		if (vector32_is_highbit_set(result))
+			return true;
+	}
+
+	/* then whole vectors, the last of which may run into the padding */
+	for (; i < nelem; i += nelem_per_vector)
+	{
+		Vector32	vals;
+		uint64		mask;
+
+		vector32_load(&vals, &base[i]);
+		mask = vector32_eq_mask(keys, vals);
+		if (nelem - i < nelem_per_vector)
+			mask &= simd_mask_prefix((nelem - i) * sizeof(uint32));
+		if (mask != 0)
+			return true;
+	}
+
+	return false;
+}
+
+/* bytes covered by one prefetch */
+#define LFIND_NT_LINE	64
+
+/*
+ * lfind8_nt
+ *
+ * Like lfind8, for huge arrays that are scanned once and not needed again
+ * soon, such as a cold column or a freshly mapped file.  A normal scan
+ * pulls every line of the array through the caches, evicting the hot data
+ * of whatever else runs on the same core or socket.  This one prefetches
+ * simd_prefetch_distance bytes ahead with a non-temporal hint (prefetchnta
+ * on x86, PLDL1STRM on Arm) and reads the aligned body with non-temporal
+ * loads, so that the array mostly bypasses the caches.  It runs at about
+ * the speed of lfind8 on data in memory and is slower on cached data.
+ */
+bool
+SIMD_FN(lfind8_nt)(uint8 key, uint8 *base, uint32 nelem)
+{
+	const Vector8 keys = vector8_broadcast(key);
+	const uint32 nelem_per_iteration = 4 * sizeof(Vector8);
+	const uint32 distance = simd_prefetch_distance;
+	uint32		head = (uint32) (-(uintptr_t) base & (sizeof(Vector8) - 1));
+	uint32		i = 0;
+
+	/* an unaligned start, up to the first vector boundary */
+	if (head > 0)
+	{
+		Vector8		chunk;
+
+		if (head > nelem)
+			head = nelem;
+		vector8_load_partial(&chunk, base, head);
+		if ((vector8_eq_mask(chunk, keys) & simd_mask_prefix(head)) != 0)
+			return true;
+		i = head;
+	}
+
+	for (; nelem - i >= nelem_per_iteration; i += nelem_per_iteration)
+	{
+		Vector8		vals1,
+					vals2,
+					vals3,
+					vals4;
+		uint32		line;
+
+		for (line = 0; line < nelem_per_iteration; line += LFIND_NT_LINE)
+			__builtin_prefetch(&base[i] + distance + line, 0, 0);
+
+		vector8_load_nt(&vals1, &base[i]);
+		vector8_load_nt(&vals2, &base[i + sizeof(Vector8)]);
+		vector8_load_nt(&vals3, &base[i + sizeof(Vector8) * 2]);
+		vector8_load_nt(&vals4, &base[i + sizeof(Vector8) * 3]);
+
+		if (vector8_is_highbit_set(vector8_or(vector8_or(vector8_eq(keys, vals1),
+														 vector8_eq(keys, vals2)),
+											  vector8_or(vector8_eq(keys, vals3),
+														 vector8_eq(keys, vals4)))))
+			return true;
+	}
+
+	for (; nelem - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		Vector8		chunk;
+
+		vector8_load_nt(&chunk, &base[i]);
+		if (vector8_has(chunk, key))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		Vector8		chunk;
+		uint32		start;
+		uint64		valid = simd_load_tail8(&chunk, base, i, nelem, &start);
+
+		return (vector8_eq_mask(chunk, keys) & valid) != 0;
+	}
+
+	return false;
+}
+
+/*
+ * lfind32_nt
+ *
+ * Like lfind32, bypassing the caches as far as possible; see lfind8_nt.
+ * An array that isn't 4-byte aligned never reaches a vector boundary, so it
+ * can't use the non-temporal loads and gets a normal scan instead.
+ */
+bool
+SIMD_FN(lfind32_nt)(uint32 key, uint32 *base, uint32 nelem)
+{
+	const Vector32 keys = vector32_broadcast(key);
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+	const uint32 distance = simd_prefetch_distance;
+	uint32		head = (uint32) (-(uintptr_t) base & (sizeof(Vector32) - 1)) /
+		sizeof(uint32);
+	uint32		i = 0;
+
+	if (((uintptr_t) base & (sizeof(uint32) - 1)) != 0)
+		return SIMD_FN(lfind32)(key, base, nelem);
+
+	/* an unaligned start, up to the first vector boundary */
+	if (head > 0)
+	{
+		Vector32	vals;
+
+		if (head > nelem)
+			head = nelem;
+		vector32_load_partial(&vals, base, head);
+		if ((vector32_eq_mask(keys, vals) &
+			 simd_mask_prefix(head * sizeof(uint32))) != 0)
+			return true;
+		i = head;
+	}
+
+	for (; nelem - i >= nelem_per_iteration; i += nelem_per_iteration)
+	{
+		const uint8 *block = (const uint8 *) &base[i];
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4;
+		uint32		line;
+
+		for (line = 0; line < sizeof(Vector32) * 4; line += LFIND_NT_LINE)
+			__builtin_prefetch(block + distance + line, 0, 0);
+
+		vector32_load_nt(&vals1, &base[i]);
+		vector32_load_nt(&vals2, &base[i + nelem_per_vector]);
+		vector32_load_nt(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load_nt(&vals4, &base[i + nelem_per_vector * 3]);
+
+		if (vector32_is_highbit_set(vector32_or(vector32_or(vector32_eq(keys, vals1),
+															vector32_eq(keys, vals2)),
+												vector32_or(vector32_eq(keys, vals3),
+															vector32_eq(keys, vals4)))))
+			return true;
+	}
+
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector32	vals;
+
+		vector32_load_nt(&vals, &base[i]);
+		if (vector32_is_highbit_set(vector32_eq(keys, vals)))
+			return true;
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals;
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, base, i, nelem, &start);
+
+		return (vector32_cmp_mask(vector32_eq(keys, vals)) & valid) != 0;
+	}
+
+	return false;
+}
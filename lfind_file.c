@@ -0,0 +1,186 @@
+/*
+ * lfind_file.c
+ *
+ * Scans of binary column files, searched in place through mmap() rather
+ * than read into a buffer first.
+ *
+ * The whole file is mapped at once and handed to the kernels in chunks of
+ * whole pages, since the kernels take 32-bit element counts and files can
+ * hold more elements than that.  The mapping is advised MADV_SEQUENTIAL, so
+ * the kernel reads ahead aggressively, and MADV_HUGEPAGE where the system
+ * supports huge pages for file mappings.  Chunks already scanned are
+ * dropped from the mapping with MADV_DONTNEED, which keeps the resident
+ * size of a multi-GB scan down to about one chunk; the file's pages stay in
+ * the page cache.
+ */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simd.h"
+
+/* default chunk size, big enough that the madvise() calls don't matter */
+#define LFIND_FILE_DEFAULT_CHUNK_BYTES	(64 * 1024 * 1024)
+
+/* keeps the element count of a byte chunk within a uint32 */
+#define LFIND_FILE_MAX_CHUNK_BYTES	(1024 * 1024 * 1024)
+
+/*
+ * Chunks hold a multiple of this many elements, so that each chunk's part
+ * of a LFIND_FILE_MASK bitmap starts at a byte boundary.
+ */
+#define LFIND_FILE_CHUNK_ALIGN	8
+
+/*
+ * Run the scan's kernel over the 'nelem' elements at 'base', which are
+ * elements 'first' onward of the file.
+ */
+static uint32
+lfind_file_chunk(const LfindFileScan *scan, uint8 *base, uint32 nelem,
+				 uint64 first)
+{
+	uint8	   *bitmap = scan->bitmap + first / 8;
+	uint32	   *words = (uint32 *) base;
+
+	if (scan->elem_size == sizeof(uint8))
+	{
+		uint8		key = (uint8) scan->key;
+
+		if (scan->op == LFIND_FILE_FIND)
+			return scan->parallel ? lfind8_parallel(key, base, nelem, scan->pool) :
+				lfind8(key, base, nelem);
+		if (scan->op == LFIND_FILE_COUNT)
+			return scan->parallel ? lfind8_count_parallel(key, base, nelem, scan->pool) :
+				lfind8_count(key, base, nelem);
+		return scan->parallel ? lfind8_mask_parallel(key, base, nelem, bitmap, scan->pool) :
+			lfind8_mask(key, base, nelem, bitmap);
+	}
+	else
+	{
+		uint32		key = (uint32) scan->key;
+
+		if (scan->op == LFIND_FILE_FIND)
+			return scan->parallel ? lfind32_parallel(key, words, nelem, scan->pool) :
+				lfind32(key, words, nelem);
+		if (scan->op == LFIND_FILE_COUNT)
+			return scan->parallel ? lfind32_count_parallel(key, words, nelem, scan->pool) :
+				lfind32_count(key, words, nelem);
+		return scan->parallel ? lfind32_mask_parallel(key, words, nelem, bitmap, scan->pool) :
+			lfind32_mask(key, words, nelem, bitmap);
+	}
+}
+
+/*
+ * lfind_file_scan_fd
+ *
+ * Run 'scan' over the file open for reading on 'fd', taken as an array of
+ * scan->elem_size byte elements; a trailing partial element is ignored.
+ * Returns 1 or 0 for LFIND_FILE_FIND, and the number of matches for the
+ * other operations.  Returns -1 and sets errno if the scan is invalid or
+ * the file cannot be mapped.  'fd' is not closed.
+ */
+int64
+lfind_file_scan_fd(int fd, const LfindFileScan *scan)
+{
+	struct stat st;
+	long		page_size = sysconf(_SC_PAGESIZE);
+	uint64		chunk_bytes;
+	uint64		size;
+	uint64		nelem;
+	uint64		first;
+	uint8	   *map;
+	int64		result = 0;
+
+	if ((scan->elem_size != sizeof(uint8) && scan->elem_size != sizeof(uint32)) ||
+		scan->op > LFIND_FILE_MASK ||
+		(scan->op == LFIND_FILE_MASK && scan->bitmap == NULL) ||
+		scan->key > (scan->elem_size == sizeof(uint8) ? UINT8_MAX : UINT32_MAX))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0)
+		return -1;
+	if (!S_ISREG(st.st_mode))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	size = (uint64) st.st_size;
+	nelem = size / scan->elem_size;
+	if (nelem == 0)
+		return 0;
+
+	/* whole pages, and a whole number of bitmap bytes */
+	chunk_bytes = scan->chunk_bytes ? scan->chunk_bytes : LFIND_FILE_DEFAULT_CHUNK_BYTES;
+	if (chunk_bytes > LFIND_FILE_MAX_CHUNK_BYTES)
+		chunk_bytes = LFIND_FILE_MAX_CHUNK_BYTES;
+	chunk_bytes = (chunk_bytes + page_size - 1) / page_size * page_size;
+	while (chunk_bytes / scan->elem_size % LFIND_FILE_CHUNK_ALIGN != 0)
+		chunk_bytes += page_size;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+
+	/* both are only hints, so failures don't matter */
+	(void) madvise(map, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	(void) madvise(map, size, MADV_HUGEPAGE);
+#endif
+
+	for (first = 0; first < nelem;)
+	{
+		uint64		offset = first * scan->elem_size;
+		uint64		n = chunk_bytes / scan->elem_size;
+		uint32		found;
+
+		if (n > nelem - first)
+			n = nelem - first;
+
+		found = lfind_file_chunk(scan, map + offset, (uint32) n, first);
+		first += n;
+
+		if (scan->op == LFIND_FILE_FIND && found)
+		{
+			result = 1;
+			break;
+		}
+		result += found;
+
+		(void) madvise(map + offset, chunk_bytes < size - offset ? chunk_bytes :
+					   size - offset, MADV_DONTNEED);
+	}
+
+	munmap(map, size);
+	return result;
+}
+
+/*
+ * lfind_file_scan
+ *
+ * Like lfind_file_scan_fd, for the file at 'path'.
+ */
+int64
+lfind_file_scan(const char *path, const LfindFileScan *scan)
+{
+	int			fd = open(path, O_RDONLY);
+	int64		result;
+	int			save_errno;
+
+	if (fd < 0)
+		return -1;
+
+	result = lfind_file_scan_fd(fd, scan);
+	save_errno = errno;
+	close(fd);
+	errno = save_errno;
+	return result;
+}
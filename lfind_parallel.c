@@ -0,0 +1,443 @@
+/*
+ * lfind_parallel.c
+ *
+ * Multi-threaded versions of the scan kernels for arrays too large for one
+ * core to keep up with memory bandwidth.
+ *
+ * The array is cut into fixed-size chunks which the calling thread and the
+ * pool's workers claim from a shared counter, so faster threads simply take
+ * more chunks.  The searching variants share a "stop" flag: once any thread
+ * finds a match, the others finish the chunk at hand and claim no more.
+ * Arrays of less than two chunks are searched by the calling thread alone,
+ * so the chunk size also sets the point at which threads start to pay off.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "simd.h"
+
+/* default chunk size; a chunk takes a core some tens of microseconds */
+#define LFIND_POOL_DEFAULT_CHUNK_BYTES	(1024 * 1024)
+
+/*
+ * Chunks hold a multiple of this many elements, so that each chunk's part
+ * of a _mask bitmap starts at a byte boundary.
+ */
+#define LFIND_POOL_CHUNK_ALIGN	64
+
+typedef struct LfindJob LfindJob;
+
+/*
+ * Search 'n' elements starting at element 'start' on behalf of 'job'.
+ * Returns true if the other threads can stop.
+ */
+typedef bool (*LfindChunkFn) (LfindJob *job, uint32 start, uint32 n);
+
+struct LfindJob
+{
+	LfindChunkFn run;
+	uint64		key;
+	void	   *base;
+	uint8	   *bitmap;
+	uint32		nelem;
+	uint32		chunk_elems;
+	uint32		nchunks;
+
+	/* shared between the threads working on the job */
+	uint32		next_chunk;
+	uint32		count;
+	bool		stop;
+};
+
+struct LfindPool
+{
+	pthread_mutex_t submit_lock;	/* held for the duration of a job */
+	pthread_mutex_t lock;		/* protects the fields below */
+	pthread_cond_t work_cv;		/* signalled when a job is posted */
+	pthread_cond_t done_cv;		/* signalled when the last worker is done */
+	LfindJob   *job;
+	uint64		generation;		/* incremented for each job */
+	uint32		nbusy;			/* workers still on the current job */
+	bool		shutdown;
+
+	pthread_t  *threads;
+	uint32		nthreads;
+	uint32		chunk_bytes;
+};
+
+static LfindPool *default_pool = NULL;
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Claim and search chunks until there are none left or some thread has
+ * asked everyone to stop.
+ */
+static void
+lfind_job_run(LfindJob *job)
+{
+	for (;;)
+	{
+		uint32		chunk;
+		uint32		start;
+		uint32		n;
+
+		if (__atomic_load_n(&job->stop, __ATOMIC_RELAXED))
+			break;
+
+		chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+		if (chunk >= job->nchunks)
+			break;
+
+		start = chunk * job->chunk_elems;
+		n = job->nelem - start;
+		if (n > job->chunk_elems)
+			n = job->chunk_elems;
+
+		if (job->run(job, start, n))
+			__atomic_store_n(&job->stop, true, __ATOMIC_RELAXED);
+	}
+}
+
+static void *
+lfind_pool_worker(void *arg)
+{
+	LfindPool  *pool = arg;
+	uint64		seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;)
+	{
+		LfindJob   *job;
+
+		while (!pool->shutdown && pool->generation == seen)
+			pthread_cond_wait(&pool->work_cv, &pool->lock);
+		if (pool->shutdown)
+			break;
+
+		seen = pool->generation;
+		job = pool->job;
+		pthread_mutex_unlock(&pool->lock);
+
+		lfind_job_run(job);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->nbusy == 0)
+			pthread_cond_signal(&pool->done_cv);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/*
+ * lfind_pool_create
+ *
+ * Start a pool of 'nthreads' worker threads.  The thread calling one of the
+ * _parallel functions works on the job as well, so 0 (the default) means
+ * one worker per online CPU besides the caller.  Returns NULL if the pool
+ * could not be set up.
+ */
+LfindPool *
+lfind_pool_create(uint32 nthreads)
+{
+	LfindPool  *pool;
+
+	if (nthreads == 0)
+	{
+		long		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nthreads = ncpus > 1 ? (uint32) ncpus - 1 : 0;
+	}
+
+	pool = calloc(1, sizeof(LfindPool));
+	if (pool == NULL)
+		return NULL;
+	pool->threads = calloc(nthreads > 0 ? nthreads : 1, sizeof(pthread_t));
+	if (pool->threads == NULL)
+	{
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->submit_lock, NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_cv, NULL);
+	pthread_cond_init(&pool->done_cv, NULL);
+	pool->chunk_bytes = LFIND_POOL_DEFAULT_CHUNK_BYTES;
+
+	/* keep whatever threads we did get */
+	for (pool->nthreads = 0; pool->nthreads < nthreads; pool->nthreads++)
+	{
+		if (pthread_create(&pool->threads[pool->nthreads], NULL,
+						   lfind_pool_worker, pool) != 0)
+			break;
+	}
+
+	return pool;
+}
+
+/*
+ * lfind_pool_destroy
+ *
+ * Stop the workers and free the pool.  No job may be running.
+ */
+void
+lfind_pool_destroy(LfindPool *pool)
+{
+	uint32		i;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->work_cv);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done_cv);
+	pthread_cond_destroy(&pool->work_cv);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_mutex_destroy(&pool->submit_lock);
+	free(pool->threads);
+	free(pool);
+}
+
+/*
+ * lfind_pool_set_chunk_size
+ *
+ * Set the number of bytes of the array handed to a thread at a time.
+ * Smaller chunks balance the load better and stop sooner after a match;
+ * larger ones cost less coordination.  Arrays of less than two chunks are
+ * not split at all.
+ */
+void
+lfind_pool_set_chunk_size(LfindPool *pool, uint32 chunk_bytes)
+{
+	pthread_mutex_lock(&pool->submit_lock);
+	pool->chunk_bytes = chunk_bytes;
+	pthread_mutex_unlock(&pool->submit_lock);
+}
+
+static void
+lfind_default_pool_init(void)
+{
+	default_pool = lfind_pool_create(0);
+}
+
+/*
+ * Run 'job' on 'pool', or on the default pool if that is NULL.  Returns
+ * false without doing anything if the array is too small to be worth
+ * splitting, or if there is no pool, in which case the caller should use
+ * the single-threaded kernel.
+ */
+static bool
+lfind_pool_run(LfindPool *pool, LfindJob *job, uint32 elem_size)
+{
+	uint64		chunk_elems;
+
+	if (pool == NULL)
+	{
+		pthread_once(&default_pool_once, lfind_default_pool_init);
+		pool = default_pool;
+		if (pool == NULL || pool->nthreads == 0)
+			return false;
+	}
+
+	pthread_mutex_lock(&pool->submit_lock);
+
+	chunk_elems = pool->chunk_bytes / elem_size;
+	chunk_elems -= chunk_elems % LFIND_POOL_CHUNK_ALIGN;
+	if (chunk_elems == 0)
+		chunk_elems = LFIND_POOL_CHUNK_ALIGN;
+
+	if (job->nelem < 2 * chunk_elems)
+	{
+		pthread_mutex_unlock(&pool->submit_lock);
+		return false;
+	}
+
+	job->chunk_elems = (uint32) chunk_elems;
+	job->nchunks = (uint32) ((job->nelem + chunk_elems - 1) / chunk_elems);
+	job->next_chunk = 0;
+	job->count = 0;
+	job->stop = false;
+
+	/* post the job, then pitch in until the chunks run out */
+	pthread_mutex_lock(&pool->lock);
+	pool->job = job;
+	pool->nbusy = pool->nthreads;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work_cv);
+	pthread_mutex_unlock(&pool->lock);
+
+	lfind_job_run(job);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->nbusy > 0)
+		pthread_cond_wait(&pool->done_cv, &pool->lock);
+	pool->job = NULL;
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_mutex_unlock(&pool->submit_lock);
+	return true;
+}
+
+static void
+lfind_job_init(LfindJob *job, LfindChunkFn run, uint64 key, void *base,
+			   uint32 nelem, uint8 *bitmap)
+{
+	memset(job, 0, sizeof(LfindJob));
+	job->run = run;
+	job->key = key;
+	job->base = base;
+	job->nelem = nelem;
+	job->bitmap = bitmap;
+}
+
+static bool
+lfind8_chunk(LfindJob *job, uint32 start, uint32 n)
+{
+	return lfind8((uint8) job->key, (uint8 *) job->base + start, n);
+}
+
+static bool
+lfind32_chunk(LfindJob *job, uint32 start, uint32 n)
+{
+	return lfind32((uint32) job->key, (uint32 *) job->base + start, n);
+}
+
+static bool
+lfind8_count_chunk(LfindJob *job, uint32 start, uint32 n)
+{
+	__atomic_fetch_add(&job->count,
+					   lfind8_count((uint8) job->key, (uint8 *) job->base + start, n),
+					   __ATOMIC_RELAXED);
+	return false;
+}
+
+static bool
+lfind32_count_chunk(LfindJob *job, uint32 start, uint32 n)
+{
+	__atomic_fetch_add(&job->count,
+					   lfind32_count((uint32) job->key, (uint32 *) job->base + start, n),
+					   __ATOMIC_RELAXED);
+	return false;
+}
+
+static bool
+lfind8_mask_chunk(LfindJob *job, uint32 start, uint32 n)
+{
+	__atomic_fetch_add(&job->count,
+					   lfind8_mask((uint8) job->key, (uint8 *) job->base + start, n,
+								   job->bitmap + start / 8),
+					   __ATOMIC_RELAXED);
+	return false;
+}
+
+static bool
+lfind32_mask_chunk(LfindJob *job, uint32 start, uint32 n)
+{
+	__atomic_fetch_add(&job->count,
+					   lfind32_mask((uint32) job->key, (uint32 *) job->base + start, n,
+									job->bitmap + start / 8),
+					   __ATOMIC_RELAXED);
+	return false;
+}
+
+/*
+ * lfind8_parallel / lfind32_parallel
+ *
+ * lfind8 and lfind32 spread over the threads of 'pool' (NULL for a default
+ * pool with one thread per CPU).
+ */
+bool
+lfind8_parallel(uint8 key, uint8 *base, uint32 nelem, LfindPool *pool)
+{
+	LfindJob	job;
+
+	lfind_job_init(&job, lfind8_chunk, key, base, nelem, NULL);
+	if (!lfind_pool_run(pool, &job, sizeof(uint8)))
+		return lfind8(key, base, nelem);
+
+	return job.stop;
+}
+
+bool
+lfind32_parallel(uint32 key, uint32 *base, uint32 nelem, LfindPool *pool)
+{
+	LfindJob	job;
+
+	lfind_job_init(&job, lfind32_chunk, key, base, nelem, NULL);
+	if (!lfind_pool_run(pool, &job, sizeof(uint32)))
+		return lfind32(key, base, nelem);
+
+	return job.stop;
+}
+
+/*
+ * lfind8_count_parallel / lfind32_count_parallel
+ *
+ * Multi-threaded lfind8_count and lfind32_count.
+ */
+uint32
+lfind8_count_parallel(uint8 key, uint8 *base, uint32 nelem, LfindPool *pool)
+{
+	LfindJob	job;
+
+	lfind_job_init(&job, lfind8_count_chunk, key, base, nelem, NULL);
+	if (!lfind_pool_run(pool, &job, sizeof(uint8)))
+		return lfind8_count(key, base, nelem);
+
+	return job.count;
+}
+
+uint32
+lfind32_count_parallel(uint32 key, uint32 *base, uint32 nelem, LfindPool *pool)
+{
+	LfindJob	job;
+
+	lfind_job_init(&job, lfind32_count_chunk, key, base, nelem, NULL);
+	if (!lfind_pool_run(pool, &job, sizeof(uint32)))
+		return lfind32_count(key, base, nelem);
+
+	return job.count;
+}
+
+/*
+ * lfind8_mask_parallel / lfind32_mask_parallel
+ *
+ * Multi-threaded lfind8_mask and lfind32_mask.  Each thread writes the part
+ * of 'bitmap' that covers its chunks.
+ */
+uint32
+lfind8_mask_parallel(uint8 key, uint8 *base, uint32 nelem, uint8 *bitmap,
+					 LfindPool *pool)
+{
+	LfindJob	job;
+
+	lfind_job_init(&job, lfind8_mask_chunk, key, base, nelem, bitmap);
+	if (!lfind_pool_run(pool, &job, sizeof(uint8)))
+		return lfind8_mask(key, base, nelem, bitmap);
+
+	return job.count;
+}
+
+uint32
+lfind32_mask_parallel(uint32 key, uint32 *base, uint32 nelem, uint8 *bitmap,
+					  LfindPool *pool)
+{
+	LfindJob	job;
+
+	lfind_job_init(&job, lfind32_mask_chunk, key, base, nelem, bitmap);
+	if (!lfind_pool_run(pool, &job, sizeof(uint32)))
+		return lfind32_mask(key, base, nelem, bitmap);
+
+	return job.count;
+}
@@ -0,0 +1,74 @@
+/*
+ * lfind_range.c
+ *
+ * Comparison predicates for 8-, 16- and 32-bit elements, signed and
+ * unsigned.  Each one is a closed range [lo, hi] in disguise, so they all
+ * reduce to the lfind*_range kernels: "x >= key" is [key, MAX], "x < key"
+ * is [MIN, key - 1], and so on.
+ *
+ * The range kernels test (x - lo) <= (hi - lo) in wrapping unsigned
+ * arithmetic.  Adding the same bias to x, lo and hi does not change either
+ * difference, so signed data can be passed through unchanged: reinterpreting
+ * it as unsigned is the same as biasing everything by 2^(bits-1).
+ */
+#include "simd.h"
+
+/*
+ * Define the ge, gt, lt and between predicates for one element type.
+ * 'suffix' is empty for the unsigned versions and _signed for the signed
+ * ones; 'minval' and 'maxval' are the limits of 'type'.
+ */
+#define LFIND_RANGE_PREDICATES(bits, suffix, type, minval, maxval) \
+bool \
+lfind##bits##_between##suffix(type lo, type hi, type *base, uint32 nelem) \
+{ \
+	if (lo > hi) \
+		return false; \
+	return lfind##bits##_range((uint##bits) lo, \
+							   (uint##bits) ((uint##bits) hi - (uint##bits) lo), \
+							   (uint##bits *) base, nelem); \
+} \
+\
+bool \
+lfind##bits##_ge##suffix(type key, type *base, uint32 nelem) \
+{ \
+	return lfind##bits##_between##suffix(key, maxval, base, nelem); \
+} \
+\
+bool \
+lfind##bits##_gt##suffix(type key, type *base, uint32 nelem) \
+{ \
+	if (key == (maxval)) \
+		return false; \
+	return lfind##bits##_between##suffix(key + 1, maxval, base, nelem); \
+} \
+\
+bool \
+lfind##bits##_lt##suffix(type key, type *base, uint32 nelem) \
+{ \
+	if (key == (minval)) \
+		return false; \
+	return lfind##bits##_between##suffix(minval, key - 1, base, nelem); \
+}
+
+/* the "le" predicate, except for unsigned 8-bit which has its own kernel */
+#define LFIND_RANGE_LE(bits, suffix, type, minval) \
+bool \
+lfind##bits##_le##suffix(type key, type *base, uint32 nelem) \
+{ \
+	return lfind##bits##_between##suffix(minval, key, base, nelem); \
+}
+
+LFIND_RANGE_PREDICATES(8, , uint8, 0, 0xFF)
+LFIND_RANGE_PREDICATES(16, , uint16, 0, 0xFFFF)
+LFIND_RANGE_PREDICATES(32, , uint32, 0, 0xFFFFFFFF)
+
+LFIND_RANGE_PREDICATES(8, _signed, int8, -0x7F - 1, 0x7F)
+LFIND_RANGE_PREDICATES(16, _signed, int16, -0x7FFF - 1, 0x7FFF)
+LFIND_RANGE_PREDICATES(32, _signed, int32, -0x7FFFFFFF - 1, 0x7FFFFFFF)
+
+LFIND_RANGE_LE(16, , uint16, 0)
+LFIND_RANGE_LE(32, , uint32, 0)
+LFIND_RANGE_LE(8, _signed, int8, -0x7F - 1)
+LFIND_RANGE_LE(16, _signed, int16, -0x7FFF - 1)
+LFIND_RANGE_LE(32, _signed, int32, -0x7FFFFFFF - 1)
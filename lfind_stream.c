@@ -0,0 +1,141 @@
+/*
+ * lfind_stream.c
+ *
+ * Search for a byte string in data that arrives in pieces, such as network
+ * buffers or file chunks, without first copying it into one buffer.
+ *
+ * Each chunk is searched in place with simd_memchr() or lfind_substr().
+ * The only extra work is at chunk boundaries: the stream keeps the last
+ * nlen - 1 bytes it has seen, and before searching a chunk it searches
+ * those bytes joined to the start of the chunk, which is where a match
+ * spanning the boundary must be.  Match positions are offsets from the
+ * start of the stream.
+ */
+#include <string.h>
+
+#include "simd.h"
+
+/*
+ * lfind_stream_init
+ *
+ * Start a search for the 'nlen' bytes at 'needle', which are copied into
+ * the stream.  Returns false if 'nlen' is 0 or more than
+ * LFIND_STREAM_MAX_NEEDLE.
+ */
+bool
+lfind_stream_init(LfindStream *stream, const uint8 *needle, uint32 nlen)
+{
+	if (nlen == 0 || nlen > LFIND_STREAM_MAX_NEEDLE)
+		return false;
+
+	memcpy(stream->needle, needle, nlen);
+	stream->nlen = nlen;
+	stream->ncarry = 0;
+	stream->offset = 0;
+	stream->found = LFIND_STREAM_NOT_FOUND;
+	return true;
+}
+
+/*
+ * Remember the last nlen - 1 bytes of the stream, now that 'chunk' follows
+ * the bytes already in the carry buffer.
+ */
+static void
+lfind_stream_carry(LfindStream *stream, const uint8 *chunk, uint32 len)
+{
+	uint32		keep = stream->nlen - 1;
+
+	if (len >= keep)
+	{
+		memcpy(stream->carry, chunk + len - keep, keep);
+		stream->ncarry = keep;
+		return;
+	}
+
+	/* a short chunk: drop only as much of the old carry as is needed */
+	if (stream->ncarry + len > keep)
+	{
+		uint32		drop = stream->ncarry + len - keep;
+
+		memmove(stream->carry, stream->carry + drop, stream->ncarry - drop);
+		stream->ncarry -= drop;
+	}
+	memcpy(stream->carry + stream->ncarry, chunk, len);
+	stream->ncarry += len;
+}
+
+/*
+ * lfind_stream_feed
+ *
+ * Search the next 'len' bytes of the stream, at 'chunk'.  Returns the
+ * stream offset of the first match if one has been found, in this chunk or
+ * an earlier one, or LFIND_STREAM_NOT_FOUND.  Once a match has been found,
+ * further chunks are not searched, only counted.
+ */
+uint64
+lfind_stream_feed(LfindStream *stream, const uint8 *chunk, uint32 len)
+{
+	uint32		idx;
+
+	if (stream->found != LFIND_STREAM_NOT_FOUND || len == 0)
+	{
+		stream->offset += len;
+		return stream->found;
+	}
+
+	if (stream->nlen == 1)
+	{
+		const uint8 *match = simd_memchr(chunk, stream->needle[0], len);
+
+		if (match != NULL)
+			stream->found = stream->offset + (uint64) (match - chunk);
+		stream->offset += len;
+		return stream->found;
+	}
+
+	/*
+	 * A match that starts in the carried bytes ends within the first
+	 * nlen - 1 bytes of this chunk.  Every match lying entirely in the
+	 * carried bytes would have been found already.
+	 */
+	if (stream->ncarry > 0)
+	{
+		uint8		joined[2 * (LFIND_STREAM_MAX_NEEDLE - 1)];
+		uint32		nhead = len < stream->nlen - 1 ? len : stream->nlen - 1;
+		uint32		njoined = stream->ncarry + nhead;
+
+		memcpy(joined, stream->carry, stream->ncarry);
+		memcpy(joined + stream->ncarry, chunk, nhead);
+
+		idx = lfind_substr(stream->needle, stream->nlen, joined, njoined);
+		if (idx != LFIND_NOT_FOUND)
+		{
+			stream->found = stream->offset - stream->ncarry + idx;
+			stream->offset += len;
+			return stream->found;
+		}
+	}
+
+	idx = lfind_substr(stream->needle, stream->nlen, chunk, len);
+	if (idx != LFIND_NOT_FOUND)
+		stream->found = stream->offset + idx;
+	else
+		lfind_stream_carry(stream, chunk, len);
+
+	stream->offset += len;
+	return stream->found;
+}
+
+/*
+ * lfind_stream_finish
+ *
+ * End the stream and return the offset of the first match, or
+ * LFIND_STREAM_NOT_FOUND.  stream->offset holds the total length fed.  The
+ * stream holds no resources, so it can simply be dropped or reinitialized.
+ */
+uint64
+lfind_stream_finish(LfindStream *stream)
+{
+	stream->ncarry = 0;
+	return stream->found;
+}
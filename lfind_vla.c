@@ -0,0 +1,226 @@
+/*
+ * lfind_vla.c
+ *
+ * Vector-length-agnostic versions of the basic scan kernels for Arm SVE.
+ *
+ * SVE vectors are between 128 and 2048 bits wide, and the width is only
+ * known at run time, so these kernels cannot be written against the fixed
+ * Vector8/Vector32 types of the other backends.  Instead each loop steps
+ * by svcntb() (or svcnth/svcntw/svcntd) elements, and the last, partial
+ * vector is handled by the governing predicate from svwhilelt: lanes past
+ * the end are neither loaded nor compared, so there is no tail code at all.
+ *
+ * This file is built twice on aarch64, as the "sve" and "sve2" variants
+ * (see the Makefile); the SVE2 build additionally uses MATCH for lfind8_any.
+ * Kernels that are not listed in simd_kernels_sve.h come from the NEON
+ * variant, see simd_dispatch.c.
+ */
+#include "simd_internal.h"
+
+#if defined(__ARM_FEATURE_SVE)
+
+#include <arm_sve.h>
+
+/* the intrinsics take <stdint.h> pointers, and uint64 is not uint64_t */
+#define SVE_LOAD(bits, pg, p)	svld1_u##bits(pg, (const uint##bits##_t *) (p))
+
+/*
+ * Define an existence test.  'bits' is the element width, 'cnt' the
+ * function counting elements per vector, and 'cmp' the compare to apply
+ * between the elements and the key.  Full vectors are taken four at a
+ * time with an all-true predicate, merging the compare results before the
+ * single test; the rest is done under a svwhilelt predicate.
+ */
+#define SVE_DEFINE_HAS(name, bits, cnt, cmp) \
+bool \
+SIMD_FN(name)(uint##bits key, uint##bits *base, uint32 nelem) \
+{ \
+	const svbool_t all = svptrue_b##bits(); \
+	const svuint##bits##_t keys = svdup_n_u##bits(key); \
+	const uint64 step = cnt(); \
+	uint64		i = 0; \
+	svbool_t	pg; \
+\
+	for (; i + 4 * step <= nelem; i += 4 * step) \
+	{ \
+		svbool_t	m1 = cmp(all, SVE_LOAD(bits, all, &base[i]), keys); \
+		svbool_t	m2 = cmp(all, SVE_LOAD(bits, all, &base[i + step]), keys); \
+		svbool_t	m3 = cmp(all, SVE_LOAD(bits, all, &base[i + 2 * step]), keys); \
+		svbool_t	m4 = cmp(all, SVE_LOAD(bits, all, &base[i + 3 * step]), keys); \
+\
+		if (svptest_any(all, svorr_b_z(all, svorr_b_z(all, m1, m2), \
+									   svorr_b_z(all, m3, m4)))) \
+			return true; \
+	} \
+\
+	for (pg = svwhilelt_b##bits##_u64(i, nelem); svptest_any(all, pg); \
+		 i += step, pg = svwhilelt_b##bits##_u64(i, nelem)) \
+	{ \
+		if (svptest_any(pg, cmp(pg, SVE_LOAD(bits, pg, &base[i]), keys))) \
+			return true; \
+	} \
+\
+	return false; \
+}
+
+SVE_DEFINE_HAS(lfind8, 8, svcntb, svcmpeq_u8)
+SVE_DEFINE_HAS(lfind8_le, 8, svcntb, svcmple_u8)
+SVE_DEFINE_HAS(lfind16, 16, svcnth, svcmpeq_u16)
+SVE_DEFINE_HAS(lfind32, 32, svcntw, svcmpeq_u32)
+SVE_DEFINE_HAS(lfind64, 64, svcntd, svcmpeq_u64)
+
+/*
+ * Define the _index kernel for one width.  BRKB keeps the lanes before the
+ * first match, so counting them gives the match's offset in the vector.
+ */
+#define SVE_DEFINE_INDEX(bits, cnt) \
+uint32 \
+SIMD_FN(lfind##bits##_index)(uint##bits key, uint##bits *base, uint32 nelem) \
+{ \
+	const svuint##bits##_t keys = svdup_n_u##bits(key); \
+	const uint64 step = cnt(); \
+	uint64		i = 0; \
+	svbool_t	pg; \
+\
+	for (pg = svwhilelt_b##bits##_u64(i, nelem); svptest_any(svptrue_b##bits(), pg); \
+		 i += step, pg = svwhilelt_b##bits##_u64(i, nelem)) \
+	{ \
+		svbool_t	match = svcmpeq_u##bits(pg, SVE_LOAD(bits, pg, &base[i]), keys); \
+\
+		if (svptest_any(pg, match)) \
+			return (uint32) (i + svcntp_b##bits(pg, svbrkb_b_z(pg, match))); \
+	} \
+\
+	return LFIND_NOT_FOUND; \
+}
+
+SVE_DEFINE_INDEX(8, svcntb)
+SVE_DEFINE_INDEX(32, svcntw)
+
+/*
+ * Define the _count kernel for one width.  The per-vector counts are summed
+ * into a scalar, since svcntp already reduces the predicate.
+ */
+#define SVE_DEFINE_COUNT(bits, cnt) \
+uint32 \
+SIMD_FN(lfind##bits##_count)(uint##bits key, uint##bits *base, uint32 nelem) \
+{ \
+	const svuint##bits##_t keys = svdup_n_u##bits(key); \
+	const uint64 step = cnt(); \
+	uint64		count = 0; \
+	uint64		i = 0; \
+	svbool_t	pg; \
+\
+	for (pg = svwhilelt_b##bits##_u64(i, nelem); svptest_any(svptrue_b##bits(), pg); \
+		 i += step, pg = svwhilelt_b##bits##_u64(i, nelem)) \
+	{ \
+		count += svcntp_b##bits(pg, svcmpeq_u##bits(pg, SVE_LOAD(bits, pg, &base[i]), keys)); \
+	} \
+\
+	return (uint32) count; \
+}
+
+SVE_DEFINE_COUNT(8, svcntb)
+SVE_DEFINE_COUNT(32, svcntw)
+
+/*
+ * Define a 32-bit selection kernel, see select.c.  COMPACT packs the
+ * matching lanes to the start of the vector, and a store predicated on the
+ * first svcntp of them writes exactly those, so unlike the fixed-width
+ * kernels these store nothing past the selected entries.  COMPACT only
+ * exists for 32- and 64-bit lanes; the byte kernels come from NEON.
+ */
+#define SVE_DEFINE_SELECT(name, cmp, indexes) \
+uint32 \
+SIMD_FN(name)(uint32 key, uint32 *base, uint32 nelem, uint32 *out) \
+{ \
+	const svuint32_t keys = svdup_n_u32(key); \
+	const uint64 step = svcntw(); \
+	uint64		n = 0; \
+	uint64		i = 0; \
+	svbool_t	pg; \
+\
+	for (pg = svwhilelt_b32_u64(i, nelem); svptest_any(svptrue_b32(), pg); \
+		 i += step, pg = svwhilelt_b32_u64(i, nelem)) \
+	{ \
+		svuint32_t	vals = SVE_LOAD(32, pg, &base[i]); \
+		svbool_t	match = cmp(pg, vals, keys); \
+		uint64		count = svcntp_b32(pg, match); \
+\
+		if (indexes) \
+			vals = svindex_u32((uint32_t) i, 1); \
+		svst1_u32(svwhilelt_b32_u64((uint64) 0, count), (uint32_t *) &out[n], \
+				  svcompact_u32(match, vals)); \
+		n += count; \
+	} \
+\
+	return (uint32) n; \
+}
+
+SVE_DEFINE_SELECT(select32, svcmpeq_u32, true)
+SVE_DEFINE_SELECT(select32_le, svcmple_u32, false)
+SVE_DEFINE_SELECT(select32_le_index, svcmple_u32, true)
+
+#if defined(__ARM_FEATURE_SVE2)
+
+/* MATCH compares each byte against 16 keys, replicated in every 128 bits */
+#define SVE_MATCH_KEYS	16
+
+/* beyond this many MATCHes per vector, the NEON lookup tables are faster */
+#define SVE_MATCH_MAX_KEYS	(4 * SVE_MATCH_KEYS)
+
+extern SIMD_HIDDEN bool lfind8_any_neon(const uint8 *keys, uint32 nkeys,
+										uint8 *base, uint32 nelem);
+
+/*
+ * lfind8_any
+ *
+ * Return true if any element in 'base' equals any of the 'nkeys' values in
+ * 'keys'.  The keys are split into groups of 16, the last one padded by
+ * repeating its first key.  svld1rq replicates a group into every 128-bit
+ * segment of a vector, and one MATCH then tests each byte against the
+ * whole group.  Sizeless SVE types cannot be kept in an array, so the
+ * groups are reloaded for every vector, from L1.  Large key sets go to the
+ * NEON kernel's lookup tables instead, which cost the same for any number
+ * of keys.
+ */
+bool
+SIMD_FN(lfind8_any)(const uint8 *keys, uint32 nkeys, uint8 *base, uint32 nelem)
+{
+	const svbool_t all = svptrue_b8();
+	uint8		groups[SVE_MATCH_MAX_KEYS];
+	uint32		ngroups = (nkeys + SVE_MATCH_KEYS - 1) / SVE_MATCH_KEYS;
+	uint32		k;
+	uint64		i = 0;
+	svbool_t	pg;
+
+	if (nkeys == 0)
+		return false;
+
+	if (nkeys > SVE_MATCH_MAX_KEYS)
+		return lfind8_any_neon(keys, nkeys, base, nelem);
+
+	for (k = 0; k < ngroups * SVE_MATCH_KEYS; k++)
+		groups[k] = keys[k < nkeys ? k : k - k % SVE_MATCH_KEYS];
+
+	for (pg = svwhilelt_b8_u64(i, nelem); svptest_any(all, pg);
+		 i += svcntb(), pg = svwhilelt_b8_u64(i, nelem))
+	{
+		svuint8_t	vals = svld1_u8(pg, &base[i]);
+		svbool_t	match = svpfalse_b();
+
+		for (k = 0; k < ngroups; k++)
+			match = svorr_b_z(pg, match,
+							  svmatch_u8(pg, vals,
+										 svld1rq_u8(all, &groups[k * SVE_MATCH_KEYS])));
+
+		if (svptest_any(pg, match))
+			return true;
+	}
+
+	return false;
+}
+
+#endif							/* __ARM_FEATURE_SVE2 */
+
+#endif							/* __ARM_FEATURE_SVE */
@@ -0,0 +1,209 @@
+/*
+ * lsearch.c
+ *
+ * Search kernels for sorted arrays.  Like lfind.c this is compiled once per
+ * instruction-set variant; the exported functions live in simd_dispatch.c.
+ */
+#include "simd_internal.h"
+
+/*
+ * lower_bound32
+ *
+ * Return the index of the first element of the sorted array 'base' that is
+ * greater than or equal to 'key', i.e. the index at which 'key' would be
+ * inserted to keep the array sorted.  Returns 'nelem' if every element is
+ * less than 'key'.
+ *
+ * A branchless binary search narrows the array down to a leaf of at most
+ * four vectors, then the leaf is finished by counting the elements less
+ * than 'key': the array is sorted, so that count is the offset of the
+ * answer within the leaf.  The halving step compiles to a conditional move,
+ * so there are no mispredicted branches, and the last few levels of the
+ * search, which would otherwise each wait on a dependent load, become one
+ * pass of vector compares.
+ */
+uint32
+SIMD_FN(lower_bound32)(uint32 key, uint32 *base, uint32 nelem)
+{
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 leaf_size = 4 * nelem_per_vector;
+	const uint32 *b = base;
+	uint32		n = nelem;
+	uint32		count = 0;
+	uint32		i;
+	Vector32	keys;
+	Vector32	vals;
+
+	/* nothing is less than 0, and that case would wrap around below */
+	if (key == 0)
+		return 0;
+
+	/* the answer is always within [b, b + n] */
+	while (n > leaf_size)
+	{
+		uint32		half = n / 2;
+
+		b = (b[half] < key) ? b + half : b;
+		n -= half;
+	}
+
+	/* x < key is x <= key - 1 */
+	keys = vector32_broadcast(key - 1);
+
+	for (i = 0; n - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		vector32_load(&vals, &b[i]);
+		count += simd_mask_count_bytes(vector32_cmp_mask(vector32_le(vals, keys)));
+	}
+
+	if (i < n)
+	{
+		uint32		start;
+		uint64		valid = simd_load_tail32(&vals, b, i, n, &start);
+
+		count += simd_mask_count_bytes(vector32_cmp_mask(vector32_le(vals, keys)) &
+									   valid);
+	}
+
+	return (uint32) (b - base) + count / sizeof(uint32);
+}
+
+/*
+ * lsearch32_sorted
+ *
+ * Return the index of the first element of the sorted array 'base' that
+ * equals 'key', or LFIND_NOT_FOUND if there is none.
+ */
+uint32
+SIMD_FN(lsearch32_sorted)(uint32 key, uint32 *base, uint32 nelem)
+{
+	uint32		i = SIMD_FN(lower_bound32)(key, base, nelem);
+
+	return (i < nelem && base[i] == key) ? i : LFIND_NOT_FOUND;
+}
+
+/*
+ * Number of keys of the tree node at 'node' that are less than the search
+ * key, given 'keys' holding copies of the search key minus one.  A node is
+ * one cache line, i.e. one compare with AVX-512, two with AVX2 and four
+ * with SSE2 or NEON.
+ */
+static inline uint32
+stree32_rank(const uint32 *node, const Vector32 keys)
+{
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	uint32		count = 0;
+	uint32		j;
+
+	for (j = 0; j < STREE32_NODE_KEYS; j += nelem_per_vector)
+	{
+		Vector32	vals;
+
+		vector32_load(&vals, &node[j]);
+		count += simd_mask_count_bytes(vector32_cmp_mask(vector32_le(vals, keys)));
+	}
+
+	return count / sizeof(uint32);
+}
+
+/*
+ * stree32_lower_bound
+ *
+ * Same result as lower_bound32() on the sorted array the tree was built
+ * from: the index of the first key >= 'key', or the number of keys if
+ * there is none.  Visits one cache line per layer.
+ */
+uint32
+SIMD_FN(stree32_lower_bound)(const Stree32 *tree, uint32 key)
+{
+	const uint32 *nodes = tree->nodes;
+	Vector32	keys;
+	uint32		k = 0;
+	uint32		h;
+
+	/* nothing is less than 0, and that case would wrap around below */
+	if (key == 0)
+		return 0;
+
+	/* x < key is x <= key - 1 */
+	keys = vector32_broadcast(key - 1);
+
+	for (h = tree->height - 1; h > 0; h--)
+	{
+		k = k * STREE32_FANOUT +
+			stree32_rank(&nodes[(tree->offsets[h] + k) * STREE32_NODE_KEYS], keys);
+	}
+
+	return k * STREE32_NODE_KEYS +
+		stree32_rank(&nodes[(tree->offsets[0] + k) * STREE32_NODE_KEYS], keys);
+}
+
+/* queries that descend the tree together in stree32_lower_bound_batch */
+#define STREE32_BATCH_GROUP	16
+
+/*
+ * stree32_lower_bound_batch
+ *
+ * Set results[q] to stree32_lower_bound(tree, keys[q]) for each of the
+ * 'nkeys' queries, and return the number of queries whose key is present.
+ *
+ * A single search spends most of its time waiting for the next node to
+ * arrive from memory.  Here a group of queries descends the tree one layer
+ * at a time, and each query prefetches its node in the next layer as soon
+ * as it is known, so the misses of the whole group overlap.
+ */
+uint32
+SIMD_FN(stree32_lower_bound_batch)(const Stree32 *tree, const uint32 *keys,
+								   uint32 nkeys, uint32 *results)
+{
+	const uint32 *nodes = tree->nodes;
+	const uint32 *leaves = &nodes[tree->offsets[0] * STREE32_NODE_KEYS];
+	uint32		nfound = 0;
+	uint32		q;
+
+	for (q = 0; q < nkeys; q += STREE32_BATCH_GROUP)
+	{
+		uint32		node[STREE32_BATCH_GROUP] = {0};
+		uint32		ngroup = nkeys - q;
+		uint32		h;
+		uint32		j;
+
+		if (ngroup > STREE32_BATCH_GROUP)
+			ngroup = STREE32_BATCH_GROUP;
+
+		for (h = tree->height - 1; h > 0; h--)
+		{
+			const uint32 *layer = &nodes[tree->offsets[h] * STREE32_NODE_KEYS];
+			const uint32 *next = &nodes[tree->offsets[h - 1] * STREE32_NODE_KEYS];
+
+			for (j = 0; j < ngroup; j++)
+			{
+				uint32		key = keys[q + j];
+				uint32		rank = 0;
+
+				if (key != 0)
+					rank = stree32_rank(&layer[node[j] * STREE32_NODE_KEYS],
+										vector32_broadcast(key - 1));
+				node[j] = node[j] * STREE32_FANOUT + rank;
+				__builtin_prefetch(&next[node[j] * STREE32_NODE_KEYS]);
+			}
+		}
+
+		for (j = 0; j < ngroup; j++)
+		{
+			uint32		key = keys[q + j];
+			uint32		result = 0;
+
+			if (key != 0)
+				result = node[j] * STREE32_NODE_KEYS +
+					stree32_rank(&leaves[node[j] * STREE32_NODE_KEYS],
+								 vector32_broadcast(key - 1));
+
+			results[q + j] = result;
+			if (result < tree->nelem && leaves[result] == key)
+				nfound++;
+		}
+	}
+
+	return nfound;
+}
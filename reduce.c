@@ -0,0 +1,381 @@
+/*
+ * reduce.c
+ *
+ * Reduction kernels: the minimum, maximum, sum, and position of the
+ * minimum or maximum of an array of unsigned 8-, 16-, 32- or 64-bit
+ * elements, plus lfind32_stats, which finds and counts a key and computes
+ * the minimum, maximum and sum in the same pass.
+ *
+ * The loops have the same shape as the search kernels in lfind.c: blocks
+ * of four vectors, each feeding its own accumulator so that successive
+ * blocks don't wait on each other, then single vectors, then one partial
+ * vector for the remainder.  The accumulators are combined, and their
+ * lanes reduced, only once at the end.
+ *
+ * Like lfind.c this is compiled once per instruction-set variant; the
+ * exported functions live in simd_dispatch.c.
+ */
+#include "simd_internal.h"
+
+/*
+ * Masks for the last, partial vector of an array.  Loading a vector from
+ * &reduce_masks[64 - n] gives n all-ones bytes followed by zero bytes, and
+ * loading from &reduce_masks[128 - n] gives n zero bytes followed by
+ * all-ones bytes.
+ */
+static const uint8 reduce_masks[192] __attribute__((aligned(64))) = {
+	[0 ... 63] = 0xFF,
+	[128 ... 191] = 0xFF
+};
+
+#define REDUCE_MIN(a, b)	((a) < (b) ? (a) : (b))
+#define REDUCE_MAX(a, b)	((a) > (b) ? (a) : (b))
+
+/*
+ * Load the last, partial vector of base[i .. nelem - 1].  The partial load
+ * leaves the padding lanes unspecified, so set them to zero, or to all ones
+ * (the identity for a minimum) if 'ones' is true.
+ */
+#define REDUCE_DEFINE_LOAD_TAIL(bits) \
+static inline Vector##bits \
+reduce_load_tail##bits(const uint##bits *base, uint32 i, uint32 nelem, bool ones) \
+{ \
+	const uint32 nbytes = (nelem - i) * sizeof(uint##bits); \
+	Vector##bits v; \
+	Vector##bits mask; \
+\
+	vector##bits##_load_partial(&v, &base[i], nelem - i); \
+	vector##bits##_load(&mask, (const uint##bits *) &reduce_masks[64 - nbytes]); \
+	v = vector##bits##_and(v, mask); \
+	if (ones) \
+	{ \
+		vector##bits##_load(&mask, (const uint##bits *) &reduce_masks[128 - nbytes]); \
+		v = vector##bits##_or(v, mask); \
+	} \
+	return v; \
+}
+
+/*
+ * Define vmin<bits> or vmax<bits>.  'op' is min or max, 'OP' the matching
+ * scalar macro and 'identity' the value that leaves the result unchanged,
+ * which is also what an empty array returns.
+ */
+#define REDUCE_DEFINE_MINMAX(bits, op, OP, identity) \
+uint##bits \
+SIMD_FN(v##op##bits)(uint##bits *base, uint32 nelem) \
+{ \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector; \
+	Vector##bits acc1 = vector##bits##_broadcast(identity); \
+	Vector##bits acc2 = acc1; \
+	Vector##bits acc3 = acc1; \
+	Vector##bits acc4 = acc1; \
+	uint##bits	lanes[sizeof(Vector##bits) / sizeof(uint##bits)]; \
+	uint##bits	result; \
+	uint32		i; \
+\
+	for (i = 0; nelem - i >= nelem_per_iteration; i += nelem_per_iteration) \
+	{ \
+		Vector##bits vals1, \
+					vals2, \
+					vals3, \
+					vals4; \
+\
+		vector##bits##_load(&vals1, &base[i]); \
+		vector##bits##_load(&vals2, &base[i + nelem_per_vector]); \
+		vector##bits##_load(&vals3, &base[i + nelem_per_vector * 2]); \
+		vector##bits##_load(&vals4, &base[i + nelem_per_vector * 3]); \
+\
+		acc1 = vector##bits##_##op(acc1, vals1); \
+		acc2 = vector##bits##_##op(acc2, vals2); \
+		acc3 = vector##bits##_##op(acc3, vals3); \
+		acc4 = vector##bits##_##op(acc4, vals4); \
+	} \
+\
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		Vector##bits vals; \
+\
+		vector##bits##_load(&vals, &base[i]); \
+		acc1 = vector##bits##_##op(acc1, vals); \
+	} \
+\
+	if (i < nelem) \
+		acc2 = vector##bits##_##op(acc2, \
+								   reduce_load_tail##bits(base, i, nelem, \
+														  (identity) != 0)); \
+\
+	acc1 = vector##bits##_##op(vector##bits##_##op(acc1, acc2), \
+							   vector##bits##_##op(acc3, acc4)); \
+	memcpy(lanes, &acc1, sizeof(acc1)); \
+	result = lanes[0]; \
+	for (i = 1; i < nelem_per_vector; i++) \
+		result = OP(result, lanes[i]); \
+\
+	return result; \
+}
+
+/*
+ * Define vsum<bits>.  Every vector is widened into 64-bit lanes before it is
+ * added, so the sum of up to 2^32 elements narrower than 64 bits is exact;
+ * vsum64 wraps around modulo 2^64.
+ */
+#define REDUCE_DEFINE_SUM(bits, widen) \
+uint64 \
+SIMD_FN(vsum##bits)(uint##bits *base, uint32 nelem) \
+{ \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector; \
+	Vector64	acc1 = vector64_broadcast(0); \
+	Vector64	acc2 = acc1; \
+	Vector64	acc3 = acc1; \
+	Vector64	acc4 = acc1; \
+	uint64		lanes[sizeof(Vector64) / sizeof(uint64)]; \
+	uint64		result = 0; \
+	uint32		i; \
+\
+	for (i = 0; nelem - i >= nelem_per_iteration; i += nelem_per_iteration) \
+	{ \
+		Vector##bits vals1, \
+					vals2, \
+					vals3, \
+					vals4; \
+\
+		vector##bits##_load(&vals1, &base[i]); \
+		vector##bits##_load(&vals2, &base[i + nelem_per_vector]); \
+		vector##bits##_load(&vals3, &base[i + nelem_per_vector * 2]); \
+		vector##bits##_load(&vals4, &base[i + nelem_per_vector * 3]); \
+\
+		acc1 = vector64_add(acc1, widen(vals1)); \
+		acc2 = vector64_add(acc2, widen(vals2)); \
+		acc3 = vector64_add(acc3, widen(vals3)); \
+		acc4 = vector64_add(acc4, widen(vals4)); \
+	} \
+\
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		Vector##bits vals; \
+\
+		vector##bits##_load(&vals, &base[i]); \
+		acc1 = vector64_add(acc1, widen(vals)); \
+	} \
+\
+	if (i < nelem) \
+		acc2 = vector64_add(acc2, widen(reduce_load_tail##bits(base, i, nelem, false))); \
+\
+	acc1 = vector64_add(vector64_add(acc1, acc2), vector64_add(acc3, acc4)); \
+	memcpy(lanes, &acc1, sizeof(acc1)); \
+	for (i = 0; i < sizeof(Vector64) / sizeof(uint64); i++) \
+		result += lanes[i]; \
+\
+	return result; \
+}
+
+/*
+ * Define argmin<bits> or argmax<bits>: the index of the first element equal
+ * to the minimum or maximum, or LFIND_NOT_FOUND for an empty array.  The
+ * value is located with a second pass, which stops at its first occurrence
+ * and so only reads the whole array again if that is near the end.
+ */
+#define REDUCE_DEFINE_ARG(bits, op) \
+uint32 \
+SIMD_FN(arg##op##bits)(uint##bits *base, uint32 nelem) \
+{ \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	Vector##bits keys; \
+	uint64		mask; \
+	uint32		start; \
+	uint32		i; \
+\
+	if (nelem == 0) \
+		return LFIND_NOT_FOUND; \
+	keys = vector##bits##_broadcast(SIMD_FN(v##op##bits)(base, nelem)); \
+\
+	for (i = 0; nelem - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		Vector##bits vals; \
+\
+		vector##bits##_load(&vals, &base[i]); \
+		mask = vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+		if (mask != 0) \
+			return i + simd_mask_first_byte(mask) / sizeof(uint##bits); \
+	} \
+\
+	/* the value is in what's left, so no need to check the result */ \
+	{ \
+		Vector##bits vals; \
+\
+		mask = simd_load_tail##bits(&vals, base, i, nelem, &start); \
+		mask &= vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+	} \
+	return start + simd_mask_first_byte(mask) / sizeof(uint##bits); \
+}
+
+#define REDUCE_DEFINE_ALL(bits, maxval, widen) \
+REDUCE_DEFINE_LOAD_TAIL(bits) \
+REDUCE_DEFINE_MINMAX(bits, min, REDUCE_MIN, maxval) \
+REDUCE_DEFINE_MINMAX(bits, max, REDUCE_MAX, 0) \
+REDUCE_DEFINE_SUM(bits, widen) \
+REDUCE_DEFINE_ARG(bits, min) \
+REDUCE_DEFINE_ARG(bits, max)
+
+/* vsum64 adds the elements as they are, wrapping around */
+#define reduce_sum64_identity(v)	(v)
+
+REDUCE_DEFINE_ALL(8, UINT8_MAX, vector8_sum64)
+REDUCE_DEFINE_ALL(16, UINT16_MAX, vector16_sum64)
+REDUCE_DEFINE_ALL(32, UINT32_MAX, vector32_sum64)
+REDUCE_DEFINE_ALL(64, UINT64_MAX, reduce_sum64_identity)
+
+/*
+ * lfind32_stats
+ *
+ * Scan 'base' once and fill in '*stats': how many elements equal 'key' and
+ * the index of the first one (LFIND_NOT_FOUND if none), and the minimum,
+ * maximum and sum of all the elements.  An empty array gives a minimum of
+ * UINT32_MAX and a maximum and sum of 0.  Returns stats->count.
+ *
+ * This is what an aggregation over the same array as a search would
+ * otherwise need four separate passes for.
+ */
+uint32
+SIMD_FN(lfind32_stats)(uint32 key, uint32 *base, uint32 nelem,
+					   Lfind32Stats *stats)
+{
+	const Vector32 keys = vector32_broadcast(key);
+	const uint32 nelem_per_vector = sizeof(Vector32) / sizeof(uint32);
+	const uint32 nelem_per_iteration = 4 * nelem_per_vector;
+	Vector32	min1 = vector32_broadcast(UINT32_MAX);
+	Vector32	min2 = min1;
+	Vector32	max1 = vector32_broadcast(0);
+	Vector32	max2 = max1;
+	Vector64	sum1 = vector64_broadcast(0);
+	Vector64	sum2 = sum1;
+	uint32		lanes[sizeof(Vector32) / sizeof(uint32)];
+	uint64		sums[sizeof(Vector64) / sizeof(uint64)];
+	uint32		first = LFIND_NOT_FOUND;
+	uint32		count = 0;
+	uint32		i;
+
+	/*
+	 * Each block updates three accumulators per register pair, so two sets
+	 * are enough to keep the min, max and add units busy.
+	 */
+	for (i = 0; nelem - i >= nelem_per_iteration; i += nelem_per_iteration)
+	{
+		Vector32	vals1,
+					vals2,
+					vals3,
+					vals4;
+		uint64		mask1,
+					mask2,
+					mask3,
+					mask4;
+
+		vector32_load(&vals1, &base[i]);
+		vector32_load(&vals2, &base[i + nelem_per_vector]);
+		vector32_load(&vals3, &base[i + nelem_per_vector * 2]);
+		vector32_load(&vals4, &base[i + nelem_per_vector * 3]);
+
+		mask1 = vector32_eq_mask(keys, vals1);
+		mask2 = vector32_eq_mask(keys, vals2);
+		mask3 = vector32_eq_mask(keys, vals3);
+		mask4 = vector32_eq_mask(keys, vals4);
+
+		if ((mask1 | mask2 | mask3 | mask4) != 0)
+		{
+			count += (simd_mask_count_bytes(mask1) +
+					  simd_mask_count_bytes(mask2) +
+					  simd_mask_count_bytes(mask3) +
+					  simd_mask_count_bytes(mask4)) / sizeof(uint32);
+
+			if (first == LFIND_NOT_FOUND)
+			{
+				uint32		j = i;
+
+				if (mask1 == 0)
+				{
+					j += nelem_per_vector;
+					mask1 = mask2;
+				}
+				if (mask1 == 0)
+				{
+					j += nelem_per_vector;
+					mask1 = mask3;
+				}
+				if (mask1 == 0)
+				{
+					j += nelem_per_vector;
+					mask1 = mask4;
+				}
+				first = j + simd_mask_first_byte(mask1) / sizeof(uint32);
+			}
+		}
+
+		min1 = vector32_min(min1, vector32_min(vals1, vals2));
+		min2 = vector32_min(min2, vector32_min(vals3, vals4));
+		max1 = vector32_max(max1, vector32_max(vals1, vals2));
+		max2 = vector32_max(max2, vector32_max(vals3, vals4));
+		sum1 = vector64_add(sum1, vector64_add(vector32_sum64(vals1),
+											   vector32_sum64(vals2)));
+		sum2 = vector64_add(sum2, vector64_add(vector32_sum64(vals3),
+											   vector32_sum64(vals4)));
+	}
+
+	/* then single vectors, and one partial vector */
+	for (; nelem - i >= nelem_per_vector; i += nelem_per_vector)
+	{
+		Vector32	vals;
+		uint64		mask;
+
+		vector32_load(&vals, &base[i]);
+		mask = vector32_eq_mask(keys, vals);
+		count += simd_mask_count_bytes(mask) / sizeof(uint32);
+		if (first == LFIND_NOT_FOUND && mask != 0)
+			first = i + simd_mask_first_byte(mask) / sizeof(uint32);
+
+		min1 = vector32_min(min1, vals);
+		max1 = vector32_max(max1, vals);
+		sum1 = vector64_add(sum1, vector32_sum64(vals));
+	}
+
+	if (i < nelem)
+	{
+		Vector32	vals = reduce_load_tail32(base, i, nelem, false);
+		uint64		mask;
+
+		/* the zeroed padding could match the key */
+		mask = vector32_eq_mask(keys, vals) &
+			simd_mask_prefix((nelem - i) * sizeof(uint32));
+		count += simd_mask_count_bytes(mask) / sizeof(uint32);
+		if (first == LFIND_NOT_FOUND && mask != 0)
+			first = i + simd_mask_first_byte(mask) / sizeof(uint32);
+
+		min2 = vector32_min(min2, reduce_load_tail32(base, i, nelem, true));
+		max2 = vector32_max(max2, vals);
+		sum2 = vector64_add(sum2, vector32_sum64(vals));
+	}
+
+	stats->count = count;
+	stats->first = first;
+
+	min1 = vector32_min(min1, min2);
+	memcpy(lanes, &min1, sizeof(min1));
+	stats->min = lanes[0];
+	for (i = 1; i < nelem_per_vector; i++)
+		stats->min = REDUCE_MIN(stats->min, lanes[i]);
+
+	max1 = vector32_max(max1, max2);
+	memcpy(lanes, &max1, sizeof(max1));
+	stats->max = lanes[0];
+	for (i = 1; i < nelem_per_vector; i++)
+		stats->max = REDUCE_MAX(stats->max, lanes[i]);
+
+	sum1 = vector64_add(sum1, sum2);
+	memcpy(sums, &sum1, sizeof(sum1));
+	stats->sum = 0;
+	for (i = 0; i < sizeof(Vector64) / sizeof(uint64); i++)
+		stats->sum += sums[i];
+
+	return stats->count;
+}
@@ -0,0 +1,147 @@
+/*
+ * select.c
+ *
+ * Selection kernels: evaluate the predicate of a scan over an array and
+ * write the matching elements, or their indexes, contiguously to an output
+ * array.  Like lfind.c this is compiled once per instruction-set variant;
+ * the exported functions live in simd_dispatch.c.
+ *
+ * Each vector is compared, the compare result turned into a bitmask with
+ * vector*_bitmask(), and the selected lanes compacted to the output with
+ * vector*_compress_store().  That may write a vector's worth of junk after
+ * the selected lanes, which is harmless for whole vectors: no more elements
+ * have been selected than have been read, so the store stays within the
+ * first 'nelem' elements of the output.  The last, partial vector is
+ * compacted to a local buffer and copied.
+ */
+#include "simd_internal.h"
+
+/* lanes per Vector32, the number of indexes one compress store writes */
+#define SELECT_INDEXES_PER_VECTOR	(sizeof(Vector32) / sizeof(uint32))
+
+/* lane numbers, for turning the position of a vector into element indexes */
+static const uint32 select_lane_numbers[64 / sizeof(uint32)] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+/* compaction of one vector of matches, elements or indexes */
+static inline uint32
+select8_values(uint8 *out, const Vector8 vals, uint64 lanes, uint32 i)
+{
+	(void) i;
+	return vector8_compress_store(out, vals, lanes);
+}
+
+static inline uint32
+select32_values(uint32 *out, const Vector32 vals, uint64 lanes, uint32 i)
+{
+	(void) i;
+	return vector32_compress_store(out, vals, lanes);
+}
+
+/* the indexes i, i + 1, ... of the lanes selected by 'lanes' */
+static inline uint32
+select_store_indexes(uint32 *out, uint64 lanes, uint32 i)
+{
+	Vector32	lane_numbers;
+
+	vector32_load(&lane_numbers, select_lane_numbers);
+	return vector32_compress_store(out, vector32_add(vector32_broadcast(i), lane_numbers),
+								   lanes);
+}
+
+static inline uint32
+select32_indexes(uint32 *out, const Vector32 vals, uint64 lanes, uint32 i)
+{
+	(void) vals;
+	return select_store_indexes(out, lanes, i);
+}
+
+/* a vector of bytes holds several Vector32s' worth of indexes */
+static inline uint32
+select8_indexes(uint32 *out, const Vector8 vals, uint64 lanes, uint32 i)
+{
+	uint32		n = 0;
+	uint32		j;
+
+	(void) vals;
+	for (j = 0; j < sizeof(Vector8); j += SELECT_INDEXES_PER_VECTOR)
+	{
+		uint64		group = (lanes >> j) & ((UINT64_C(1) << SELECT_INDEXES_PER_VECTOR) - 1);
+
+		/* sparse matches leave most groups empty, skip their stores */
+		if (group != 0)
+			n += select_store_indexes(&out[n], group, i + j);
+	}
+	return n;
+}
+
+/*
+ * Define a selection kernel.  'bits' is the element width, 'cmp' the
+ * compare between the elements and the key, and 'emit' one of the
+ * compaction functions above, writing elements of type 'out_type'.
+ */
+#define SELECT_DEFINE(name, bits, cmp, out_type, emit) \
+uint32 \
+SIMD_FN(name)(uint##bits key, uint##bits *base, uint32 nelem, out_type *out) \
+{ \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	const Vector##bits keys = vector##bits##_broadcast(key); \
+	uint32		tail_idx = nelem & ~(nelem_per_vector - 1); \
+	uint32		n = 0; \
+	uint32		i; \
+\
+	for (i = 0; i < tail_idx; i += nelem_per_vector) \
+	{ \
+		Vector##bits vals; \
+\
+		vector##bits##_load(&vals, &base[i]); \
+		n += emit(&out[n], vals, vector##bits##_bitmask(cmp(vals, keys)), i); \
+	} \
+\
+	if (i < nelem) \
+	{ \
+		out_type	tail[sizeof(Vector8)]; \
+		Vector##bits vals; \
+		uint32		start; \
+		uint64		valid; \
+		uint32		count; \
+\
+		/* simd_load_tail's mask is in the cmp_mask layout, so make our own */ \
+		(void) simd_load_tail##bits(&vals, base, i, nelem, &start); \
+		valid = ((UINT64_C(1) << (nelem - i)) - 1) << (i - start); \
+		count = emit(tail, vals, vector##bits##_bitmask(cmp(vals, keys)) & valid, start); \
+		memcpy(&out[n], tail, count * sizeof(out_type)); \
+		n += count; \
+	} \
+\
+	return n; \
+}
+
+/*
+ * select8 / select32
+ *
+ * Write the index of each element of 'base' equal to 'key', in increasing
+ * order, to 'indexes' and return their number.  'indexes' must have room
+ * for 'nelem' entries.
+ */
+SELECT_DEFINE(select8, 8, vector8_eq, uint32, select8_indexes)
+SELECT_DEFINE(select32, 32, vector32_eq, uint32, select32_indexes)
+
+/*
+ * select8_le / select32_le
+ *
+ * Write each element of 'base' less than or equal to 'key', in order, to
+ * 'out' and return their number.  'out' must have room for 'nelem'
+ * elements.
+ */
+SELECT_DEFINE(select8_le, 8, vector8_le, uint8, select8_values)
+SELECT_DEFINE(select32_le, 32, vector32_le, uint32, select32_values)
+
+/*
+ * select8_le_index / select32_le_index
+ *
+ * Like select8 and select32, for the elements less than or equal to 'key'.
+ */
+SELECT_DEFINE(select8_le_index, 8, vector8_le, uint32, select8_indexes)
+SELECT_DEFINE(select32_le_index, 32, vector32_le, uint32, select32_indexes)
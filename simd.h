@@ -2,17 +2,20 @@
 #define SIMD_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifndef HAVE_INT8
 typedef signed char int8;		/* == 8 bits */
 typedef signed short int16;		/* == 16 bits */
 typedef signed int int32;		/* == 32 bits */
+typedef signed long long int int64;	/* == 64 bits */
 #endif							/* not HAVE_INT8 */
 
 #ifndef HAVE_UINT8
 typedef unsigned char uint8;	/* == 8 bits */
 typedef unsigned short uint16;	/* == 16 bits */
 typedef unsigned int uint32;	/* == 32 bits */
+typedef unsigned long long int uint64;	/* == 64 bits */
 #endif							/* not HAVE_UINT8 */
 
 
@@ -25,8 +28,427 @@ typedef unsigned int uint32;	/* == 32 bits */
 	#error "Unsupported platform: No SIMD implementation available for this architecture."
 #endif
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
 extern bool lfind8(uint8 key, uint8 *base, uint32 nelem);
 extern bool lfind8_le(uint8 key, uint8 *base, uint32 nelem);
 extern bool lfind32(uint32 key, uint32 *base, uint32 nelem);
+extern bool lfind16(uint16 key, uint16 *base, uint32 nelem);
+extern bool lfind64(uint64 key, uint64 *base, uint32 nelem);
+
+/* returned by the _index variants when there is no match */
+#define LFIND_NOT_FOUND		((uint32) 0xFFFFFFFF)
+
+extern uint32 lfind8_index(uint8 key, uint8 *base, uint32 nelem);
+extern uint32 lfind32_index(uint32 key, uint32 *base, uint32 nelem);
+
+/* number of bytes written to 'bitmap' by the _mask variants */
+#define LFIND_BITMAP_BYTES(nelem)	(((nelem) + 7) / 8)
+
+extern uint32 lfind8_count(uint8 key, uint8 *base, uint32 nelem);
+extern uint32 lfind32_count(uint32 key, uint32 *base, uint32 nelem);
+extern uint32 lfind8_mask(uint8 key, uint8 *base, uint32 nelem, uint8 *bitmap);
+extern uint32 lfind32_mask(uint32 key, uint32 *base, uint32 nelem, uint8 *bitmap);
+
+extern bool lfind8_any(const uint8 *keys, uint32 nkeys, uint8 *base, uint32 nelem);
+extern bool lfind32_any(const uint32 *keys, uint32 nkeys, uint32 *base, uint32 nelem);
+
+/*
+ * Batched lookups of many keys in one array: lfind32_batch sets one bit per
+ * key in 'bitmap' (LFIND_BITMAP_BYTES(nkeys) bytes), lfind32_index_batch
+ * stores each key's first index or LFIND_NOT_FOUND.  Both return the number
+ * of keys found.
+ */
+extern uint32 lfind32_batch(const uint32 *keys, uint32 nkeys, uint32 *base,
+							uint32 nelem, uint8 *bitmap);
+extern uint32 lfind32_index_batch(const uint32 *keys, uint32 nkeys, uint32 *base,
+								  uint32 nelem, uint32 *indexes);
+
+/*
+ * Selection, see select.c: write the elements matching the predicate of
+ * lfind*, or lfind*_le for the _le variants, contiguously to 'out', or with
+ * the plain and _le_index variants their indexes, in order.  Return the
+ * number written.  The output must have room for 'nelem' entries.
+ */
+extern uint32 select8(uint8 key, uint8 *base, uint32 nelem, uint32 *indexes);
+extern uint32 select32(uint32 key, uint32 *base, uint32 nelem, uint32 *indexes);
+extern uint32 select8_le(uint8 key, uint8 *base, uint32 nelem, uint8 *out);
+extern uint32 select32_le(uint32 key, uint32 *base, uint32 nelem, uint32 *out);
+extern uint32 select8_le_index(uint8 key, uint8 *base, uint32 nelem, uint32 *indexes);
+extern uint32 select32_le_index(uint32 key, uint32 *base, uint32 nelem, uint32 *indexes);
+
+/*
+ * Bitmap combinators, see bitmap.c, e.g. for combining the bitmaps of the
+ * _mask kernels on several columns.  The first four set 'out' to a & b,
+ * a | b, a ^ b and a & ~b over 'nbytes' bytes and return it; 'out' may be
+ * one of the inputs.  simd_bitmap_any stops at the first bit set.
+ */
+extern uint8 *simd_bitmap_and(uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes);
+extern uint8 *simd_bitmap_or(uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes);
+extern uint8 *simd_bitmap_xor(uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes);
+extern uint8 *simd_bitmap_andnot(uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes);
+extern uint64 simd_bitmap_count(const uint8 *bitmap, size_t nbytes);
+extern bool simd_bitmap_any(const uint8 *bitmap, size_t nbytes);
+
+/*
+ * Range predicates, see lfind_range.c.  lfind*_range(lo, span) is true if
+ * some element x has lo <= x <= lo + span, computed with wrapping unsigned
+ * arithmetic; the named predicates below are built on it.
+ */
+extern bool lfind8_range(uint8 lo, uint8 span, uint8 *base, uint32 nelem);
+extern bool lfind16_range(uint16 lo, uint16 span, uint16 *base, uint32 nelem);
+extern bool lfind32_range(uint32 lo, uint32 span, uint32 *base, uint32 nelem);
+
+extern bool lfind8_lt(uint8 key, uint8 *base, uint32 nelem);
+extern bool lfind8_ge(uint8 key, uint8 *base, uint32 nelem);
+extern bool lfind8_gt(uint8 key, uint8 *base, uint32 nelem);
+extern bool lfind8_between(uint8 lo, uint8 hi, uint8 *base, uint32 nelem);
+
+extern bool lfind8_le_signed(int8 key, int8 *base, uint32 nelem);
+extern bool lfind8_lt_signed(int8 key, int8 *base, uint32 nelem);
+extern bool lfind8_ge_signed(int8 key, int8 *base, uint32 nelem);
+extern bool lfind8_gt_signed(int8 key, int8 *base, uint32 nelem);
+extern bool lfind8_between_signed(int8 lo, int8 hi, int8 *base, uint32 nelem);
+
+extern bool lfind16_le(uint16 key, uint16 *base, uint32 nelem);
+extern bool lfind16_lt(uint16 key, uint16 *base, uint32 nelem);
+extern bool lfind16_ge(uint16 key, uint16 *base, uint32 nelem);
+extern bool lfind16_gt(uint16 key, uint16 *base, uint32 nelem);
+extern bool lfind16_between(uint16 lo, uint16 hi, uint16 *base, uint32 nelem);
+
+extern bool lfind16_le_signed(int16 key, int16 *base, uint32 nelem);
+extern bool lfind16_lt_signed(int16 key, int16 *base, uint32 nelem);
+extern bool lfind16_ge_signed(int16 key, int16 *base, uint32 nelem);
+extern bool lfind16_gt_signed(int16 key, int16 *base, uint32 nelem);
+extern bool lfind16_between_signed(int16 lo, int16 hi, int16 *base, uint32 nelem);
+
+extern bool lfind32_le(uint32 key, uint32 *base, uint32 nelem);
+extern bool lfind32_lt(uint32 key, uint32 *base, uint32 nelem);
+extern bool lfind32_ge(uint32 key, uint32 *base, uint32 nelem);
+extern bool lfind32_gt(uint32 key, uint32 *base, uint32 nelem);
+extern bool lfind32_between(uint32 lo, uint32 hi, uint32 *base, uint32 nelem);
+
+extern bool lfind32_le_signed(int32 key, int32 *base, uint32 nelem);
+extern bool lfind32_lt_signed(int32 key, int32 *base, uint32 nelem);
+extern bool lfind32_ge_signed(int32 key, int32 *base, uint32 nelem);
+extern bool lfind32_gt_signed(int32 key, int32 *base, uint32 nelem);
+extern bool lfind32_between_signed(int32 lo, int32 hi, int32 *base, uint32 nelem);
+
+/*
+ * Variants for padded buffers: the caller guarantees that the LFIND_PADDING
+ * bytes after the last element are readable.  Their contents don't matter.
+ * The other kernels never read past 'nelem' elements in a way that could
+ * fault, but they need extra work to ensure that.
+ */
+#define LFIND_PADDING		64
+
+extern bool lfind8_padded(uint8 key, uint8 *base, uint32 nelem);
+extern bool lfind32_padded(uint32 key, uint32 *base, uint32 nelem);
+
+/*
+ * Buffers for the kernels: aligned to SIMD_ALIGNMENT, a cache line and the
+ * widest vector, and followed by LFIND_PADDING readable bytes.  lfind8 and
+ * lfind32 align their main loop themselves, but an aligned array saves them
+ * the unaligned head.  See simd_alloc.c.
+ */
+#define SIMD_ALIGNMENT		64
+#define SIMD_ALIGN_UP(len)	(((len) + SIMD_ALIGNMENT - 1) & ~((size_t) SIMD_ALIGNMENT - 1))
+
+extern void *simd_alloc_aligned(size_t size);
+extern void simd_free_aligned(void *p);
+
+/*
+ * Arenas of such buffers, freed all at once by simd_arena_reset() and kept
+ * mapped for reuse, so a query path can run without allocating.  One thread
+ * at a time per arena; simd_arena_thread() is the calling thread's own.
+ * See simd_arena.c.
+ */
+typedef struct SimdArena SimdArena;
+
+extern SimdArena *simd_arena_create(size_t block_size);
+extern void simd_arena_destroy(SimdArena *arena);
+extern void *simd_arena_alloc(SimdArena *arena, size_t size);
+extern uint8 *simd_arena_bitmap(SimdArena *arena, uint64 nelem);
+extern uint32 *simd_arena_indexes(SimdArena *arena, uint32 nkeys);
+extern void simd_arena_reset(SimdArena *arena);
+extern size_t simd_arena_mapped(const SimdArena *arena);
+extern SimdArena *simd_arena_thread(void);
+
+/*
+ * Scans of huge, cold arrays that try not to evict other data from the
+ * caches, see lfind8_nt in lfind.c.  lfind8 and lfind32 switch to these on
+ * arrays of at least the threshold set by lfind_set_nt_threshold() (never,
+ * by default).  lfind_set_prefetch_distance() sets how far ahead they
+ * prefetch; 0 resets either setting.
+ */
+extern bool lfind8_nt(uint8 key, uint8 *base, uint32 nelem);
+extern bool lfind32_nt(uint32 key, uint32 *base, uint32 nelem);
+extern void lfind_set_nt_threshold(size_t nbytes);
+extern void lfind_set_prefetch_distance(uint32 nbytes);
+
+/*
+ * Searches of sorted arrays, see lsearch.c.  lower_bound32 returns the
+ * insertion index of 'key' (the first element >= key); lsearch32_sorted
+ * returns the index of 'key' or LFIND_NOT_FOUND.
+ */
+extern uint32 lower_bound32(uint32 key, uint32 *base, uint32 nelem);
+extern uint32 lsearch32_sorted(uint32 key, uint32 *base, uint32 nelem);
+
+/*
+ * Static search tree over a sorted array, for large read-only key sets.
+ * stree32_lower_bound gives the same answer as lower_bound32 on the
+ * original array, touching one cache line per tree level;
+ * stree32_lower_bound_batch answers many queries at once and returns how
+ * many of the keys are present.
+ */
+typedef struct Stree32 Stree32;
+
+extern Stree32 *stree32_build(const uint32 *keys, uint32 nelem);
+extern void stree32_free(Stree32 *tree);
+extern uint32 stree32_lower_bound(const Stree32 *tree, uint32 key);
+extern uint32 stree32_lower_bound_batch(const Stree32 *tree, const uint32 *keys,
+										uint32 nkeys, uint32 *results);
+
+/*
+ * Shared indexes of keys, probed by many threads while they are rebuilt,
+ * see simd_index.c.  A reader registers once, then brackets each batch of
+ * probes with simd_index_read_begin() and simd_index_read_end(), without
+ * locking or waiting; the snapshot it gets is immutable, and freed after
+ * the last read of it once a newer one has been published.  The keys of a
+ * snapshot are aligned to 'alignment' and followed by 'padding' readable
+ * bytes, so the _padded kernels can be used on them.
+ */
+#define SIMD_INDEX_SORTED	0x01	/* keys are in ascending order */
+#define SIMD_INDEX_TREE		0x02	/* also build a search tree, implies sorted */
+
+typedef struct SimdIndex SimdIndex;
+typedef struct SimdIndexReader SimdIndexReader;
+
+typedef struct SimdIndexSnapshot
+{
+	const uint32 *keys;
+	uint32		nelem;
+	uint32		flags;			/* SIMD_INDEX_* it was published with */
+	uint64		version;		/* 0 for the initial empty snapshot, then 1, 2, ... */
+	size_t		alignment;
+	size_t		padding;
+	const Stree32 *tree;		/* NULL without SIMD_INDEX_TREE */
+} SimdIndexSnapshot;
+
+extern SimdIndex *simd_index_create(uint32 max_readers);
+extern void simd_index_destroy(SimdIndex *index);
+extern bool simd_index_publish(SimdIndex *index, const uint32 *keys, uint32 nelem,
+							   uint32 flags);
+extern uint32 simd_index_reclaim(SimdIndex *index);
+extern SimdIndexReader *simd_index_reader_register(SimdIndex *index);
+extern void simd_index_reader_unregister(SimdIndexReader *reader);
+extern const SimdIndexSnapshot *simd_index_read_begin(SimdIndexReader *reader);
+extern void simd_index_read_end(SimdIndexReader *reader);
+extern bool simd_snapshot_contains(const SimdIndexSnapshot *snapshot, uint32 key);
+extern uint32 simd_snapshot_lower_bound(const SimdIndexSnapshot *snapshot, uint32 key);
+
+/*
+ * Reductions over unsigned arrays.  vmin returns the type's maximum value
+ * and vmax 0 for an empty array.  vsum adds into 64-bit accumulators, so it
+ * cannot overflow except for 64-bit elements, which wrap around.  argmin
+ * and argmax return the index of the first minimum or maximum, or
+ * LFIND_NOT_FOUND for an empty array.
+ */
+extern uint8 vmin8(uint8 *base, uint32 nelem);
+extern uint8 vmax8(uint8 *base, uint32 nelem);
+extern uint64 vsum8(uint8 *base, uint32 nelem);
+extern uint32 argmin8(uint8 *base, uint32 nelem);
+extern uint32 argmax8(uint8 *base, uint32 nelem);
+extern uint16 vmin16(uint16 *base, uint32 nelem);
+extern uint16 vmax16(uint16 *base, uint32 nelem);
+extern uint64 vsum16(uint16 *base, uint32 nelem);
+extern uint32 argmin16(uint16 *base, uint32 nelem);
+extern uint32 argmax16(uint16 *base, uint32 nelem);
+extern uint32 vmin32(uint32 *base, uint32 nelem);
+extern uint32 vmax32(uint32 *base, uint32 nelem);
+extern uint64 vsum32(uint32 *base, uint32 nelem);
+extern uint32 argmin32(uint32 *base, uint32 nelem);
+extern uint32 argmax32(uint32 *base, uint32 nelem);
+extern uint64 vmin64(uint64 *base, uint32 nelem);
+extern uint64 vmax64(uint64 *base, uint32 nelem);
+extern uint64 vsum64(uint64 *base, uint32 nelem);
+extern uint32 argmin64(uint64 *base, uint32 nelem);
+extern uint32 argmax64(uint64 *base, uint32 nelem);
+
+/* search and aggregate in one pass; see lfind32_stats */
+typedef struct Lfind32Stats
+{
+	uint32		count;			/* number of elements equal to the key */
+	uint32		first;			/* index of the first, or LFIND_NOT_FOUND */
+	uint32		min;
+	uint32		max;
+	uint64		sum;
+} Lfind32Stats;
+
+extern uint32 lfind32_stats(uint32 key, uint32 *base, uint32 nelem,
+							Lfind32Stats *stats);
+
+/*
+ * Open-addressing hash map from uint64 keys to uint64 values, searched a
+ * group of 16 slots at a time with vector compares of their control bytes
+ * (SwissTable style).  Not safe for concurrent updates.
+ */
+typedef struct SimdHashMap SimdHashMap;
+
+extern SimdHashMap *simd_hash_create(uint32 capacity);
+extern void simd_hash_destroy(SimdHashMap *map);
+extern bool simd_hash_insert(SimdHashMap *map, uint64 key, uint64 value);
+extern bool simd_hash_lookup(const SimdHashMap *map, uint64 key, uint64 *value);
+extern bool simd_hash_delete(SimdHashMap *map, uint64 key);
+extern uint32 simd_hash_count(const SimdHashMap *map);
+
+/*
+ * Multi-threaded scans, see lfind_parallel.c.  Pass a pool from
+ * lfind_pool_create() or NULL for a default pool with one thread per CPU.
+ * Arrays shorter than two chunks are searched by the calling thread.
+ */
+typedef struct LfindPool LfindPool;
+
+extern LfindPool *lfind_pool_create(uint32 nthreads);
+extern void lfind_pool_destroy(LfindPool *pool);
+extern void lfind_pool_set_chunk_size(LfindPool *pool, uint32 chunk_bytes);
+
+extern bool lfind8_parallel(uint8 key, uint8 *base, uint32 nelem, LfindPool *pool);
+extern bool lfind32_parallel(uint32 key, uint32 *base, uint32 nelem, LfindPool *pool);
+extern uint32 lfind8_count_parallel(uint8 key, uint8 *base, uint32 nelem,
+									LfindPool *pool);
+extern uint32 lfind32_count_parallel(uint32 key, uint32 *base, uint32 nelem,
+									 LfindPool *pool);
+extern uint32 lfind8_mask_parallel(uint8 key, uint8 *base, uint32 nelem,
+								   uint8 *bitmap, LfindPool *pool);
+extern uint32 lfind32_mask_parallel(uint32 key, uint32 *base, uint32 nelem,
+									uint8 *bitmap, LfindPool *pool);
+
+/*
+ * Scans of whole files through mmap(), see lfind_file.c.  The file is an
+ * array of 'elem_size' (1 or 4) byte elements in native byte order.  With
+ * 'parallel' set the chunks are spread over 'pool' (NULL for the default
+ * pool), like the _parallel functions.  LFIND_FILE_MASK needs a 'bitmap' of
+ * LFIND_BITMAP_BYTES(number of elements) bytes.  'chunk_bytes' is how much
+ * of the file each kernel call covers, 0 for a default of 64MB.
+ */
+#define LFIND_FILE_FIND		0	/* returns 1 if 'key' is in the file, else 0 */
+#define LFIND_FILE_COUNT	1	/* returns the number of matches */
+#define LFIND_FILE_MASK		2	/* same, and sets their bits in 'bitmap' */
+
+typedef struct LfindFileScan
+{
+	uint32		op;
+	uint32		elem_size;
+	uint64		key;
+	uint8	   *bitmap;
+	bool		parallel;
+	LfindPool  *pool;
+	uint32		chunk_bytes;
+} LfindFileScan;
+
+extern int64 lfind_file_scan_fd(int fd, const LfindFileScan *scan);
+extern int64 lfind_file_scan(const char *path, const LfindFileScan *scan);
+
+/*
+ * Byte scanners with the semantics of their libc namesakes, see bytescan.c.
+ * simd_memchr2/3 find the first byte equal to any of the given values.
+ */
+extern void *simd_memchr(const void *s, int c, size_t n);
+extern void *simd_memrchr(const void *s, int c, size_t n);
+extern void *simd_memchr2(const void *s, int c1, int c2, size_t n);
+extern void *simd_memchr3(const void *s, int c1, int c2, int c3, size_t n);
+extern size_t simd_strlen(const char *s);
+
+/*
+ * Text validation and classification, see textscan.c.  simd_is_ascii and
+ * simd_utf8_validate tell whether 'buf' is all ASCII, or well-formed UTF-8
+ * (no overlong forms, surrogates or code points above U+10FFFF, nor a
+ * sequence cut off at the end).  simd_find_byte_class returns the offset of
+ * the first byte of 'buf' in a class set up by simd_byte_class_init, or 'n'
+ * if there is none, like strcspn.
+ */
+typedef struct SimdByteClass
+{
+	uint8		set[32];		/* byte c is in bit (c & 7) of set[c >> 3] */
+	uint8		row0[16];		/* nibble tables derived from 'set' */
+	uint8		row1[16];
+} SimdByteClass;
+
+extern void simd_byte_class_init(SimdByteClass *cls, const uint8 *set);
+extern bool simd_is_ascii(const void *buf, size_t n);
+extern bool simd_utf8_validate(const void *buf, size_t n);
+extern size_t simd_find_byte_class(const SimdByteClass *cls, const void *buf, size_t n);
+
+/* offset of the first occurrence of 'needle' in 'haystack', or LFIND_NOT_FOUND */
+extern uint32 lfind_substr(const uint8 *needle, uint32 nlen,
+						   const uint8 *haystack, uint32 hlen);
+
+/*
+ * Search for a byte string in data fed in chunks, e.g. scatter/gather
+ * buffers, without copying them together; see lfind_stream.c.  Matches that
+ * span chunk boundaries are found, and positions are offsets from the start
+ * of the stream.  An LfindStream holds no resources and may live on the
+ * stack.
+ */
+#define LFIND_STREAM_MAX_NEEDLE	64
+#define LFIND_STREAM_NOT_FOUND	(~(uint64) 0)
+
+typedef struct LfindStream
+{
+	uint8		needle[LFIND_STREAM_MAX_NEEDLE];
+	uint32		nlen;
+	uint8		carry[LFIND_STREAM_MAX_NEEDLE - 1];	/* end of the data so far */
+	uint32		ncarry;
+	uint64		offset;			/* number of bytes fed */
+	uint64		found;			/* offset of the first match */
+} LfindStream;
+
+extern bool lfind_stream_init(LfindStream *stream, const uint8 *needle, uint32 nlen);
+extern uint64 lfind_stream_feed(LfindStream *stream, const uint8 *chunk, uint32 len);
+extern uint64 lfind_stream_finish(LfindStream *stream);
+
+/*
+ * Hardware performance counters per call site and kernel, see simd_perf.c.
+ * Only a library built with SIMD_PERF_COUNTERS records anything; otherwise
+ * simd_perf_enable() returns -1 and the rest do nothing.
+ */
+#define SIMD_PERF_CYCLES		0x01
+#define SIMD_PERF_INSTRUCTIONS	0x02
+#define SIMD_PERF_L1D_MISSES	0x04
+#define SIMD_PERF_LLC_MISSES	0x08
+#define SIMD_PERF_BRANCH_MISSES	0x10
+
+typedef struct SimdPerfCounters
+{
+	const char *site;			/* "" for calls outside any named site */
+	const char *kernel;
+	uint64		calls;
+	uint64		bytes;			/* size of the data searched */
+	uint64		sampled;		/* calls the counters below cover */
+	uint64		cycles;
+	uint64		instructions;
+	uint64		l1d_misses;
+	uint64		llc_misses;
+	uint64		branch_misses;
+} SimdPerfCounters;
+
+extern int simd_perf_enable(uint32 sample_every);
+extern void simd_perf_disable(void);
+extern void simd_perf_reset(void);
+extern bool simd_perf_set_site(const char *site);
+extern uint32 simd_perf_read(SimdPerfCounters *counters, uint32 max);
+extern void simd_perf_dump(int fd);
+
+/* runtime kernel selection, see simd_dispatch.c */
+extern const char *simd_get_impl_name(void);
+extern bool simd_set_impl(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif	/* SIMD_H */
@@ -0,0 +1,557 @@
+/*
+ * simd.hpp
+ *
+ * C++20 front end: find, count and find_if over any contiguous range of
+ * 1, 2, 4 or 8 byte integers, such as a std::span, std::vector, std::array
+ * or C array, without copying it.
+ *
+ *	std::span<const uint32> ids = ...;
+ *	size_t		i = simd::find(key, ids);
+ *	size_t		n = simd::count<uint8>('\n', buf);
+ *	size_t		j = simd::find_if(ids, simd::range<uint32>{lo, hi});
+ *
+ * The scans are templates over the element type and the predicate (eq, le
+ * or range), built from the Vector8 .. Vector64 primitives of the backend
+ * headers and inlined into the caller, so they use the instruction set of
+ * the caller's compile flags.  Ranges whose size is part of their type
+ * (std::array, C arrays, fixed-extent spans) get the fully unrolled code of
+ * simd_inline.h's lfindN_n: no loop and a single branch for a miss.
+ *
+ * The one exception to inlining is an equality scan of at least
+ * SIMD_CXX_LIBRARY_BYTES over 1 or 4 byte elements, which goes to the
+ * library's lfind8_index / lfind32_index / lfind8_count / lfind32_count.
+ * At that size the call costs nothing, and the library picks the widest
+ * kernel the CPU supports at run time, so programs using it link -lsimd.
+ */
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <ranges>
+#include <span>
+#include <type_traits>
+
+#include "simd_inline.h"
+
+/* equality scans at least this big go to the library's kernels */
+#ifndef SIMD_CXX_LIBRARY_BYTES
+#define SIMD_CXX_LIBRARY_BYTES	4096
+#endif
+
+namespace simd
+{
+
+/*
+ * Predicates for find_if().  The bounds are inclusive, and the element type
+ * must be unsigned for le and range.
+ */
+template <typename K>
+struct eq
+{
+	K			key;
+};
+
+template <typename K>
+struct le
+{
+	K			key;
+};
+
+template <typename K>
+struct range
+{
+	K			lo;
+	K			hi;
+};
+
+/* deduction guides: range{1, 10u} is a range<unsigned> */
+template <typename K> eq(K) -> eq<K>;
+template <typename K> le(K) -> le<K>;
+template <typename K, typename L> range(K, L) -> range<std::common_type_t<K, L>>;
+
+namespace detail
+{
+
+/*
+ * The vector primitives for one element size.  'unroll' is the number of
+ * vectors the dynamic-size loops take per step before testing for a match:
+ * enough to hide the compare latency, but fewer of the wide AVX-512
+ * vectors, so that short arrays still reach the loop.
+ */
+template <std::size_t Size>
+struct traits;
+
+/*
+ * The partial loads may read past the end of an array, within its page, as
+ * simd_x86.h explains.  Once a fixed-size array is inlined, -Warray-bounds
+ * sees that; passing the pointer through an empty asm hides the array.
+ */
+template <typename E>
+inline const E *
+hide_bounds(const E *p)
+{
+	__asm__("" : "+r"(p));
+	return p;
+}
+
+#define SIMD_DEFINE_TRAITS(bits) \
+template <> \
+struct traits<sizeof(uint##bits)> \
+{ \
+	using elem = uint##bits; \
+	using vec = Vector##bits; \
+\
+	static constexpr std::size_t lanes = sizeof(Vector##bits) / sizeof(uint##bits); \
+	static constexpr std::size_t unroll = sizeof(Vector##bits) >= 64 ? 2 : 4; \
+\
+	static vec broadcast(elem c) { return vector##bits##_broadcast(c); } \
+	static vec load(const elem *p) { vec v; vector##bits##_load(&v, p); return v; } \
+	static vec load_partial(const elem *p, uint32 n) \
+	{ \
+		vec			v; \
+		vector##bits##_load_partial(&v, hide_bounds(p), n); \
+		return v; \
+	} \
+	static uint64 load_tail(vec *v, const elem *p, uint32 i, uint32 n, uint32 *start) \
+	{ \
+		return simd_load_tail##bits(v, hide_bounds(p), i, n, start); \
+	} \
+	static vec eq(vec a, vec b) { return vector##bits##_eq(a, b); } \
+	static vec min(vec a, vec b) { return vector##bits##_min(a, b); } \
+	static vec max(vec a, vec b) { return vector##bits##_max(a, b); } \
+	static vec or_(vec a, vec b) { return vector##bits##_or(a, b); } \
+	static bool any(vec m) { return vector##bits##_is_highbit_set(m); } \
+	static uint64 mask(vec m) { return vector##bits##_cmp_mask(m); } \
+};
+
+SIMD_DEFINE_TRAITS(8)
+SIMD_DEFINE_TRAITS(16)
+SIMD_DEFINE_TRAITS(32)
+SIMD_DEFINE_TRAITS(64)
+
+#undef SIMD_DEFINE_TRAITS
+
+/*
+ * A predicate bound to vectors: operator() returns the compare result for
+ * one vector of elements, all ones in the lanes that match.
+ */
+template <typename Tr, typename P>
+struct matcher;
+
+template <typename Tr, typename K>
+struct matcher<Tr, eq<K>>
+{
+	typename Tr::vec key;
+
+	explicit matcher(const eq<K> &p) : key(Tr::broadcast((typename Tr::elem) p.key)) {}
+	typename Tr::vec operator()(typename Tr::vec v) const { return Tr::eq(v, key); }
+};
+
+/* v <= key where min(v, key) == v */
+template <typename Tr, typename K>
+struct matcher<Tr, le<K>>
+{
+	typename Tr::vec key;
+
+	explicit matcher(const le<K> &p) : key(Tr::broadcast((typename Tr::elem) p.key)) {}
+	typename Tr::vec operator()(typename Tr::vec v) const
+	{
+		return Tr::eq(Tr::min(v, key), v);
+	}
+};
+
+/* lo <= v <= hi where clamping v to [lo, hi] leaves it alone */
+template <typename Tr, typename K>
+struct matcher<Tr, range<K>>
+{
+	typename Tr::vec lo;
+	typename Tr::vec hi;
+
+	explicit matcher(const range<K> &p) :
+		lo(Tr::broadcast((typename Tr::elem) p.lo)),
+		hi(Tr::broadcast((typename Tr::elem) p.hi)) {}
+	typename Tr::vec operator()(typename Tr::vec v) const
+	{
+		return Tr::eq(Tr::min(Tr::max(v, lo), hi), v);
+	}
+};
+
+template <typename P>
+inline constexpr bool is_ordered_v = false;
+template <typename K>
+inline constexpr bool is_ordered_v<le<K>> = true;
+template <typename K>
+inline constexpr bool is_ordered_v<range<K>> = true;
+
+template <typename P>
+inline constexpr bool is_eq_v = false;
+template <typename K>
+inline constexpr bool is_eq_v<eq<K>> = true;
+
+/* the size of a range if it is part of its type, else dynamic_extent */
+template <typename R>
+inline constexpr std::size_t static_extent_v = std::dynamic_extent;
+template <typename T, std::size_t N>
+inline constexpr std::size_t static_extent_v<std::span<T, N>> = N;
+template <typename T, std::size_t N>
+inline constexpr std::size_t static_extent_v<std::array<T, N>> = N;
+template <typename T, std::size_t N>
+inline constexpr std::size_t static_extent_v<T[N]> = N;
+
+template <typename R>
+using value_t = std::remove_cv_t<std::ranges::range_value_t<R>>;
+
+/* the key type: T if given, else the range's element type */
+struct deduce;
+
+template <typename T, typename R>
+using key_t = std::conditional_t<std::is_same_v<T, deduce>, value_t<R>, T>;
+
+template <typename T, typename R, typename P>
+constexpr void
+check_types()
+{
+	using V = value_t<R>;
+
+	static_assert(std::ranges::contiguous_range<R> && std::ranges::sized_range<R>,
+				  "simd scans need a contiguous, sized range");
+	static_assert(std::is_integral_v<V> && !std::is_same_v<V, bool> &&
+				  (sizeof(V) == 1 || sizeof(V) == 2 || sizeof(V) == 4 || sizeof(V) == 8),
+				  "simd scans take 1, 2, 4 or 8 byte integers");
+	static_assert(sizeof(key_t<T, R>) == sizeof(V),
+				  "the key type must have the size of the range's elements");
+	static_assert(!is_ordered_v<P> || std::is_unsigned_v<V>,
+				  "le and range compare unsigned elements");
+}
+
+/*
+ * Index of the first of the 'n' elements at 'base' that 'match' selects, or
+ * 'n'.  Works like lfindN_index: 'unroll' vectors per step while they last,
+ * merging their compares before the test, then single vectors, then the
+ * tail through simd_load_tailN, so there is no scalar remainder loop.
+ */
+template <typename Tr, typename M>
+inline std::size_t
+find_first(const typename Tr::elem *base, std::size_t n, const M &match)
+{
+	using vec = typename Tr::vec;
+	constexpr std::size_t lanes = Tr::lanes;
+	constexpr std::size_t step = Tr::unroll * lanes;
+	std::size_t i = 0;
+	uint64		mask;
+
+	for (; n - i >= step; i += step)
+	{
+		vec			m[Tr::unroll];
+		vec			merged;
+
+		m[0] = match(Tr::load(&base[i]));
+		merged = m[0];
+		for (std::size_t k = 1; k < Tr::unroll; k++)
+		{
+			m[k] = match(Tr::load(&base[i + k * lanes]));
+			merged = Tr::or_(merged, m[k]);
+		}
+		if (!Tr::any(merged))
+			continue;
+		for (std::size_t k = 0; k < Tr::unroll; k++)
+		{
+			mask = Tr::mask(m[k]);
+			if (mask != 0)
+				return i + k * lanes + simd_mask_first_byte(mask) / sizeof(typename Tr::elem);
+		}
+	}
+
+	for (; n - i >= lanes; i += lanes)
+	{
+		mask = Tr::mask(match(Tr::load(&base[i])));
+		if (mask != 0)
+			return i + simd_mask_first_byte(mask) / sizeof(typename Tr::elem);
+	}
+
+	if (i < n)
+	{
+		/* at most a vector back, so the tail counts fit a uint32 */
+		std::size_t back = i < lanes ? i : lanes;
+		const typename Tr::elem *tail = &base[i - back];
+		vec			v;
+		uint32		start;
+
+		mask = Tr::load_tail(&v, tail, (uint32) back, (uint32) (n - i + back), &start);
+		mask &= Tr::mask(match(v));
+		if (mask != 0)
+			return i - back + start + simd_mask_first_byte(mask) / sizeof(typename Tr::elem);
+	}
+
+	return n;
+}
+
+/* number of the 'n' elements at 'base' that 'match' selects */
+template <typename Tr, typename M>
+inline std::size_t
+count_matches(const typename Tr::elem *base, std::size_t n, const M &match)
+{
+	using vec = typename Tr::vec;
+	constexpr std::size_t lanes = Tr::lanes;
+	std::size_t count = 0;
+	std::size_t i = 0;
+
+	for (; n - i >= Tr::unroll * lanes; i += Tr::unroll * lanes)
+	{
+		for (std::size_t k = 0; k < Tr::unroll; k++)
+			count += simd_mask_count_bytes(Tr::mask(match(Tr::load(&base[i + k * lanes]))));
+	}
+
+	for (; n - i >= lanes; i += lanes)
+		count += simd_mask_count_bytes(Tr::mask(match(Tr::load(&base[i]))));
+
+	if (i < n)
+	{
+		std::size_t back = i < lanes ? i : lanes;
+		vec			v;
+		uint32		start;
+		uint64		mask;
+
+		mask = Tr::load_tail(&v, &base[i - back], (uint32) back,
+							 (uint32) (n - i + back), &start);
+		count += simd_mask_count_bytes(mask & Tr::mask(match(v)));
+	}
+
+	return count / sizeof(typename Tr::elem);
+}
+
+/*
+ * find_first() for a compile-time size, like lfindN_index_n: the compares
+ * of all whole vectors, plus one overlapping the end if N is not a multiple
+ * of the vector, are merged and tested once, and only a hit goes back to
+ * find the first matching lane.
+ */
+template <typename Tr, std::size_t N, typename M>
+[[gnu::always_inline]] inline std::size_t
+find_first_n(const typename Tr::elem *base, const M &match)
+{
+	using vec = typename Tr::vec;
+	constexpr std::size_t lanes = Tr::lanes;
+	constexpr std::size_t whole = N / lanes;
+
+	if constexpr (N == 0)
+		return 0;
+	else if constexpr (N < lanes)
+	{
+		uint64		mask = Tr::mask(match(Tr::load_partial(base, N))) &
+			simd_mask_prefix(N * sizeof(typename Tr::elem));
+
+		return mask != 0 ? simd_mask_first_byte(mask) / sizeof(typename Tr::elem) : N;
+	}
+	else
+	{
+		vec			m[whole + 1];
+		vec			merged;
+
+		m[0] = match(Tr::load(base));
+		merged = m[0];
+#pragma GCC unroll 64
+		for (std::size_t k = 1; k < whole; k++)
+		{
+			m[k] = match(Tr::load(&base[k * lanes]));
+			merged = Tr::or_(merged, m[k]);
+		}
+		if constexpr (N % lanes != 0)
+		{
+			m[whole] = match(Tr::load(&base[N - lanes]));
+			merged = Tr::or_(merged, m[whole]);
+		}
+		if (!Tr::any(merged))
+			return N;
+
+#pragma GCC unroll 64
+		for (std::size_t k = 0; k < whole; k++)
+		{
+			uint64		mask = Tr::mask(m[k]);
+
+			if (mask != 0)
+				return k * lanes + simd_mask_first_byte(mask) / sizeof(typename Tr::elem);
+		}
+		if constexpr (N % lanes != 0)
+			return N - lanes + simd_mask_first_byte(Tr::mask(m[whole])) /
+				sizeof(typename Tr::elem);
+		else
+			return N;
+	}
+}
+
+template <typename Tr, std::size_t N, typename M>
+[[gnu::always_inline]] inline std::size_t
+count_matches_n(const typename Tr::elem *base, const M &match)
+{
+	constexpr std::size_t lanes = Tr::lanes;
+	std::size_t count = 0;
+
+	if constexpr (N == 0)
+		return 0;
+	else if constexpr (N < lanes)
+		count = simd_mask_count_bytes(Tr::mask(match(Tr::load_partial(base, N))) &
+									  simd_mask_prefix(N * sizeof(typename Tr::elem)));
+	else
+	{
+#pragma GCC unroll 64
+		for (std::size_t k = 0; k < N / lanes; k++)
+			count += simd_mask_count_bytes(Tr::mask(match(Tr::load(&base[k * lanes]))));
+		/* the overlapping last vector, less the lanes already counted */
+		if constexpr (N % lanes != 0)
+			count += simd_mask_count_bytes(Tr::mask(match(Tr::load(&base[N - lanes]))) &
+										   ~simd_mask_prefix((lanes - N % lanes) *
+															 sizeof(typename Tr::elem)));
+	}
+	return count / sizeof(typename Tr::elem);
+}
+
+/* the library kernels, for large equality scans */
+template <typename E>
+inline bool
+use_library(std::size_t n)
+{
+	return (sizeof(E) == 1 || sizeof(E) == 4) &&
+		n * sizeof(E) >= SIMD_CXX_LIBRARY_BYTES && n < LFIND_NOT_FOUND;
+}
+
+inline std::size_t
+library_find(uint8 key, const uint8 *base, std::size_t n)
+{
+	uint32		i = lfind8_index(key, const_cast<uint8 *>(base), (uint32) n);
+
+	return i == LFIND_NOT_FOUND ? n : i;
+}
+
+inline std::size_t
+library_find(uint32 key, const uint32 *base, std::size_t n)
+{
+	uint32		i = lfind32_index(key, const_cast<uint32 *>(base), (uint32) n);
+
+	return i == LFIND_NOT_FOUND ? n : i;
+}
+
+
+inline std::size_t
+library_count(uint8 key, const uint8 *base, std::size_t n)
+{
+	return lfind8_count(key, const_cast<uint8 *>(base), (uint32) n);
+}
+
+inline std::size_t
+library_count(uint32 key, const uint32 *base, std::size_t n)
+{
+	return lfind32_count(key, const_cast<uint32 *>(base), (uint32) n);
+}
+
+
+}								/* namespace detail */
+
+/*
+ * find_if
+ *
+ * Index of the first element of 'r' that 'pred' (simd::eq, simd::le or
+ * simd::range) selects, or the size of 'r' if there is none, like
+ * std::ranges::find_if returns end().
+ */
+template <typename T = detail::deduce, typename R, typename P>
+inline std::size_t
+find_if(R &&r, const P &pred)
+{
+	detail::check_types<T, R, P>();
+
+	using V = detail::value_t<R>;
+	using Tr = detail::traits<sizeof(V)>;
+	using E = typename Tr::elem;
+	constexpr std::size_t extent = detail::static_extent_v<std::remove_cvref_t<R>>;
+
+	const E    *base = reinterpret_cast<const E *>(std::ranges::data(r));
+	const detail::matcher<Tr, P> match(pred);
+
+	if constexpr (extent != std::dynamic_extent)
+		return detail::find_first_n<Tr, extent>(base, match);
+	else
+	{
+		std::size_t n = std::ranges::size(r);
+
+		if constexpr (detail::is_eq_v<P> && (sizeof(E) == 1 || sizeof(E) == 4))
+		{
+			if (detail::use_library<E>(n))
+				return detail::library_find((E) pred.key, base, n);
+		}
+		return detail::find_first<Tr>(base, n, match);
+	}
+}
+
+/*
+ * find
+ *
+ * Index of the first element of 'r' equal to 'key', or the size of 'r'.
+ * simd::find<T>(key, r) converts 'key' to T, which must have the size of
+ * the elements; by default it is the element type.
+ */
+template <typename T = detail::deduce, typename R>
+inline std::size_t
+find(detail::key_t<T, R> key, R &&r)
+{
+	return find_if<T>(std::forward<R>(r), eq<detail::key_t<T, R>>{key});
+}
+
+/*
+ * contains
+ *
+ * Whether any element of 'r' equals 'key'.
+ */
+template <typename T = detail::deduce, typename R>
+inline bool
+contains(detail::key_t<T, R> key, R &&r)
+{
+	return find<T>(key, r) != std::ranges::size(r);
+}
+
+/*
+ * count_if / count
+ *
+ * Number of elements of 'r' that 'pred' selects, or that equal 'key'.
+ */
+template <typename T = detail::deduce, typename R, typename P>
+inline std::size_t
+count_if(R &&r, const P &pred)
+{
+	detail::check_types<T, R, P>();
+
+	using V = detail::value_t<R>;
+	using Tr = detail::traits<sizeof(V)>;
+	using E = typename Tr::elem;
+	constexpr std::size_t extent = detail::static_extent_v<std::remove_cvref_t<R>>;
+
+	const E    *base = reinterpret_cast<const E *>(std::ranges::data(r));
+	const detail::matcher<Tr, P> match(pred);
+
+	if constexpr (extent != std::dynamic_extent)
+		return detail::count_matches_n<Tr, extent>(base, match);
+	else
+	{
+		std::size_t n = std::ranges::size(r);
+
+		if constexpr (detail::is_eq_v<P> && (sizeof(E) == 1 || sizeof(E) == 4))
+		{
+			if (detail::use_library<E>(n))
+				return detail::library_count((E) pred.key, base, n);
+		}
+		return detail::count_matches<Tr>(base, n, match);
+	}
+}
+
+template <typename T = detail::deduce, typename R>
+inline std::size_t
+count(detail::key_t<T, R> key, R &&r)
+{
+	return count_if<T>(std::forward<R>(r), eq<detail::key_t<T, R>>{key});
+}
+
+}								/* namespace simd */
+
+#endif							/* SIMD_HPP */
@@ -0,0 +1,61 @@
+/*
+ * simd_alloc.c
+ *
+ * Allocation of buffers laid out for the scan kernels.
+ *
+ * Buffers from simd_alloc_aligned() start on a SIMD_ALIGNMENT boundary, so
+ * the kernels' aligned main loops start at the first element, and they
+ * are followed by at least LFIND_PADDING readable bytes, so the _padded
+ * kernels may be used on any prefix of them.  The padding is zeroed, which
+ * keeps tools like valgrind quiet about the kernels' over-reads.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd_internal.h"
+
+/*
+ * simd_alloc_aligned
+ *
+ * Allocate 'size' bytes aligned to SIMD_ALIGNMENT and padded for the
+ * vectorized tail, as above.  The contents of the first 'size' bytes are
+ * undefined.  Returns NULL with errno set on failure.  Free the buffer
+ * with simd_free_aligned().
+ */
+void *
+simd_alloc_aligned(size_t size)
+{
+	size_t		padded = SIMD_ALIGN_UP(size) + LFIND_PADDING;
+	void	   *p;
+	int			rc;
+
+	if (padded < size)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	rc = posix_memalign(&p, SIMD_ALIGNMENT, padded);
+	if (rc != 0)
+	{
+		errno = rc;
+		return NULL;
+	}
+
+	memset((uint8 *) p + size, 0, padded - size);
+	return p;
+}
+
+/*
+ * simd_free_aligned
+ *
+ * Free a buffer from simd_alloc_aligned().  NULL is ignored.
+ */
+void
+simd_free_aligned(void *p)
+{
+	free(p);
+}
@@ -0,0 +1,304 @@
+/*
+ * simd_arena.c
+ *
+ * Arena allocator for the temporary buffers of a query: filter bitmaps,
+ * index outputs, gathered keys.
+ *
+ * An arena hands out buffers from large blocks mapped with mmap(), bumping
+ * a pointer, and frees them all at once with simd_arena_reset().  The
+ * blocks are kept across resets, so a query path that allocates the same
+ * buffers every time stops making system calls, and stops faulting in
+ * fresh pages, after its first run.  Blocks of SIMD_ARENA_HUGE_PAGE bytes
+ * or more are aligned to that size and advised MADV_HUGEPAGE, so that with
+ * transparent huge pages enabled a big bitmap costs a handful of TLB
+ * entries instead of thousands.
+ *
+ * Every buffer is aligned to SIMD_ALIGNMENT and followed by at least
+ * LFIND_PADDING readable bytes, like those of simd_alloc_aligned().  The
+ * padding may be the start of the next buffer, since the _padded kernels
+ * only need it to be readable.
+ *
+ * An arena must only be used by one thread at a time.  simd_arena_thread()
+ * gives each thread its own, destroyed when the thread exits.
+ */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "simd_internal.h"
+
+/* default block size, see simd_arena_create() */
+#define SIMD_ARENA_DEFAULT_BLOCK	(2 * 1024 * 1024)
+
+/* transparent huge page size on x86-64 and on arm64 with 4kB pages */
+#define SIMD_ARENA_HUGE_PAGE		(2 * 1024 * 1024)
+
+typedef struct SimdArenaBlock
+{
+	struct SimdArenaBlock *next;
+	size_t		size;			/* of the mapping, header included */
+} SimdArenaBlock;
+
+/* buffers start this far into their block */
+#define SIMD_ARENA_HEADER	SIMD_ALIGN_UP(sizeof(SimdArenaBlock))
+
+struct SimdArena
+{
+	SimdArenaBlock *first;
+	SimdArenaBlock *current;	/* the block being allocated from */
+	size_t		used;			/* bytes of 'current' taken, header included */
+	size_t		block_size;
+	size_t		mapped;			/* total size of the blocks */
+};
+
+/* the calling thread's arena, destroyed when the thread exits */
+static __thread SimdArena *simd_arena_local;
+static pthread_key_t simd_arena_thread_key;
+static pthread_once_t simd_arena_key_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Map a block of at least 'size' bytes.  Big blocks are rounded up to whole
+ * huge pages and aligned to one, by mapping a huge page more than needed
+ * and unmapping the ends.
+ */
+static SimdArenaBlock *
+simd_arena_map_block(size_t size)
+{
+	SimdArenaBlock *block;
+	uint8	   *map;
+
+	if (size < SIMD_ARENA_HUGE_PAGE)
+	{
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED)
+			return NULL;
+	}
+	else
+	{
+		size_t		head;
+		size_t		tail;
+
+		size = (size + SIMD_ARENA_HUGE_PAGE - 1) & ~((size_t) SIMD_ARENA_HUGE_PAGE - 1);
+		map = mmap(NULL, size + SIMD_ARENA_HUGE_PAGE, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED)
+			return NULL;
+
+		head = (SIMD_ARENA_HUGE_PAGE - ((uintptr_t) map & (SIMD_ARENA_HUGE_PAGE - 1))) &
+			(SIMD_ARENA_HUGE_PAGE - 1);
+		tail = SIMD_ARENA_HUGE_PAGE - head;
+		if (head > 0)
+			munmap(map, head);
+		munmap(map + head + size, tail);
+		map += head;
+
+#ifdef MADV_HUGEPAGE
+		/* only a hint, so a failure doesn't matter */
+		(void) madvise(map, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	block = (SimdArenaBlock *) map;
+	block->next = NULL;
+	block->size = size;
+	return block;
+}
+
+/*
+ * simd_arena_create
+ *
+ * Create an empty arena that maps its memory in blocks of 'block_size'
+ * bytes, 0 for a default of 2MB.  Larger buffers get a block of their own.
+ * Returns NULL if out of memory.
+ */
+SimdArena *
+simd_arena_create(size_t block_size)
+{
+	SimdArena  *arena = calloc(1, sizeof(SimdArena));
+
+	if (arena == NULL)
+		return NULL;
+
+	arena->block_size = block_size ? block_size : SIMD_ARENA_DEFAULT_BLOCK;
+	return arena;
+}
+
+/*
+ * simd_arena_destroy
+ *
+ * Unmap all of the arena's blocks, freeing every buffer it handed out.
+ * NULL is ignored.
+ */
+void
+simd_arena_destroy(SimdArena *arena)
+{
+	SimdArenaBlock *block;
+
+	if (arena == NULL)
+		return;
+
+	for (block = arena->first; block != NULL;)
+	{
+		SimdArenaBlock *next = block->next;
+
+		munmap(block, block->size);
+		block = next;
+	}
+	free(arena);
+}
+
+/*
+ * simd_arena_alloc
+ *
+ * Allocate 'size' bytes from 'arena', aligned to SIMD_ALIGNMENT and followed
+ * by at least LFIND_PADDING readable bytes.  The contents are undefined.
+ * Returns NULL with errno set if out of memory.  The buffer lives until the
+ * next simd_arena_reset() or simd_arena_destroy().
+ */
+void *
+simd_arena_alloc(SimdArena *arena, size_t size)
+{
+	size_t		need = SIMD_ALIGN_UP(size) + LFIND_PADDING;
+	SimdArenaBlock *block;
+	void	   *p;
+
+	if (need < size)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* the current block, or the next one kept from before a reset that fits */
+	for (block = arena->current; block != NULL; block = block->next)
+	{
+		size_t		used = block == arena->current ? arena->used : SIMD_ARENA_HEADER;
+
+		if (block->size - used >= need)
+		{
+			arena->current = block;
+			arena->used = used;
+			break;
+		}
+	}
+
+	if (block == NULL)
+	{
+		size_t		block_size = arena->block_size;
+		SimdArenaBlock *last;
+
+		if (block_size < SIMD_ARENA_HEADER + need)
+			block_size = SIMD_ARENA_HEADER + need;
+
+		block = simd_arena_map_block(block_size);
+		if (block == NULL)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+
+		/* new blocks go last, so a reset arena reuses blocks in order */
+		if (arena->first == NULL)
+			arena->first = block;
+		else
+		{
+			for (last = arena->current ? arena->current : arena->first;
+				 last->next != NULL; last = last->next)
+				;
+			last->next = block;
+		}
+		arena->mapped += block->size;
+		arena->current = block;
+		arena->used = SIMD_ARENA_HEADER;
+	}
+
+	/* the padding may overlap the next buffer, it only has to be readable */
+	p = (uint8 *) arena->current + arena->used;
+	arena->used += SIMD_ALIGN_UP(size);
+	return p;
+}
+
+/*
+ * simd_arena_bitmap / simd_arena_indexes
+ *
+ * Allocate the output of an lfind*_mask, lfind32_batch or _parallel mask
+ * scan over 'nelem' elements, LFIND_BITMAP_BYTES(nelem) bytes, or of an
+ * lfind32_index_batch of 'nkeys' keys.  The kernels write all of it, so it
+ * is not cleared.
+ */
+uint8 *
+simd_arena_bitmap(SimdArena *arena, uint64 nelem)
+{
+	return simd_arena_alloc(arena, (size_t) LFIND_BITMAP_BYTES(nelem));
+}
+
+uint32 *
+simd_arena_indexes(SimdArena *arena, uint32 nkeys)
+{
+	return simd_arena_alloc(arena, (size_t) nkeys * sizeof(uint32));
+}
+
+/*
+ * simd_arena_reset
+ *
+ * Free every buffer handed out by 'arena' at once.  The blocks stay mapped,
+ * and their pages stay resident, for the buffers of the next query.
+ */
+void
+simd_arena_reset(SimdArena *arena)
+{
+	arena->current = arena->first;
+	arena->used = SIMD_ARENA_HEADER;
+}
+
+/*
+ * simd_arena_mapped
+ *
+ * Total size of the blocks 'arena' has mapped.  A query path that only
+ * allocates from a reset arena has stopped allocating once this stays the
+ * same from one query to the next.
+ */
+size_t
+simd_arena_mapped(const SimdArena *arena)
+{
+	return arena->mapped;
+}
+
+static void
+simd_arena_destroy_thread(void *arg)
+{
+	simd_arena_destroy(arg);
+	simd_arena_local = NULL;
+}
+
+static void
+simd_arena_make_key(void)
+{
+	pthread_key_create(&simd_arena_thread_key, simd_arena_destroy_thread);
+}
+
+/*
+ * simd_arena_thread
+ *
+ * The calling thread's arena, with the default block size, created on
+ * first use and destroyed when the thread exits.  Returns NULL if it cannot
+ * be created.
+ */
+SimdArena *
+simd_arena_thread(void)
+{
+	if (simd_arena_local != NULL)
+		return simd_arena_local;
+
+	simd_arena_local = simd_arena_create(0);
+	if (simd_arena_local != NULL)
+	{
+		pthread_once(&simd_arena_key_once, simd_arena_make_key);
+		pthread_setspecific(simd_arena_thread_key, simd_arena_local);
+	}
+	return simd_arena_local;
+}
@@ -1,27 +1,84 @@
 #include <arm_neon.h>
+#include <stdint.h>
+#include <string.h>
 #define USE_NEON
+
+/*
+ * Masks built with the shrn narrowing trick (see vector8_cmp_mask) carry
+ * four bits per byte.
+ */
+#define VECTOR_MASK_BITS_PER_BYTE 4
+
+/* tbl gives us 16-entry table lookups */
+#define VECTOR8_HAS_LOOKUP
+
 typedef uint8x16_t Vector8;
+typedef uint16x8_t Vector16;
 typedef uint32x4_t Vector32;
+typedef uint64x2_t Vector64;
 
 /* load/store operations */
 static inline void vector8_load(Vector8 *v, const uint8 *s);
+static inline void vector16_load(Vector16 *v, const uint16 *s);
 static inline void vector32_load(Vector32 *v, const uint32 *s);
+static inline void vector64_load(Vector64 *v, const uint64 *s);
+static inline bool vector_load_in_page(const void *s);
+static inline void vector8_load_partial(Vector8 *v, const uint8 *s, uint32 n);
+static inline void vector16_load_partial(Vector16 *v, const uint16 *s, uint32 n);
+static inline void vector32_load_partial(Vector32 *v, const uint32 *s, uint32 n);
+static inline void vector64_load_partial(Vector64 *v, const uint64 *s, uint32 n);
+static inline void vector8_load_aligned(Vector8 *v, const uint8 *s);
+static inline void vector32_load_aligned(Vector32 *v, const uint32 *s);
+static inline void vector8_load_nt(Vector8 *v, const uint8 *s);
+static inline void vector32_load_nt(Vector32 *v, const uint32 *s);
+static inline void vector8_store(uint8 *s, const Vector8 v);
 
 /* assignment operations */
 static inline Vector8 vector8_broadcast(const uint8 c);
+static inline Vector16 vector16_broadcast(const uint16 c);
 static inline Vector32 vector32_broadcast(const uint32 c);
+static inline Vector64 vector64_broadcast(const uint64 c);
 
 /* element-wise comparisons to a scalar */
 static inline bool vector8_has(const Vector8 v, const uint8 c);
 static inline bool vector8_has_zero(const Vector8 v);
 static inline bool vector8_has_le(const Vector8 v, const uint8 c);
 static inline bool vector8_is_highbit_set(const Vector8 v);
+static inline bool vector8_is_zero(const Vector8 v);
+static inline bool vector16_is_highbit_set(const Vector16 v);
 static inline bool vector32_is_highbit_set(const Vector32 v);
+static inline bool vector64_is_highbit_set(const Vector64 v);
 
 /* arithmetic operations */
 static inline Vector8 vector8_or(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_xor(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_or(const Vector16 v1, const Vector16 v2);
 static inline Vector32 vector32_or(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_or(const Vector64 v1, const Vector64 v2);
 static inline Vector8 vector8_ssub(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_sub(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_add(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_sub(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_sub(const Vector32 v1, const Vector32 v2);
+static inline Vector32 vector32_add(const Vector32 v1, const Vector32 v2);
+static inline Vector8 vector8_and(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_andnot(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_and(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_and(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_and(const Vector64 v1, const Vector64 v2);
+static inline Vector8 vector8_shift_right(const Vector8 v, int i);
+static inline Vector8 vector8_min(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_min(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_min(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_min(const Vector64 v1, const Vector64 v2);
+static inline Vector8 vector8_max(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_max(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_max(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_max(const Vector64 v1, const Vector64 v2);
+static inline Vector64 vector64_add(const Vector64 v1, const Vector64 v2);
+static inline Vector64 vector8_sum64(const Vector8 v);
+static inline Vector64 vector16_sum64(const Vector16 v);
+static inline Vector64 vector32_sum64(const Vector32 v);
 
 /*
  * comparisons between vectors
@@ -30,7 +87,30 @@ static inline Vector8 vector8_ssub(const Vector8 v1, const Vector8 v2);
  * have non-SIMD implementations.
  */
 static inline Vector8 vector8_eq(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_eq(const Vector16 v1, const Vector16 v2);
 static inline Vector32 vector32_eq(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_eq(const Vector64 v1, const Vector64 v2);
+static inline Vector8 vector8_le(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_le(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_le(const Vector32 v1, const Vector32 v2);
+
+/* bitmasks of compare results */
+static inline uint64 vector8_cmp_mask(const Vector8 v);
+static inline uint64 vector16_cmp_mask(const Vector16 v);
+static inline uint64 vector32_cmp_mask(const Vector32 v);
+static inline uint64 vector64_cmp_mask(const Vector64 v);
+static inline uint64 vector8_eq_mask(const Vector8 v1, const Vector8 v2);
+static inline uint64 vector32_eq_mask(const Vector32 v1, const Vector32 v2);
+static inline uint64 vector8_bitmask(const Vector8 v);
+static inline uint64 vector32_bitmask(const Vector32 v);
+
+/* compaction of the lanes selected by a bitmask */
+static inline uint32 vector8_compress_store(uint8 *out, const Vector8 v, uint64 lanes);
+static inline uint32 vector32_compress_store(uint32 *out, const Vector32 v, uint64 lanes);
+
+/* 16-entry table lookups */
+static inline void vector8_load_lut(Vector8 *v, const uint8 *lut);
+static inline Vector8 vector8_lookup(const Vector8 lut, const Vector8 idx);
 
 /*
  * Load a chunk of memory into the given vector.
@@ -38,13 +118,127 @@ static inline Vector32 vector32_eq(const Vector32 v1, const Vector32 v2);
 static inline void
 vector8_load(Vector8 *v, const uint8 *s)
 {
-	*v = _mm_loadu_si128((const __m128i *) s);
+	*v = vld1q_u8(s);
+}
+
+/*
+ * Store a vector to memory, which needn't be aligned.
+ */
+static inline void
+vector8_store(uint8 *s, const Vector8 v)
+{
+	vst1q_u8(s, v);
 }
 
 static inline void
 vector32_load(Vector32 *v, const uint32 *s)
 {
-	*v = _mm_loadu_si128((const __m128i *) s);
+	*v = vld1q_u32(s);
+}
+
+static inline void
+vector16_load(Vector16 *v, const uint16 *s)
+{
+	*v = vld1q_u16(s);
+}
+
+static inline void
+vector64_load(Vector64 *v, const uint64 *s)
+{
+	*v = vld1q_u64((const uint64_t *) s);
+}
+
+/*
+ * Memory protection works on whole pages, so a full vector load is safe as
+ * long as it does not cross into the next page, even if it reads past the
+ * end of the object.  An address sanitizer would rightly report the
+ * over-read, so don't take the shortcut in sanitized builds.  Arm64 kernels
+ * may use 16kB or 64kB pages, but 4kB is a safe lower bound.
+ */
+#define VECTOR_PAGE_SIZE	4096
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define VECTOR_NO_OVERREAD
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define VECTOR_NO_OVERREAD
+#endif
+
+static inline bool
+vector_load_in_page(const void *s)
+{
+#ifdef VECTOR_NO_OVERREAD
+	(void) s;
+	return false;
+#else
+	return ((uintptr_t) s & (VECTOR_PAGE_SIZE - 1)) <=
+		VECTOR_PAGE_SIZE - sizeof(Vector8);
+#endif
+}
+
+/*
+ * Load the first 'n' elements at 's', where 'n' is less than a full vector,
+ * without faulting on memory past them.  The remaining lanes are
+ * unspecified and must be masked off by the caller.  NEON has no masked
+ * loads, so load in place if that stays within the page, or copy the
+ * elements out first.
+ */
+static inline void
+vector8_load_partial(Vector8 *v, const uint8 *s, uint32 n)
+{
+	if (vector_load_in_page(s))
+		vector8_load(v, s);
+	else
+	{
+		uint8		buf[sizeof(Vector8)] = {0};
+
+		memcpy(buf, s, n);
+		vector8_load(v, buf);
+	}
+}
+
+static inline void
+vector16_load_partial(Vector16 *v, const uint16 *s, uint32 n)
+{
+	if (vector_load_in_page(s))
+		vector16_load(v, s);
+	else
+	{
+		uint16		buf[sizeof(Vector16) / sizeof(uint16)] = {0};
+
+		memcpy(buf, s, n * sizeof(uint16));
+		vector16_load(v, buf);
+	}
+}
+
+static inline void
+vector32_load_partial(Vector32 *v, const uint32 *s, uint32 n)
+{
+	if (vector_load_in_page(s))
+		vector32_load(v, s);
+	else
+	{
+		uint32		buf[sizeof(Vector32) / sizeof(uint32)] = {0};
+
+		memcpy(buf, s, n * sizeof(uint32));
+		vector32_load(v, buf);
+	}
+}
+
+static inline void
+vector64_load_partial(Vector64 *v, const uint64 *s, uint32 n)
+{
+	if (vector_load_in_page(s))
+		vector64_load(v, s);
+	else
+	{
+		uint64		buf[sizeof(Vector64) / sizeof(uint64)] = {0};
+
+		memcpy(buf, s, n * sizeof(uint64));
+		vector64_load(v, buf);
+	}
 }
 
 /*
@@ -53,13 +247,25 @@ vector32_load(Vector32 *v, const uint32 *s)
 static inline Vector8
 vector8_broadcast(const uint8 c)
 {
-	return _mm_set1_epi8(c);
+	return vdupq_n_u8(c);
 }
 
 static inline Vector32
 vector32_broadcast(const uint32 c)
 {
-	return _mm_set1_epi32(c);
+	return vdupq_n_u32(c);
+}
+
+static inline Vector16
+vector16_broadcast(const uint16 c)
+{
+	return vdupq_n_u16(c);
+}
+
+static inline Vector64
+vector64_broadcast(const uint64 c)
+{
+	return vdupq_n_u64(c);
 }
 
 /*
@@ -109,23 +315,82 @@ vector8_has_le(const Vector8 v, const uint8 c)
 static inline bool
 vector8_is_highbit_set(const Vector8 v)
 {
-	return _mm_movemask_epi8(v) != 0;
+	return vmaxvq_u8(v) > 0x7F;
+}
+
+/*
+ * Return true if every bit of the vector is clear
+ */
+static inline bool
+vector8_is_zero(const Vector8 v)
+{
+	return vmaxvq_u8(v) == 0;
+}
+
+/*
+ * Load a vector from an address aligned to sizeof(Vector8).  NEON has no
+ * separate aligned load; the point is the address, which keeps the load
+ * within one cache line.
+ */
+static inline void
+vector8_load_aligned(Vector8 *v, const uint8 *s)
+{
+	*v = vld1q_u8((const uint8 *) __builtin_assume_aligned(s, sizeof(Vector8)));
+}
+
+static inline void
+vector32_load_aligned(Vector32 *v, const uint32 *s)
+{
+	*v = vld1q_u32((const uint32 *) __builtin_assume_aligned(s, sizeof(Vector32)));
+}
+
+/*
+ * Load a vector with a non-temporal hint, for data that won't be needed
+ * again soon.  's' must be aligned to sizeof(Vector8).  There is no
+ * intrinsic for ldnp, so load the two halves as a pair of d registers.
+ */
+static inline void
+vector8_load_nt(Vector8 *v, const uint8 *s)
+{
+	uint64x1_t	lo,
+				hi;
+
+	__asm__("ldnp %d0, %d1, [%2]"
+			: "=w" (lo), "=w" (hi)
+			: "r" (s), "m" (*(const uint8 (*)[16]) s));
+	*v = vreinterpretq_u8_u64(vcombine_u64(lo, hi));
+}
+
+static inline void
+vector32_load_nt(Vector32 *v, const uint32 *s)
+{
+	Vector8		bytes;
+
+	vector8_load_nt(&bytes, (const uint8 *) s);
+	*v = vreinterpretq_u32_u8(bytes);
 }
 
 /*
  * Exactly like vector8_is_highbit_set except for the input type, so it
- * looks at each byte separately.
- *
- * XXX x86 uses the same underlying type for 8-bit, 16-bit, and 32-bit
- * integer elements, but Arm does not, hence the need for a separate
- * function. We could instead adopt the behavior of Arm's vmaxvq_u32(), i.e.
- * check each 32-bit element, but that would require an additional mask
- * operation on x86.
+ * looks at each byte separately.  Arm uses distinct types for 8-bit and
+ * 32-bit elements, so reinterpret the register before testing it.
  */
 static inline bool
 vector32_is_highbit_set(const Vector32 v)
 {
-	return vector8_is_highbit_set(v);
+	return vector8_is_highbit_set(vreinterpretq_u8_u32(v));
+}
+
+static inline bool
+vector16_is_highbit_set(const Vector16 v)
+{
+	return vector8_is_highbit_set(vreinterpretq_u8_u16(v));
+}
+
+static inline bool
+vector64_is_highbit_set(const Vector64 v)
+{
+	return vector8_is_highbit_set(vreinterpretq_u8_u64(v));
 }
 
 /*
@@ -134,13 +399,34 @@ vector32_is_highbit_set(const Vector32 v)
 static inline Vector8
 vector8_or(const Vector8 v1, const Vector8 v2)
 {
-	return _mm_or_si128(v1, v2);
+	return vorrq_u8(v1, v2);
+}
+
+/*
+ * Return the bitwise exclusive OR of the inputs
+ */
+static inline Vector8
+vector8_xor(const Vector8 v1, const Vector8 v2)
+{
+	return veorq_u8(v1, v2);
 }
 
 static inline Vector32
 vector32_or(const Vector32 v1, const Vector32 v2)
 {
-	return _mm_or_si128(v1, v2);
+	return vorrq_u32(v1, v2);
+}
+
+static inline Vector16
+vector16_or(const Vector16 v1, const Vector16 v2)
+{
+	return vorrq_u16(v1, v2);
+}
+
+static inline Vector64
+vector64_or(const Vector64 v1, const Vector64 v2)
+{
+	return vorrq_u64(v1, v2);
 }
 
 /*
@@ -152,8 +438,182 @@ vector32_or(const Vector32 v1, const Vector32 v2)
 static inline Vector8
 vector8_ssub(const Vector8 v1, const Vector8 v2)
 {
-	return _mm_subs_epu8(v1, v2);
+	return vqsubq_u8(v1, v2);
 }
+
+/*
+ * Return the result of subtracting the respective elements of the input
+ * vectors, wrapping around on overflow.
+ */
+static inline Vector8
+vector8_sub(const Vector8 v1, const Vector8 v2)
+{
+	return vsubq_u8(v1, v2);
+}
+
+/*
+ * Return the sum of the respective elements of the input vectors, wrapping
+ * around on overflow.
+ */
+static inline Vector8
+vector8_add(const Vector8 v1, const Vector8 v2)
+{
+	return vaddq_u8(v1, v2);
+}
+
+static inline Vector16
+vector16_sub(const Vector16 v1, const Vector16 v2)
+{
+	return vsubq_u16(v1, v2);
+}
+
+static inline Vector32
+vector32_sub(const Vector32 v1, const Vector32 v2)
+{
+	return vsubq_u32(v1, v2);
+}
+
+/*
+ * Return the sum of the respective elements of the input vectors, wrapping
+ * around on overflow.
+ */
+static inline Vector32
+vector32_add(const Vector32 v1, const Vector32 v2)
+{
+	return vaddq_u32(v1, v2);
+}
+
+/*
+ * Return the bitwise AND of the inputs
+ */
+static inline Vector8
+vector8_and(const Vector8 v1, const Vector8 v2)
+{
+	return vandq_u8(v1, v2);
+}
+
+/*
+ * Return the bitwise AND of the first input and the complement of the second
+ */
+static inline Vector8
+vector8_andnot(const Vector8 v1, const Vector8 v2)
+{
+	return vbicq_u8(v1, v2);
+}
+
+static inline Vector16
+vector16_and(const Vector16 v1, const Vector16 v2)
+{
+	return vandq_u16(v1, v2);
+}
+
+static inline Vector32
+vector32_and(const Vector32 v1, const Vector32 v2)
+{
+	return vandq_u32(v1, v2);
+}
+
+static inline Vector64
+vector64_and(const Vector64 v1, const Vector64 v2)
+{
+	return vandq_u64(v1, v2);
+}
+
+/*
+ * Shift each byte right by 'i' bits, shifting in zeros.  vshrq_n_u8 needs a
+ * constant, so use a shift left by a negative amount instead.
+ */
+static inline Vector8
+vector8_shift_right(const Vector8 v, int i)
+{
+	return vshlq_u8(v, vdupq_n_s8((int8) -i));
+}
+/*
+ * Return the element-wise minimum or maximum of the inputs, treating the
+ * lanes as unsigned.  There is no 64-bit min or max, so select with a
+ * compare.
+ */
+static inline Vector8
+vector8_min(const Vector8 v1, const Vector8 v2)
+{
+	return vminq_u8(v1, v2);
+}
+
+static inline Vector8
+vector8_max(const Vector8 v1, const Vector8 v2)
+{
+	return vmaxq_u8(v1, v2);
+}
+
+static inline Vector16
+vector16_min(const Vector16 v1, const Vector16 v2)
+{
+	return vminq_u16(v1, v2);
+}
+
+static inline Vector16
+vector16_max(const Vector16 v1, const Vector16 v2)
+{
+	return vmaxq_u16(v1, v2);
+}
+
+static inline Vector32
+vector32_min(const Vector32 v1, const Vector32 v2)
+{
+	return vminq_u32(v1, v2);
+}
+
+static inline Vector32
+vector32_max(const Vector32 v1, const Vector32 v2)
+{
+	return vmaxq_u32(v1, v2);
+}
+
+static inline Vector64
+vector64_min(const Vector64 v1, const Vector64 v2)
+{
+	return vbslq_u64(vcgtq_u64(v1, v2), v2, v1);
+}
+
+static inline Vector64
+vector64_max(const Vector64 v1, const Vector64 v2)
+{
+	return vbslq_u64(vcgtq_u64(v1, v2), v1, v2);
+}
+
+/*
+ * Return the sum of the inputs, wrapping around on overflow
+ */
+static inline Vector64
+vector64_add(const Vector64 v1, const Vector64 v2)
+{
+	return vaddq_u64(v1, v2);
+}
+
+/*
+ * Return a vector of 64-bit lanes that together hold the sum of the
+ * unsigned elements of 'v', for adding into a widening accumulator.  Which
+ * elements go into which lane is unspecified.  Each pairwise add-long
+ * (uaddlp) widens the elements by one step.
+ */
+static inline Vector64
+vector8_sum64(const Vector8 v)
+{
+	return vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(v)));
+}
+
+static inline Vector64
+vector16_sum64(const Vector16 v)
+{
+	return vpaddlq_u32(vpaddlq_u16(v));
+}
+
+static inline Vector64
+vector32_sum64(const Vector32 v)
+{
+	return vpaddlq_u32(v);
+}
+
 /*
  * Return a vector with all bits set in each lane where the corresponding
  * lanes in the inputs are equal.
@@ -161,11 +621,209 @@ vector8_ssub(const Vector8 v1, const Vector8 v2)
 static inline Vector8
 vector8_eq(const Vector8 v1, const Vector8 v2)
 {
-	return _mm_cmpeq_epi8(v1, v2);
+	return vceqq_u8(v1, v2);
 }
 
 static inline Vector32
 vector32_eq(const Vector32 v1, const Vector32 v2)
 {
-	return _mm_cmpeq_epi32(v1, v2);
+	return vceqq_u32(v1, v2);
+}
+
+static inline Vector16
+vector16_eq(const Vector16 v1, const Vector16 v2)
+{
+	return vceqq_u16(v1, v2);
+}
+
+static inline Vector64
+vector64_eq(const Vector64 v1, const Vector64 v2)
+{
+	return vceqq_u64(v1, v2);
+}
+
+/*
+ * Return a vector with all bits set in each lane where v1 <= v2, treating
+ * the lanes as unsigned.  NEON has native unsigned compares.
+ */
+static inline Vector8
+vector8_le(const Vector8 v1, const Vector8 v2)
+{
+	return vcleq_u8(v1, v2);
+}
+
+static inline Vector16
+vector16_le(const Vector16 v1, const Vector16 v2)
+{
+	return vcleq_u16(v1, v2);
+}
+
+static inline Vector32
+vector32_le(const Vector32 v1, const Vector32 v2)
+{
+	return vcleq_u32(v1, v2);
+}
+
+/*
+ * Return a bitmask of the lanes set in a compare result, i.e. a vector whose
+ * bytes are each either all ones or all zeros.  Each byte contributes
+ * VECTOR_MASK_BITS_PER_BYTE bits, lowest address in the lowest bits, so
+ * the first matching byte is at __builtin_ctzll(mask) /
+ * VECTOR_MASK_BITS_PER_BYTE.
+ *
+ * NEON has no movemask; shifting each 16-bit lane right by four and
+ * narrowing to 8 bits keeps one nibble of every byte, which packs the whole
+ * 128-bit compare result into a single 64-bit scalar.  This only works for
+ * compare results, where each nibble is a copy of its byte.
+ */
+static inline uint64
+vector8_cmp_mask(const Vector8 v)
+{
+	uint8x8_t	narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+
+	return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static inline uint64
+vector32_cmp_mask(const Vector32 v)
+{
+	return vector8_cmp_mask(vreinterpretq_u8_u32(v));
+}
+
+static inline uint64
+vector16_cmp_mask(const Vector16 v)
+{
+	return vector8_cmp_mask(vreinterpretq_u8_u16(v));
+}
+
+static inline uint64
+vector64_cmp_mask(const Vector64 v)
+{
+	return vector8_cmp_mask(vreinterpretq_u8_u64(v));
+}
+
+/*
+ * Equivalent to vector8_cmp_mask(vector8_eq(v1, v2)).
+ */
+static inline uint64
+vector8_eq_mask(const Vector8 v1, const Vector8 v2)
+{
+	return vector8_cmp_mask(vector8_eq(v1, v2));
+}
+
+/*
+ * As above, for 32-bit lanes.  Each lane still covers four bytes' worth of
+ * mask bits, so callers can treat masks of all widths the same way.
+ */
+static inline uint64
+vector32_eq_mask(const Vector32 v1, const Vector32 v2)
+{
+	return vector32_cmp_mask(vector32_eq(v1, v2));
+}
+
+/*
+ * Return a compact bitmask of a compare result, one bit per lane (so bit n
+ * stands for element n of the vector).  Unlike vector8_cmp_mask(), the
+ * layout does not depend on the backend, which is what bitmap outputs need.
+ *
+ * Keep a distinct power of two in each lane and add them up across the
+ * vector; for bytes this has to be done for each half separately.
+ */
+static inline uint64
+vector8_bitmask(const Vector8 v)
+{
+	static const uint8 weights[16] = {
+		1, 2, 4, 8, 16, 32, 64, 128,
+		1, 2, 4, 8, 16, 32, 64, 128
+	};
+	uint8x16_t	bits = vandq_u8(v, vld1q_u8(weights));
+
+	return (uint64) vaddv_u8(vget_low_u8(bits)) |
+		((uint64) vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static inline uint64
+vector32_bitmask(const Vector32 v)
+{
+	static const uint32 weights[4] = {1, 2, 4, 8};
+
+	return vaddvq_u32(vandq_u32(v, vld1q_u32(weights)));
+}
+
+/*
+ * Return the TBL indexes that move the lanes selected by the low eight bits
+ * of 'lanes' to the front of a group of eight byte lanes: byte j holds the
+ * index of the j-th selected lane.  The bytes after those are junk, but
+ * still less than 8.  Each half of the group comes from a 16-entry table,
+ * the upper one shifted past the lanes the lower one selected.
+ */
+static inline uint64
+vector_compress_control8(uint64 lanes)
+{
+	static const uint32 nibble[16] = {
+		0x00000000, 0x00000000, 0x00000001, 0x00000100,
+		0x00000002, 0x00000200, 0x00000201, 0x00020100,
+		0x00000003, 0x00000300, 0x00000301, 0x00030100,
+		0x00000302, 0x00030200, 0x00030201, 0x03020100
+	};
+	uint32		lo = (uint32) lanes & 0x0F;
+	uint32		hi = ((uint32) lanes >> 4) & 0x0F;
+
+	return nibble[lo] |
+		((uint64) (nibble[hi] + 0x04040404) << (8 * __builtin_popcount(lo)));
+}
+
+/*
+ * Store the lanes of 'v' selected by 'lanes', a bitmask in the
+ * vector8_bitmask() layout, contiguously at 'out' and return their number.
+ * The rest of the sizeof(Vector8) bytes at 'out' may be overwritten with
+ * junk.  Each half of the vector is compacted with one TBL.
+ */
+static inline uint32
+vector8_compress_store(uint8 *out, const Vector8 v, uint64 lanes)
+{
+	uint64		lo = lanes & 0xFF;
+	uint64		hi = (lanes >> 8) & 0xFF;
+	uint32		n = __builtin_popcountll(lo);
+
+	vst1_u8(out, vtbl1_u8(vget_low_u8(v), vcreate_u8(vector_compress_control8(lo))));
+	vst1_u8(&out[n], vtbl1_u8(vget_high_u8(v), vcreate_u8(vector_compress_control8(hi))));
+	return n + __builtin_popcountll(hi);
+}
+
+/*
+ * The same for 32-bit lanes, with 'lanes' in the vector32_bitmask() layout.
+ * The lane indexes are spread to the four bytes of each lane for TBL.
+ */
+static inline uint32
+vector32_compress_store(uint32 *out, const Vector32 v, uint64 lanes)
+{
+	static const uint8 spread[16] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+	static const uint8 offset[16] = {0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3};
+	uint8x16_t	control;
+
+	control = vqtbl1q_u8(vcombine_u8(vcreate_u8(vector_compress_control8(lanes & 0x0F)),
+									 vdup_n_u8(0)),
+						 vld1q_u8(spread));
+	control = vaddq_u8(vshlq_n_u8(control, 2), vld1q_u8(offset));
+	vst1q_u32(out, vreinterpretq_u32_u8(vqtbl1q_u8(vreinterpretq_u8_u32(v), control)));
+	return __builtin_popcountll(lanes & 0x0F);
+}
+
+/*
+ * Load a 16-byte lookup table for vector8_lookup().
+ */
+static inline void
+vector8_load_lut(Vector8 *v, const uint8 *lut)
+{
+	*v = vld1q_u8(lut);
+}
+
+/*
+ * Return lut[idx] for each byte of 'idx', which must be in the range 0..15.
+ */
+static inline Vector8
+vector8_lookup(const Vector8 lut, const Vector8 idx)
+{
+	return vqtbl1q_u8(lut, idx);
 }
@@ -0,0 +1,383 @@
+/*
+ * simd_dispatch.c
+ *
+ * Runtime selection of the kernel variant best suited to the running CPU.
+ *
+ * Every kernel listed in simd_kernels.h is built once per instruction set
+ * (SSE2, AVX2 and AVX-512BW on x86-64, NEON on Arm, plus, if built with
+ * SIMD_SVE, SVE and SVE2 versions of the kernels in simd_kernels_sve.h),
+ * and the exported entry points call through the table chosen here.  The
+ * choice is made on the first call into the library, following the
+ * "_choose" pattern PostgreSQL uses for its CRC and popcount routines: the
+ * table initially points at stubs which detect the CPU, install the real
+ * table and forward the call.
+ *
+ * The environment variable LIBSIMD_IMPL can name a variant to use instead
+ * of the detected one, which is mostly useful for testing and benchmarking.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd_internal.h"
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+/* prototypes for every variant built on this architecture */
+#if (defined(__x86_64__) || defined(_M_AMD64))
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+	extern SIMD_HIDDEN ret name##_sse2 params; \
+	extern SIMD_HIDDEN ret name##_avx2 params; \
+	extern SIMD_HIDDEN ret name##_avx512 params;
+#elif defined(__aarch64__) && defined(SIMD_SVE)
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+	extern SIMD_HIDDEN ret name##_neon params; \
+	extern SIMD_HIDDEN ret name##_sve params; \
+	extern SIMD_HIDDEN ret name##_sve2 params;
+#elif defined(__aarch64__)
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+	extern SIMD_HIDDEN ret name##_neon params;
+#endif
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+
+#if (defined(__x86_64__) || defined(_M_AMD64))
+
+static const SimdImpl simd_impl_sse2 = {
+	"sse2",
+#define SIMD_KERNEL(ret, name, params, args, bytes) name##_sse2,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+};
+
+static const SimdImpl simd_impl_avx2 = {
+	"avx2",
+#define SIMD_KERNEL(ret, name, params, args, bytes) name##_avx2,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+};
+
+static const SimdImpl simd_impl_avx512 = {
+	"avx512",
+#define SIMD_KERNEL(ret, name, params, args, bytes) name##_avx512,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+};
+
+/*
+ * __builtin_cpu_supports() also checks that the OS saves the wider register
+ * state (XCR0), so a "true" here means the instructions are usable.
+ */
+static bool
+simd_cpu_has_sse2(void)
+{
+	return true;				/* part of the x86-64 baseline */
+}
+
+static bool
+simd_cpu_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") &&
+		__builtin_cpu_supports("bmi") &&
+		__builtin_cpu_supports("bmi2") &&
+		__builtin_cpu_supports("popcnt");
+}
+
+static bool
+simd_cpu_has_avx512(void)
+{
+	__builtin_cpu_init();
+	return simd_cpu_has_avx2() &&
+		__builtin_cpu_supports("avx512f") &&
+		__builtin_cpu_supports("avx512bw") &&
+		__builtin_cpu_supports("avx512vl");
+}
+
+#elif defined(__aarch64__)
+
+static const SimdImpl simd_impl_neon = {
+	"neon",
+#define SIMD_KERNEL(ret, name, params, args, bytes) name##_neon,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+};
+
+#ifdef SIMD_SVE
+
+/*
+ * The SVE variants start from the NEON table and replace the kernels that
+ * have an SVE version.  A later designated initializer for the same member
+ * overrides an earlier one, which is exactly what we want here.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+
+static const SimdImpl simd_impl_sve = {
+	.name = "sve",
+#define SIMD_KERNEL(ret, name, params, args, bytes) .name = name##_neon,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+#define SIMD_SVE_KERNEL(name) .name = name##_sve,
+#define SIMD_SVE2_KERNEL(name)
+#include "simd_kernels_sve.h"
+#undef SIMD_SVE_KERNEL
+#undef SIMD_SVE2_KERNEL
+};
+
+static const SimdImpl simd_impl_sve2 = {
+	.name = "sve2",
+#define SIMD_KERNEL(ret, name, params, args, bytes) .name = name##_neon,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+#define SIMD_SVE_KERNEL(name) .name = name##_sve2,
+#define SIMD_SVE2_KERNEL(name) .name = name##_sve2,
+#include "simd_kernels_sve.h"
+#undef SIMD_SVE_KERNEL
+#undef SIMD_SVE2_KERNEL
+};
+
+#pragma GCC diagnostic pop
+
+/* older headers lack the SVE bits */
+#ifndef HWCAP_SVE
+#define HWCAP_SVE			(1 << 22)
+#endif
+#ifndef HWCAP2_SVE2
+#define HWCAP2_SVE2			(1 << 1)
+#endif
+
+static bool
+simd_cpu_has_sve(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
+}
+
+static bool
+simd_cpu_has_sve2(void)
+{
+	return simd_cpu_has_sve() && (getauxval(AT_HWCAP2) & HWCAP2_SVE2) != 0;
+}
+
+#endif							/* SIMD_SVE */
+
+static bool
+simd_cpu_has_neon(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+}
+
+#endif
+
+typedef struct SimdVariant
+{
+	const SimdImpl *impl;
+	bool		(*supported) (void);
+} SimdVariant;
+
+/* all variants built for this architecture, best first */
+static const SimdVariant simd_variants[] = {
+#if (defined(__x86_64__) || defined(_M_AMD64))
+	{&simd_impl_avx512, simd_cpu_has_avx512},
+	{&simd_impl_avx2, simd_cpu_has_avx2},
+	{&simd_impl_sse2, simd_cpu_has_sse2},
+#elif defined(__aarch64__)
+#ifdef SIMD_SVE
+	{&simd_impl_sve2, simd_cpu_has_sve2},
+	{&simd_impl_sve, simd_cpu_has_sve},
+#endif
+	{&simd_impl_neon, simd_cpu_has_neon},
+#endif
+};
+
+#define SIMD_NUM_VARIANTS	(sizeof(simd_variants) / sizeof(simd_variants[0]))
+
+/* implementation in use; starts out as the table of "_choose" stubs */
+static const SimdImpl simd_impl_choose;
+static const SimdImpl *simd_impl = &simd_impl_choose;
+
+static void simd_choose_impl(void);
+
+/* stubs that resolve the implementation on first use */
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+static ret \
+name##_choose params \
+{ \
+	simd_choose_impl(); \
+	return simd_impl->name args; \
+}
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+
+static const SimdImpl simd_impl_choose = {
+	"unresolved",
+#define SIMD_KERNEL(ret, name, params, args, bytes) name##_choose,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+};
+
+/*
+ * Look up a supported variant by name.  Returns NULL if the name is unknown
+ * or the running CPU cannot execute that variant.
+ */
+static const SimdImpl *
+simd_lookup_impl(const char *name)
+{
+	size_t		i;
+
+	for (i = 0; i < SIMD_NUM_VARIANTS; i++)
+	{
+		if (strcmp(simd_variants[i].impl->name, name) == 0)
+			return simd_variants[i].supported() ? simd_variants[i].impl : NULL;
+	}
+
+	return NULL;
+}
+
+/*
+ * Pick the implementation for this process.  An explicit LIBSIMD_IMPL wins
+ * if the CPU supports it; otherwise take the best supported variant.  The
+ * last entry of simd_variants[] is always supported.
+ */
+static void
+simd_choose_impl(void)
+{
+	const char *forced = getenv("LIBSIMD_IMPL");
+	const SimdImpl *impl = NULL;
+	size_t		i;
+
+	if (forced != NULL && forced[0] != '\0')
+		impl = simd_lookup_impl(forced);
+
+	for (i = 0; impl == NULL && i < SIMD_NUM_VARIANTS; i++)
+	{
+		if (simd_variants[i].supported())
+			impl = simd_variants[i].impl;
+	}
+
+	simd_impl = impl;
+}
+
+/*
+ * simd_get_impl_name
+ *
+ * Return the name of the kernel variant in use ("sse2", "avx2", "avx512",
+ * "neon", "sve" or "sve2").  Resolves the implementation if no kernel has
+ * been called yet.
+ */
+const char *
+simd_get_impl_name(void)
+{
+	if (simd_impl == &simd_impl_choose)
+		simd_choose_impl();
+
+	return simd_impl->name;
+}
+
+/*
+ * simd_set_impl
+ *
+ * Switch to the named kernel variant, or back to automatic selection if
+ * 'name' is NULL or "auto".  Returns false, leaving the current choice in
+ * place, if the variant is unknown or not supported by this CPU.
+ *
+ * This is meant for tests and benchmarks; it must not be called while other
+ * threads may be running kernels.
+ */
+bool
+simd_set_impl(const char *name)
+{
+	const SimdImpl *impl;
+
+	if (name == NULL || strcmp(name, "auto") == 0)
+	{
+		simd_impl = &simd_impl_choose;
+		simd_choose_impl();
+		return true;
+	}
+
+	impl = simd_lookup_impl(name);
+	if (impl == NULL)
+		return false;
+
+	simd_impl = impl;
+	return true;
+}
+
+/* see lfind_set_nt_threshold(); SIZE_MAX is never reached, i.e. off */
+SIMD_HIDDEN size_t simd_nt_threshold = SIZE_MAX;
+
+/* far enough ahead to cover memory latency at full bandwidth */
+#define SIMD_DEFAULT_PREFETCH_DISTANCE	1024
+SIMD_HIDDEN uint32 simd_prefetch_distance = SIMD_DEFAULT_PREFETCH_DISTANCE;
+
+/*
+ * lfind_set_nt_threshold
+ *
+ * Make lfind8 and lfind32 scan arrays of at least 'nbytes' bytes like
+ * lfind8_nt and lfind32_nt, keeping them out of the caches.  0 turns this
+ * off again, which is the default.  Not thread-safe with respect to
+ * concurrent scans, like simd_set_impl().
+ */
+void
+lfind_set_nt_threshold(size_t nbytes)
+{
+	simd_nt_threshold = nbytes == 0 ? SIZE_MAX : nbytes;
+}
+
+/*
+ * lfind_set_prefetch_distance
+ *
+ * Set how many bytes ahead of the scan the _nt kernels prefetch, or reset
+ * the default if 'nbytes' is 0.
+ */
+void
+lfind_set_prefetch_distance(uint32 nbytes)
+{
+	simd_prefetch_distance = nbytes == 0 ? SIMD_DEFAULT_PREFETCH_DISTANCE : nbytes;
+}
+
+/*
+ * simd_byte_class_init
+ *
+ * Set up 'cls' for simd_find_byte_class() from the 256-bit membership
+ * bitmap 'set'.  The tables are the same for every variant, so a class
+ * stays valid across simd_set_impl().
+ */
+void
+simd_byte_class_init(SimdByteClass *cls, const uint8 *set)
+{
+	memcpy(cls->set, set, sizeof(cls->set));
+	byteset_build_rows(cls->set, cls->row0, cls->row1);
+}
+
+/* exported entry points */
+#ifndef SIMD_PERF_COUNTERS
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+ret \
+name params \
+{ \
+	return simd_impl->name args; \
+}
+#else
+/* the same, counting the calls while the instrumentation is on */
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+ret \
+name params \
+{ \
+	SimdPerfSample sample; \
+	ret			result; \
+\
+	if (!__atomic_load_n(&simd_perf_active, __ATOMIC_RELAXED)) \
+		return simd_impl->name args; \
+\
+	simd_perf_begin(&sample); \
+	result = simd_impl->name args; \
+	simd_perf_end(&sample, SIMD_PERF_ID_##name, (uint64) (bytes)); \
+	return result; \
+}
+#endif
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
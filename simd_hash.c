@@ -0,0 +1,396 @@
+/*
+ * simd_hash.c
+ *
+ * Open-addressing hash map from uint64 keys to uint64 values, probed a
+ * group of slots at a time in the style of SwissTable.
+ *
+ * Every slot has a control byte: SIMD_HASH_EMPTY, SIMD_HASH_DELETED (a
+ * tombstone), or for a full slot the low 7 bits of its key's hash ("H2").
+ * The slots are divided into groups of SIMD_HASH_GROUP_WIDTH, and a search
+ * loads the control bytes of a whole group into one vector: one compare
+ * against the search key's H2 finds the candidate slots, and a second one
+ * tells whether the group has an empty slot, which ends the search.  The
+ * remaining hash bits ("H1") pick the first group to probe, and further
+ * groups follow a triangular sequence, which visits every group when their
+ * number is a power of two.
+ *
+ * The group width is fixed, so the layout does not depend on the kernel
+ * variant in use.  16 control bytes are one SSE2 or NEON vector, so unlike
+ * the scanning kernels this file is compiled just once, for the
+ * architecture baseline.  Wider vectors would also work, looking at only
+ * the first 16 lanes.
+ */
+#include <stdlib.h>
+
+#include "simd_internal.h"
+
+#define SIMD_HASH_GROUP_WIDTH	16
+
+/* control byte values; full slots hold 0x00 .. 0x7F */
+#define SIMD_HASH_EMPTY			0x80
+#define SIMD_HASH_DELETED		0xFE
+
+/* largest table we'll build, to keep slot indexes well within a uint32 */
+#define SIMD_HASH_MAX_GROUPS	(UINT32_C(1) << 26)
+
+typedef struct SimdHashSlot
+{
+	uint64		key;
+	uint64		value;
+} SimdHashSlot;
+
+struct SimdHashMap
+{
+	uint8	   *ctrl;			/* one control byte per slot */
+	SimdHashSlot *slots;
+	uint32		ngroups;		/* a power of two */
+	uint32		nitems;			/* number of full slots */
+	uint32		growth_left;	/* empty slots we may still fill */
+};
+
+/*
+ * Masks of the slots of the group in 'ctrl' whose control byte is 'h2', is
+ * empty, or is either empty or deleted.  The masks are in the layout of
+ * vector8_cmp_mask(), so on NEON each slot has four bits, narrowed with
+ * shrn.  Lanes past the group, if the vector is wider than one, are ignored.
+ */
+static inline uint64
+simd_group_match(const Vector8 ctrl, uint8 h2)
+{
+	return vector8_eq_mask(ctrl, vector8_broadcast(h2)) &
+		simd_mask_prefix(SIMD_HASH_GROUP_WIDTH);
+}
+
+static inline uint64
+simd_group_match_empty(const Vector8 ctrl)
+{
+	return vector8_eq_mask(ctrl, vector8_broadcast(SIMD_HASH_EMPTY)) &
+		simd_mask_prefix(SIMD_HASH_GROUP_WIDTH);
+}
+
+static inline uint64
+simd_group_match_free(const Vector8 ctrl)
+{
+	/* empty and deleted are the control bytes with the high bit set */
+	if (!vector8_is_highbit_set(ctrl))
+		return 0;
+
+	return vector8_cmp_mask(vector8_le(vector8_broadcast(0x80), ctrl)) &
+		simd_mask_prefix(SIMD_HASH_GROUP_WIDTH);
+}
+
+/* the murmur3 finalizer: cheap, and every key bit affects H1 and H2 */
+static inline uint64
+simd_hash_mix(uint64 key)
+{
+	key ^= key >> 33;
+	key *= UINT64_C(0xff51afd7ed558ccd);
+	key ^= key >> 33;
+	key *= UINT64_C(0xc4ceb9fe1a85ec53);
+	key ^= key >> 33;
+
+	return key;
+}
+
+static inline void
+simd_hash_load_group(Vector8 *ctrl, const SimdHashMap *map, uint32 group)
+{
+	vector8_load(ctrl, &map->ctrl[group * SIMD_HASH_GROUP_WIDTH]);
+}
+
+/* number of slots with up to 7/8 of them in use */
+static inline uint32
+simd_hash_max_items(uint32 ngroups)
+{
+	return ngroups * SIMD_HASH_GROUP_WIDTH / 8 * 7;
+}
+
+/*
+ * Find a free slot for a key with hash 'hash', which must not be in the
+ * map.  Returns the slot index.
+ */
+static uint32
+simd_hash_find_free(const SimdHashMap *map, uint64 hash)
+{
+	uint32		group = (uint32) (hash >> 7) & (map->ngroups - 1);
+	uint32		step = 0;
+
+	for (;;)
+	{
+		Vector8		ctrl;
+		uint64		mask;
+
+		simd_hash_load_group(&ctrl, map, group);
+		mask = simd_group_match_free(ctrl);
+		if (mask != 0)
+			return group * SIMD_HASH_GROUP_WIDTH + simd_mask_first_byte(mask);
+
+		/* the load factor limit guarantees a free slot somewhere */
+		step++;
+		group = (group + step) & (map->ngroups - 1);
+	}
+}
+
+/*
+ * Find the slot holding 'key'.  Returns -1 if the key is not in the map.
+ */
+static int64
+simd_hash_find(const SimdHashMap *map, uint64 key)
+{
+	uint64		hash = simd_hash_mix(key);
+	uint8		h2 = (uint8) (hash & 0x7F);
+	uint32		group = (uint32) (hash >> 7) & (map->ngroups - 1);
+	uint32		step = 0;
+
+	for (;;)
+	{
+		Vector8		ctrl;
+		uint64		mask;
+
+		simd_hash_load_group(&ctrl, map, group);
+
+		mask = simd_group_match(ctrl, h2);
+		while (mask != 0)
+		{
+			uint32		lane = simd_mask_first_byte(mask);
+			uint32		slot = group * SIMD_HASH_GROUP_WIDTH + lane;
+
+			if (map->slots[slot].key == key)
+				return slot;
+			mask &= ~simd_mask_prefix(lane + 1);
+		}
+
+		/* an empty slot means the key was never pushed past this group */
+		if (simd_group_match_empty(ctrl) != 0)
+			return -1;
+
+		step++;
+		if (step == map->ngroups)
+			return -1;
+		group = (group + step) & (map->ngroups - 1);
+	}
+}
+
+/*
+ * Allocate the arrays for a table of 'ngroups' groups, all slots empty.
+ * The control bytes are padded to a whole vector past the last group.
+ */
+static bool
+simd_hash_alloc(SimdHashMap *map, uint32 ngroups)
+{
+	size_t		nslots = (size_t) ngroups * SIMD_HASH_GROUP_WIDTH;
+	size_t		nctrl = nslots + sizeof(Vector8) - SIMD_HASH_GROUP_WIDTH;
+
+	map->ctrl = malloc(nctrl);
+	map->slots = malloc(nslots * sizeof(SimdHashSlot));
+	if (map->ctrl == NULL || map->slots == NULL)
+	{
+		free(map->ctrl);
+		free(map->slots);
+		return false;
+	}
+
+	memset(map->ctrl, SIMD_HASH_EMPTY, nctrl);
+	map->ngroups = ngroups;
+	map->nitems = 0;
+	map->growth_left = simd_hash_max_items(ngroups);
+	return true;
+}
+
+/*
+ * Move everything into a new table.  The table doubles unless at least half
+ * of the used slots are tombstones, in which case rebuilding it at the same
+ * size is enough to make room.  Returns false, leaving the map unchanged,
+ * if out of memory.
+ */
+static bool
+simd_hash_grow(SimdHashMap *map)
+{
+	SimdHashMap old = *map;
+	uint32		ngroups = map->ngroups;
+	uint32		slot;
+
+	if (map->nitems >= simd_hash_max_items(ngroups) / 2)
+	{
+		if (ngroups >= SIMD_HASH_MAX_GROUPS)
+			return false;
+		ngroups *= 2;
+	}
+
+	if (!simd_hash_alloc(map, ngroups))
+	{
+		*map = old;
+		return false;
+	}
+
+	for (slot = 0; slot < old.ngroups * SIMD_HASH_GROUP_WIDTH; slot++)
+	{
+		uint64		hash;
+		uint32		dst;
+
+		if (old.ctrl[slot] & 0x80)
+			continue;
+
+		hash = simd_hash_mix(old.slots[slot].key);
+		dst = simd_hash_find_free(map, hash);
+		map->ctrl[dst] = (uint8) (hash & 0x7F);
+		map->slots[dst] = old.slots[slot];
+		map->nitems++;
+		map->growth_left--;
+	}
+
+	free(old.ctrl);
+	free(old.slots);
+	return true;
+}
+
+/*
+ * simd_hash_create
+ *
+ * Create an empty map with room for 'capacity' entries before it needs to
+ * grow.  Returns NULL if out of memory.
+ */
+SimdHashMap *
+simd_hash_create(uint32 capacity)
+{
+	SimdHashMap *map;
+	uint32		ngroups = 1;
+
+	while (simd_hash_max_items(ngroups) < capacity &&
+		   ngroups < SIMD_HASH_MAX_GROUPS)
+		ngroups *= 2;
+
+	map = malloc(sizeof(SimdHashMap));
+	if (map == NULL)
+		return NULL;
+
+	if (!simd_hash_alloc(map, ngroups))
+	{
+		free(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+/*
+ * simd_hash_destroy
+ *
+ * Free a map made by simd_hash_create().
+ */
+void
+simd_hash_destroy(SimdHashMap *map)
+{
+	if (map == NULL)
+		return;
+
+	free(map->ctrl);
+	free(map->slots);
+	free(map);
+}
+
+/*
+ * simd_hash_insert
+ *
+ * Map 'key' to 'value', replacing any value it had.  Returns false if the
+ * map had to grow and could not.
+ */
+bool
+simd_hash_insert(SimdHashMap *map, uint64 key, uint64 value)
+{
+	int64		found = simd_hash_find(map, key);
+	uint64		hash;
+	uint32		slot;
+
+	if (found >= 0)
+	{
+		map->slots[found].value = value;
+		return true;
+	}
+
+	hash = simd_hash_mix(key);
+	slot = simd_hash_find_free(map, hash);
+
+	/* reusing a tombstone never brings the next resize closer */
+	if (map->ctrl[slot] == SIMD_HASH_EMPTY)
+	{
+		if (map->growth_left == 0)
+		{
+			if (!simd_hash_grow(map))
+				return false;
+			slot = simd_hash_find_free(map, hash);
+		}
+		if (map->ctrl[slot] == SIMD_HASH_EMPTY)
+			map->growth_left--;
+	}
+
+	map->ctrl[slot] = (uint8) (hash & 0x7F);
+	map->slots[slot].key = key;
+	map->slots[slot].value = value;
+	map->nitems++;
+	return true;
+}
+
+/*
+ * simd_hash_lookup
+ *
+ * Look up 'key'.  If it is present, store its value at '*value' (if 'value'
+ * is not NULL) and return true.
+ */
+bool
+simd_hash_lookup(const SimdHashMap *map, uint64 key, uint64 *value)
+{
+	int64		found = simd_hash_find(map, key);
+
+	if (found < 0)
+		return false;
+
+	if (value != NULL)
+		*value = map->slots[found].value;
+	return true;
+}
+
+/*
+ * simd_hash_delete
+ *
+ * Remove 'key' from the map.  Returns false if it was not present.
+ */
+bool
+simd_hash_delete(SimdHashMap *map, uint64 key)
+{
+	int64		found = simd_hash_find(map, key);
+	uint32		group;
+	Vector8		ctrl;
+
+	if (found < 0)
+		return false;
+
+	/*
+	 * Searches stop at the first group with an empty slot.  If this group
+	 * already has one, no search can have passed through it, so the slot
+	 * can become empty again; otherwise it has to be a tombstone.
+	 */
+	group = (uint32) found / SIMD_HASH_GROUP_WIDTH;
+	simd_hash_load_group(&ctrl, map, group);
+	if (simd_group_match_empty(ctrl) != 0)
+	{
+		map->ctrl[found] = SIMD_HASH_EMPTY;
+		map->growth_left++;
+	}
+	else
+		map->ctrl[found] = SIMD_HASH_DELETED;
+
+	map->nitems--;
+	return true;
+}
+
+/*
+ * simd_hash_count
+ *
+ * Return the number of entries in the map.
+ */
+uint32
+simd_hash_count(const SimdHashMap *map)
+{
+	return map->nitems;
+}
@@ -0,0 +1,392 @@
+/*
+ * simd_index.c
+ *
+ * Shared search indexes: a key array, and optionally a search tree over
+ * it, that many threads probe while another rebuilds it from time to time.
+ *
+ * Every version of the keys is an immutable snapshot.  The index holds a
+ * pointer to the current one; readers pick it up with an atomic load and
+ * probe it without any lock, and writers build a new snapshot aside and
+ * publish it with an atomic exchange.  A replaced snapshot is freed once no
+ * reader can still be using it, which is tracked with epochs:
+ *
+ * - the index has a global epoch, advanced by every publish;
+ * - each reader has a slot of its own, one cache line, in which it records
+ *   the global epoch when it begins a read and 0 when it ends it;
+ * - a publish stamps the snapshot it replaces with the epoch before its
+ *   increment, and that snapshot is freed as soon as no slot holds an
+ *   epoch at or below the stamp.
+ *
+ * A reader that sees the old snapshot loaded the pointer before the
+ * exchange, so it had stored its epoch before the exchange too, and had
+ * read the epoch before the increment; its slot holds at most the stamp,
+ * and keeps the snapshot alive until the read ends.  A reader whose slot
+ * holds a later epoch read it after the increment, hence after the
+ * exchange, and can only have the new snapshot.  The loads and stores
+ * involved are all sequentially consistent, for that reasoning to hold.
+ *
+ * Beginning a read is then a load, a store and a load, and ending it a
+ * store, with no retries and no writes to cache lines that other readers
+ * write: readers are wait-free, and a rebuild never stalls them.
+ * Writers are serialized by a mutex among themselves.  Reclamation is only
+ * done by writers, when they publish or call simd_index_reclaim(); a
+ * reader that stays in a read for a long time only delays it.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd_internal.h"
+
+/* default number of reader slots, see simd_index_create() */
+#define SIMD_INDEX_DEFAULT_READERS	64
+
+/*
+ * A reader's slot.  'epoch' is written by the reader only, and read by
+ * writers; the alignment keeps readers from sharing a cache line.
+ */
+struct SimdIndexReader
+{
+	uint64		epoch;			/* global epoch at read begin, 0 between reads */
+	bool		in_use;
+	SimdIndex  *index;
+} __attribute__((aligned(SIMD_ALIGNMENT)));
+
+/* a snapshot and its reclamation state, 'snapshot' first */
+typedef struct SimdIndexVersion
+{
+	SimdIndexSnapshot snapshot;
+	uint64		retired_epoch;
+	struct SimdIndexVersion *next_retired;
+} SimdIndexVersion;
+
+struct SimdIndex
+{
+	SimdIndexVersion *current;
+	uint64		epoch;
+	uint64		version;		/* of the last snapshot published */
+	SimdIndexVersion *retired;	/* replaced snapshots, newest first */
+	uint32		nretired;
+	uint32		max_readers;
+	SimdIndexReader *readers;
+	pthread_mutex_t writer_lock;
+};
+
+/*
+ * Build a snapshot of 'nelem' keys.  Returns NULL with errno set if out of
+ * memory.
+ */
+static SimdIndexVersion *
+simd_index_build(const uint32 *keys, uint32 nelem, uint32 flags)
+{
+	SimdIndexVersion *v = calloc(1, sizeof(SimdIndexVersion));
+	uint32	   *copy;
+
+	if (v == NULL)
+		return NULL;
+
+	copy = simd_alloc_aligned((size_t) nelem * sizeof(uint32));
+	if (copy == NULL)
+	{
+		free(v);
+		return NULL;
+	}
+	if (nelem > 0)
+		memcpy(copy, keys, (size_t) nelem * sizeof(uint32));
+
+	if (flags & SIMD_INDEX_TREE)
+	{
+		v->snapshot.tree = stree32_build(keys, nelem);
+		if (v->snapshot.tree == NULL)
+		{
+			simd_free_aligned(copy);
+			free(v);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	v->snapshot.keys = copy;
+	v->snapshot.nelem = nelem;
+	v->snapshot.flags = flags;
+	v->snapshot.alignment = SIMD_ALIGNMENT;
+	v->snapshot.padding = LFIND_PADDING;
+	return v;
+}
+
+static void
+simd_index_free_version(SimdIndexVersion *v)
+{
+	stree32_free((Stree32 *) v->snapshot.tree);
+	simd_free_aligned((uint32 *) v->snapshot.keys);
+	free(v);
+}
+
+/*
+ * Free the retired snapshots no reader can still be using.  The caller
+ * holds the writer lock.
+ */
+static uint32
+simd_index_reclaim_locked(SimdIndex *index)
+{
+	SimdIndexVersion **prev;
+	SimdIndexVersion *v;
+	uint64		oldest = UINT64_MAX;
+	uint32		i;
+
+	if (index->retired == NULL)
+		return 0;
+
+	for (i = 0; i < index->max_readers; i++)
+	{
+		uint64		epoch = __atomic_load_n(&index->readers[i].epoch, __ATOMIC_SEQ_CST);
+
+		if (epoch != 0 && epoch < oldest)
+			oldest = epoch;
+	}
+
+	for (prev = &index->retired; (v = *prev) != NULL;)
+	{
+		if (v->retired_epoch < oldest)
+		{
+			*prev = v->next_retired;
+			simd_index_free_version(v);
+			index->nretired--;
+		}
+		else
+			prev = &v->next_retired;
+	}
+
+	return index->nretired;
+}
+
+/*
+ * simd_index_create
+ *
+ * Create an index holding an empty snapshot, which up to 'max_readers'
+ * threads can read at a time, 0 for a default of 64.  Returns NULL if out
+ * of memory.
+ */
+SimdIndex *
+simd_index_create(uint32 max_readers)
+{
+	SimdIndex  *index = calloc(1, sizeof(SimdIndex));
+
+	if (index == NULL)
+		return NULL;
+
+	index->max_readers = max_readers ? max_readers : SIMD_INDEX_DEFAULT_READERS;
+	index->readers = simd_alloc_aligned((size_t) index->max_readers * sizeof(SimdIndexReader));
+	index->current = simd_index_build(NULL, 0, 0);
+	if (index->readers == NULL || index->current == NULL ||
+		pthread_mutex_init(&index->writer_lock, NULL) != 0)
+	{
+		if (index->current != NULL)
+			simd_index_free_version(index->current);
+		simd_free_aligned(index->readers);
+		free(index);
+		return NULL;
+	}
+	memset(index->readers, 0, (size_t) index->max_readers * sizeof(SimdIndexReader));
+
+	/* epoch 0 marks a slot that is not reading */
+	index->epoch = 1;
+	return index;
+}
+
+/*
+ * simd_index_destroy
+ *
+ * Free the index and all of its snapshots.  No thread may be reading it,
+ * and its reader handles become invalid.  NULL is ignored.
+ */
+void
+simd_index_destroy(SimdIndex *index)
+{
+	SimdIndexVersion *v;
+
+	if (index == NULL)
+		return;
+
+	for (v = index->retired; v != NULL;)
+	{
+		SimdIndexVersion *next = v->next_retired;
+
+		simd_index_free_version(v);
+		v = next;
+	}
+	simd_index_free_version(index->current);
+	pthread_mutex_destroy(&index->writer_lock);
+	simd_free_aligned(index->readers);
+	free(index);
+}
+
+/*
+ * simd_index_publish
+ *
+ * Make a snapshot of the 'nelem' keys at 'keys' the current one, and free
+ * the replaced snapshots that are no longer being read.  The keys are
+ * copied.  'flags' may have SIMD_INDEX_SORTED if the keys are in ascending
+ * order, and SIMD_INDEX_TREE, which implies it, to also build a search
+ * tree.  Returns false with errno set if out of memory, leaving the
+ * current snapshot in place.
+ *
+ * The snapshot is built before the writer lock is taken, so concurrent
+ * writers only wait for each other's exchange and reclamation, and readers
+ * never wait at all.
+ */
+bool
+simd_index_publish(SimdIndex *index, const uint32 *keys, uint32 nelem, uint32 flags)
+{
+	SimdIndexVersion *v;
+	SimdIndexVersion *old;
+
+	if (flags & SIMD_INDEX_TREE)
+		flags |= SIMD_INDEX_SORTED;
+
+	v = simd_index_build(keys, nelem, flags);
+	if (v == NULL)
+		return false;
+
+	pthread_mutex_lock(&index->writer_lock);
+
+	v->snapshot.version = ++index->version;
+	old = __atomic_exchange_n(&index->current, v, __ATOMIC_SEQ_CST);
+	old->retired_epoch = __atomic_fetch_add(&index->epoch, 1, __ATOMIC_SEQ_CST);
+	old->next_retired = index->retired;
+	index->retired = old;
+	index->nretired++;
+	(void) simd_index_reclaim_locked(index);
+
+	pthread_mutex_unlock(&index->writer_lock);
+	return true;
+}
+
+/*
+ * simd_index_reclaim
+ *
+ * Free the replaced snapshots that are no longer being read, and return
+ * how many are left, still held by readers.
+ */
+uint32
+simd_index_reclaim(SimdIndex *index)
+{
+	uint32		left;
+
+	pthread_mutex_lock(&index->writer_lock);
+	left = simd_index_reclaim_locked(index);
+	pthread_mutex_unlock(&index->writer_lock);
+	return left;
+}
+
+/*
+ * simd_index_reader_register
+ *
+ * Take one of the index's reader slots, for the calling thread to read
+ * with.  Keep it across reads: registering is not wait-free, reading is.
+ * Returns NULL if all 'max_readers' slots are taken.
+ */
+SimdIndexReader *
+simd_index_reader_register(SimdIndex *index)
+{
+	uint32		i;
+
+	for (i = 0; i < index->max_readers; i++)
+	{
+		SimdIndexReader *reader = &index->readers[i];
+		bool		expected = false;
+
+		if (__atomic_compare_exchange_n(&reader->in_use, &expected, true, false,
+										__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			reader->index = index;
+			return reader;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * simd_index_reader_unregister
+ *
+ * Give back a reader slot; the reader must not be in a read.  NULL is
+ * ignored.
+ */
+void
+simd_index_reader_unregister(SimdIndexReader *reader)
+{
+	if (reader == NULL)
+		return;
+
+	__atomic_store_n(&reader->in_use, false, __ATOMIC_RELEASE);
+}
+
+/*
+ * simd_index_read_begin
+ *
+ * Return the current snapshot, which stays valid, and unchanged, until
+ * simd_index_read_end() on the same reader.  Reads don't nest.
+ */
+const SimdIndexSnapshot *
+simd_index_read_begin(SimdIndexReader *reader)
+{
+	SimdIndex  *index = reader->index;
+
+	__atomic_store_n(&reader->epoch, __atomic_load_n(&index->epoch, __ATOMIC_SEQ_CST),
+					 __ATOMIC_SEQ_CST);
+	return &__atomic_load_n(&index->current, __ATOMIC_SEQ_CST)->snapshot;
+}
+
+/*
+ * simd_index_read_end
+ *
+ * End the read, after which the snapshot it returned may be freed.
+ */
+void
+simd_index_read_end(SimdIndexReader *reader)
+{
+	__atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * simd_snapshot_contains
+ *
+ * Return true if 'key' is one of the snapshot's keys: with the tree or a
+ * binary search if it has them, otherwise with a scan that may use the
+ * padding after the keys.
+ */
+bool
+simd_snapshot_contains(const SimdIndexSnapshot *snapshot, uint32 key)
+{
+	uint32	   *keys = (uint32 *) snapshot->keys;
+	uint32		i;
+
+	if (snapshot->tree != NULL)
+		i = stree32_lower_bound(snapshot->tree, key);
+	else if (snapshot->flags & SIMD_INDEX_SORTED)
+		i = lower_bound32(key, keys, snapshot->nelem);
+	else
+		return lfind32_padded(key, keys, snapshot->nelem);
+
+	return i < snapshot->nelem && keys[i] == key;
+}
+
+/*
+ * simd_snapshot_lower_bound
+ *
+ * Return the index of the first key >= 'key' of a sorted snapshot, or its
+ * number of keys if there is none, like lower_bound32().  Returns
+ * LFIND_NOT_FOUND if the snapshot is not sorted.
+ */
+uint32
+simd_snapshot_lower_bound(const SimdIndexSnapshot *snapshot, uint32 key)
+{
+	if (snapshot->tree != NULL)
+		return stree32_lower_bound(snapshot->tree, key);
+	if (snapshot->flags & SIMD_INDEX_SORTED)
+		return lower_bound32(key, (uint32 *) snapshot->keys, snapshot->nelem);
+	return LFIND_NOT_FOUND;
+}
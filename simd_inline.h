@@ -0,0 +1,293 @@
+/*
+ * simd_inline.h
+ *
+ * Header-only versions of the basic scans, for call sites where the call
+ * into libsimd.so costs more than the scan itself, such as probing a hash
+ * bucket of a few dozen elements.
+ *
+ * Everything here is static inline and built for the instruction set the
+ * including translation unit is compiled for (-mavx2, -mavx512bw, ...),
+ * since there is no runtime dispatch; without such flags x86-64 gets SSE2.
+ * Nothing needs the library, so including this header alone is enough.
+ *
+ * lfindN_inline, lfindN_index_inline and lfindN_count_inline take any
+ * 'nelem', like the exported kernels, but scan one vector per step, which
+ * suits short arrays; long ones are faster through the library.
+ *
+ * lfindN_n and lfindN_index_n are meant for a compile-time constant 'n'.
+ * They are always inlined, so the compiler sees the constant: the loop over
+ * whole vectors unrolls completely, and the elements past the last whole
+ * vector are covered by one overlapping load instead of a remainder loop.
+ * LFIND_N() picks the width from the element type of 'base'.
+ *
+ * The same file provides the lane mask and tail-load helpers the library's
+ * kernels are built on.
+ */
+#ifndef SIMD_INLINE_H
+#define SIMD_INLINE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "simd.h"
+
+#define SIMD_ALWAYS_INLINE	inline __attribute__((always_inline))
+
+/*
+ * Byte offset of the first lane set in a mask from vector8_cmp_mask() or
+ * one of its siblings.  The mask must not be zero.
+ */
+static inline uint32
+simd_mask_first_byte(uint64 mask)
+{
+	return (uint32) __builtin_ctzll(mask) / VECTOR_MASK_BITS_PER_BYTE;
+}
+
+/*
+ * Byte offset of the last lane set in a mask from vector8_cmp_mask() or one
+ * of its siblings.  The mask must not be zero.
+ */
+static inline uint32
+simd_mask_last_byte(uint64 mask)
+{
+	return (uint32) (63 - __builtin_clzll(mask)) / VECTOR_MASK_BITS_PER_BYTE;
+}
+
+/* number of lanes set in a mask from vector8_cmp_mask() or its siblings */
+static inline uint32
+simd_mask_count_bytes(uint64 mask)
+{
+	return (uint32) __builtin_popcountll(mask) / VECTOR_MASK_BITS_PER_BYTE;
+}
+
+/*
+ * Store the low 'nbits' bits of a lane bitmask at 'dst', lowest lane in the
+ * lowest bit of the first byte.  'nbits' is rounded up to whole bytes, and
+ * bits above it must be zero.  Both supported architectures are
+ * little-endian, so this is a plain byte copy of the mask.
+ */
+static inline void
+simd_store_bitmask(uint8 *dst, uint64 bits, uint32 nbits)
+{
+	memcpy(dst, &bits, (nbits + 7) / 8);
+}
+
+/*
+ * Mask of the lanes holding the first 'nbytes' bytes of a vector, in the
+ * layout of vector8_cmp_mask() and its siblings.
+ */
+static inline uint64
+simd_mask_prefix(uint32 nbytes)
+{
+	uint32		nbits = nbytes * VECTOR_MASK_BITS_PER_BYTE;
+
+	return nbits >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << nbits) - 1;
+}
+
+/*
+ * Load the last, partial vector of an array: the fewer than a vector's worth
+ * of elements from base[i] to base[nelem - 1].  Returns the mask (in the
+ * vector*_cmp_mask() layout) of the lanes holding those elements and sets
+ * '*start' to the index of the element in lane 0.
+ *
+ * Arrays of at least one vector reload the vector ending at the last
+ * element, overlapping elements already searched, which the mask leaves
+ * out.  Shorter arrays use a partial load.  Either way the kernels need no
+ * scalar remainder loop.
+ */
+#define SIMD_DEFINE_LOAD_TAIL(bits) \
+static inline uint64 \
+simd_load_tail##bits(Vector##bits *v, const uint##bits *base, uint32 i, \
+					 uint32 nelem, uint32 *start) \
+{ \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+\
+	if (nelem >= nelem_per_vector) \
+	{ \
+		*start = nelem - nelem_per_vector; \
+		vector##bits##_load(v, &base[*start]); \
+		return ~simd_mask_prefix((i - *start) * sizeof(uint##bits)); \
+	} \
+\
+	*start = i; \
+	vector##bits##_load_partial(v, &base[i], nelem - i); \
+	return simd_mask_prefix((nelem - i) * sizeof(uint##bits)); \
+}
+
+SIMD_DEFINE_LOAD_TAIL(8)
+SIMD_DEFINE_LOAD_TAIL(16)
+SIMD_DEFINE_LOAD_TAIL(32)
+SIMD_DEFINE_LOAD_TAIL(64)
+
+/*
+ * Define the inline scans for one element width.
+ */
+#define SIMD_DEFINE_INLINE_SCANS(bits) \
+static inline bool \
+lfind##bits##_inline(uint##bits key, const uint##bits *base, uint32 nelem) \
+{ \
+	const Vector##bits keys = vector##bits##_broadcast(key); \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	Vector##bits vals; \
+	uint64		valid; \
+	uint32		start; \
+	uint32		i; \
+\
+	for (i = 0; nelem - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		vector##bits##_load(&vals, &base[i]); \
+		if (vector##bits##_is_highbit_set(vector##bits##_eq(keys, vals))) \
+			return true; \
+	} \
+	if (i == nelem) \
+		return false; \
+\
+	valid = simd_load_tail##bits(&vals, base, i, nelem, &start); \
+	return (vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)) & valid) != 0; \
+} \
+\
+static inline uint32 \
+lfind##bits##_index_inline(uint##bits key, const uint##bits *base, uint32 nelem) \
+{ \
+	const Vector##bits keys = vector##bits##_broadcast(key); \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	Vector##bits vals; \
+	uint64		mask; \
+	uint32		start; \
+	uint32		i; \
+\
+	for (i = 0; nelem - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		vector##bits##_load(&vals, &base[i]); \
+		mask = vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+		if (mask != 0) \
+			return i + simd_mask_first_byte(mask) / sizeof(uint##bits); \
+	} \
+	if (i == nelem) \
+		return LFIND_NOT_FOUND; \
+\
+	mask = simd_load_tail##bits(&vals, base, i, nelem, &start); \
+	mask &= vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+	if (mask == 0) \
+		return LFIND_NOT_FOUND; \
+	return start + simd_mask_first_byte(mask) / sizeof(uint##bits); \
+} \
+\
+static inline uint32 \
+lfind##bits##_count_inline(uint##bits key, const uint##bits *base, uint32 nelem) \
+{ \
+	const Vector##bits keys = vector##bits##_broadcast(key); \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	Vector##bits vals; \
+	uint64		mask; \
+	uint32		count = 0; \
+	uint32		start; \
+	uint32		i; \
+\
+	for (i = 0; nelem - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		vector##bits##_load(&vals, &base[i]); \
+		mask = vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+		count += simd_mask_count_bytes(mask) / sizeof(uint##bits); \
+	} \
+	if (i < nelem) \
+	{ \
+		mask = simd_load_tail##bits(&vals, base, i, nelem, &start); \
+		mask &= vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+		count += simd_mask_count_bytes(mask) / sizeof(uint##bits); \
+	} \
+	return count; \
+} \
+\
+static SIMD_ALWAYS_INLINE bool \
+lfind##bits##_n(uint##bits key, const uint##bits *base, const uint32 n) \
+{ \
+	const Vector##bits keys = vector##bits##_broadcast(key); \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	Vector##bits vals; \
+	Vector##bits found; \
+	uint32		i; \
+\
+	if (n < nelem_per_vector) \
+	{ \
+		if (n == 0) \
+			return false; \
+		vector##bits##_load_partial(&vals, base, n); \
+		return (vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)) & \
+				simd_mask_prefix(n * sizeof(uint##bits))) != 0; \
+	} \
+\
+	/* merge all compares and test once; overlapping lanes don't matter */ \
+	vector##bits##_load(&vals, base); \
+	found = vector##bits##_eq(keys, vals); \
+	_Pragma("GCC unroll 64") \
+	for (i = nelem_per_vector; n - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		vector##bits##_load(&vals, &base[i]); \
+		found = vector##bits##_or(found, vector##bits##_eq(keys, vals)); \
+	} \
+	if (i < n) \
+	{ \
+		vector##bits##_load(&vals, &base[n - nelem_per_vector]); \
+		found = vector##bits##_or(found, vector##bits##_eq(keys, vals)); \
+	} \
+	return vector##bits##_is_highbit_set(found); \
+} \
+\
+static SIMD_ALWAYS_INLINE uint32 \
+lfind##bits##_index_n(uint##bits key, const uint##bits *base, const uint32 n) \
+{ \
+	const Vector##bits keys = vector##bits##_broadcast(key); \
+	const uint32 nelem_per_vector = sizeof(Vector##bits) / sizeof(uint##bits); \
+	Vector##bits vals; \
+	uint64		mask; \
+	uint32		i; \
+\
+	if (n < nelem_per_vector) \
+	{ \
+		if (n == 0) \
+			return LFIND_NOT_FOUND; \
+		vector##bits##_load_partial(&vals, base, n); \
+		mask = vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)) & \
+			simd_mask_prefix(n * sizeof(uint##bits)); \
+		return mask != 0 ? simd_mask_first_byte(mask) / sizeof(uint##bits) : \
+			LFIND_NOT_FOUND; \
+	} \
+\
+	_Pragma("GCC unroll 64") \
+	for (i = 0; n - i >= nelem_per_vector; i += nelem_per_vector) \
+	{ \
+		vector##bits##_load(&vals, &base[i]); \
+		mask = vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)); \
+		if (mask != 0) \
+			return i + simd_mask_first_byte(mask) / sizeof(uint##bits); \
+	} \
+	if (i < n) \
+	{ \
+		/* the last whole vector, less the lanes already searched */ \
+		vector##bits##_load(&vals, &base[n - nelem_per_vector]); \
+		mask = vector##bits##_cmp_mask(vector##bits##_eq(keys, vals)) & \
+			~simd_mask_prefix((i - (n - nelem_per_vector)) * sizeof(uint##bits)); \
+		if (mask != 0) \
+			return n - nelem_per_vector + simd_mask_first_byte(mask) / sizeof(uint##bits); \
+	} \
+	return LFIND_NOT_FOUND; \
+}
+
+SIMD_DEFINE_INLINE_SCANS(8)
+SIMD_DEFINE_INLINE_SCANS(16)
+SIMD_DEFINE_INLINE_SCANS(32)
+SIMD_DEFINE_INLINE_SCANS(64)
+
+/*
+ * lfind8_n .. lfind64_n chosen by the element size of 'base', which must
+ * point to 1, 2, 4 or 8 byte unsigned integers.  The choice is made at
+ * compile time.
+ */
+#define LFIND_N(key, base, n) \
+	(sizeof(*(base)) == 1 ? lfind8_n((uint8) (key), (const uint8 *) (base), (n)) : \
+	 sizeof(*(base)) == 2 ? lfind16_n((uint16) (key), (const uint16 *) (base), (n)) : \
+	 sizeof(*(base)) == 4 ? lfind32_n((uint32) (key), (const uint32 *) (base), (n)) : \
+	 lfind64_n((uint64) (key), (const uint64 *) (base), (n)))
+
+#endif							/* SIMD_INLINE_H */
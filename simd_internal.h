@@ -0,0 +1,194 @@
+/*
+ * simd_internal.h
+ *
+ * Declarations shared by the kernel translation units and the runtime
+ * dispatcher.  Not part of the installed API.
+ *
+ * Kernel sources (see KERNEL_SOURCES in the Makefile) are compiled once for
+ * each instruction-set variant with -DSIMD_VARIANT=<name> and the matching
+ * -m flags, so the vector backend headers pick that variant's vector width.
+ * SIMD_FN() appends the variant name to each kernel, e.g. lfind8 compiled
+ * for AVX2 becomes lfind8_avx2.
+ */
+#ifndef SIMD_INTERNAL_H
+#define SIMD_INTERNAL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "simd.h"
+#include "simd_inline.h"
+
+/* per-variant kernels are reached only through the dispatch table */
+#define SIMD_HIDDEN			__attribute__((visibility("hidden")))
+
+#define SIMD_CONCAT_(a, b)	a##_##b
+#define SIMD_CONCAT(a, b)	SIMD_CONCAT_(a, b)
+
+#ifdef SIMD_VARIANT
+#define SIMD_FN(name)		SIMD_CONCAT(name, SIMD_VARIANT)
+
+/* prototypes for the variant being compiled */
+#define SIMD_KERNEL(ret, name, params, args, bytes) \
+	extern SIMD_HIDDEN ret SIMD_FN(name) params;
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+#endif							/* SIMD_VARIANT */
+
+/*
+ * Nibble tables describing an arbitrary set of byte values, for the
+ * lfind8_any and simd_find_byte_class kernels.
+ *
+ * Think of the set as a 16x16 bit matrix indexed by the low and high nibble
+ * of a byte.  row0[lo] holds the bits for high nibbles 0..7 and row1[lo]
+ * those for 8..15; bit0[hi] and bit1[hi] select the bit for the high nibble
+ * from one of the rows and are zero for the other.  This is the "truffle"
+ * technique and is exact for any set.
+ *
+ * 'set' is a membership bitmap of 256 bits, byte c in bit (c & 7) of
+ * set[c >> 3].  The rows don't depend on the vector width, so they can be
+ * built once, as SimdByteClass does, and loaded by any variant.
+ */
+static inline void
+byteset_build_rows(const uint8 *set, uint8 *row0, uint8 *row1)
+{
+	uint32		c;
+
+	memset(row0, 0, 16);
+	memset(row1, 0, 16);
+	for (c = 0; c < 256; c++)
+	{
+		if (set[c >> 3] & (1 << (c & 7)))
+		{
+			if ((c >> 4) < 8)
+				row0[c & 0x0F] |= 1 << (c >> 4);
+			else
+				row1[c & 0x0F] |= 1 << ((c >> 4) - 8);
+		}
+	}
+}
+
+#ifdef VECTOR8_HAS_LOOKUP
+
+typedef struct ByteSetLuts
+{
+	Vector8		row0;
+	Vector8		row1;
+	Vector8		bit0;
+	Vector8		bit1;
+} ByteSetLuts;
+
+static inline void
+byteset_load_luts(ByteSetLuts *luts, const uint8 *row0, const uint8 *row1)
+{
+	static const uint8 bit0[16] = {1, 2, 4, 8, 16, 32, 64, 128};
+	static const uint8 bit1[16] = {0, 0, 0, 0, 0, 0, 0, 0,
+	1, 2, 4, 8, 16, 32, 64, 128};
+
+	vector8_load_lut(&luts->row0, row0);
+	vector8_load_lut(&luts->row1, row1);
+	vector8_load_lut(&luts->bit0, bit0);
+	vector8_load_lut(&luts->bit1, bit1);
+}
+
+/*
+ * Return a compare result with all bits set in each byte of 'chunk' that is
+ * a member of the set.  Exactly one of bit0[hi]/bit1[hi] is nonzero, so the
+ * selected row bit is either zero or equal to the bit we looked for.
+ */
+static inline Vector8
+byteset_match(const Vector8 chunk, const ByteSetLuts *luts)
+{
+	const Vector8 nibble = vector8_broadcast(0x0F);
+	Vector8		lo = vector8_and(chunk, nibble);
+	Vector8		hi = vector8_shift_right(chunk, 4);
+	Vector8		b0 = vector8_lookup(luts->bit0, hi);
+	Vector8		b1 = vector8_lookup(luts->bit1, hi);
+	Vector8		hit;
+
+	hit = vector8_or(vector8_and(vector8_lookup(luts->row0, lo), b0),
+					 vector8_and(vector8_lookup(luts->row1, lo), b1));
+
+	return vector8_eq(hit, vector8_or(b0, b1));
+}
+
+#endif							/* VECTOR8_HAS_LOOKUP */
+
+/*
+ * Tuning of the cache-bypassing _nt scans, set through
+ * lfind_set_nt_threshold() and lfind_set_prefetch_distance().  lfind8 and
+ * lfind32 hand arrays of at least simd_nt_threshold bytes to their _nt
+ * versions.
+ */
+extern SIMD_HIDDEN size_t simd_nt_threshold;
+extern SIMD_HIDDEN uint32 simd_prefetch_distance;
+
+/*
+ * Static search tree over a sorted uint32 array, built by stree32_build()
+ * and searched by the stree32_* kernels in lsearch.c.
+ *
+ * This is a B+ tree stored without pointers ("S+ tree").  Every node holds
+ * STREE32_NODE_KEYS keys in one 64-byte cache line, and node k of a layer
+ * has children k * (STREE32_NODE_KEYS + 1) + i, for i = 0 .. NODE_KEYS, in
+ * the layer below.  Key i of an internal node is the smallest key in child
+ * i + 1, so the number of node keys less than the search key is the child
+ * to descend to.  The bottom layer (layer 0) is the sorted array itself,
+ * padded with UINT32_MAX to whole nodes, so the position reached there is
+ * the answer's index in the original array.
+ */
+#define STREE32_NODE_KEYS	16
+#define STREE32_FANOUT		(STREE32_NODE_KEYS + 1)
+
+/* 17^8 nodes of 16 keys is more than any uint32 count of elements needs */
+#define STREE32_MAX_HEIGHT	8
+
+struct Stree32
+{
+	uint32	   *nodes;			/* all layers, 64-byte aligned */
+	uint32		nelem;			/* number of keys in the sorted array */
+	uint32		height;			/* number of layers, counting the leaves */
+	uint32		offsets[STREE32_MAX_HEIGHT];	/* first node of each layer */
+};
+
+/*
+ * One implementation of every kernel, all built for the same instruction
+ * set.  The dispatcher holds a pointer to the table chosen for this CPU.
+ */
+typedef struct SimdImpl
+{
+	const char *name;
+#define SIMD_KERNEL(ret, name, params, args, bytes) ret (*name) params;
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+} SimdImpl;
+
+/*
+ * Instrumentation of the exported entry points, built with
+ * -DSIMD_PERF_COUNTERS; see simd_perf.c.  Each kernel has a number for
+ * indexing the aggregated counters.  While simd_perf_active is set, the
+ * wrappers in simd_dispatch.c bracket every call with simd_perf_begin()
+ * and simd_perf_end().
+ */
+enum
+{
+#define SIMD_KERNEL(ret, name, params, args, bytes) SIMD_PERF_ID_##name,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+	SIMD_PERF_NUM_KERNELS
+};
+
+/* hardware counters read around a call; cycles first */
+#define SIMD_PERF_NUM_EVENTS	5
+
+typedef struct SimdPerfSample
+{
+	bool		counted;		/* were the counters read? */
+	uint64		values[SIMD_PERF_NUM_EVENTS];
+} SimdPerfSample;
+
+extern SIMD_HIDDEN bool simd_perf_active;
+extern SIMD_HIDDEN void simd_perf_begin(SimdPerfSample *sample);
+extern SIMD_HIDDEN void simd_perf_end(SimdPerfSample *sample, uint32 kernel,
+									  uint64 bytes);
+
+#endif							/* SIMD_INTERNAL_H */
@@ -0,0 +1,86 @@
+/*
+ * simd_kernels.h
+ *
+ * List of the kernels that are compiled once per instruction-set variant
+ * and selected at runtime by simd_dispatch.c.
+ *
+ * Note: this file has no include guard; it is included several times with
+ * different definitions of SIMD_KERNEL.  Each entry is
+ *
+ *		SIMD_KERNEL(return type, name, (parameter list), (argument list), bytes)
+ *
+ * and every kernel must return a value, so the generated wrappers can
+ * simply "return" the result of the selected implementation.  'bytes' is an
+ * expression over the parameters giving the size of the data a call
+ * searches, which the SIMD_PERF_COUNTERS instrumentation accumulates (see
+ * simd_perf.c); 0 where that isn't known up front.
+ */
+
+SIMD_KERNEL(bool, lfind8, (uint8 key, uint8 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind8_le, (uint8 key, uint8 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind32, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind16, (uint16 key, uint16 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind64, (uint64 key, uint64 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind8_index, (uint8 key, uint8 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind32_index, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind8_count, (uint8 key, uint8 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind32_count, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind8_mask, (uint8 key, uint8 *base, uint32 nelem, uint8 *bitmap), (key, base, nelem, bitmap), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind32_mask, (uint32 key, uint32 *base, uint32 nelem, uint8 *bitmap), (key, base, nelem, bitmap), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind8_any, (const uint8 *keys, uint32 nkeys, uint8 *base, uint32 nelem), (keys, nkeys, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind32_any, (const uint32 *keys, uint32 nkeys, uint32 *base, uint32 nelem), (keys, nkeys, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind8_range, (uint8 lo, uint8 span, uint8 *base, uint32 nelem), (lo, span, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind16_range, (uint16 lo, uint16 span, uint16 *base, uint32 nelem), (lo, span, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind32_range, (uint32 lo, uint32 span, uint32 *base, uint32 nelem), (lo, span, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind32_batch, (const uint32 *keys, uint32 nkeys, uint32 *base, uint32 nelem, uint8 *bitmap), (keys, nkeys, base, nelem, bitmap), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind32_index_batch, (const uint32 *keys, uint32 nkeys, uint32 *base, uint32 nelem, uint32 *indexes), (keys, nkeys, base, nelem, indexes), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind8_padded, (uint8 key, uint8 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind32_padded, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind8_nt, (uint8 key, uint8 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, lfind32_nt, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(void *, simd_memchr, (const void *s, int c, size_t n), (s, c, n), n)
+SIMD_KERNEL(void *, simd_memrchr, (const void *s, int c, size_t n), (s, c, n), n)
+SIMD_KERNEL(void *, simd_memchr2, (const void *s, int c1, int c2, size_t n), (s, c1, c2, n), n)
+SIMD_KERNEL(void *, simd_memchr3, (const void *s, int c1, int c2, int c3, size_t n), (s, c1, c2, c3, n), n)
+SIMD_KERNEL(size_t, simd_strlen, (const char *s), (s), 0)
+SIMD_KERNEL(uint32, lfind_substr, (const uint8 *needle, uint32 nlen, const uint8 *haystack, uint32 hlen), (needle, nlen, haystack, hlen), hlen)
+SIMD_KERNEL(uint32, lower_bound32, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lsearch32_sorted, (uint32 key, uint32 *base, uint32 nelem), (key, base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, stree32_lower_bound, (const Stree32 *tree, uint32 key), (tree, key), (uint64) tree->nelem * sizeof(uint32))
+SIMD_KERNEL(uint32, stree32_lower_bound_batch, (const Stree32 *tree, const uint32 *keys, uint32 nkeys, uint32 *results), (tree, keys, nkeys, results), (uint64) tree->nelem * sizeof(uint32))
+SIMD_KERNEL(uint8, vmin8, (uint8 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint8, vmax8, (uint8 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint64, vsum8, (uint8 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmin8, (uint8 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmax8, (uint8 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint16, vmin16, (uint16 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint16, vmax16, (uint16 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint64, vsum16, (uint16 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmin16, (uint16 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmax16, (uint16 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, vmin32, (uint32 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, vmax32, (uint32 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint64, vsum32, (uint32 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmin32, (uint32 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmax32, (uint32 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint64, vmin64, (uint64 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint64, vmax64, (uint64 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint64, vsum64, (uint64 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmin64, (uint64 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, argmax64, (uint64 *base, uint32 nelem), (base, nelem), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, lfind32_stats, (uint32 key, uint32 *base, uint32 nelem, Lfind32Stats *stats), (key, base, nelem, stats), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(bool, simd_is_ascii, (const void *buf, size_t n), (buf, n), n)
+SIMD_KERNEL(bool, simd_utf8_validate, (const void *buf, size_t n), (buf, n), n)
+SIMD_KERNEL(size_t, simd_find_byte_class, (const SimdByteClass *cls, const void *buf, size_t n), (cls, buf, n), n)
+SIMD_KERNEL(uint32, select8, (uint8 key, uint8 *base, uint32 nelem, uint32 *indexes), (key, base, nelem, indexes), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, select32, (uint32 key, uint32 *base, uint32 nelem, uint32 *indexes), (key, base, nelem, indexes), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, select8_le, (uint8 key, uint8 *base, uint32 nelem, uint8 *out), (key, base, nelem, out), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, select32_le, (uint32 key, uint32 *base, uint32 nelem, uint32 *out), (key, base, nelem, out), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, select8_le_index, (uint8 key, uint8 *base, uint32 nelem, uint32 *indexes), (key, base, nelem, indexes), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint32, select32_le_index, (uint32 key, uint32 *base, uint32 nelem, uint32 *indexes), (key, base, nelem, indexes), (uint64) nelem * sizeof(*base))
+SIMD_KERNEL(uint8 *, simd_bitmap_and, (uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes), (out, a, b, nbytes), 2 * (uint64) nbytes)
+SIMD_KERNEL(uint8 *, simd_bitmap_or, (uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes), (out, a, b, nbytes), 2 * (uint64) nbytes)
+SIMD_KERNEL(uint8 *, simd_bitmap_xor, (uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes), (out, a, b, nbytes), 2 * (uint64) nbytes)
+SIMD_KERNEL(uint8 *, simd_bitmap_andnot, (uint8 *out, const uint8 *a, const uint8 *b, size_t nbytes), (out, a, b, nbytes), 2 * (uint64) nbytes)
+SIMD_KERNEL(uint64, simd_bitmap_count, (const uint8 *bitmap, size_t nbytes), (bitmap, nbytes), nbytes)
+SIMD_KERNEL(bool, simd_bitmap_any, (const uint8 *bitmap, size_t nbytes), (bitmap, nbytes), nbytes)
@@ -0,0 +1,24 @@
+/*
+ * simd_kernels_sve.h
+ *
+ * The kernels that have vector-length-agnostic SVE versions in lfind_vla.c.
+ * The "sve" and "sve2" variants use these and take every other kernel from
+ * the NEON build, see simd_dispatch.c.  SIMD_SVE2_KERNEL entries exist only
+ * in the SVE2 build.
+ *
+ * There is deliberately no include guard: like simd_kernels.h, this header
+ * is expanded several times with different definitions of the macros.
+ */
+SIMD_SVE_KERNEL(lfind8)
+SIMD_SVE_KERNEL(lfind8_le)
+SIMD_SVE_KERNEL(lfind16)
+SIMD_SVE_KERNEL(lfind32)
+SIMD_SVE_KERNEL(lfind64)
+SIMD_SVE_KERNEL(lfind8_index)
+SIMD_SVE_KERNEL(lfind32_index)
+SIMD_SVE_KERNEL(lfind8_count)
+SIMD_SVE_KERNEL(lfind32_count)
+SIMD_SVE_KERNEL(select32)
+SIMD_SVE_KERNEL(select32_le)
+SIMD_SVE_KERNEL(select32_le_index)
+SIMD_SVE2_KERNEL(lfind8_any)
@@ -0,0 +1,437 @@
+/*
+ * simd_perf.c
+ *
+ * Optional hardware performance counter instrumentation of the exported
+ * kernels, for telling whether a kernel that got slower is bound by the
+ * front end, by memory or by branch mispredictions.
+ *
+ * With the library built with -DSIMD_PERF_COUNTERS (make PERF_COUNTERS=1),
+ * every exported entry point can record, per call site and kernel, the
+ * number of calls and bytes searched, and the cycles, instructions, L1D
+ * read misses, last level cache misses and branch misses spent in the call.
+ * The counters come from perf_event_open(): each thread opens one counter
+ * group for itself, on its first instrumented call, counting user space
+ * only, and a call reads the group before and after the kernel runs.  A
+ * group read is a system call, about a microsecond, so the hardware
+ * counters can be read on every Nth call only; calls and bytes are always
+ * counted.  Counters the CPU or the kernel doesn't offer (virtual machines
+ * often have none) read as 0.
+ *
+ * Totals are kept with relaxed atomic adds, per call site, which threads
+ * set with simd_perf_set_site().  Without SIMD_PERF_COUNTERS the entry
+ * points have no instrumentation at all and this file only provides stubs,
+ * so callers need not know how the library was built.
+ */
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <stdio.h>
+
+#include "simd_internal.h"
+
+#ifdef SIMD_PERF_COUNTERS
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* call sites that can be told apart; site 0 is the unnamed default */
+#define SIMD_PERF_MAX_SITES		32
+
+typedef struct SimdPerfTotals
+{
+	uint64		calls;
+	uint64		bytes;
+	uint64		sampled;
+	uint64		values[SIMD_PERF_NUM_EVENTS];
+} SimdPerfTotals;
+
+/* per-thread counter group */
+typedef struct SimdPerfThread
+{
+	bool		opened;			/* have we tried to open the group? */
+	int			fds[SIMD_PERF_NUM_EVENTS];
+	uint32		nevents;		/* number of events opened */
+	uint32		event[SIMD_PERF_NUM_EVENTS];	/* which event each one is */
+	uint32		site;
+	uint32		countdown;		/* calls until the next sampled one */
+} SimdPerfThread;
+
+/* the events, in the order of the SIMD_PERF_* bits in simd.h */
+static const struct
+{
+	uint32		type;
+	uint64		config;
+}			simd_perf_events[SIMD_PERF_NUM_EVENTS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static const char *const simd_perf_kernel_names[SIMD_PERF_NUM_KERNELS] = {
+#define SIMD_KERNEL(ret, name, params, args, bytes) #name,
+#include "simd_kernels.h"
+#undef SIMD_KERNEL
+};
+
+SIMD_HIDDEN bool simd_perf_active = false;
+static uint32 simd_perf_sample_every = 1;
+
+static SimdPerfTotals simd_perf_totals[SIMD_PERF_MAX_SITES][SIMD_PERF_NUM_KERNELS];
+
+/* names of the call sites; only ever appended to, under the lock */
+static const char *simd_perf_sites[SIMD_PERF_MAX_SITES] = {""};
+static uint32 simd_perf_nsites = 1;
+static pthread_mutex_t simd_perf_sites_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread SimdPerfThread simd_perf_thread;
+
+/* closes a thread's counters when it exits */
+static pthread_key_t simd_perf_thread_key;
+static pthread_once_t simd_perf_key_once = PTHREAD_ONCE_INIT;
+
+static void
+simd_perf_close_thread(void *arg)
+{
+	SimdPerfThread *thread = arg;
+	uint32		i;
+
+	for (i = 0; i < thread->nevents; i++)
+		close(thread->fds[i]);
+	thread->nevents = 0;
+}
+
+static void
+simd_perf_make_key(void)
+{
+	pthread_key_create(&simd_perf_thread_key, simd_perf_close_thread);
+}
+
+/*
+ * Open the calling thread's counter group, once.  The first event that can
+ * be opened leads the group; the others are read along with it.
+ */
+static SimdPerfThread *
+simd_perf_open_thread(void)
+{
+	SimdPerfThread *thread = &simd_perf_thread;
+	uint32		e;
+
+	if (thread->opened)
+		return thread;
+	thread->opened = true;
+
+	for (e = 0; e < SIMD_PERF_NUM_EVENTS; e++)
+	{
+		struct perf_event_attr attr;
+		int			fd;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = simd_perf_events[e].type;
+		attr.config = simd_perf_events[e].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+
+		fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1,
+						   thread->nevents > 0 ? thread->fds[0] : -1, 0);
+		if (fd < 0)
+			continue;
+
+		thread->fds[thread->nevents] = fd;
+		thread->event[thread->nevents] = e;
+		thread->nevents++;
+	}
+
+	if (thread->nevents > 0)
+	{
+		pthread_once(&simd_perf_key_once, simd_perf_make_key);
+		pthread_setspecific(simd_perf_thread_key, thread);
+	}
+	return thread;
+}
+
+/* read the thread's group into values[], indexed by event */
+static bool
+simd_perf_read_group(SimdPerfThread *thread, uint64 *values)
+{
+	uint64		buf[1 + SIMD_PERF_NUM_EVENTS];
+	uint32		i;
+
+	if (read(thread->fds[0], buf, sizeof(buf)) < (ssize_t) sizeof(uint64) ||
+		buf[0] != thread->nevents)
+		return false;
+
+	for (i = 0; i < thread->nevents; i++)
+		values[thread->event[i]] = buf[1 + i];
+	return true;
+}
+
+/*
+ * Start timing a call: read the counters if this call is sampled.
+ */
+SIMD_HIDDEN void
+simd_perf_begin(SimdPerfSample *sample)
+{
+	SimdPerfThread *thread = simd_perf_open_thread();
+
+	sample->counted = false;
+	if (thread->nevents == 0)
+		return;
+
+	if (thread->countdown > 0)
+	{
+		thread->countdown--;
+		return;
+	}
+	thread->countdown = simd_perf_sample_every - 1;
+
+	memset(sample->values, 0, sizeof(sample->values));
+	sample->counted = simd_perf_read_group(thread, sample->values);
+}
+
+/*
+ * Finish a call of kernel number 'kernel' that searched 'bytes' bytes, and
+ * add it to the totals of the thread's call site.
+ */
+SIMD_HIDDEN void
+simd_perf_end(SimdPerfSample *sample, uint32 kernel, uint64 bytes)
+{
+	SimdPerfThread *thread = &simd_perf_thread;
+	SimdPerfTotals *totals = &simd_perf_totals[thread->site][kernel];
+	uint64		after[SIMD_PERF_NUM_EVENTS] = {0};
+	uint32		e;
+
+	__atomic_fetch_add(&totals->calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&totals->bytes, bytes, __ATOMIC_RELAXED);
+
+	if (!sample->counted || !simd_perf_read_group(thread, after))
+		return;
+
+	__atomic_fetch_add(&totals->sampled, 1, __ATOMIC_RELAXED);
+	for (e = 0; e < SIMD_PERF_NUM_EVENTS; e++)
+		__atomic_fetch_add(&totals->values[e], after[e] - sample->values[e],
+						   __ATOMIC_RELAXED);
+}
+
+/*
+ * simd_perf_enable
+ *
+ * Start instrumenting calls, reading the hardware counters on every
+ * 'sample_every'th call of each thread (0 means 1).  Returns the SIMD_PERF_*
+ * bits of the counters the calling thread could open, 0 if there are none
+ * (calls and bytes are still counted), or -1 if the library was built
+ * without SIMD_PERF_COUNTERS.
+ */
+int
+simd_perf_enable(uint32 sample_every)
+{
+	SimdPerfThread *thread = simd_perf_open_thread();
+	int			mask = 0;
+	uint32		i;
+
+	for (i = 0; i < thread->nevents; i++)
+		mask |= 1 << thread->event[i];
+
+	simd_perf_sample_every = sample_every == 0 ? 1 : sample_every;
+	__atomic_store_n(&simd_perf_active, true, __ATOMIC_RELAXED);
+	return mask;
+}
+
+/*
+ * simd_perf_disable
+ *
+ * Stop instrumenting calls.  The totals are kept.
+ */
+void
+simd_perf_disable(void)
+{
+	__atomic_store_n(&simd_perf_active, false, __ATOMIC_RELAXED);
+}
+
+/*
+ * simd_perf_reset
+ *
+ * Zero the totals.  Calls running concurrently may be partly counted.
+ */
+void
+simd_perf_reset(void)
+{
+	memset(simd_perf_totals, 0, sizeof(simd_perf_totals));
+}
+
+/*
+ * simd_perf_set_site
+ *
+ * Attribute the calling thread's following calls to the call site 'site',
+ * which must stay valid (normally a string constant), or to the unnamed
+ * default site if 'site' is NULL.  Returns false if there are already
+ * SIMD_PERF_MAX_SITES sites, in which case the default site is used.
+ */
+bool
+simd_perf_set_site(const char *site)
+{
+	uint32		i;
+
+	simd_perf_thread.site = 0;
+	if (site == NULL || site[0] == '\0')
+		return true;
+
+	pthread_mutex_lock(&simd_perf_sites_lock);
+	for (i = 1; i < simd_perf_nsites; i++)
+	{
+		if (strcmp(simd_perf_sites[i], site) == 0)
+			break;
+	}
+	if (i == simd_perf_nsites && i < SIMD_PERF_MAX_SITES)
+	{
+		simd_perf_sites[i] = site;
+		__atomic_store_n(&simd_perf_nsites, i + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&simd_perf_sites_lock);
+
+	if (i == SIMD_PERF_MAX_SITES)
+		return false;
+
+	simd_perf_thread.site = i;
+	return true;
+}
+
+/* copy the totals of one site and kernel, returning false if never called */
+static bool
+simd_perf_copy(uint32 site, uint32 kernel, SimdPerfCounters *c)
+{
+	SimdPerfTotals *totals = &simd_perf_totals[site][kernel];
+
+	c->calls = __atomic_load_n(&totals->calls, __ATOMIC_RELAXED);
+	if (c->calls == 0)
+		return false;
+
+	c->site = simd_perf_sites[site];
+	c->kernel = simd_perf_kernel_names[kernel];
+	c->bytes = __atomic_load_n(&totals->bytes, __ATOMIC_RELAXED);
+	c->sampled = __atomic_load_n(&totals->sampled, __ATOMIC_RELAXED);
+	c->cycles = __atomic_load_n(&totals->values[0], __ATOMIC_RELAXED);
+	c->instructions = __atomic_load_n(&totals->values[1], __ATOMIC_RELAXED);
+	c->l1d_misses = __atomic_load_n(&totals->values[2], __ATOMIC_RELAXED);
+	c->llc_misses = __atomic_load_n(&totals->values[3], __ATOMIC_RELAXED);
+	c->branch_misses = __atomic_load_n(&totals->values[4], __ATOMIC_RELAXED);
+	return true;
+}
+
+/*
+ * simd_perf_read
+ *
+ * Copy the totals of every (site, kernel) pair that has been called into
+ * 'counters', up to 'max' of them.  Returns the number of pairs, which may
+ * be more than 'max'.
+ */
+uint32
+simd_perf_read(SimdPerfCounters *counters, uint32 max)
+{
+	uint32		nsites = __atomic_load_n(&simd_perf_nsites, __ATOMIC_ACQUIRE);
+	uint32		n = 0;
+	uint32		site;
+	uint32		k;
+
+	for (site = 0; site < nsites; site++)
+	{
+		for (k = 0; k < SIMD_PERF_NUM_KERNELS; k++)
+		{
+			SimdPerfCounters c;
+
+			if (!simd_perf_copy(site, k, &c))
+				continue;
+			if (n < max)
+				counters[n] = c;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/*
+ * simd_perf_dump
+ *
+ * Write a table of the totals to 'fd': per site and kernel the calls, bytes
+ * per call, and cycles, IPC and misses per sampled call.
+ */
+void
+simd_perf_dump(int fd)
+{
+	uint32		nsites = __atomic_load_n(&simd_perf_nsites, __ATOMIC_ACQUIRE);
+	uint32		site;
+	uint32		k;
+
+	dprintf(fd, "%-16s %-26s %12s %12s %10s %6s %10s %10s %10s\n",
+			"site", "kernel", "calls", "bytes/call", "cycles", "IPC",
+			"L1D miss", "LLC miss", "br miss");
+	for (site = 0; site < nsites; site++)
+	{
+		for (k = 0; k < SIMD_PERF_NUM_KERNELS; k++)
+		{
+			SimdPerfCounters c;
+			double		sampled;
+
+			if (!simd_perf_copy(site, k, &c))
+				continue;
+
+			sampled = c.sampled > 0 ? (double) c.sampled : 1.0;
+			dprintf(fd, "%-16s %-26s %12llu %12.0f %10.0f %6.2f %10.1f %10.1f %10.1f\n",
+					c.site[0] != '\0' ? c.site : "-", c.kernel, c.calls,
+					(double) c.bytes / c.calls, c.cycles / sampled,
+					c.cycles > 0 ? (double) c.instructions / c.cycles : 0.0,
+					c.l1d_misses / sampled, c.llc_misses / sampled,
+					c.branch_misses / sampled);
+		}
+	}
+}
+
+#else							/* !SIMD_PERF_COUNTERS */
+
+int
+simd_perf_enable(uint32 sample_every)
+{
+	(void) sample_every;
+	return -1;
+}
+
+void
+simd_perf_disable(void)
+{
+}
+
+void
+simd_perf_reset(void)
+{
+}
+
+bool
+simd_perf_set_site(const char *site)
+{
+	(void) site;
+	return false;
+}
+
+uint32
+simd_perf_read(SimdPerfCounters *counters, uint32 max)
+{
+	(void) counters;
+	(void) max;
+	return 0;
+}
+
+void
+simd_perf_dump(int fd)
+{
+	dprintf(fd, "libsimd was built without SIMD_PERF_COUNTERS\n");
+}
+
+#endif							/* SIMD_PERF_COUNTERS */
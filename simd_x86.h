@@ -1,27 +1,100 @@
-#include <emmintrin.h>
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
 
+/*
+ * The vector width follows the instruction set the translation unit is
+ * compiled for: AVX-512BW gives 64-byte vectors, AVX2 32-byte vectors, and
+ * plain SSE2 (always present on x86-64) 16-byte vectors.  Callers only ever
+ * see sizeof(Vector8), so the kernels in lfind.c scale automatically.
+ */
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define USE_AVX512
+#define VECTOR_MASK_BITS_PER_BYTE 1
+#define VECTOR8_HAS_LOOKUP
+typedef __m512i Vector8;
+typedef __m512i Vector16;
+typedef __m512i Vector32;
+typedef __m512i Vector64;
+#elif defined(__AVX2__)
+#define USE_AVX2
+#define VECTOR_MASK_BITS_PER_BYTE 1
+#define VECTOR8_HAS_LOOKUP
+typedef __m256i Vector8;
+typedef __m256i Vector16;
+typedef __m256i Vector32;
+typedef __m256i Vector64;
+#else
+#define USE_SSE2
+#define VECTOR_MASK_BITS_PER_BYTE 1
 typedef __m128i Vector8;
+typedef __m128i Vector16;
 typedef __m128i Vector32;
+typedef __m128i Vector64;
+#endif
 
 /* load/store operations */
 static inline void vector8_load(Vector8 *v, const uint8 *s);
+static inline void vector16_load(Vector16 *v, const uint16 *s);
 static inline void vector32_load(Vector32 *v, const uint32 *s);
+static inline void vector64_load(Vector64 *v, const uint64 *s);
+static inline bool vector_load_in_page(const void *s);
+static inline void vector8_load_partial(Vector8 *v, const uint8 *s, uint32 n);
+static inline void vector16_load_partial(Vector16 *v, const uint16 *s, uint32 n);
+static inline void vector32_load_partial(Vector32 *v, const uint32 *s, uint32 n);
+static inline void vector64_load_partial(Vector64 *v, const uint64 *s, uint32 n);
+static inline void vector8_load_aligned(Vector8 *v, const uint8 *s);
+static inline void vector32_load_aligned(Vector32 *v, const uint32 *s);
+static inline void vector8_load_nt(Vector8 *v, const uint8 *s);
+static inline void vector32_load_nt(Vector32 *v, const uint32 *s);
+static inline void vector8_store(uint8 *s, const Vector8 v);
 
 /* assignment operations */
 static inline Vector8 vector8_broadcast(const uint8 c);
+static inline Vector16 vector16_broadcast(const uint16 c);
 static inline Vector32 vector32_broadcast(const uint32 c);
+static inline Vector64 vector64_broadcast(const uint64 c);
 
 /* element-wise comparisons to a scalar */
 static inline bool vector8_has(const Vector8 v, const uint8 c);
 static inline bool vector8_has_zero(const Vector8 v);
 static inline bool vector8_has_le(const Vector8 v, const uint8 c);
 static inline bool vector8_is_highbit_set(const Vector8 v);
+static inline bool vector8_is_zero(const Vector8 v);
+static inline bool vector16_is_highbit_set(const Vector16 v);
 static inline bool vector32_is_highbit_set(const Vector32 v);
+static inline bool vector64_is_highbit_set(const Vector64 v);
 
 /* arithmetic operations */
 static inline Vector8 vector8_or(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_xor(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_or(const Vector16 v1, const Vector16 v2);
 static inline Vector32 vector32_or(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_or(const Vector64 v1, const Vector64 v2);
 static inline Vector8 vector8_ssub(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_sub(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_add(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_sub(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_sub(const Vector32 v1, const Vector32 v2);
+static inline Vector32 vector32_add(const Vector32 v1, const Vector32 v2);
+static inline Vector8 vector8_and(const Vector8 v1, const Vector8 v2);
+static inline Vector8 vector8_andnot(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_and(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_and(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_and(const Vector64 v1, const Vector64 v2);
+static inline Vector8 vector8_shift_right(const Vector8 v, int i);
+static inline Vector8 vector8_min(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_min(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_min(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_min(const Vector64 v1, const Vector64 v2);
+static inline Vector8 vector8_max(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_max(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_max(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_max(const Vector64 v1, const Vector64 v2);
+static inline Vector64 vector64_add(const Vector64 v1, const Vector64 v2);
+static inline Vector64 vector8_sum64(const Vector8 v);
+static inline Vector64 vector16_sum64(const Vector16 v);
+static inline Vector64 vector32_sum64(const Vector32 v);
 
 /*
  * comparisons between vectors
@@ -30,7 +103,32 @@ static inline Vector8 vector8_ssub(const Vector8 v1, const Vector8 v2);
  * have non-SIMD implementations.
  */
 static inline Vector8 vector8_eq(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_eq(const Vector16 v1, const Vector16 v2);
 static inline Vector32 vector32_eq(const Vector32 v1, const Vector32 v2);
+static inline Vector64 vector64_eq(const Vector64 v1, const Vector64 v2);
+static inline Vector8 vector8_le(const Vector8 v1, const Vector8 v2);
+static inline Vector16 vector16_le(const Vector16 v1, const Vector16 v2);
+static inline Vector32 vector32_le(const Vector32 v1, const Vector32 v2);
+
+/* bitmasks of compare results */
+static inline uint64 vector8_cmp_mask(const Vector8 v);
+static inline uint64 vector16_cmp_mask(const Vector16 v);
+static inline uint64 vector32_cmp_mask(const Vector32 v);
+static inline uint64 vector64_cmp_mask(const Vector64 v);
+static inline uint64 vector8_eq_mask(const Vector8 v1, const Vector8 v2);
+static inline uint64 vector32_eq_mask(const Vector32 v1, const Vector32 v2);
+static inline uint64 vector8_bitmask(const Vector8 v);
+static inline uint64 vector32_bitmask(const Vector32 v);
+
+/* compaction of the lanes selected by a bitmask */
+static inline uint32 vector8_compress_store(uint8 *out, const Vector8 v, uint64 lanes);
+static inline uint32 vector32_compress_store(uint32 *out, const Vector32 v, uint64 lanes);
+
+#ifdef VECTOR8_HAS_LOOKUP
+/* 16-entry table lookups */
+static inline void vector8_load_lut(Vector8 *v, const uint8 *lut);
+static inline Vector8 vector8_lookup(const Vector8 lut, const Vector8 idx);
+#endif
 
 /*
  * Load a chunk of memory into the given vector.
@@ -38,13 +136,222 @@ static inline Vector32 vector32_eq(const Vector32 v1, const Vector32 v2);
 static inline void
 vector8_load(Vector8 *v, const uint8 *s)
 {
+#if defined(USE_AVX512)
+	*v = _mm512_loadu_si512((const void *) s);
+#elif defined(USE_AVX2)
+	*v = _mm256_loadu_si256((const __m256i *) s);
+#else
 	*v = _mm_loadu_si128((const __m128i *) s);
+#endif
+}
+
+/*
+ * Store a vector to memory, which needn't be aligned.
+ */
+static inline void
+vector8_store(uint8 *s, const Vector8 v)
+{
+#if defined(USE_AVX512)
+	_mm512_storeu_si512((void *) s, v);
+#elif defined(USE_AVX2)
+	_mm256_storeu_si256((__m256i *) s, v);
+#else
+	_mm_storeu_si128((__m128i *) s, v);
+#endif
 }
 
 static inline void
 vector32_load(Vector32 *v, const uint32 *s)
 {
+#if defined(USE_AVX512)
+	*v = _mm512_loadu_si512((const void *) s);
+#elif defined(USE_AVX2)
+	*v = _mm256_loadu_si256((const __m256i *) s);
+#else
+	*v = _mm_loadu_si128((const __m128i *) s);
+#endif
+}
+
+static inline void
+vector16_load(Vector16 *v, const uint16 *s)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_loadu_si512((const void *) s);
+#elif defined(USE_AVX2)
+	*v = _mm256_loadu_si256((const __m256i *) s);
+#else
 	*v = _mm_loadu_si128((const __m128i *) s);
+#endif
+}
+
+static inline void
+vector64_load(Vector64 *v, const uint64 *s)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_loadu_si512((const void *) s);
+#elif defined(USE_AVX2)
+	*v = _mm256_loadu_si256((const __m256i *) s);
+#else
+	*v = _mm_loadu_si128((const __m128i *) s);
+#endif
+}
+
+/*
+ * Load a vector from an address aligned to sizeof(Vector8).  An aligned
+ * load never straddles two cache lines, which the unaligned loads above do
+ * for every other vector of a misaligned AVX-512 scan.
+ */
+static inline void
+vector8_load_aligned(Vector8 *v, const uint8 *s)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_load_si512((const void *) s);
+#elif defined(USE_AVX2)
+	*v = _mm256_load_si256((const __m256i *) s);
+#else
+	*v = _mm_load_si128((const __m128i *) s);
+#endif
+}
+
+static inline void
+vector32_load_aligned(Vector32 *v, const uint32 *s)
+{
+	vector8_load_aligned(v, (const uint8 *) s);
+}
+
+/*
+ * Load a vector with a non-temporal hint, for data that won't be needed
+ * again soon.  's' must be aligned to sizeof(Vector8).  The streaming load
+ * (movntdqa) is SSE4.1, so SSE2 makes an ordinary aligned load.  Most CPUs
+ * treat the hint as a plain load on normal write-back memory anyway; the
+ * prefetchnta that callers issue ahead of these loads is what keeps the
+ * data out of most of the cache hierarchy.
+ */
+static inline void
+vector8_load_nt(Vector8 *v, const uint8 *s)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_stream_load_si512((void *) s);
+#elif defined(USE_AVX2)
+	*v = _mm256_stream_load_si256((const __m256i *) s);
+#else
+	*v = _mm_load_si128((const __m128i *) s);
+#endif
+}
+
+static inline void
+vector32_load_nt(Vector32 *v, const uint32 *s)
+{
+	vector8_load_nt(v, (const uint8 *) s);
+}
+
+/*
+ * Memory protection works on whole pages, so a full vector load is safe as
+ * long as it does not cross into the next page, even if it reads past the
+ * end of the object.  The partial loads below use this to avoid copying
+ * when there is no masked load.  An address sanitizer would rightly report
+ * the over-read, so don't take the shortcut in sanitized builds.
+ */
+#define VECTOR_PAGE_SIZE	4096
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define VECTOR_NO_OVERREAD
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define VECTOR_NO_OVERREAD
+#endif
+
+static inline bool
+vector_load_in_page(const void *s)
+{
+#ifdef VECTOR_NO_OVERREAD
+	(void) s;
+	return false;
+#else
+	return ((uintptr_t) s & (VECTOR_PAGE_SIZE - 1)) <=
+		VECTOR_PAGE_SIZE - sizeof(Vector8);
+#endif
+}
+
+/*
+ * Load the first 'n' elements at 's', where 'n' is less than a full vector,
+ * without faulting on memory past them.  The remaining lanes are
+ * unspecified and must be masked off by the caller.  AVX-512 has masked
+ * loads, which suppress faults on the disabled lanes; otherwise load in
+ * place if that stays within the page, or copy the elements out first.
+ */
+static inline void
+vector8_load_partial(Vector8 *v, const uint8 *s, uint32 n)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_maskz_loadu_epi8((__mmask64) ((UINT64_C(1) << n) - 1), s);
+#else
+	if (vector_load_in_page(s))
+		vector8_load(v, s);
+	else
+	{
+		uint8		buf[sizeof(Vector8)] = {0};
+
+		memcpy(buf, s, n);
+		vector8_load(v, buf);
+	}
+#endif
+}
+
+static inline void
+vector16_load_partial(Vector16 *v, const uint16 *s, uint32 n)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_maskz_loadu_epi16((__mmask32) ((UINT32_C(1) << n) - 1), s);
+#else
+	if (vector_load_in_page(s))
+		vector16_load(v, s);
+	else
+	{
+		uint16		buf[sizeof(Vector16) / sizeof(uint16)] = {0};
+
+		memcpy(buf, s, n * sizeof(uint16));
+		vector16_load(v, buf);
+	}
+#endif
+}
+
+static inline void
+vector32_load_partial(Vector32 *v, const uint32 *s, uint32 n)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_maskz_loadu_epi32((__mmask16) ((1 << n) - 1), s);
+#else
+	if (vector_load_in_page(s))
+		vector32_load(v, s);
+	else
+	{
+		uint32		buf[sizeof(Vector32) / sizeof(uint32)] = {0};
+
+		memcpy(buf, s, n * sizeof(uint32));
+		vector32_load(v, buf);
+	}
+#endif
+}
+
+static inline void
+vector64_load_partial(Vector64 *v, const uint64 *s, uint32 n)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_maskz_loadu_epi64((__mmask8) ((1 << n) - 1), s);
+#else
+	if (vector_load_in_page(s))
+		vector64_load(v, s);
+	else
+	{
+		uint64		buf[sizeof(Vector64) / sizeof(uint64)] = {0};
+
+		memcpy(buf, s, n * sizeof(uint64));
+		vector64_load(v, buf);
+	}
+#endif
 }
 
 /*
@@ -53,13 +360,49 @@ vector32_load(Vector32 *v, const uint32 *s)
 static inline Vector8
 vector8_broadcast(const uint8 c)
 {
+#if defined(USE_AVX512)
+	return _mm512_set1_epi8(c);
+#elif defined(USE_AVX2)
+	return _mm256_set1_epi8(c);
+#else
 	return _mm_set1_epi8(c);
+#endif
 }
 
 static inline Vector32
 vector32_broadcast(const uint32 c)
 {
+#if defined(USE_AVX512)
+	return _mm512_set1_epi32(c);
+#elif defined(USE_AVX2)
+	return _mm256_set1_epi32(c);
+#else
 	return _mm_set1_epi32(c);
+#endif
+}
+
+static inline Vector16
+vector16_broadcast(const uint16 c)
+{
+#if defined(USE_AVX512)
+	return _mm512_set1_epi16(c);
+#elif defined(USE_AVX2)
+	return _mm256_set1_epi16(c);
+#else
+	return _mm_set1_epi16(c);
+#endif
+}
+
+static inline Vector64
+vector64_broadcast(const uint64 c)
+{
+#if defined(USE_AVX512)
+	return _mm512_set1_epi64(c);
+#elif defined(USE_AVX2)
+	return _mm256_set1_epi64x(c);
+#else
+	return _mm_set1_epi64x(c);
+#endif
 }
 
 /*
@@ -70,7 +413,12 @@ vector8_has(const Vector8 v, const uint8 c)
 {
 	bool		result;
 
+#if defined(USE_AVX512)
+	/* compare straight into a mask register, no need for a result vector */
+	result = _mm512_cmpeq_epi8_mask(v, vector8_broadcast(c)) != 0;
+#else
 	result = vector8_is_highbit_set(vector8_eq(v, vector8_broadcast(c)));
+#endif
 
 	return result;
 }
@@ -93,12 +441,18 @@ vector8_has_le(const Vector8 v, const uint8 c)
 {
 	bool		result = false;
 
+#if defined(USE_AVX512)
+	/* AVX-512BW has a native unsigned compare producing a mask */
+	result = _mm512_cmple_epu8_mask(v, vector8_broadcast(c)) != 0;
+#else
+
 	/*
 	 * Use saturating subtraction to find bytes <= c, which will present as
 	 * NUL bytes.  This approach is a workaround for the lack of unsigned
 	 * comparison instructions on some architectures.
 	 */
 	result = vector8_has_zero(vector8_ssub(v, vector8_broadcast(c)));
+#endif
 
 	return result;
 }
@@ -109,7 +463,28 @@ vector8_has_le(const Vector8 v, const uint8 c)
 static inline bool
 vector8_is_highbit_set(const Vector8 v)
 {
+#if defined(USE_AVX512)
+	return _mm512_movepi8_mask(v) != 0;
+#elif defined(USE_AVX2)
+	return _mm256_movemask_epi8(v) != 0;
+#else
 	return _mm_movemask_epi8(v) != 0;
+#endif
+}
+
+/*
+ * Return true if every bit of the vector is clear
+ */
+static inline bool
+vector8_is_zero(const Vector8 v)
+{
+#if defined(USE_AVX512)
+	return _mm512_test_epi8_mask(v, v) == 0;
+#elif defined(USE_AVX2)
+	return _mm256_testz_si256(v, v) != 0;
+#else
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+#endif
 }
 
 /*
@@ -128,19 +503,70 @@ vector32_is_highbit_set(const Vector32 v)
 	return vector8_is_highbit_set(v);
 }
 
+static inline bool
+vector16_is_highbit_set(const Vector16 v)
+{
+	return vector8_is_highbit_set(v);
+}
+
+static inline bool
+vector64_is_highbit_set(const Vector64 v)
+{
+	return vector8_is_highbit_set(v);
+}
+
 /*
  * Return the bitwise OR of the inputs
  */
 static inline Vector8
 vector8_or(const Vector8 v1, const Vector8 v2)
 {
+#if defined(USE_AVX512)
+	return _mm512_or_si512(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_or_si256(v1, v2);
+#else
 	return _mm_or_si128(v1, v2);
+#endif
+}
+
+/*
+ * Return the bitwise exclusive OR of the inputs
+ */
+static inline Vector8
+vector8_xor(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_xor_si512(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_xor_si256(v1, v2);
+#else
+	return _mm_xor_si128(v1, v2);
+#endif
 }
 
 static inline Vector32
 vector32_or(const Vector32 v1, const Vector32 v2)
 {
+#if defined(USE_AVX512)
+	return _mm512_or_si512(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_or_si256(v1, v2);
+#else
 	return _mm_or_si128(v1, v2);
+#endif
+}
+
+static inline Vector16
+vector16_or(const Vector16 v1, const Vector16 v2)
+{
+	return vector32_or(v1, v2);
+}
+
+static inline Vector64
+vector64_or(const Vector64 v1, const Vector64 v2)
+{
+	return vector32_or(v1, v2);
 }
 
 /*
@@ -152,20 +578,697 @@ vector32_or(const Vector32 v1, const Vector32 v2)
 static inline Vector8
 vector8_ssub(const Vector8 v1, const Vector8 v2)
 {
+#if defined(USE_AVX512)
+	return _mm512_subs_epu8(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_subs_epu8(v1, v2);
+#else
 	return _mm_subs_epu8(v1, v2);
+#endif
+}
+
+/*
+ * Return the result of subtracting the respective elements of the input
+ * vectors, wrapping around on overflow.
+ */
+static inline Vector8
+vector8_sub(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_sub_epi8(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_sub_epi8(v1, v2);
+#else
+	return _mm_sub_epi8(v1, v2);
+#endif
+}
+
+/*
+ * Return the sum of the respective elements of the input vectors, wrapping
+ * around on overflow.
+ */
+static inline Vector8
+vector8_add(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_add_epi8(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_add_epi8(v1, v2);
+#else
+	return _mm_add_epi8(v1, v2);
+#endif
+}
+
+static inline Vector16
+vector16_sub(const Vector16 v1, const Vector16 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_sub_epi16(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_sub_epi16(v1, v2);
+#else
+	return _mm_sub_epi16(v1, v2);
+#endif
+}
+
+static inline Vector32
+vector32_sub(const Vector32 v1, const Vector32 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_sub_epi32(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_sub_epi32(v1, v2);
+#else
+	return _mm_sub_epi32(v1, v2);
+#endif
+}
+
+/*
+ * Return the sum of the respective elements of the input vectors, wrapping
+ * around on overflow.
+ */
+static inline Vector32
+vector32_add(const Vector32 v1, const Vector32 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_add_epi32(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_add_epi32(v1, v2);
+#else
+	return _mm_add_epi32(v1, v2);
+#endif
+}
+
+/*
+ * Return the bitwise AND of the inputs
+ */
+static inline Vector8
+vector8_and(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_and_si512(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_and_si256(v1, v2);
+#else
+	return _mm_and_si128(v1, v2);
+#endif
+}
+
+/*
+ * Return the bitwise AND of the first input and the complement of the second
+ */
+static inline Vector8
+vector8_andnot(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_andnot_si512(v2, v1);
+#elif defined(USE_AVX2)
+	return _mm256_andnot_si256(v2, v1);
+#else
+	return _mm_andnot_si128(v2, v1);
+#endif
+}
+
+static inline Vector16
+vector16_and(const Vector16 v1, const Vector16 v2)
+{
+	return vector8_and(v1, v2);
+}
+
+static inline Vector32
+vector32_and(const Vector32 v1, const Vector32 v2)
+{
+	return vector8_and(v1, v2);
+}
+
+static inline Vector64
+vector64_and(const Vector64 v1, const Vector64 v2)
+{
+	return vector8_and(v1, v2);
+}
+
+/*
+ * Shift each byte right by 'i' bits, shifting in zeros.  x86 has no 8-bit
+ * shifts, so shift 16-bit lanes and clear the bits that crossed over from
+ * the neighbouring byte.
+ */
+static inline Vector8
+vector8_shift_right(const Vector8 v, int i)
+{
+#if defined(USE_AVX512)
+	return vector8_and(_mm512_srli_epi16(v, i), vector8_broadcast(0xFF >> i));
+#elif defined(USE_AVX2)
+	return vector8_and(_mm256_srli_epi16(v, i), vector8_broadcast(0xFF >> i));
+#else
+	return vector8_and(_mm_srli_epi16(v, i), vector8_broadcast(0xFF >> i));
+#endif
+}
+
+/*
+ * Return the element-wise minimum or maximum of the inputs, treating the
+ * lanes as unsigned.
+ *
+ * SSE2 only has an unsigned min and max for 8-bit lanes.  For 16-bit lanes
+ * v1 - (v1 -sat v2) is the minimum and v2 + (v1 -sat v2) the maximum; for
+ * 32-bit and 64-bit lanes, flip the sign bits and select with a signed
+ * compare.  Only AVX-512 has 64-bit min and max; elsewhere the maximum is
+ * v1 ^ v2 ^ min(v1, v2).
+ */
+static inline Vector8
+vector8_min(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_min_epu8(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_min_epu8(v1, v2);
+#else
+	return _mm_min_epu8(v1, v2);
+#endif
+}
+
+static inline Vector8
+vector8_max(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_max_epu8(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_max_epu8(v1, v2);
+#else
+	return _mm_max_epu8(v1, v2);
+#endif
+}
+
+static inline Vector16
+vector16_min(const Vector16 v1, const Vector16 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_min_epu16(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_min_epu16(v1, v2);
+#else
+	return _mm_sub_epi16(v1, _mm_subs_epu16(v1, v2));
+#endif
+}
+
+static inline Vector16
+vector16_max(const Vector16 v1, const Vector16 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_max_epu16(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_max_epu16(v1, v2);
+#else
+	return _mm_add_epi16(v2, _mm_subs_epu16(v1, v2));
+#endif
+}
+
+static inline Vector32
+vector32_min(const Vector32 v1, const Vector32 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_min_epu32(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_min_epu32(v1, v2);
+#else
+	const __m128i sign = _mm_set1_epi32((int) 0x80000000);
+	__m128i		gt = _mm_cmpgt_epi32(_mm_xor_si128(v1, sign),
+									 _mm_xor_si128(v2, sign));
+
+	return _mm_or_si128(_mm_and_si128(gt, v2), _mm_andnot_si128(gt, v1));
+#endif
+}
+
+static inline Vector32
+vector32_max(const Vector32 v1, const Vector32 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_max_epu32(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_max_epu32(v1, v2);
+#else
+	const __m128i sign = _mm_set1_epi32((int) 0x80000000);
+	__m128i		gt = _mm_cmpgt_epi32(_mm_xor_si128(v1, sign),
+									 _mm_xor_si128(v2, sign));
+
+	return _mm_or_si128(_mm_and_si128(gt, v1), _mm_andnot_si128(gt, v2));
+#endif
+}
+
+static inline Vector64
+vector64_min(const Vector64 v1, const Vector64 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_min_epu64(v1, v2);
+#elif defined(USE_AVX2)
+	const __m256i sign = _mm256_set1_epi64x((long long) 0x8000000000000000ULL);
+	__m256i		gt = _mm256_cmpgt_epi64(_mm256_xor_si256(v1, sign),
+										_mm256_xor_si256(v2, sign));
+
+	return _mm256_blendv_epi8(v1, v2, gt);
+#else
+	/*
+	 * No 64-bit compare either (pcmpgtq is SSE4.2): v1 > v2 if the high
+	 * halves compare greater, or are equal and the low halves do.
+	 */
+	const __m128i sign = _mm_set1_epi32((int) 0x80000000);
+	__m128i		b1 = _mm_xor_si128(v1, sign);
+	__m128i		b2 = _mm_xor_si128(v2, sign);
+	__m128i		gt32 = _mm_cmpgt_epi32(b1, b2);
+	__m128i		eq32 = _mm_cmpeq_epi32(b1, b2);
+	__m128i		gt;
+
+	gt = _mm_or_si128(_mm_shuffle_epi32(gt32, _MM_SHUFFLE(3, 3, 1, 1)),
+					  _mm_and_si128(_mm_shuffle_epi32(eq32, _MM_SHUFFLE(3, 3, 1, 1)),
+									_mm_shuffle_epi32(gt32, _MM_SHUFFLE(2, 2, 0, 0))));
+
+	return _mm_or_si128(_mm_and_si128(gt, v2), _mm_andnot_si128(gt, v1));
+#endif
+}
+
+static inline Vector64
+vector64_max(const Vector64 v1, const Vector64 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_max_epu64(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_xor_si256(_mm256_xor_si256(v1, v2), vector64_min(v1, v2));
+#else
+	return _mm_xor_si128(_mm_xor_si128(v1, v2), vector64_min(v1, v2));
+#endif
+}
+
+/*
+ * Return the sum of the inputs, wrapping around on overflow
+ */
+static inline Vector64
+vector64_add(const Vector64 v1, const Vector64 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_add_epi64(v1, v2);
+#elif defined(USE_AVX2)
+	return _mm256_add_epi64(v1, v2);
+#else
+	return _mm_add_epi64(v1, v2);
+#endif
 }
+
+/*
+ * Return a vector of 64-bit lanes that together hold the sum of the
+ * unsigned elements of 'v', for adding into a widening accumulator.  Which
+ * elements go into which lane is unspecified.  psadbw against zero sums
+ * each group of eight bytes; wider elements are added in pairs, each pair
+ * widening them by one step.
+ */
+static inline Vector64
+vector8_sum64(const Vector8 v)
+{
+#if defined(USE_AVX512)
+	return _mm512_sad_epu8(v, _mm512_setzero_si512());
+#elif defined(USE_AVX2)
+	return _mm256_sad_epu8(v, _mm256_setzero_si256());
+#else
+	return _mm_sad_epu8(v, _mm_setzero_si128());
+#endif
+}
+
+static inline Vector64
+vector32_sum64(const Vector32 v)
+{
+#if defined(USE_AVX512)
+	return _mm512_add_epi64(_mm512_and_si512(v, _mm512_set1_epi64(0xFFFFFFFF)),
+							_mm512_srli_epi64(v, 32));
+#elif defined(USE_AVX2)
+	return _mm256_add_epi64(_mm256_and_si256(v, _mm256_set1_epi64x(0xFFFFFFFF)),
+							_mm256_srli_epi64(v, 32));
+#else
+	return _mm_add_epi64(_mm_and_si128(v, _mm_set1_epi64x(0xFFFFFFFF)),
+						 _mm_srli_epi64(v, 32));
+#endif
+}
+
+static inline Vector64
+vector16_sum64(const Vector16 v)
+{
+#if defined(USE_AVX512)
+	return vector32_sum64(_mm512_add_epi32(_mm512_and_si512(v, _mm512_set1_epi32(0xFFFF)),
+										   _mm512_srli_epi32(v, 16)));
+#elif defined(USE_AVX2)
+	return vector32_sum64(_mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)),
+										   _mm256_srli_epi32(v, 16)));
+#else
+	return vector32_sum64(_mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)),
+										_mm_srli_epi32(v, 16)));
+#endif
+}
+
 /*
  * Return a vector with all bits set in each lane where the corresponding
  * lanes in the inputs are equal.
+ *
+ * AVX-512 compares only produce a mask register, so expand the mask back
+ * into a vector to keep the same contract as the narrower backends.
  */
 static inline Vector8
 vector8_eq(const Vector8 v1, const Vector8 v2)
 {
+#if defined(USE_AVX512)
+	return _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(v1, v2));
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi8(v1, v2);
+#else
 	return _mm_cmpeq_epi8(v1, v2);
+#endif
 }
 
 static inline Vector32
 vector32_eq(const Vector32 v1, const Vector32 v2)
 {
+#if defined(USE_AVX512)
+	return _mm512_maskz_set1_epi32(_mm512_cmpeq_epi32_mask(v1, v2), -1);
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi32(v1, v2);
+#else
 	return _mm_cmpeq_epi32(v1, v2);
+#endif
+}
+
+static inline Vector16
+vector16_eq(const Vector16 v1, const Vector16 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_movm_epi16(_mm512_cmpeq_epi16_mask(v1, v2));
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi16(v1, v2);
+#else
+	return _mm_cmpeq_epi16(v1, v2);
+#endif
 }
+
+/*
+ * SSE2 has no 64-bit equality compare (pcmpeqq is SSE4.1), so compare the
+ * 32-bit halves and AND each half with its neighbour.
+ */
+static inline Vector64
+vector64_eq(const Vector64 v1, const Vector64 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_maskz_set1_epi64(_mm512_cmpeq_epi64_mask(v1, v2), -1);
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi64(v1, v2);
+#else
+	__m128i		halves = _mm_cmpeq_epi32(v1, v2);
+
+	return _mm_and_si128(halves,
+						 _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+#endif
+}
+
+/*
+ * Return a vector with all bits set in each lane where v1 <= v2, treating
+ * the lanes as unsigned.
+ *
+ * Before AVX-512, x86 only has signed compares.  Where an unsigned min is
+ * available, v1 <= v2 is the same as min(v1, v2) == v1.  SSE2 has no 16-bit
+ * or 32-bit unsigned min (those are SSE4.1), so 16-bit lanes use a
+ * saturating subtraction, which is zero exactly when v1 <= v2, and 32-bit
+ * lanes flip the sign bits to turn the question into a signed compare.
+ */
+static inline Vector8
+vector8_le(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_movm_epi8(_mm512_cmple_epu8_mask(v1, v2));
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(v1, v2), v1);
+#else
+	return _mm_cmpeq_epi8(_mm_min_epu8(v1, v2), v1);
+#endif
+}
+
+static inline Vector16
+vector16_le(const Vector16 v1, const Vector16 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_movm_epi16(_mm512_cmple_epu16_mask(v1, v2));
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi16(_mm256_min_epu16(v1, v2), v1);
+#else
+	return _mm_cmpeq_epi16(_mm_subs_epu16(v1, v2), _mm_setzero_si128());
+#endif
+}
+
+static inline Vector32
+vector32_le(const Vector32 v1, const Vector32 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_maskz_set1_epi32(_mm512_cmple_epu32_mask(v1, v2), -1);
+#elif defined(USE_AVX2)
+	return _mm256_cmpeq_epi32(_mm256_min_epu32(v1, v2), v1);
+#else
+	const __m128i sign = _mm_set1_epi32((int) 0x80000000);
+	__m128i		gt = _mm_cmpgt_epi32(_mm_xor_si128(v1, sign),
+									 _mm_xor_si128(v2, sign));
+
+	return _mm_xor_si128(gt, _mm_set1_epi32(-1));
+#endif
+}
+
+/*
+ * Return a bitmask of the lanes set in a compare result, i.e. a vector whose
+ * bytes are each either all ones or all zeros.  Each byte contributes
+ * VECTOR_MASK_BITS_PER_BYTE bits, lowest address in the lowest bits, so
+ * the first matching byte is at __builtin_ctzll(mask) /
+ * VECTOR_MASK_BITS_PER_BYTE.  On x86 this is simply movemask.
+ */
+static inline uint64
+vector8_cmp_mask(const Vector8 v)
+{
+#if defined(USE_AVX512)
+	return _mm512_movepi8_mask(v);
+#elif defined(USE_AVX2)
+	return (uint32) _mm256_movemask_epi8(v);
+#else
+	return (uint32) _mm_movemask_epi8(v);
+#endif
+}
+
+static inline uint64
+vector32_cmp_mask(const Vector32 v)
+{
+	return vector8_cmp_mask(v);
+}
+
+static inline uint64
+vector16_cmp_mask(const Vector16 v)
+{
+	return vector8_cmp_mask(v);
+}
+
+static inline uint64
+vector64_cmp_mask(const Vector64 v)
+{
+	return vector8_cmp_mask(v);
+}
+
+/*
+ * Equivalent to vector8_cmp_mask(vector8_eq(v1, v2)), but lets AVX-512 go
+ * straight from the compare to the mask register.
+ */
+static inline uint64
+vector8_eq_mask(const Vector8 v1, const Vector8 v2)
+{
+#if defined(USE_AVX512)
+	return _mm512_cmpeq_epi8_mask(v1, v2);
+#else
+	return vector8_cmp_mask(vector8_eq(v1, v2));
+#endif
+}
+
+/*
+ * As above, for 32-bit lanes.  Each lane still covers four bytes' worth of
+ * mask bits, so callers can treat masks of all widths the same way.
+ */
+static inline uint64
+vector32_eq_mask(const Vector32 v1, const Vector32 v2)
+{
+	return vector32_cmp_mask(vector32_eq(v1, v2));
+}
+
+/*
+ * Return a compact bitmask of a compare result, one bit per lane (so bit n
+ * stands for element n of the vector).  Unlike vector8_cmp_mask(), the
+ * layout does not depend on the backend, which is what bitmap outputs need.
+ */
+static inline uint64
+vector8_bitmask(const Vector8 v)
+{
+	return vector8_cmp_mask(v);
+}
+
+static inline uint64
+vector32_bitmask(const Vector32 v)
+{
+#if defined(USE_AVX512)
+	return _mm512_test_epi32_mask(v, v);
+#elif defined(USE_AVX2)
+	return (uint32) _mm256_movemask_ps(_mm256_castsi256_ps(v));
+#else
+	return (uint32) _mm_movemask_ps(_mm_castsi128_ps(v));
+#endif
+}
+
+#if defined(USE_AVX2)
+/*
+ * Return the shuffle control that moves the lanes selected by the low eight
+ * bits of 'lanes' to the front of a group of eight byte lanes: byte j holds
+ * the index of the j-th selected lane.  The bytes after those are junk, but
+ * still less than 8.  Each half of the group comes from a 16-entry table,
+ * the upper one shifted past the lanes the lower one selected.
+ */
+static inline uint64
+vector_compress_control8(uint64 lanes)
+{
+	static const uint32 nibble[16] = {
+		0x00000000, 0x00000000, 0x00000001, 0x00000100,
+		0x00000002, 0x00000200, 0x00000201, 0x00020100,
+		0x00000003, 0x00000300, 0x00000301, 0x00030100,
+		0x00000302, 0x00030200, 0x00030201, 0x03020100
+	};
+	uint32		lo = (uint32) lanes & 0x0F;
+	uint32		hi = ((uint32) lanes >> 4) & 0x0F;
+
+	return nibble[lo] |
+		((uint64) (nibble[hi] + 0x04040404) << (8 * __builtin_popcount(lo)));
+}
+#endif
+
+/*
+ * Store the lanes of 'v' selected by 'lanes', a bitmask in the
+ * vector8_bitmask() layout, contiguously at 'out' and return their number.
+ * The rest of the sizeof(Vector8) bytes at 'out' may be overwritten with
+ * junk.  AVX-512 compresses 16 bytes at a time widened to 32 bits,
+ * since VPCOMPRESSB needs AVX512-VBMI2; AVX2 shuffles groups of eight bytes
+ * with vector_compress_control8(), and SSE2, which has no variable shuffle,
+ * stores each lane and advances past the selected ones.
+ */
+static inline uint32
+vector8_compress_store(uint8 *out, const Vector8 v, uint64 lanes)
+{
+#if defined(USE_AVX512)
+	const __m128i quarters[4] = {
+		_mm512_extracti32x4_epi32(v, 0), _mm512_extracti32x4_epi32(v, 1),
+		_mm512_extracti32x4_epi32(v, 2), _mm512_extracti32x4_epi32(v, 3)
+	};
+	uint32		n = 0;
+	int			q;
+
+	for (q = 0; q < 4; q++)
+	{
+		__mmask16	m = (__mmask16) (lanes >> (16 * q));
+
+		_mm_storeu_si128((__m128i *) &out[n],
+						 _mm512_cvtepi32_epi8(_mm512_maskz_compress_epi32(m,
+																		  _mm512_cvtepu8_epi32(quarters[q]))));
+		n += __builtin_popcount(m);
+	}
+	return n;
+#elif defined(USE_AVX2)
+	const __m128i halves[2] = {
+		_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)
+	};
+	uint32		n = 0;
+	int			h;
+
+	for (h = 0; h < 2; h++)
+	{
+		uint64		lo = (lanes >> (16 * h)) & 0xFF;
+		uint64		hi = (lanes >> (16 * h + 8)) & 0xFF;
+		__m128i		packed;
+
+		packed = _mm_shuffle_epi8(halves[h],
+								  _mm_set_epi64x((long long) (vector_compress_control8(hi) +
+															  UINT64_C(0x0808080808080808)),
+												 (long long) vector_compress_control8(lo)));
+		_mm_storel_epi64((__m128i *) &out[n], packed);
+		n += __builtin_popcountll(lo);
+		_mm_storel_epi64((__m128i *) &out[n], _mm_unpackhi_epi64(packed, packed));
+		n += __builtin_popcountll(hi);
+	}
+	return n;
+#else
+	uint8		bytes[sizeof(Vector8)];
+	uint32		n = 0;
+	uint32		j;
+
+	_mm_storeu_si128((__m128i *) bytes, v);
+	for (j = 0; j < sizeof(Vector8); j++)
+	{
+		out[n] = bytes[j];
+		n += (lanes >> j) & 1;
+	}
+	return n;
+#endif
+}
+
+/*
+ * The same for 32-bit lanes, with 'lanes' in the vector32_bitmask() layout.
+ * AVX-512 has VPCOMPRESSD, and AVX2 permutes the lanes with VPERMD.
+ */
+static inline uint32
+vector32_compress_store(uint32 *out, const Vector32 v, uint64 lanes)
+{
+#if defined(USE_AVX512)
+	__mmask16	m = (__mmask16) lanes;
+
+	_mm512_storeu_si512(out, _mm512_maskz_compress_epi32(m, v));
+	return __builtin_popcount(m);
+#elif defined(USE_AVX2)
+	__m256i		control = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long) vector_compress_control8(lanes)));
+
+	_mm256_storeu_si256((__m256i *) out, _mm256_permutevar8x32_epi32(v, control));
+	return __builtin_popcountll(lanes & 0xFF);
+#else
+	uint32		words[sizeof(Vector32) / sizeof(uint32)];
+	uint32		n = 0;
+	uint32		j;
+
+	_mm_storeu_si128((__m128i *) words, v);
+	for (j = 0; j < sizeof(Vector32) / sizeof(uint32); j++)
+	{
+		out[n] = words[j];
+		n += (lanes >> j) & 1;
+	}
+	return n;
+#endif
+}
+
+#ifdef VECTOR8_HAS_LOOKUP
+
+/*
+ * Load a 16-byte lookup table for vector8_lookup().  pshufb looks up within
+ * each 128-bit lane, so wider vectors get a copy of the table per lane.
+ */
+static inline void
+vector8_load_lut(Vector8 *v, const uint8 *lut)
+{
+#if defined(USE_AVX512)
+	*v = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) lut));
+#else
+	*v = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) lut));
+#endif
+}
+
+/*
+ * Return lut[idx] for each byte of 'idx', which must be in the range 0..15.
+ */
+static inline Vector8
+vector8_lookup(const Vector8 lut, const Vector8 idx)
+{
+#if defined(USE_AVX512)
+	return _mm512_shuffle_epi8(lut, idx);
+#else
+	return _mm256_shuffle_epi8(lut, idx);
+#endif
+}
+
+#endif							/* VECTOR8_HAS_LOOKUP */
@@ -0,0 +1,114 @@
+/*
+ * stree.c
+ *
+ * Construction of the static search tree (see struct Stree32 in
+ * simd_internal.h).  Building is a one-off scalar job; the searches are
+ * per-variant kernels in lsearch.c.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+
+#include "simd_internal.h"
+
+/* cache line size, and the size of one node */
+#define STREE32_ALIGN	64
+
+/*
+ * stree32_build
+ *
+ * Build a search tree over the 'nelem' keys at 'keys', which must be sorted
+ * in ascending order.  The keys are copied, so the array can be freed
+ * afterwards.  Returns NULL if out of memory.
+ */
+Stree32 *
+stree32_build(const uint32 *keys, uint32 nelem)
+{
+	Stree32    *tree;
+	uint32		layer_nodes[STREE32_MAX_HEIGHT];
+	uint64		total_nodes = 0;
+	uint32		h;
+	uint32		k;
+	uint32		i;
+	void	   *nodes;
+
+	tree = calloc(1, sizeof(Stree32));
+	if (tree == NULL)
+		return NULL;
+	tree->nelem = nelem;
+
+	/* count the nodes of each layer, from the leaves up to a single root */
+	layer_nodes[0] = (nelem + STREE32_NODE_KEYS - 1) / STREE32_NODE_KEYS;
+	if (layer_nodes[0] == 0)
+		layer_nodes[0] = 1;
+	tree->height = 1;
+	while (layer_nodes[tree->height - 1] > 1)
+	{
+		layer_nodes[tree->height] =
+			(layer_nodes[tree->height - 1] + STREE32_FANOUT - 1) / STREE32_FANOUT;
+		tree->height++;
+	}
+
+	/* lay the layers out root first, in the order a search visits them */
+	for (h = tree->height; h-- > 0;)
+	{
+		tree->offsets[h] = (uint32) total_nodes;
+		total_nodes += layer_nodes[h];
+	}
+
+	if (posix_memalign(&nodes, STREE32_ALIGN,
+					   total_nodes * STREE32_NODE_KEYS * sizeof(uint32)) != 0)
+	{
+		free(tree);
+		return NULL;
+	}
+	tree->nodes = nodes;
+
+	/* the leaves are the sorted keys, padded to whole nodes */
+	for (i = 0; i < layer_nodes[0] * STREE32_NODE_KEYS; i++)
+	{
+		tree->nodes[tree->offsets[0] * STREE32_NODE_KEYS + i] =
+			i < nelem ? keys[i] : UINT32_MAX;
+	}
+
+	/*
+	 * Key i of an internal node is the first key of child i + 1, i.e. the
+	 * first key of that child's leftmost leaf.  Missing children get
+	 * UINT32_MAX, which no search key is ever greater than.
+	 */
+	for (h = 1; h < tree->height; h++)
+	{
+		for (k = 0; k < layer_nodes[h]; k++)
+		{
+			for (i = 0; i < STREE32_NODE_KEYS; i++)
+			{
+				uint64		child = (uint64) k * STREE32_FANOUT + i + 1;
+				uint32		l;
+
+				for (l = h - 1; l > 0; l--)
+					child *= STREE32_FANOUT;
+				child *= STREE32_NODE_KEYS;
+
+				tree->nodes[(tree->offsets[h] + k) * STREE32_NODE_KEYS + i] =
+					child < nelem ? keys[child] : UINT32_MAX;
+			}
+		}
+	}
+
+	return tree;
+}
+
+/*
+ * stree32_free
+ *
+ * Free a tree made by stree32_build().
+ */
+void
+stree32_free(Stree32 *tree)
+{
+	if (tree == NULL)
+		return;
+
+	free(tree->nodes);
+	free(tree);
+}
@@ -0,0 +1,146 @@
+/*
+ * test_cpp.cpp - Tests for the C++ front end in simd.hpp
+ *
+ * Checks simd::find, count, find_if and count_if against the standard
+ * algorithms, for each element width and predicate, over dynamic and
+ * fixed-size ranges, on both sides of the size at which equality scans go
+ * to the library.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+#include "../simd.hpp"
+
+/* Test statistics */
+static int total_tests = 0;
+static int failed_tests = 0;
+
+/* Test assertion macro */
+#define TEST_ASSERT(condition, message) do { \
+    total_tests++; \
+    if (condition) { \
+        printf("PASS: %s\n", message); \
+    } else { \
+        printf("FAIL: %s\n", message); \
+        failed_tests++; \
+    } \
+} while(0)
+
+/* std::ranges::find as an index, the way simd::find returns it */
+template <typename T, typename Pred>
+static size_t
+reference_find_if(std::span<const T> s, Pred pred)
+{
+    return std::find_if(s.begin(), s.end(), pred) - s.begin();
+}
+
+/* Compare every scan with the standard algorithms over random data */
+template <typename T>
+static int
+check_dynamic(const std::vector<T> &data, uint32_t nkeys)
+{
+    int mismatches = 0;
+
+    for (size_t n = 0; n <= data.size(); n += (n < 300 ? 1 : 997)) {
+        std::span<const T> s(data.data(), n);
+        T key = (T)(rand() % nkeys);
+        T hi = (T)(key + rand() % 4);
+
+        mismatches += simd::find(key, s) !=
+            reference_find_if(s, [&](T v) { return v == key; });
+        mismatches += simd::count(key, s) != (size_t) std::count(s.begin(), s.end(), key);
+        mismatches += simd::find_if(s, simd::le<T>{key}) !=
+            reference_find_if(s, [&](T v) { return v <= key; });
+        mismatches += simd::find_if(s, simd::range<T>{key, hi}) !=
+            reference_find_if(s, [&](T v) { return v >= key && v <= hi; });
+        mismatches += simd::count_if(s, simd::range<T>{key, hi}) !=
+            (size_t) std::count_if(s.begin(), s.end(),
+                                   [&](T v) { return v >= key && v <= hi; });
+        mismatches += simd::contains(key, s) != (std::find(s.begin(), s.end(), key) != s.end());
+    }
+    return mismatches;
+}
+
+/* The same for ranges whose size is a compile-time constant */
+template <typename T, size_t N>
+static int
+check_fixed(const std::vector<T> &data)
+{
+    std::array<T, N> a;
+    int mismatches = 0;
+
+    std::copy(data.begin(), data.begin() + N, a.begin());
+    for (uint32_t k = 0; k < 200; k++) {
+        T key = (T) k;
+        std::span<const T, N> s(a);
+
+        mismatches += simd::find(key, a) !=
+            reference_find_if(std::span<const T>(a), [&](T v) { return v == key; });
+        mismatches += simd::find(key, s) != simd::find(key, std::span<const T>(a));
+        mismatches += simd::count(key, a) != (size_t) std::count(a.begin(), a.end(), key);
+        mismatches += simd::find_if(a, simd::le<T>{key}) !=
+            reference_find_if(std::span<const T>(a), [&](T v) { return v <= key; });
+    }
+    return mismatches;
+}
+
+template <typename T>
+static void
+test_width(const char *name)
+{
+    std::vector<T> data(20000);
+    char message[128];
+    int mismatches;
+
+    srand(83);
+    for (auto &v : data) {
+        v = (T)(rand() % 200);
+    }
+
+    mismatches = check_dynamic(data, 220);
+    mismatches += check_fixed<T, 0>(data);
+    mismatches += check_fixed<T, 1>(data);
+    mismatches += check_fixed<T, 5>(data);
+    mismatches += check_fixed<T, 16>(data);
+    mismatches += check_fixed<T, 37>(data);
+    mismatches += check_fixed<T, 64>(data);
+    mismatches += check_fixed<T, 130>(data);
+    snprintf(message, sizeof(message),
+             "%s scans should match the standard algorithms", name);
+    TEST_ASSERT(mismatches == 0, message);
+}
+
+int main(void)
+{
+    printf("libsimd C++ Front End Tests\n");
+    printf("===========================\n");
+
+    test_width<uint8_t>("uint8");
+    test_width<uint16_t>("uint16");
+    test_width<uint32_t>("uint32");
+    test_width<uint64_t>("uint64");
+
+    /* signed elements, C arrays and explicit key types */
+    std::vector<int> ints = {3, -1, 7, -1, 9};
+    int carray[] = {4, 8, 15, 16, 23, 42};
+    std::vector<uint8_t> big(100000, 'a');
+    big[77777] = '\n';
+    TEST_ASSERT(simd::find(-1, ints) == 1 && simd::count(-1, ints) == 2 &&
+                simd::find(5, ints) == ints.size(),
+                "equality scans should take signed elements");
+    TEST_ASSERT(simd::find(23, carray) == 4 && !simd::contains(5, carray),
+                "scans should take C arrays");
+    TEST_ASSERT(simd::find<uint8_t>('\n', big) == 77777 &&
+                simd::count<uint8_t>('\n', big) == 1 &&
+                simd::count<uint8_t>('a', big) == big.size() - 1,
+                "explicit key types should convert the key");
+
+    printf("\nTotal tests: %d\n", total_tests);
+    printf("Failed: %d\n", failed_tests);
+    return failed_tests;
+}
@@ -5,20 +5,87 @@
  * including lfind8, lfind32, and other utility functions.
  */
 
+/* for MAP_ANONYMOUS under -std=c99 */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 /* Include the SIMD headers and functions */
 #include "../simd.h"
+#include "../simd_inline.h"
 
 /* Function prototypes from lfind.c */
 extern bool lfind8(uint8_t key, uint8_t *base, uint32_t nelem);
 extern bool lfind8_le(uint8_t key, uint8_t *base, uint32_t nelem);
 extern bool lfind32(uint32_t key, uint32_t *base, uint32_t nelem);
+extern bool lfind16(uint16_t key, uint16_t *base, uint32_t nelem);
+extern bool lfind64(uint64 key, uint64 *base, uint32_t nelem);
+extern uint32_t lfind8_index(uint8_t key, uint8_t *base, uint32_t nelem);
+extern uint32_t lfind32_index(uint32_t key, uint32_t *base, uint32_t nelem);
+extern uint32_t lfind8_count(uint8_t key, uint8_t *base, uint32_t nelem);
+extern uint32_t lfind32_count(uint32_t key, uint32_t *base, uint32_t nelem);
+extern uint32_t lfind8_mask(uint8_t key, uint8_t *base, uint32_t nelem, uint8_t *bitmap);
+extern uint32_t lfind32_mask(uint32_t key, uint32_t *base, uint32_t nelem, uint8_t *bitmap);
+extern bool lfind8_any(const uint8_t *keys, uint32_t nkeys, uint8_t *base, uint32_t nelem);
+extern bool lfind32_any(const uint32_t *keys, uint32_t nkeys, uint32_t *base, uint32_t nelem);
+extern uint32_t lfind32_batch(const uint32_t *keys, uint32_t nkeys, uint32_t *base,
+                              uint32_t nelem, uint8_t *bitmap);
+extern uint32_t lfind32_index_batch(const uint32_t *keys, uint32_t nkeys, uint32_t *base,
+                                    uint32_t nelem, uint32_t *indexes);
+extern bool lfind8_padded(uint8_t key, uint8_t *base, uint32_t nelem);
+extern bool lfind32_padded(uint32_t key, uint32_t *base, uint32_t nelem);
+extern void *simd_memchr(const void *s, int c, size_t n);
+extern void *simd_memrchr(const void *s, int c, size_t n);
+extern void *simd_memchr2(const void *s, int c1, int c2, size_t n);
+extern void *simd_memchr3(const void *s, int c1, int c2, int c3, size_t n);
+extern size_t simd_strlen(const char *s);
+extern uint32_t lower_bound32(uint32_t key, uint32_t *base, uint32_t nelem);
+extern uint32_t lsearch32_sorted(uint32_t key, uint32_t *base, uint32_t nelem);
+extern uint32_t lfind_substr(const uint8_t *needle, uint32_t nlen,
+                             const uint8_t *haystack, uint32_t hlen);
+extern uint8_t vmin8(uint8_t *base, uint32_t nelem);
+extern uint8_t vmax8(uint8_t *base, uint32_t nelem);
+extern uint64 vsum8(uint8_t *base, uint32_t nelem);
+extern uint32_t argmin8(uint8_t *base, uint32_t nelem);
+extern uint32_t argmax8(uint8_t *base, uint32_t nelem);
+extern uint16_t vmin16(uint16_t *base, uint32_t nelem);
+extern uint16_t vmax16(uint16_t *base, uint32_t nelem);
+extern uint64 vsum16(uint16_t *base, uint32_t nelem);
+extern uint32_t argmin16(uint16_t *base, uint32_t nelem);
+extern uint32_t argmax16(uint16_t *base, uint32_t nelem);
+extern uint32_t vmin32(uint32_t *base, uint32_t nelem);
+extern uint32_t vmax32(uint32_t *base, uint32_t nelem);
+extern uint64 vsum32(uint32_t *base, uint32_t nelem);
+extern uint32_t argmin32(uint32_t *base, uint32_t nelem);
+extern uint32_t argmax32(uint32_t *base, uint32_t nelem);
+extern uint64 vmin64(uint64 *base, uint32_t nelem);
+extern uint64 vmax64(uint64 *base, uint32_t nelem);
+extern uint64 vsum64(uint64 *base, uint32_t nelem);
+extern uint32_t argmin64(uint64 *base, uint32_t nelem);
+extern uint32_t argmax64(uint64 *base, uint32_t nelem);
+extern uint32_t lfind32_stats(uint32_t key, uint32_t *base, uint32_t nelem,
+                              Lfind32Stats *stats);
+extern SimdHashMap *simd_hash_create(uint32_t capacity);
+extern void simd_hash_destroy(SimdHashMap *map);
+extern bool simd_hash_insert(SimdHashMap *map, uint64 key, uint64 value);
+extern bool simd_hash_lookup(const SimdHashMap *map, uint64 key, uint64 *value);
+extern bool simd_hash_delete(SimdHashMap *map, uint64 key);
+extern uint32_t simd_hash_count(const SimdHashMap *map);
+extern Stree32 *stree32_build(const uint32_t *keys, uint32_t nelem);
+extern void stree32_free(Stree32 *tree);
+extern uint32_t stree32_lower_bound(const Stree32 *tree, uint32_t key);
+extern uint32_t stree32_lower_bound_batch(const Stree32 *tree, const uint32_t *keys,
+                                          uint32_t nkeys, uint32_t *results);
 
 /* Test statistics */
 typedef struct {
@@ -62,6 +129,28 @@ static bool linear_search_uint32(uint32_t key, uint32_t *base, uint32_t nelem)
     return false;
 }
 
+static bool linear_search_uint8_any(const uint8_t *keys, uint32_t nkeys,
+                                    uint8_t *base, uint32_t nelem)
+{
+    for (uint32_t k = 0; k < nkeys; k++) {
+        if (linear_search_uint8(keys[k], base, nelem)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool linear_search_uint32_any(const uint32_t *keys, uint32_t nkeys,
+                                     uint32_t *base, uint32_t nelem)
+{
+    for (uint32_t k = 0; k < nkeys; k++) {
+        if (linear_search_uint32(keys[k], base, nelem)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static bool linear_search_uint8_le(uint8_t key, uint8_t *base, uint32_t nelem)
 {
     for (uint32_t i = 0; i < nelem; i++) {
@@ -281,73 +370,2460 @@ void test_lfind32_large_array(void)
     free(large_array);
 }
 
-/* Test vector alignment and boundary conditions */
-void test_vector_alignment(void)
+/* Test lfind8_index function */
+void test_lfind8_index(void)
 {
-    printf("\n=== Testing Vector Alignment ===\n");
+    printf("\n=== Testing lfind8_index ===\n");
     
-    /* Test arrays of different sizes to check vector boundary handling */
-    for (uint32_t size = 1; size <= 64; size++) {
-        uint8_t *test_array = malloc(size * sizeof(uint8_t));
+    uint8_t small_array[] = {1, 3, 5, 7, 9, 3, 13, 15};
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
+    
+    TEST_ASSERT(lfind8_index(1, small_array, small_size) == 0,
+                "lfind8_index should return 0 for first element");
+    TEST_ASSERT(lfind8_index(3, small_array, small_size) == 1,
+                "lfind8_index should return the first of duplicate elements");
+    TEST_ASSERT(lfind8_index(15, small_array, small_size) == 7,
+                "lfind8_index should return index of last element");
+    TEST_ASSERT(lfind8_index(2, small_array, small_size) == LFIND_NOT_FOUND,
+                "lfind8_index should return LFIND_NOT_FOUND for missing element");
+    TEST_ASSERT(lfind8_index(0, NULL, 0) == LFIND_NOT_FOUND,
+                "lfind8_index should return LFIND_NOT_FOUND for empty array");
+    
+    /* Place a single key at every position of arrays spanning several vectors */
+    int mismatches = 0;
+    for (uint32_t size = 1; size <= 200; size++) {
+        uint8_t *test_array = calloc(size, sizeof(uint8_t));
+        
+        for (uint32_t pos = 0; pos < size; pos++) {
+            test_array[pos] = 0xAA;
+            if (lfind8_index(0xAA, test_array, size) != pos) {
+                mismatches++;
+            }
+            /* a later duplicate must not change the answer */
+            test_array[size - 1] = 0xAA;
+            if (lfind8_index(0xAA, test_array, size) != pos) {
+                mismatches++;
+            }
+            test_array[size - 1] = 0;
+            test_array[pos] = 0;
+        }
+        if (lfind8_index(0xAA, test_array, size) != LFIND_NOT_FOUND) {
+            mismatches++;
+        }
+        
+        free(test_array);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind8_index should return the first match at every position");
+}
+
+/* Test lfind32_index function */
+void test_lfind32_index(void)
+{
+    printf("\n=== Testing lfind32_index ===\n");
+    
+    uint32_t small_array[] = {10, 30, 50, 70, 90, 30, 130, 150};
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
+    
+    TEST_ASSERT(lfind32_index(10, small_array, small_size) == 0,
+                "lfind32_index should return 0 for first element");
+    TEST_ASSERT(lfind32_index(30, small_array, small_size) == 1,
+                "lfind32_index should return the first of duplicate elements");
+    TEST_ASSERT(lfind32_index(150, small_array, small_size) == 7,
+                "lfind32_index should return index of last element");
+    TEST_ASSERT(lfind32_index(25, small_array, small_size) == LFIND_NOT_FOUND,
+                "lfind32_index should return LFIND_NOT_FOUND for missing element");
+    
+    /*
+     * Exercise every register of the four-register block: the key sits at
+     * each position, with a duplicate in a later register.
+     */
+    int mismatches = 0;
+    for (uint32_t size = 1; size <= 300; size += (size < 140 ? 1 : 7)) {
+        uint32_t *test_array = calloc(size, sizeof(uint32_t));
+        
+        for (uint32_t pos = 0; pos < size; pos++) {
+            test_array[pos] = 0xDEADBEEF;
+            test_array[size - 1] = 0xDEADBEEF;
+            if (lfind32_index(0xDEADBEEF, test_array, size) != pos) {
+                mismatches++;
+            }
+            test_array[size - 1] = 0;
+            test_array[pos] = 0;
+        }
+        if (lfind32_index(0xDEADBEEF, test_array, size) != LFIND_NOT_FOUND) {
+            mismatches++;
+        }
+        
+        free(test_array);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind32_index should return the first match at every position");
+}
+
+/* Test lfind8_count and lfind8_mask functions */
+void test_lfind8_count_mask(void)
+{
+    printf("\n=== Testing lfind8_count / lfind8_mask ===\n");
+    
+    uint8_t small_array[] = {7, 1, 7, 2, 7, 3, 4, 7, 5};
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
+    uint8_t bitmap[LFIND_BITMAP_BYTES(9)];
+    
+    TEST_ASSERT(lfind8_count(7, small_array, small_size) == 4,
+                "lfind8_count should count every match");
+    TEST_ASSERT(lfind8_count(9, small_array, small_size) == 0,
+                "lfind8_count should return 0 for missing element");
+    TEST_ASSERT(lfind8_mask(7, small_array, small_size, bitmap) == 4,
+                "lfind8_mask should return the number of matches");
+    TEST_ASSERT(bitmap[0] == 0x95 && bitmap[1] == 0x00,
+                "lfind8_mask should set the bits of matching positions");
+    
+    /* Compare with linear implementation over sizes spanning several vectors */
+    int mismatches = 0;
+    for (uint32_t size = 0; size <= 300; size++) {
+        uint8_t *test_array = malloc(size + 1);
+        uint8_t *test_bitmap = malloc(LFIND_BITMAP_BYTES(size) + 1);
         
-        /* Fill with sequential values */
         for (uint32_t i = 0; i < size; i++) {
-            test_array[i] = (uint8_t)(i % 256);
+            test_array[i] = (uint8_t)((i * 7 + size) % 5);
         }
         
-        /* Test finding first and last elements */
-        bool found_first = lfind8(0, test_array, size);
-        bool found_last = lfind8((uint8_t)((size - 1) % 256), test_array, size);
+        uint32_t expected = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            expected += (test_array[i] == 3);
+        }
         
-        if (!found_first || !found_last) {
-            printf("FAIL: Vector alignment issue with size %u\n", size);
-            stats.total_tests++;
-            stats.failed_tests++;
+        test_bitmap[LFIND_BITMAP_BYTES(size)] = 0x5A;   /* guard byte */
+        if (lfind8_count(3, test_array, size) != expected ||
+            lfind8_mask(3, test_array, size, test_bitmap) != expected ||
+            test_bitmap[LFIND_BITMAP_BYTES(size)] != 0x5A) {
+            mismatches++;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            bool bit = (test_bitmap[i / 8] >> (i % 8)) & 1;
+            if (bit != (test_array[i] == 3)) {
+                mismatches++;
+            }
+        }
+        if (size % 8 != 0 && (test_bitmap[size / 8] >> (size % 8)) != 0) {
+            mismatches++;
         }
         
         free(test_array);
+        free(test_bitmap);
     }
+    TEST_ASSERT(mismatches == 0,
+                "lfind8_count/lfind8_mask should match linear search for all sizes");
+}
+
+/* Test lfind32_count and lfind32_mask functions */
+void test_lfind32_count_mask(void)
+{
+    printf("\n=== Testing lfind32_count / lfind32_mask ===\n");
     
-    stats.total_tests++;
-    stats.passed_tests++;
-    printf("Vector alignment tests completed successfully\n");
+    uint32_t small_array[] = {0xFFFFFFFF, 1, 0xFFFFFFFF, 2, 3};
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
+    uint8_t bitmap[LFIND_BITMAP_BYTES(5)];
+    
+    TEST_ASSERT(lfind32_count(0xFFFFFFFF, small_array, small_size) == 2,
+                "lfind32_count should count every match");
+    TEST_ASSERT(lfind32_mask(0xFFFFFFFF, small_array, small_size, bitmap) == 2 &&
+                bitmap[0] == 0x05,
+                "lfind32_mask should set the bits of matching positions");
+    
+    int mismatches = 0;
+    for (uint32_t size = 0; size <= 300; size++) {
+        uint32_t *test_array = malloc((size + 1) * sizeof(uint32_t));
+        uint8_t *test_bitmap = malloc(LFIND_BITMAP_BYTES(size) + 1);
+        
+        for (uint32_t i = 0; i < size; i++) {
+            test_array[i] = (i * 2654435761u + size) % 3;
+        }
+        
+        uint32_t expected = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            expected += (test_array[i] == 1);
+        }
+        
+        test_bitmap[LFIND_BITMAP_BYTES(size)] = 0x5A;   /* guard byte */
+        if (lfind32_count(1, test_array, size) != expected ||
+            lfind32_mask(1, test_array, size, test_bitmap) != expected ||
+            test_bitmap[LFIND_BITMAP_BYTES(size)] != 0x5A) {
+            mismatches++;
+        }
+        for (uint32_t i = 0; i < size; i++) {
+            bool bit = (test_bitmap[i / 8] >> (i % 8)) & 1;
+            if (bit != (test_array[i] == 1)) {
+                mismatches++;
+            }
+        }
+        
+        free(test_array);
+        free(test_bitmap);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind32_count/lfind32_mask should match linear search for all sizes");
 }
 
-/* Print test summary */
-void print_test_summary(void)
+/* Test lfind8_any and lfind32_any functions */
+void test_lfind_any(void)
 {
-    printf("\n" "================================================\n");
-    printf("Functional Test Summary:\n");
-    printf("Total tests: %d\n", stats.total_tests);
-    printf("Passed: %d\n", stats.passed_tests);
-    printf("Failed: %d\n", stats.failed_tests);
-    printf("Success rate: %.2f%%\n", 
-           stats.total_tests > 0 ? (double)stats.passed_tests / stats.total_tests * 100 : 0);
+    printf("\n=== Testing lfind8_any / lfind32_any ===\n");
     
-    if (stats.failed_tests == 0) {
-        printf("All functional tests PASSED!\n");
-    } else {
-        printf("WARNING: %d functional tests FAILED!\n", stats.failed_tests);
+    uint8_t text[] = "key=value;other=thing\n";
+    uint32_t text_len = sizeof(text) - 1;
+    uint8_t delims[] = {',', ';', '\t'};
+    uint8_t missing[] = {',', '\t', '|', '#', '!', '?', '@'};
+    
+    TEST_ASSERT(lfind8_any(delims, 3, text, text_len) == true,
+                "lfind8_any should find one of several delimiters");
+    TEST_ASSERT(lfind8_any(missing, 7, text, text_len) == false,
+                "lfind8_any should not find absent delimiters");
+    TEST_ASSERT(lfind8_any(delims, 0, text, text_len) == false,
+                "lfind8_any should return false for an empty key set");
+    
+    uint32_t ids[] = {100, 200, 300, 400, 500, 600, 700, 800, 900};
+    uint32_t probe_hit[] = {1, 2, 3, 900};
+    uint32_t probe_miss[] = {1, 2, 3, 4};
+    TEST_ASSERT(lfind32_any(probe_hit, 4, ids, 9) == true,
+                "lfind32_any should find one of several keys");
+    TEST_ASSERT(lfind32_any(probe_miss, 4, ids, 9) == false,
+                "lfind32_any should not find absent keys");
+    
+    /*
+     * Compare with linear search for key sets of every size, covering the
+     * broadcast path, the nibble-table path and grouped keys.
+     */
+    const uint32_t size = 1000;
+    uint8_t *bytes = malloc(size);
+    uint32_t *words = malloc(size * sizeof(uint32_t));
+    uint8_t byte_keys[64];
+    uint32_t word_keys[64];
+    int mismatches = 0;
+    
+    srand(7);
+    for (uint32_t trial = 0; trial < 400; trial++) {
+        uint32_t nkeys = trial % 64;
+        uint32_t nelem = (uint32_t)(rand() % size);
+        
+        for (uint32_t i = 0; i < nelem; i++) {
+            /* keep the array free of values below 64 except for a few */
+            bytes[i] = (uint8_t)(64 + rand() % 192);
+            words[i] = (uint32_t)rand() | 0x80000000u;
+        }
+        for (uint32_t k = 0; k < nkeys; k++) {
+            byte_keys[k] = (uint8_t)(rand() % 64);
+            word_keys[k] = (uint32_t)rand() & 0x7FFFFFFFu;
+        }
+        /* plant a match in half the trials */
+        if (trial % 2 == 0 && nelem > 0 && nkeys > 0) {
+            uint32_t pos = (uint32_t)(rand() % nelem);
+            bytes[pos] = byte_keys[rand() % nkeys];
+            words[pos] = word_keys[rand() % nkeys];
+        }
+        
+        if (lfind8_any(byte_keys, nkeys, bytes, nelem) !=
+            linear_search_uint8_any(byte_keys, nkeys, bytes, nelem)) {
+            mismatches++;
+        }
+        if (lfind32_any(word_keys, nkeys, words, nelem) !=
+            linear_search_uint32_any(word_keys, nkeys, words, nelem)) {
+            mismatches++;
+        }
     }
-    printf("================================================\n");
+    
+    /* the full byte range, as large sets go through the nibble tables */
+    uint8_t all_but_one[255];
+    for (uint32_t k = 0; k < 255; k++) {
+        all_but_one[k] = (uint8_t)(k + 1);
+    }
+    memset(bytes, 0, size);
+    if (lfind8_any(all_but_one, 255, bytes, size) != false) {
+        mismatches++;
+    }
+    bytes[size - 1] = 0x80;
+    if (lfind8_any(all_but_one, 255, bytes, size) != true) {
+        mismatches++;
+    }
+    bytes[size - 1] = 0;
+    bytes[5] = 0xFF;
+    if (lfind8_any(all_but_one, 255, bytes, size) != true) {
+        mismatches++;
+    }
+    
+    TEST_ASSERT(mismatches == 0,
+                "lfind8_any/lfind32_any should match linear search for all key set sizes");
+    
+    free(bytes);
+    free(words);
 }
 
-int main(void)
+/*
+ * Check every range predicate of one element type against a scalar loop.
+ * 'keys' supplies the probe values; each is also used as the lower bound of
+ * a between() probe, with the next key as the upper bound.
+ */
+#define CHECK_RANGE_PREDICATES(bits, suffix, type, base, nelem, keys, nkeys, mismatches) \
+    for (uint32_t k = 0; k < (nkeys); k++) { \
+        type key = (keys)[k]; \
+        type hi = (keys)[(k + 1) % (nkeys)]; \
+        bool le = false, lt = false, ge = false, gt = false, between = false; \
+        for (uint32_t i = 0; i < (nelem); i++) { \
+            le |= (base)[i] <= key; \
+            lt |= (base)[i] < key; \
+            ge |= (base)[i] >= key; \
+            gt |= (base)[i] > key; \
+            between |= (base)[i] >= key && (base)[i] <= hi; \
+        } \
+        if (lfind##bits##_le##suffix(key, base, nelem) != le || \
+            lfind##bits##_lt##suffix(key, base, nelem) != lt || \
+            lfind##bits##_ge##suffix(key, base, nelem) != ge || \
+            lfind##bits##_gt##suffix(key, base, nelem) != gt || \
+            lfind##bits##_between##suffix(key, hi, base, nelem) != between) { \
+            printf("FAIL: lfind" #bits #suffix " range mismatch for key %lld\n", \
+                   (long long) key); \
+            (mismatches)++; \
+        } \
+    }
+
+/* Test the range predicates */
+void test_lfind_range(void)
 {
-    printf("libsimd Functional Tests\n");
-    printf("========================\n");
+    printf("\n=== Testing Range Predicates ===\n");
     
-    /* Run all functional tests */
-    test_lfind8_basic();
-    test_lfind8_edge_cases();
-    test_lfind8_large_array();
-    test_lfind8_le_basic();
+    uint8_t small_array[] = {10, 30, 50, 70, 90, 110, 130, 150};
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
     
-    test_lfind32_basic();
-    test_lfind32_edge_cases();
-    test_lfind32_large_array();
+    TEST_ASSERT(lfind8_ge(150, small_array, small_size) == true,
+                "lfind8_ge should find element >= 150");
+    TEST_ASSERT(lfind8_gt(150, small_array, small_size) == false,
+                "lfind8_gt should not find element > 150");
+    TEST_ASSERT(lfind8_lt(10, small_array, small_size) == false,
+                "lfind8_lt should not find element < 10");
+    TEST_ASSERT(lfind8_between(51, 69, small_array, small_size) == false,
+                "lfind8_between should not find element in an empty gap");
+    TEST_ASSERT(lfind8_between(51, 70, small_array, small_size) == true,
+                "lfind8_between should include its upper bound");
+    TEST_ASSERT(lfind8_between(70, 51, small_array, small_size) == false,
+                "lfind8_between should return false when lo > hi");
     
-    test_vector_alignment();
+    int32_t timestamps[] = {-5000, -20, 0, 17, 100000};
+    TEST_ASSERT(lfind32_between_signed(-100, -1, timestamps, 5) == true,
+                "lfind32_between_signed should handle negative ranges");
+    TEST_ASSERT(lfind32_between_signed(-19, -1, timestamps, 5) == false,
+                "lfind32_between_signed should not find element in an empty gap");
+    TEST_ASSERT(lfind32_lt_signed(-5000, timestamps, 5) == false,
+                "lfind32_lt_signed should respect the sign");
+    TEST_ASSERT(lfind32_gt(0x7FFFFFFFu, (uint32_t *) timestamps, 5) == true,
+                "lfind32_gt should treat negative values as large unsigned ones");
+    
+    /* random arrays of every size against scalar loops */
+    int mismatches = 0;
+    srand(11);
+    for (uint32_t nelem = 0; nelem <= 150; nelem++) {
+        uint8_t u8[150], u8keys[8];
+        int8_t s8[150], s8keys[8];
+        uint16_t u16[150], u16keys[8];
+        int16_t s16[150], s16keys[8];
+        uint32_t u32[150], u32keys[8];
+        int32_t s32[150], s32keys[8];
+        
+        for (uint32_t i = 0; i < nelem; i++) {
+            /* keep values away from the limits so edges get tested too */
+            u8[i] = (uint8_t)(1 + rand() % 254);
+            s8[i] = (int8_t) u8[i];
+            u16[i] = (uint16_t)(1 + rand() % 65534);
+            s16[i] = (int16_t) u16[i];
+            u32[i] = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+            s32[i] = (int32_t) u32[i];
+        }
+        for (uint32_t k = 0; k < 8; k++) {
+            uint32_t pick = nelem ? (uint32_t) rand() % nelem : 0;
+            
+            if (k < 2) {
+                /* the type limits */
+                u8keys[k] = k ? 0xFF : 0;
+                s8keys[k] = k ? 127 : -128;
+                u16keys[k] = k ? 0xFFFF : 0;
+                s16keys[k] = k ? 32767 : -32768;
+                u32keys[k] = k ? 0xFFFFFFFFu : 0;
+                s32keys[k] = k ? INT32_MAX : INT32_MIN;
+            } else if (k < 5 && nelem > 0) {
+                /* values present in the array */
+                u8keys[k] = u8[pick];
+                s8keys[k] = s8[pick];
+                u16keys[k] = u16[pick];
+                s16keys[k] = s16[pick];
+                u32keys[k] = u32[pick];
+                s32keys[k] = s32[pick];
+            } else {
+                u8keys[k] = (uint8_t) rand();
+                s8keys[k] = (int8_t) rand();
+                u16keys[k] = (uint16_t) rand();
+                s16keys[k] = (int16_t) rand();
+                u32keys[k] = (uint32_t) rand() * 3u;
+                s32keys[k] = (int32_t)((uint32_t) rand() * 3u);
+            }
+        }
+        
+        CHECK_RANGE_PREDICATES(8, , uint8_t, u8, nelem, u8keys, 8, mismatches)
+        CHECK_RANGE_PREDICATES(8, _signed, int8_t, s8, nelem, s8keys, 8, mismatches)
+        CHECK_RANGE_PREDICATES(16, , uint16_t, u16, nelem, u16keys, 8, mismatches)
+        CHECK_RANGE_PREDICATES(16, _signed, int16_t, s16, nelem, s16keys, 8, mismatches)
+        CHECK_RANGE_PREDICATES(32, , uint32_t, u32, nelem, u32keys, 8, mismatches)
+        CHECK_RANGE_PREDICATES(32, _signed, int32_t, s32, nelem, s32keys, 8, mismatches)
+    }
+    TEST_ASSERT(mismatches == 0,
+                "range predicates should match scalar comparisons for all types");
+}
+
+/* Test lfind32_batch / lfind32_index_batch */
+void test_lfind32_batch(void)
+{
+    printf("\n=== Testing lfind32_batch / lfind32_index_batch ===\n");
+    
+    uint32_t bucket[] = {7, 14, 21, 28, 35, 42, 49, 56, 63, 70, 77, 14};
+    uint32_t bucket_size = sizeof(bucket) / sizeof(bucket[0]);
+    uint32_t probes[] = {14, 15, 77, 0, 7, 70};
+    uint32_t indexes[6];
+    uint8_t bitmap[2];
+    
+    TEST_ASSERT(lfind32_batch(probes, 6, bucket, bucket_size, bitmap) == 4,
+                "lfind32_batch should count the keys present");
+    TEST_ASSERT(bitmap[0] == 0x35,
+                "lfind32_batch should set one bit per key found");
+    TEST_ASSERT(lfind32_index_batch(probes, 6, bucket, bucket_size, indexes) == 4,
+                "lfind32_index_batch should count the keys present");
+    TEST_ASSERT(indexes[0] == 1 && indexes[1] == LFIND_NOT_FOUND &&
+                indexes[2] == 10 && indexes[3] == LFIND_NOT_FOUND &&
+                indexes[4] == 0 && indexes[5] == 9,
+                "lfind32_index_batch should return the first index of each key");
+    TEST_ASSERT(lfind32_batch(probes, 0, bucket, bucket_size, bitmap) == 0,
+                "lfind32_batch should handle an empty batch");
+    
+    /*
+     * Compare with lfind32_index for every array size up to a few vectors
+     * and a large one, with batches that do not fill the last key group.
+     */
+    const uint32_t max_size = 2000;
+    const uint32_t nkeys = 37;
+    uint32_t *array = malloc(max_size * sizeof(uint32_t));
+    uint32_t keys[37];
+    uint32_t key_indexes[37];
+    uint8_t key_bitmap[LFIND_BITMAP_BYTES(37)];
+    int mismatches = 0;
+    
+    srand(23);
+    for (uint32_t i = 0; i < max_size; i++) {
+        array[i] = (uint32_t)(rand() % 500);
+    }
+    for (uint32_t size = 0; size <= max_size; size += (size < 80 ? 1 : 959)) {
+        for (uint32_t k = 0; k < nkeys; k++) {
+            keys[k] = (uint32_t)(rand() % 700);
+        }
+        
+        uint32_t nfound = lfind32_index_batch(keys, nkeys, array, size, key_indexes);
+        uint32_t nfound_bitmap = lfind32_batch(keys, nkeys, array, size, key_bitmap);
+        uint32_t expected_found = 0;
+        
+        for (uint32_t k = 0; k < nkeys; k++) {
+            uint32_t expected = lfind32_index(keys[k], array, size);
+            bool bit = (key_bitmap[k / 8] >> (k % 8)) & 1;
+            
+            if (expected != LFIND_NOT_FOUND) {
+                expected_found++;
+            }
+            if (key_indexes[k] != expected || bit != (expected != LFIND_NOT_FOUND)) {
+                printf("FAIL: batch mismatch for size %u key %u\n", size, keys[k]);
+                mismatches++;
+            }
+        }
+        if (nfound != expected_found || nfound_bitmap != expected_found) {
+            printf("FAIL: batch count mismatch for size %u\n", size);
+            mismatches++;
+        }
+        if (key_bitmap[LFIND_BITMAP_BYTES(nkeys) - 1] >> (nkeys % 8) != 0) {
+            printf("FAIL: batch bitmap padding set for size %u\n", size);
+            mismatches++;
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "batch lookups should match lfind32_index for all sizes");
+
+    free(array);
+}
+
+/* Test the select kernels */
+void test_select(void)
+{
+    printf("\n=== Testing select ===\n");
+
+    uint32_t column[] = {5, 9, 2, 9, 1, 9, 7};
+    uint8_t bytes[] = {'b', 'a', 'd', 'a', 'c', 'e'};
+    uint32_t rows[8];
+    uint32_t values[8];
+    uint8_t small[8];
+
+    TEST_ASSERT(select32(9, column, 7, rows) == 3 &&
+                rows[0] == 1 && rows[1] == 3 && rows[2] == 5,
+                "select32 should write the indexes of the matches");
+    TEST_ASSERT(select32_le(5, column, 7, values) == 3 &&
+                values[0] == 5 && values[1] == 2 && values[2] == 1,
+                "select32_le should write the matching elements in order");
+    TEST_ASSERT(select8_le('b', bytes, 6, small) == 3 && memcmp(small, "baa", 3) == 0,
+                "select8_le should write the matching elements in order");
+    TEST_ASSERT(select8('z', bytes, 6, rows) == 0 && select32(9, column, 0, rows) == 0,
+                "select should handle no matches and empty arrays");
+
+    /*
+     * Compare with scalar selection for every array size up to a few
+     * vectors, and a large one, at low and high selectivity.  A guard entry
+     * after the first 'size' of the output must survive.
+     */
+    const uint32_t max_size = 3000;
+    uint32_t *array32 = malloc(max_size * sizeof(uint32_t));
+    uint8_t *array8 = malloc(max_size);
+    uint32_t *out32 = malloc((max_size + 1) * sizeof(uint32_t));
+    uint8_t *out8 = malloc(max_size + 1);
+    uint32_t *expected32 = malloc(max_size * sizeof(uint32_t));
+    uint8_t *expected8 = malloc(max_size);
+    int mismatches = 0;
+
+    srand(89);
+    for (uint32_t i = 0; i < max_size; i++) {
+        array32[i] = (uint32_t)(rand() % 50) * 0x01010101u;
+        array8[i] = (uint8_t)(rand() % 50);
+    }
+    for (uint32_t size = 0; size <= max_size; size += (size < 200 ? 1 : 1399)) {
+        for (int pass = 0; pass < 6; pass++) {
+            uint32_t key = (uint32_t)(rand() % 50);
+            uint32_t key32 = key * 0x01010101u;
+            bool le = pass >= 2;
+            bool indexes = pass < 2 || pass >= 4;
+            bool wide = pass % 2;
+            uint32_t expected = 0;
+            uint32_t n;
+
+            for (uint32_t i = 0; i < size; i++) {
+                bool match = wide ? (le ? array32[i] <= key32 : array32[i] == key32)
+                                  : (le ? array8[i] <= key : array8[i] == key);
+
+                if (match && (indexes || wide)) {
+                    expected32[expected++] = indexes ? i : array32[i];
+                } else if (match) {
+                    expected8[expected++] = array8[i];
+                }
+            }
+            out32[size] = 0xDEADBEEF;
+            out8[size] = 0xA5;
+
+            if (!le) {
+                n = wide ? select32(key32, array32, size, out32)
+                         : select8((uint8_t) key, array8, size, out32);
+            } else if (indexes) {
+                n = wide ? select32_le_index(key32, array32, size, out32)
+                         : select8_le_index((uint8_t) key, array8, size, out32);
+            } else {
+                n = wide ? select32_le(key32, array32, size, out32)
+                         : select8_le((uint8_t) key, array8, size, out8);
+            }
+
+            if (n != expected ||
+                (!wide && !indexes ? memcmp(out8, expected8, n) != 0 || out8[size] != 0xA5
+                                   : memcmp(out32, expected32, n * sizeof(uint32_t)) != 0 ||
+                                     out32[size] != 0xDEADBEEF)) {
+                printf("FAIL: select mismatch for size %u pass %d\n", size, pass);
+                mismatches++;
+            }
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "select should match scalar selection for all sizes");
+
+    free(array32);
+    free(array8);
+    free(out32);
+    free(out8);
+    free(expected32);
+    free(expected8);
+}
+
+/* Test the bitmap combinators */
+void test_bitmaps(void)
+{
+    printf("\n=== Testing bitmap combinators ===\n");
+
+    /* rows where both columns match, from the bitmaps of lfind32_mask */
+    uint32_t price[] = {3, 5, 3, 3, 8, 3, 1, 3, 3, 2};
+    uint32_t region[] = {7, 7, 2, 7, 7, 7, 7, 2, 7, 7};
+    uint8_t price_bits[LFIND_BITMAP_BYTES(10)];
+    uint8_t region_bits[LFIND_BITMAP_BYTES(10)];
+    uint8_t both[LFIND_BITMAP_BYTES(10)];
+
+    lfind32_mask(3, price, 10, price_bits);
+    lfind32_mask(7, region, 10, region_bits);
+    TEST_ASSERT(simd_bitmap_and(both, price_bits, region_bits, sizeof(both)) == both &&
+                both[0] == 0x29 && both[1] == 0x01 && simd_bitmap_count(both, sizeof(both)) == 4,
+                "simd_bitmap_and should combine the bitmaps of two columns");
+    TEST_ASSERT(simd_bitmap_any(both, sizeof(both)) && !simd_bitmap_any(both, 0) &&
+                simd_bitmap_count(both, 0) == 0,
+                "simd_bitmap_any should find a set bit");
+
+    /*
+     * Compare with scalar loops for every size up to a few blocks and a
+     * large one, at every offset within a word, in and out of place.  A
+     * guard byte after the output must survive.
+     */
+    const size_t max_size = 5000;
+    uint8_t *a = malloc(max_size + 8);
+    uint8_t *b = malloc(max_size + 8);
+    uint8_t *out = malloc(max_size + 9);
+    uint8_t *expected = malloc(max_size);
+    uint8_t *(*const combine[4])(uint8_t *, const uint8_t *, const uint8_t *, size_t) = {
+        simd_bitmap_and, simd_bitmap_or, simd_bitmap_xor, simd_bitmap_andnot
+    };
+    int mismatches = 0;
+
+    srand(97);
+    for (size_t size = 0; size <= max_size; size += (size < 300 ? 1 : 2351)) {
+        size_t offset = size % 8;
+        uint64_t count = 0;
+
+        for (size_t i = 0; i < size + 8; i++) {
+            a[i] = (uint8_t) rand();
+            b[i] = (uint8_t) rand();
+        }
+        for (int op = 0; op < 4; op++) {
+            for (size_t i = 0; i < size; i++) {
+                uint8_t x = a[offset + i];
+                uint8_t y = b[offset + i];
+
+                expected[i] = (uint8_t)(op == 0 ? x & y : op == 1 ? x | y :
+                                        op == 2 ? x ^ y : x & ~y);
+            }
+            out[offset + size] = 0xA5;
+            combine[op](out + offset, a + offset, b + offset, size);
+            mismatches += memcmp(out + offset, expected, size) != 0 || out[offset + size] != 0xA5;
+
+            /* in place, into the first input */
+            memcpy(out + offset, a + offset, size);
+            combine[op](out + offset, out + offset, b + offset, size);
+            mismatches += memcmp(out + offset, expected, size) != 0 || out[offset + size] != 0xA5;
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            count += (uint64_t) __builtin_popcount(a[offset + i]);
+        }
+        mismatches += simd_bitmap_count(a + offset, size) != count;
+
+        /* a single bit anywhere, with set bits right outside the buffer */
+        memset(out, 0xFF, size + 9);
+        memset(out + offset, 0, size);
+        mismatches += simd_bitmap_any(out + offset, size);
+        if (size > 0) {
+            size_t bit = (size_t) rand() % (size * 8);
+
+            out[offset + bit / 8] = (uint8_t)(1 << (bit % 8));
+            mismatches += !simd_bitmap_any(out + offset, size) ||
+                simd_bitmap_count(out + offset, size) != 1;
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "bitmap combinators should match scalar loops for all sizes");
+
+    free(a);
+    free(b);
+    free(out);
+    free(expected);
+}
+
+/* Test lfind16 function */
+void test_lfind16(void)
+{
+    printf("\n=== Testing lfind16 ===\n");
+    
+    uint16_t small_array[] = {10, 300, 5000, 70, 65535, 0, 130, 150};
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
+    
+    TEST_ASSERT(lfind16(5000, small_array, small_size) == true,
+                "lfind16 should find existing element 5000");
+    TEST_ASSERT(lfind16(65535, small_array, small_size) == true,
+                "lfind16 should find maximum uint16 value");
+    TEST_ASSERT(lfind16(0, small_array, small_size) == true,
+                "lfind16 should find minimum uint16 value");
+    TEST_ASSERT(lfind16(5001, small_array, small_size) == false,
+                "lfind16 should not find non-existing element");
+    /* 0x0A00 shares its low byte with nothing, its high byte with 10 */
+    TEST_ASSERT(lfind16(0x0A00, small_array, small_size) == false,
+                "lfind16 should compare whole 16-bit lanes");
+    TEST_ASSERT(lfind16(5, NULL, 0) == false,
+                "lfind16 should return false for empty array");
+    
+    int mismatches = 0;
+    for (uint32_t size = 1; size <= 300; size++) {
+        uint16_t *test_array = malloc(size * sizeof(uint16_t));
+        
+        for (uint32_t i = 0; i < size; i++) {
+            test_array[i] = (uint16_t)(i * 3 + 1);
+        }
+        if (!lfind16(1, test_array, size) ||
+            !lfind16((uint16_t)((size - 1) * 3 + 1), test_array, size) ||
+            lfind16((uint16_t)(size * 3 + 1), test_array, size)) {
+            mismatches++;
+        }
+        
+        free(test_array);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind16 should handle every array size up to 300");
+}
+
+/* Test lfind64 function */
+void test_lfind64(void)
+{
+    printf("\n=== Testing lfind64 ===\n");
+    
+    uint64 small_array[] = {
+        UINT64_C(0x1234567800000001),
+        UINT64_C(0x0000000112345678),
+        UINT64_C(0xFFFFFFFFFFFFFFFF),
+        0,
+        UINT64_C(42)
+    };
+    uint32_t small_size = sizeof(small_array) / sizeof(small_array[0]);
+    
+    TEST_ASSERT(lfind64(UINT64_C(0x1234567800000001), small_array, small_size) == true,
+                "lfind64 should find existing element");
+    TEST_ASSERT(lfind64(UINT64_C(0xFFFFFFFFFFFFFFFF), small_array, small_size) == true,
+                "lfind64 should find maximum uint64 value");
+    TEST_ASSERT(lfind64(42, small_array, small_size) == true,
+                "lfind64 should find last element");
+    /* keys matching only one 32-bit half of an element */
+    TEST_ASSERT(lfind64(UINT64_C(0x1234567800000000), small_array, small_size) == false,
+                "lfind64 should not match on the high half alone");
+    TEST_ASSERT(lfind64(UINT64_C(0x0000000012345678), small_array, small_size) == false,
+                "lfind64 should not match on the low half alone");
+    TEST_ASSERT(lfind64(5, NULL, 0) == false,
+                "lfind64 should return false for empty array");
+    
+    int mismatches = 0;
+    for (uint32_t size = 1; size <= 200; size++) {
+        uint64 *test_array = calloc(size, sizeof(uint64));
+        uint64 key = UINT64_C(0x8000000000000001);
+        
+        for (uint32_t pos = 0; pos < size; pos++) {
+            test_array[pos] = key;
+            if (!lfind64(key, test_array, size)) {
+                mismatches++;
+            }
+            /* half matches must not count */
+            test_array[pos] = key & UINT64_C(0xFFFFFFFF00000000);
+            if (lfind64(key, test_array, size)) {
+                mismatches++;
+            }
+            test_array[pos] = 0;
+        }
+        
+        free(test_array);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind64 should find a key at every position");
+}
+
+/*
+ * Test the vector tail handling.  Arrays are placed so they end right at an
+ * inaccessible page, where any over-read would crash, and at the start of a
+ * page whose remaining bytes all match the key, where any unmasked lane
+ * past the end would give a wrong answer.
+ */
+void test_tail_handling(void)
+{
+    printf("\n=== Testing Tail Handling ===\n");
+    
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *pages = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    
+    if (pages == MAP_FAILED) {
+        TEST_ASSERT(false, "mmap for tail handling tests");
+        return;
+    }
+    mprotect(pages + page_size, page_size, PROT_NONE);
+    
+    int mismatches = 0;
+    
+    for (int placement = 0; placement < 2; placement++) {
+        for (uint32_t nelem = 0; nelem <= 140; nelem++) {
+            uint8_t *end = pages + page_size;
+            uint8_t *b8 = placement ? pages : end - nelem;
+            uint16_t *b16 = placement ? (uint16_t *) pages : (uint16_t *) end - nelem;
+            uint32_t *b32 = placement ? (uint32_t *) pages : (uint32_t *) end - nelem;
+            uint64 *b64 = placement ? (uint64 *) pages : (uint64 *) end - nelem;
+            /* the padded variants may only be used away from the guard page */
+            uint32_t padded_nelem = placement ? nelem : 0;
+            uint8_t bitmap[LFIND_BITMAP_BYTES(140)];
+            uint8_t keys8[6] = {1, 2, 3, 4, 5, 0xAA};
+            uint32_t keys32[2] = {1, 0xAAAAAAAA};
+            
+            /* everything around the arrays matches the keys 0xAA... */
+            memset(pages, 0xAA, page_size);
+            for (uint32_t i = 0; i < nelem; i++) {
+                b8[i] = (uint8_t)(i % 100 + 10);
+            }
+            mismatches += lfind8(0xAA, b8, nelem) != false;
+            mismatches += lfind8_padded(0xAA, b8, padded_nelem) != false;
+            mismatches += lfind8_le(9, b8, nelem) != false;
+            mismatches += lfind8_index(0xAA, b8, nelem) != LFIND_NOT_FOUND;
+            mismatches += lfind8_count(0xAA, b8, nelem) != 0;
+            mismatches += lfind8_mask(0xAA, b8, nelem, bitmap) != 0;
+            mismatches += lfind8_any(keys8, 6, b8, nelem) != false;
+            mismatches += lfind8_any(keys8 + 4, 2, b8, nelem) != false;
+            mismatches += lfind8_between(0xAA, 0xFF, b8, nelem) != false;
+            if (nelem > 0) {
+                uint8_t last = b8[nelem - 1];
+                
+                mismatches += lfind8(last, b8, nelem) != true;
+                mismatches += lfind8_index(last, b8, nelem) != (nelem - 1) % 100;
+                mismatches += lfind8_count(last, b8, nelem) != 1 + (nelem - 1) / 100;
+            }
+            
+            memset(pages, 0xAA, page_size);
+            for (uint32_t i = 0; i < nelem; i++) {
+                b16[i] = (uint16_t)(i + 1);
+            }
+            mismatches += lfind16(0xAAAA, b16, nelem) != false;
+            mismatches += lfind16_between(0xAAAA, 0xFFFF, b16, nelem) != false;
+            if (nelem > 0) {
+                mismatches += lfind16((uint16_t) nelem, b16, nelem) != true;
+            }
+            
+            memset(pages, 0xAA, page_size);
+            for (uint32_t i = 0; i < nelem; i++) {
+                b32[i] = i + 2;
+            }
+            mismatches += lfind32(0xAAAAAAAA, b32, nelem) != false;
+            mismatches += lfind32_padded(0xAAAAAAAA, b32, padded_nelem) != false;
+            mismatches += lfind32_index(0xAAAAAAAA, b32, nelem) != LFIND_NOT_FOUND;
+            mismatches += lfind32_count(0xAAAAAAAA, b32, nelem) != 0;
+            mismatches += lfind32_mask(0xAAAAAAAA, b32, nelem, bitmap) != 0;
+            mismatches += lfind32_any(keys32, 2, b32, nelem) != false;
+            mismatches += lfind32_between(0xAAAAAAAA, 0xFFFFFFFF, b32, nelem) != false;
+            mismatches += lfind32_batch(keys32, 2, b32, nelem, bitmap) != 0;
+            if (nelem > 0) {
+                uint32_t last = nelem + 1;
+                
+                mismatches += lfind32(last, b32, nelem) != true;
+                mismatches += lfind32_padded(last, b32, padded_nelem) != (placement != 0);
+                mismatches += lfind32_index(last, b32, nelem) != nelem - 1;
+                mismatches += lfind32_count(last, b32, nelem) != 1;
+                mismatches += lfind32_mask(last, b32, nelem, bitmap) != 1;
+                mismatches += ((bitmap[(nelem - 1) / 8] >> ((nelem - 1) % 8)) & 1) != 1;
+            }
+            
+            memset(pages, 0xAA, page_size);
+            for (uint32_t i = 0; i < nelem; i++) {
+                b64[i] = i + 3;
+            }
+            mismatches += lfind64(UINT64_C(0xAAAAAAAAAAAAAAAA), b64, nelem) != false;
+            if (nelem > 0) {
+                mismatches += lfind64(nelem + 2, b64, nelem) != true;
+            }
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "tails should be masked and never read past the end of a page");
+    
+    munmap(pages, 2 * page_size);
+}
+
+/* Test the padded-buffer variants, whose last vector may cover the padding */
+void test_padded(void)
+{
+    printf("\n=== Testing Padded Variants ===\n");
+    
+    uint8_t bytes[100 + LFIND_PADDING];
+    uint32_t words[100 + LFIND_PADDING / 4];
+    int mismatches = 0;
+    
+    /* the padding matches the key, which must not be reported */
+    memset(bytes, 7, sizeof(bytes));
+    for (uint32_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        words[i] = 7;
+    }
+    for (uint32_t nelem = 0; nelem <= 100; nelem++) {
+        if (nelem > 0) {
+            bytes[nelem - 1] = 1;
+            words[nelem - 1] = 1;
+        }
+        mismatches += lfind8_padded(7, bytes, nelem) != false;
+        mismatches += lfind32_padded(7, words, nelem) != false;
+        mismatches += lfind8_padded(1, bytes, nelem) != (nelem > 0);
+        mismatches += lfind32_padded(1, words, nelem) != (nelem > 0);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "padded variants should ignore the padding");
+}
+
+/* Test the multi-threaded scans against the single-threaded kernels */
+void test_parallel(void)
+{
+    printf("\n=== Testing Parallel Scans ===\n");
+    
+    const uint32_t size = 300000;
+    uint8_t *bytes = malloc(size);
+    uint32_t *words = malloc(size * sizeof(uint32_t));
+    uint8_t *bitmap = malloc(LFIND_BITMAP_BYTES(size));
+    uint8_t *expected_bitmap = malloc(LFIND_BITMAP_BYTES(size));
+    LfindPool *pool = lfind_pool_create(3);
+    int mismatches = 0;
+    
+    TEST_ASSERT(pool != NULL, "lfind_pool_create should start a pool");
+    
+    srand(31);
+    for (uint32_t i = 0; i < size; i++) {
+        bytes[i] = (uint8_t)(rand() % 200);
+        words[i] = (uint32_t)(rand() % 100000);
+    }
+    
+    /* small chunks so that the arrays are split many ways */
+    lfind_pool_set_chunk_size(pool, 4096);
+    
+    for (uint32_t nelem = 0; nelem <= size; nelem += (nelem < 20000 ? 4999 : 70001)) {
+        uint8_t key8 = (uint8_t)(rand() % 256);
+        uint32_t key32 = (uint32_t)(rand() % 150000);
+        
+        mismatches += lfind8_parallel(key8, bytes, nelem, pool) != lfind8(key8, bytes, nelem);
+        mismatches += lfind32_parallel(key32, words, nelem, pool) != lfind32(key32, words, nelem);
+        mismatches += lfind8_count_parallel(key8, bytes, nelem, pool) !=
+            lfind8_count(key8, bytes, nelem);
+        mismatches += lfind32_count_parallel(key32, words, nelem, NULL) !=
+            lfind32_count(key32, words, nelem);
+        
+        mismatches += lfind8_mask_parallel(key8, bytes, nelem, bitmap, pool) !=
+            lfind8_mask(key8, bytes, nelem, expected_bitmap);
+        mismatches += memcmp(bitmap, expected_bitmap, LFIND_BITMAP_BYTES(nelem)) != 0;
+        mismatches += lfind32_mask_parallel(key32, words, nelem, bitmap, pool) !=
+            lfind32_mask(key32, words, nelem, expected_bitmap);
+        mismatches += memcmp(bitmap, expected_bitmap, LFIND_BITMAP_BYTES(nelem)) != 0;
+    }
+    TEST_ASSERT(mismatches == 0,
+                "parallel scans should match the single-threaded kernels");
+    
+    /* a match in the last chunk only, and no match at all */
+    words[size - 1] = 200000;
+    TEST_ASSERT(lfind32_parallel(200000, words, size, pool) == true,
+                "lfind32_parallel should find a key in the last chunk");
+    TEST_ASSERT(lfind32_parallel(200001, words, size, pool) == false,
+                "lfind32_parallel should not find an absent key");
+    TEST_ASSERT(lfind8_parallel(255, bytes, size, NULL) == false,
+                "lfind8_parallel should work with the default pool");
+    
+    lfind_pool_destroy(pool);
+    free(bytes);
+    free(words);
+    free(bitmap);
+    free(expected_bitmap);
+}
+
+/* Reference scans for the byte scanners */
+static const uint8_t *linear_memchr3(const uint8_t *s, int c1, int c2, int c3, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == (uint8_t) c1 || s[i] == (uint8_t) c2 || s[i] == (uint8_t) c3) {
+            return &s[i];
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *linear_memrchr(const uint8_t *s, int c, size_t n)
+{
+    while (n > 0) {
+        if (s[--n] == (uint8_t) c) {
+            return &s[n];
+        }
+    }
+    return NULL;
+}
+
+/* Test simd_memchr, simd_memrchr, simd_memchr2/3 and simd_strlen */
+void test_bytescan(void)
+{
+    printf("\n=== Testing Byte Scanners ===\n");
+    
+    const char *line = "GET /index.html HTTP/1.1\r\n";
+    
+    TEST_ASSERT(simd_memchr(line, ' ', strlen(line)) == line + 3,
+                "simd_memchr should find the first space");
+    TEST_ASSERT(simd_memrchr(line, ' ', strlen(line)) == line + 15,
+                "simd_memrchr should find the last space");
+    TEST_ASSERT(simd_memchr2(line, '\r', '\n', strlen(line)) == line + 24,
+                "simd_memchr2 should find the line ending");
+    TEST_ASSERT(simd_memchr3(line, '?', '#', '.', strlen(line)) == line + 10,
+                "simd_memchr3 should find the first of three bytes");
+    TEST_ASSERT(simd_memchr(line, 'z', strlen(line)) == NULL,
+                "simd_memchr should return NULL for an absent byte");
+    TEST_ASSERT(simd_memchr(line, 'G', 0) == NULL,
+                "simd_memchr should return NULL for an empty buffer");
+    TEST_ASSERT(simd_strlen(line) == strlen(line),
+                "simd_strlen should match strlen");
+    TEST_ASSERT(simd_strlen("") == 0,
+                "simd_strlen should handle the empty string");
+    
+    /*
+     * Every start alignment and length up to a few blocks, with needles at
+     * random places both inside and just outside the buffer.
+     */
+    uint8_t buffer[600];
+    int mismatches = 0;
+    
+    srand(41);
+    for (int trial = 0; trial < 3000; trial++) {
+        size_t offset = (size_t)(rand() % 64);
+        size_t n = (size_t)(rand() % (sizeof(buffer) - 64 - 2)) + (trial % 2 ? 0 : 1);
+        uint8_t *s = buffer + offset + 1;
+        int c = 'a' + rand() % 3;
+        
+        for (size_t i = 0; i < sizeof(buffer); i++) {
+            buffer[i] = (uint8_t)('d' + rand() % 20);
+        }
+        /* needles right before and after the buffer must not be found */
+        s[-1] = (uint8_t) c;
+        s[n] = (uint8_t) c;
+        for (int k = rand() % 3; k > 0 && n > 0; k--) {
+            s[rand() % n] = (uint8_t)('a' + rand() % 3);
+        }
+        
+        mismatches += (const uint8_t *) simd_memchr(s, c, n) != linear_memchr3(s, c, c, c, n);
+        mismatches += (const uint8_t *) simd_memrchr(s, c, n) != linear_memrchr(s, c, n);
+        mismatches += (const uint8_t *) simd_memchr2(s, 'a', 'b', n) !=
+            linear_memchr3(s, 'a', 'b', 'b', n);
+        mismatches += (const uint8_t *) simd_memchr3(s, 'a', 'b', 'c', n) !=
+            linear_memchr3(s, 'a', 'b', 'c', n);
+        
+        s[n] = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (s[i] == 0) {
+                s[i] = 1;
+            }
+        }
+        mismatches += simd_strlen((const char *) s) != n;
+    }
+    TEST_ASSERT(mismatches == 0,
+                "byte scanners should match reference scans for all alignments");
+    
+    /* strings and buffers that end right before an inaccessible page */
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *pages = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    
+    if (pages != MAP_FAILED) {
+        mprotect(pages + page_size, page_size, PROT_NONE);
+        memset(pages, 'x', page_size);
+        pages[page_size - 1] = 0;
+        
+        mismatches = 0;
+        for (size_t len = 0; len < 300; len++) {
+            char *str = pages + page_size - 1 - len;
+            
+            mismatches += simd_strlen(str) != len;
+            mismatches += simd_memchr(str, 'y', len + 1) != NULL;
+            mismatches += simd_memrchr(pages, 'y', page_size) != NULL;
+            mismatches += simd_memchr3(str, 'y', 'z', 0, len + 1) != str + len;
+        }
+        TEST_ASSERT(mismatches == 0,
+                    "byte scanners should not read past the end of a page");
+        munmap(pages, 2 * page_size);
+    }
+}
+
+/* UTF-8 validation by decoding each code point, for comparison */
+static bool reference_utf8_validate(const uint8_t *s, size_t n)
+{
+    static const uint32_t min_code[5] = {0, 0, 0x80, 0x800, 0x10000};
+    size_t i = 0;
+
+    while (i < n) {
+        uint32_t code;
+        size_t len;
+
+        if (s[i] < 0x80) {
+            i++;
+            continue;
+        }
+        if ((s[i] & 0xE0) == 0xC0) {
+            len = 2;
+            code = s[i] & 0x1F;
+        } else if ((s[i] & 0xF0) == 0xE0) {
+            len = 3;
+            code = s[i] & 0x0F;
+        } else if ((s[i] & 0xF8) == 0xF0) {
+            len = 4;
+            code = s[i] & 0x07;
+        } else {
+            return false;
+        }
+        if (n - i < len) {
+            return false;
+        }
+        for (size_t j = 1; j < len; j++) {
+            if ((s[i + j] & 0xC0) != 0x80) {
+                return false;
+            }
+            code = (code << 6) | (s[i + j] & 0x3F);
+        }
+        if (code < min_code[len] || code > 0x10FFFF ||
+            (code >= 0xD800 && code <= 0xDFFF)) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+/* Append the UTF-8 encoding of 'code' to 's', returning its length */
+static size_t encode_utf8(uint8_t *s, uint32_t code)
+{
+    if (code < 0x80) {
+        s[0] = (uint8_t) code;
+        return 1;
+    }
+    if (code < 0x800) {
+        s[0] = (uint8_t)(0xC0 | (code >> 6));
+        s[1] = (uint8_t)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        s[0] = (uint8_t)(0xE0 | (code >> 12));
+        s[1] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+        s[2] = (uint8_t)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    s[0] = (uint8_t)(0xF0 | (code >> 18));
+    s[1] = (uint8_t)(0x80 | ((code >> 12) & 0x3F));
+    s[2] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+    s[3] = (uint8_t)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+/* Test simd_is_ascii, simd_utf8_validate and simd_find_byte_class */
+void test_text_scans(void)
+{
+    printf("\n=== Testing Text Scans ===\n");
+
+    const char *latin = "na\xc3\xafve caf\xc3\xa9 \xe2\x82\xac 5 \xf0\x9f\x98\x80";
+
+    TEST_ASSERT(simd_is_ascii("plain text, no accents", 22) &&
+                !simd_is_ascii(latin, strlen(latin)) && simd_is_ascii(latin, 2),
+                "simd_is_ascii should find the first non-ASCII byte");
+    TEST_ASSERT(simd_utf8_validate(latin, strlen(latin)) && simd_utf8_validate("", 0),
+                "simd_utf8_validate should accept well-formed text");
+    TEST_ASSERT(!simd_utf8_validate(latin, strlen(latin) - 1) &&
+                !simd_utf8_validate(latin, 3),
+                "simd_utf8_validate should reject a sequence cut off at the end");
+    TEST_ASSERT(!simd_utf8_validate("\xc0\xaf", 2) && !simd_utf8_validate("\xe0\x80\xaf", 3) &&
+                !simd_utf8_validate("\xf0\x80\x80\xaf", 4),
+                "simd_utf8_validate should reject overlong forms");
+    TEST_ASSERT(!simd_utf8_validate("\xed\xa0\x80", 3) && simd_utf8_validate("\xed\x9f\xbf", 3),
+                "simd_utf8_validate should reject surrogates");
+    TEST_ASSERT(!simd_utf8_validate("\xf4\x90\x80\x80", 4) &&
+                simd_utf8_validate("\xf4\x8f\xbf\xbf", 4) && !simd_utf8_validate("\xf8", 1),
+                "simd_utf8_validate should reject code points above U+10FFFF");
+
+    /*
+     * Mostly valid text of random code points, mixing ASCII runs with two-
+     * to four-byte sequences, with a few random bytes overwritten in half
+     * of the trials, at every offset and length.
+     */
+    static const uint32_t code_limit[4] = {0x80, 0x800, 0x10000, 0x110000};
+    uint8_t buffer[700];
+    uint8_t set[32];
+    SimdByteClass cls;
+    int mismatches = 0;
+
+    /* the bytes a JSON string must escape */
+    memset(set, 0, sizeof(set));
+    for (int c = 0; c < 256; c++) {
+        if (c < 0x20 || c == '"' || c == '\\') {
+            set[c >> 3] |= (uint8_t)(1 << (c & 7));
+        }
+    }
+    simd_byte_class_init(&cls, set);
+    TEST_ASSERT(simd_find_byte_class(&cls, "say \\\"hi\\\"\n", 11) == 4 &&
+                simd_find_byte_class(&cls, "plain", 5) == 5 &&
+                simd_find_byte_class(&cls, "", 0) == 0,
+                "simd_find_byte_class should find the first byte in the class");
+
+    srand(59);
+    for (int trial = 0; trial < 4000; trial++) {
+        size_t offset = (size_t)(rand() % 64);
+        uint8_t *s = buffer + offset;
+        size_t n = 0;
+        size_t limit = (size_t)(rand() % (sizeof(buffer) - 64 - 4));
+
+        while (n < limit) {
+            uint32_t code;
+
+            /* printable ASCII only in a quarter of the trials */
+            if (trial % 4 == 0 || rand() % 8 < 5) {
+                code = 0x20 + (uint32_t) rand() % 0x60;
+            } else {
+                code = (uint32_t) rand() % code_limit[rand() % 4];
+            }
+            if (code >= 0xD800 && code <= 0xDFFF) {
+                code = 'x';
+            }
+            n += encode_utf8(&s[n], code);
+        }
+        if (trial % 2) {
+            for (int k = rand() % 3; k >= 0 && n > 0; k--) {
+                s[rand() % n] = (uint8_t)(rand() % 256);
+            }
+        }
+        /* cut off anywhere, possibly inside a sequence */
+        if (trial % 3 == 0 && n > 0) {
+            n -= (size_t)(rand() % 4) % n;
+        }
+
+        mismatches += simd_utf8_validate(s, n) != reference_utf8_validate(s, n);
+        size_t first_high = 0;
+        size_t first_member = 0;
+
+        while (first_high < n && s[first_high] < 0x80) {
+            first_high++;
+        }
+        while (first_member < n && !(set[s[first_member] >> 3] & (1 << (s[first_member] & 7)))) {
+            first_member++;
+        }
+        mismatches += simd_is_ascii(s, n) != (first_high == n);
+        mismatches += simd_find_byte_class(&cls, s, n) != first_member;
+    }
+    TEST_ASSERT(mismatches == 0,
+                "text scans should match reference scans for all offsets");
+
+    /* buffers that end right before an inaccessible page */
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *pages = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (pages != MAP_FAILED) {
+        mprotect(pages + page_size, page_size, PROT_NONE);
+        for (long i = 0; i + 3 <= page_size; i += 3) {
+            encode_utf8(&pages[i], 0x20AC);
+        }
+        memset(pages + page_size - page_size % 3, 'x', page_size % 3);
+
+        mismatches = 0;
+        for (size_t len = 0; len < 300; len++) {
+            uint8_t *s = pages + page_size - len;
+
+            mismatches += simd_utf8_validate(s, len) != reference_utf8_validate(s, len);
+            mismatches += simd_is_ascii(s, len) != (len <= (size_t)(page_size % 3));
+            mismatches += simd_find_byte_class(&cls, s, len) != len;
+        }
+        TEST_ASSERT(mismatches == 0,
+                    "text scans should not read past the end of a page");
+        munmap(pages, 2 * page_size);
+    }
+}
+
+/* Standard substring search for comparison */
+static uint32_t linear_substr(const uint8_t *needle, uint32_t nlen,
+                              const uint8_t *haystack, uint32_t hlen)
+{
+    for (uint32_t i = 0; i + nlen <= hlen; i++) {
+        if (memcmp(&haystack[i], needle, nlen) == 0) {
+            return i;
+        }
+    }
+    return LFIND_NOT_FOUND;
+}
+
+/* Test lfind_substr */
+void test_lfind_substr(void)
+{
+    printf("\n=== Testing lfind_substr ===\n");
+    
+    const uint8_t *log_line = (const uint8_t *)
+        "2024-05-01 12:00:03 host=db7 level=ERROR msg=\"connection reset\"";
+    uint32_t log_len = (uint32_t) strlen((const char *) log_line);
+    
+    TEST_ASSERT(lfind_substr((const uint8_t *) "ERROR", 5, log_line, log_len) == 35,
+                "lfind_substr should return the offset of a token");
+    TEST_ASSERT(lfind_substr((const uint8_t *) "WARN", 4, log_line, log_len) == LFIND_NOT_FOUND,
+                "lfind_substr should return LFIND_NOT_FOUND for an absent token");
+    TEST_ASSERT(lfind_substr((const uint8_t *) "reset\"", 6, log_line, log_len) == log_len - 6,
+                "lfind_substr should find a match at the very end");
+    TEST_ASSERT(lfind_substr((const uint8_t *) "2024", 4, log_line, log_len) == 0,
+                "lfind_substr should find a match at the start");
+    TEST_ASSERT(lfind_substr((const uint8_t *) "x", 0, log_line, log_len) == 0,
+                "lfind_substr should match an empty needle at offset 0");
+    TEST_ASSERT(lfind_substr(log_line, log_len, (const uint8_t *) "short", 5) == LFIND_NOT_FOUND,
+                "lfind_substr should not match a needle longer than the haystack");
+    
+    /*
+     * Random haystacks over a tiny alphabet, so first/last byte candidates
+     * are common and most fail verification.
+     */
+    uint8_t haystack[400];
+    uint8_t needle[20];
+    int mismatches = 0;
+    
+    srand(43);
+    for (int trial = 0; trial < 4000; trial++) {
+        uint32_t hlen = (uint32_t)(rand() % 300);
+        uint32_t nlen = (uint32_t)(rand() % 12) + 1;
+        uint32_t offset = (uint32_t)(rand() % 64);
+        
+        for (uint32_t i = 0; i < sizeof(haystack); i++) {
+            haystack[i] = (uint8_t)('a' + rand() % 3);
+        }
+        for (uint32_t i = 0; i < nlen; i++) {
+            needle[i] = (uint8_t)('a' + rand() % 3);
+        }
+        if (trial % 2 == 0 && hlen >= nlen) {
+            /* plant the needle at a random offset */
+            memcpy(&haystack[offset + rand() % (hlen - nlen + 1)], needle, nlen);
+        }
+        
+        if (lfind_substr(needle, nlen, haystack + offset, hlen) !=
+            linear_substr(needle, nlen, haystack + offset, hlen)) {
+            printf("FAIL: lfind_substr mismatch for hlen %u nlen %u\n", hlen, nlen);
+            mismatches++;
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind_substr should match a naive search");
+}
+
+/* Test lower_bound32 and lsearch32_sorted */
+void test_sorted_search(void)
+{
+    printf("\n=== Testing lower_bound32 / lsearch32_sorted ===\n");
+    
+    uint32_t ids[] = {3, 8, 8, 8, 15, 42, 100, 0xFFFFFFFF};
+    uint32_t nids = sizeof(ids) / sizeof(ids[0]);
+    
+    TEST_ASSERT(lower_bound32(8, ids, nids) == 1,
+                "lower_bound32 should return the first of equal elements");
+    TEST_ASSERT(lower_bound32(9, ids, nids) == 4,
+                "lower_bound32 should return the insertion index of a missing key");
+    TEST_ASSERT(lower_bound32(0, ids, nids) == 0,
+                "lower_bound32 should return 0 for a key below every element");
+    TEST_ASSERT(lower_bound32(0xFFFFFFFF, ids, nids - 1) == nids - 1,
+                "lower_bound32 should return nelem for a key above every element");
+    TEST_ASSERT(lsearch32_sorted(42, ids, nids) == 5,
+                "lsearch32_sorted should find an existing key");
+    TEST_ASSERT(lsearch32_sorted(43, ids, nids) == LFIND_NOT_FOUND,
+                "lsearch32_sorted should not find a missing key");
+    TEST_ASSERT(lsearch32_sorted(0xFFFFFFFF, ids, nids) == nids - 1,
+                "lsearch32_sorted should find the maximum value");
+    
+    /* sorted arrays with runs of duplicates, against a scalar lower bound */
+    const uint32_t max_size = 3000;
+    uint32_t *array = malloc(max_size * sizeof(uint32_t));
+    int mismatches = 0;
+    
+    srand(47);
+    for (uint32_t size = 0; size <= max_size; size += (size < 150 ? 1 : 397)) {
+        uint32_t value = (uint32_t)(rand() % 3);
+        
+        for (uint32_t i = 0; i < size; i++) {
+            array[i] = value;
+            value += (uint32_t)(rand() % 4);
+        }
+        for (int k = 0; k < 40; k++) {
+            uint32_t key = (k == 0) ? 0 :
+                (k == 1) ? 0xFFFFFFFF :
+                (uint32_t)(rand() % (size * 2 + 5));
+            uint32_t expected = 0;
+            
+            while (expected < size && array[expected] < key) {
+                expected++;
+            }
+            mismatches += lower_bound32(key, array, size) != expected;
+            mismatches += lsearch32_sorted(key, array, size) !=
+                ((expected < size && array[expected] == key) ? expected : LFIND_NOT_FOUND);
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lower_bound32 should match a scalar lower bound for all sizes");
+    
+    free(array);
+}
+
+/* Test the static search tree against lower_bound32 */
+void test_stree(void)
+{
+    printf("\n=== Testing stree32 search tree ===\n");
+    
+    uint32_t ids[] = {3, 8, 8, 8, 15, 42, 100, 0xFFFFFFFF};
+    uint32_t nids = sizeof(ids) / sizeof(ids[0]);
+    Stree32 *tree = stree32_build(ids, nids);
+    
+    TEST_ASSERT(tree != NULL, "stree32_build should build a tree");
+    TEST_ASSERT(stree32_lower_bound(tree, 8) == 1,
+                "stree32_lower_bound should return the first of equal elements");
+    TEST_ASSERT(stree32_lower_bound(tree, 0) == 0,
+                "stree32_lower_bound should return 0 for a key below every element");
+    TEST_ASSERT(stree32_lower_bound(tree, 0xFFFFFFFF) == nids - 1,
+                "stree32_lower_bound should find the maximum value");
+    stree32_free(tree);
+    
+    tree = stree32_build(ids, 0);
+    TEST_ASSERT(tree != NULL && stree32_lower_bound(tree, 5) == 0,
+                "stree32_lower_bound should return 0 on an empty tree");
+    stree32_free(tree);
+    
+    /*
+     * Sizes around node and layer boundaries (16 keys per leaf, 17 children
+     * per node), up to four layers, with runs of duplicates.
+     */
+    const uint32_t sizes[] = {1, 15, 16, 17, 31, 272, 273, 289, 4624, 4625,
+                              4913, 78608, 78609, 100000};
+    const uint32_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    const uint32_t nqueries = 203;
+    uint32_t *array = malloc(100000 * sizeof(uint32_t));
+    uint32_t queries[203];
+    uint32_t results[203];
+    int mismatches = 0;
+    int batch_mismatches = 0;
+    int found_mismatches = 0;
+    
+    srand(53);
+    for (uint32_t s = 0; s < nsizes; s++) {
+        uint32_t size = sizes[s];
+        uint32_t value = (uint32_t)(rand() % 3);
+        uint32_t nfound = 0;
+        
+        for (uint32_t i = 0; i < size; i++) {
+            array[i] = value;
+            value += (uint32_t)(rand() % 4);
+        }
+        tree = stree32_build(array, size);
+        
+        for (uint32_t q = 0; q < nqueries; q++) {
+            uint32_t key = (q == 0) ? 0 :
+                (q == 1) ? 0xFFFFFFFF :
+                (uint32_t)(rand() % (size * 2 + 5));
+            uint32_t expected = lower_bound32(key, array, size);
+            
+            queries[q] = key;
+            mismatches += stree32_lower_bound(tree, key) != expected;
+            nfound += expected < size && array[expected] == key;
+        }
+        
+        found_mismatches +=
+            stree32_lower_bound_batch(tree, queries, nqueries, results) != nfound;
+        for (uint32_t q = 0; q < nqueries; q++) {
+            batch_mismatches += results[q] != lower_bound32(queries[q], array, size);
+        }
+        stree32_free(tree);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "stree32_lower_bound should match lower_bound32 for all sizes");
+    TEST_ASSERT(batch_mismatches == 0,
+                "stree32_lower_bound_batch should match lower_bound32 for all sizes");
+    TEST_ASSERT(found_mismatches == 0,
+                "stree32_lower_bound_batch should count the keys present");
+    
+    free(array);
+}
+
+/* Test arena allocation and reuse across resets */
+void test_arena(void)
+{
+    printf("\n=== Testing Arenas ===\n");
+    
+    const uint32_t nelem = 100000;
+    const uint32_t nkeys = 300;
+    uint32_t *data = malloc(nelem * sizeof(uint32_t));
+    uint32_t *keys = malloc(nkeys * sizeof(uint32_t));
+    uint8_t *expected_bitmap = malloc(LFIND_BITMAP_BYTES(nelem));
+    SimdArena *arena = simd_arena_create(64 * 1024);
+    void *first_pointers[5] = {0};
+    size_t mapped = 0;
+    int mismatches = 0;
+    
+    TEST_ASSERT(arena != NULL, "simd_arena_create should create an arena");
+    
+    srand(89);
+    for (uint32_t i = 0; i < nelem; i++) {
+        data[i] = (uint32_t)(rand() % 1000);
+    }
+    for (uint32_t k = 0; k < nkeys; k++) {
+        keys[k] = (uint32_t)(rand() % 1200);
+    }
+    uint32_t expected_matches = lfind32_mask(7, data, nelem, expected_bitmap);
+    
+    /* the same query three times: the second and third reuse the blocks */
+    for (int query = 0; query < 3; query++) {
+        simd_arena_reset(arena);
+        
+        uint8_t *bitmap = simd_arena_bitmap(arena, nelem);
+        uint32_t *indexes = simd_arena_indexes(arena, nkeys);
+        uint8_t *found = simd_arena_bitmap(arena, nkeys);
+        uint8_t *small = simd_arena_alloc(arena, 3);
+        uint32_t *big = simd_arena_alloc(arena, 3 * 1024 * 1024);
+        void *pointers[5] = {bitmap, indexes, found, small, big};
+        
+        for (int b = 0; b < 5; b++) {
+            mismatches += pointers[b] == NULL ||
+                ((uintptr_t)pointers[b] % SIMD_ALIGNMENT) != 0;
+            if (query == 0) {
+                first_pointers[b] = pointers[b];
+            } else {
+                mismatches += pointers[b] != first_pointers[b];
+            }
+        }
+        if (mismatches > 0) {
+            break;
+        }
+        
+        memset(small, 0x5A, 3);
+        mismatches += lfind32_mask(7, data, nelem, bitmap) != expected_matches;
+        mismatches += memcmp(bitmap, expected_bitmap, LFIND_BITMAP_BYTES(nelem)) != 0;
+        mismatches += lfind32_index_batch(keys, nkeys, data, nelem, indexes) !=
+            lfind32_batch(keys, nkeys, data, nelem, found);
+        for (uint32_t k = 0; k < nkeys; k++) {
+            mismatches += indexes[k] != lfind32_index(keys[k], data, nelem);
+        }
+        
+        /* filling the big buffer must leave the others alone */
+        memset(big, 0xAB, 3 * 1024 * 1024);
+        mismatches += memcmp(bitmap, expected_bitmap, LFIND_BITMAP_BYTES(nelem)) != 0;
+        mismatches += small[0] != 0x5A || small[2] != 0x5A;
+        mismatches += !lfind8_padded(0x5A, small, 3);
+        
+        if (query == 1) {
+            mapped = simd_arena_mapped(arena);
+        } else if (query == 2) {
+            mismatches += simd_arena_mapped(arena) != mapped;
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "arena buffers should be aligned, separate and reused after a reset");
+    
+    TEST_ASSERT(simd_arena_thread() != NULL &&
+                simd_arena_thread() == simd_arena_thread() &&
+                simd_arena_thread() != arena,
+                "simd_arena_thread should return the thread's own arena");
+    
+    simd_arena_destroy(arena);
+    free(data);
+    free(keys);
+    free(expected_bitmap);
+}
+
+/* Keys of generation 'gen' of the shared index: sorted, and tagged with it */
+#define SHARED_INDEX_KEY(gen, i) (((uint32_t)(gen) << 20) | ((uint32_t)(i) * 2))
+
+typedef struct SharedIndexReaderArgs {
+    SimdIndex *index;
+    volatile int *stop;
+    uint32_t reads;
+    uint32_t errors;
+} SharedIndexReaderArgs;
+
+/* Probe the index until told to stop, checking every snapshot is whole */
+static void *shared_index_reader(void *arg)
+{
+    SharedIndexReaderArgs *args = arg;
+    SimdIndexReader *reader = simd_index_reader_register(args->index);
+    uint64 last_version = 0;
+    
+    if (reader == NULL) {
+        args->errors++;
+        return NULL;
+    }
+    while (!__atomic_load_n(args->stop, __ATOMIC_RELAXED)) {
+        const SimdIndexSnapshot *snap = simd_index_read_begin(reader);
+        uint32_t gen = snap->nelem > 0 ? snap->keys[0] >> 20 : 0;
+        uint32_t probe = snap->nelem > 0 ? (args->reads * 7919) % snap->nelem : 0;
+        
+        args->errors += snap->version < last_version;
+        last_version = snap->version;
+        if (snap->nelem > 0) {
+            args->errors += snap->keys[snap->nelem - 1] != SHARED_INDEX_KEY(gen, snap->nelem - 1);
+            args->errors += !simd_snapshot_contains(snap, SHARED_INDEX_KEY(gen, probe));
+            args->errors += simd_snapshot_contains(snap, SHARED_INDEX_KEY(gen, probe) + 1);
+            if (snap->flags & SIMD_INDEX_SORTED) {
+                args->errors += simd_snapshot_lower_bound(snap, SHARED_INDEX_KEY(gen, probe) - 1) !=
+                    probe;
+            }
+        }
+        simd_index_read_end(reader);
+        args->reads++;
+    }
+    simd_index_reader_unregister(reader);
+    return NULL;
+}
+
+/* Test shared index snapshots, their reclamation, and concurrent readers */
+void test_shared_index(void)
+{
+    printf("\n=== Testing Shared Indexes ===\n");
+    
+    const uint32_t nelem = 5000;
+    const int nthreads = 4;
+    const int generations = 300;
+    uint32_t *keys = malloc(nelem * sizeof(uint32_t));
+    SimdIndex *index = simd_index_create(8);
+    SimdIndexReader *readers[8];
+    SimdIndexReader *reader;
+    const SimdIndexSnapshot *snap;
+    const SimdIndexSnapshot *held;
+    int mismatches = 0;
+    
+    TEST_ASSERT(index != NULL, "simd_index_create should create an index");
+    
+    reader = simd_index_reader_register(index);
+    snap = simd_index_read_begin(reader);
+    TEST_ASSERT(snap->nelem == 0 && snap->version == 0 &&
+                !simd_snapshot_contains(snap, 0),
+                "a new index should hold an empty snapshot");
+    simd_index_read_end(reader);
+    
+    /* unsorted, sorted and tree snapshots answer like the plain kernels */
+    srand(97);
+    for (uint32_t i = 0; i < nelem; i++) {
+        keys[i] = (uint32_t)(rand() % 20000);
+    }
+    const uint32_t flags[3] = {0, SIMD_INDEX_SORTED, SIMD_INDEX_TREE};
+    for (int f = 0; f < 3; f++) {
+        if (f == 1) {
+            for (uint32_t i = 0; i < nelem; i++) {
+                keys[i] = i * 4 + 1;
+            }
+        }
+        mismatches += !simd_index_publish(index, keys, nelem, flags[f]);
+        snap = simd_index_read_begin(reader);
+        mismatches += snap->version != (uint64)(f + 1) || snap->nelem != nelem ||
+            snap->keys == keys || memcmp(snap->keys, keys, nelem * sizeof(uint32_t)) != 0;
+        mismatches += ((uintptr_t)snap->keys % snap->alignment) != 0 ||
+            snap->alignment != SIMD_ALIGNMENT || snap->padding != LFIND_PADDING;
+        mismatches += (snap->tree != NULL) != (flags[f] == SIMD_INDEX_TREE);
+        for (uint32_t key = 0; key < 20500; key += 3) {
+            mismatches += simd_snapshot_contains(snap, key) != lfind32(key, keys, nelem);
+            if (f > 0) {
+                mismatches += simd_snapshot_lower_bound(snap, key) !=
+                    lower_bound32(key, keys, nelem);
+            }
+        }
+        if (f == 0) {
+            mismatches += simd_snapshot_lower_bound(snap, 5) != LFIND_NOT_FOUND;
+        }
+        simd_index_read_end(reader);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "snapshots should hold an aligned copy of the keys and find them");
+    TEST_ASSERT(simd_index_reclaim(index) == 0,
+                "snapshots replaced outside of reads should have been freed");
+    
+    /* a snapshot being read outlives the publishes that replace it */
+    held = simd_index_read_begin(reader);
+    memcpy(keys, held->keys, nelem * sizeof(uint32_t));
+    mismatches = 0;
+    for (int g = 0; g < 2; g++) {
+        uint32_t one = (uint32_t) g;
+        mismatches += !simd_index_publish(index, &one, 1, 0);
+    }
+    mismatches += simd_index_reclaim(index) != 2;
+    mismatches += memcmp(held->keys, keys, nelem * sizeof(uint32_t)) != 0;
+    simd_index_read_end(reader);
+    mismatches += simd_index_reclaim(index) != 0;
+    TEST_ASSERT(mismatches == 0,
+                "replaced snapshots should be freed only after their last read");
+    
+    /* the slots run out at max_readers, and unregistering gives one back */
+    readers[0] = reader;
+    for (int r = 1; r < 8; r++) {
+        readers[r] = simd_index_reader_register(index);
+    }
+    TEST_ASSERT(readers[7] != NULL && simd_index_reader_register(index) == NULL,
+                "simd_index_reader_register should fail once all slots are taken");
+    simd_index_reader_unregister(readers[3]);
+    readers[3] = simd_index_reader_register(index);
+    TEST_ASSERT(readers[3] != NULL,
+                "an unregistered reader slot should be reusable");
+    for (int r = 0; r < 8; r++) {
+        simd_index_reader_unregister(readers[r]);
+    }
+    
+    /* readers probing while a writer keeps publishing new generations */
+    pthread_t threads[4];
+    SharedIndexReaderArgs args[4];
+    volatile int stop = 0;
+    uint32_t errors = 0;
+    uint32_t reads = 0;
+    
+    keys[0] = SHARED_INDEX_KEY(0, 0);
+    mismatches = !simd_index_publish(index, keys, 1, 0);
+    for (int t = 0; t < nthreads; t++) {
+        args[t] = (SharedIndexReaderArgs) {index, &stop, 0, 0};
+        pthread_create(&threads[t], NULL, shared_index_reader, &args[t]);
+    }
+    for (int gen = 1; gen <= generations; gen++) {
+        uint32_t n = 1 + (uint32_t)(gen * 37) % nelem;
+        
+        for (uint32_t i = 0; i < n; i++) {
+            keys[i] = SHARED_INDEX_KEY(gen, i);
+        }
+        mismatches += !simd_index_publish(index, keys, n, (uint32_t) gen % 3 == 0 ? 0 :
+                                          (uint32_t) gen % 3 == 1 ? SIMD_INDEX_SORTED :
+                                          SIMD_INDEX_TREE);
+        /* let the readers in between publishes, even on one CPU */
+        sched_yield();
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        errors += args[t].errors;
+        reads += args[t].reads;
+    }
+    TEST_ASSERT(mismatches == 0 && errors == 0 && reads > 0,
+                "concurrent readers should always see a whole, current snapshot");
+    TEST_ASSERT(simd_index_reclaim(index) == 0,
+                "every replaced snapshot should be freed once the readers are done");
+    
+    simd_index_destroy(index);
+    free(keys);
+}
+
+/* Test the SwissTable-style hash map against a plain array of keys */
+void test_hash_map(void)
+{
+    printf("\n=== Testing simd_hash map ===\n");
+    
+    SimdHashMap *map = simd_hash_create(0);
+    uint64 value = 0;
+    
+    TEST_ASSERT(map != NULL, "simd_hash_create should create a map");
+    TEST_ASSERT(!simd_hash_lookup(map, 42, &value),
+                "simd_hash_lookup should not find a key in an empty map");
+    TEST_ASSERT(simd_hash_insert(map, 42, 1) && simd_hash_insert(map, 42, 2),
+                "simd_hash_insert should insert and update a key");
+    TEST_ASSERT(simd_hash_lookup(map, 42, &value) && value == 2,
+                "simd_hash_lookup should return the latest value");
+    TEST_ASSERT(simd_hash_count(map) == 1,
+                "simd_hash_count should count an updated key once");
+    TEST_ASSERT(simd_hash_insert(map, 0, 7) && simd_hash_insert(map, UINT64_MAX, 8) &&
+                simd_hash_lookup(map, 0, &value) && value == 7 &&
+                simd_hash_lookup(map, UINT64_MAX, &value) && value == 8,
+                "simd_hash should store the smallest and largest keys");
+    TEST_ASSERT(simd_hash_delete(map, 42) && !simd_hash_delete(map, 42) &&
+                !simd_hash_lookup(map, 42, NULL),
+                "simd_hash_delete should remove a key once");
+    simd_hash_destroy(map);
+    
+    /*
+     * Grow from a tiny table through many resizes, then churn with deletes
+     * and reinserts so that tombstones build up, checking every key against
+     * a shadow array each round.
+     */
+    const uint32_t nkeys = 50000;
+    uint64 *keys = malloc(nkeys * sizeof(uint64));
+    bool *present = calloc(nkeys, sizeof(bool));
+    uint32_t npresent = 0;
+    int mismatches = 0;
+    
+    map = simd_hash_create(1);
+    srand(59);
+    for (uint32_t i = 0; i < nkeys; i++) {
+        /* clustered keys, which a weak hash would pile into a few groups */
+        keys[i] = ((uint64)i << 32) | (uint64)(rand() % 4);
+    }
+    for (int round = 0; round < 6; round++) {
+        for (uint32_t n = 0; n < nkeys; n++) {
+            uint32_t i = (uint32_t)(rand() % nkeys);
+            
+            if (present[i] && (rand() % 2) == 0) {
+                mismatches += !simd_hash_delete(map, keys[i]);
+                present[i] = false;
+                npresent--;
+            } else if (!present[i]) {
+                mismatches += !simd_hash_insert(map, keys[i], keys[i] ^ 0x5555);
+                present[i] = true;
+                npresent++;
+            }
+        }
+        for (uint32_t i = 0; i < nkeys; i++) {
+            bool found = simd_hash_lookup(map, keys[i], &value);
+            
+            mismatches += found != present[i];
+            mismatches += found && value != (keys[i] ^ 0x5555);
+        }
+        mismatches += simd_hash_count(map) != npresent;
+    }
+    TEST_ASSERT(mismatches == 0,
+                "simd_hash should match a shadow array through growth and deletes");
+    
+    simd_hash_destroy(map);
+    free(keys);
+    free(present);
+}
+
+/*
+ * Check the reductions of one element width against scalar loops, over
+ * every size up to a few blocks and a few larger ones, with values drawn
+ * from the extremes of the type so that the unsigned compares and the
+ * widening sums are exercised.
+ */
+#define CHECK_REDUCTIONS(bits, type, maxval) \
+    do { \
+        type *array = malloc(3000 * sizeof(type)); \
+        int mismatches = 0; \
+        \
+        for (uint32_t size = 0; size <= 3000; size += (size < 300 ? 1 : 541)) { \
+            type min = (maxval), max = 0; \
+            uint32_t argmin = LFIND_NOT_FOUND, argmax = LFIND_NOT_FOUND; \
+            uint64 sum = 0; \
+            \
+            for (uint32_t i = 0; i < size; i++) { \
+                int r = rand() % 4; \
+                array[i] = r == 0 ? (type)(maxval) : r == 1 ? (type)(maxval - 1 - rand() % 3) : \
+                    (type)(rand() % 5 + 1); \
+                if (array[i] < min || argmin == LFIND_NOT_FOUND) { min = array[i]; argmin = i; } \
+                if (array[i] > max || argmax == LFIND_NOT_FOUND) { max = array[i]; argmax = i; } \
+                sum += array[i]; \
+            } \
+            mismatches += vmin##bits(array, size) != min; \
+            mismatches += vmax##bits(array, size) != max; \
+            mismatches += vsum##bits(array, size) != sum; \
+            mismatches += argmin##bits(array, size) != argmin; \
+            mismatches += argmax##bits(array, size) != argmax; \
+        } \
+        TEST_ASSERT(mismatches == 0, \
+                    "vmin/vmax/vsum/argmin/argmax" #bits " should match scalar loops"); \
+        free(array); \
+    } while (0)
+
+/* Test the reduction kernels and lfind32_stats */
+void test_reductions(void)
+{
+    printf("\n=== Testing reductions ===\n");
+    
+    uint32_t values[] = {7, 3, 9, 3, 0xFFFFFFFF, 9};
+    Lfind32Stats result;
+    
+    TEST_ASSERT(vmin32(values, 6) == 3 && argmin32(values, 6) == 1,
+                "vmin32/argmin32 should find the first minimum");
+    TEST_ASSERT(vmax32(values, 6) == 0xFFFFFFFF && argmax32(values, 6) == 4,
+                "vmax32/argmax32 should compare unsigned");
+    TEST_ASSERT(vsum32(values, 6) == 31ULL + 0xFFFFFFFFULL,
+                "vsum32 should not overflow");
+    TEST_ASSERT(vmin8(NULL, 0) == 0xFF && vmax8(NULL, 0) == 0 &&
+                vsum8(NULL, 0) == 0 && argmin8(NULL, 0) == LFIND_NOT_FOUND,
+                "reductions of an empty array should return the identities");
+    
+    srand(61);
+    CHECK_REDUCTIONS(8, uint8_t, 0xFF);
+    CHECK_REDUCTIONS(16, uint16_t, 0xFFFF);
+    CHECK_REDUCTIONS(32, uint32_t, 0xFFFFFFFFU);
+    CHECK_REDUCTIONS(64, uint64, 0xFFFFFFFFFFFFFFFFULL);
+    
+    /* 8-bit sums widen past any 16-bit or 32-bit partial sum */
+    uint8_t *bytes = malloc(1 << 20);
+    memset(bytes, 0xFF, 1 << 20);
+    TEST_ASSERT(vsum8(bytes, 1 << 20) == 255ULL << 20,
+                "vsum8 should widen without overflow");
+    free(bytes);
+    
+    TEST_ASSERT(lfind32_stats(3, values, 6, &result) == 2 && result.count == 2 &&
+                result.first == 1 && result.min == 3 && result.max == 0xFFFFFFFF &&
+                result.sum == 31ULL + 0xFFFFFFFFULL,
+                "lfind32_stats should count, locate and aggregate in one pass");
+    TEST_ASSERT(lfind32_stats(3, values, 0, &result) == 0 &&
+                result.first == LFIND_NOT_FOUND && result.min == 0xFFFFFFFF &&
+                result.max == 0 && result.sum == 0,
+                "lfind32_stats of an empty array should return the identities");
+    
+    /* against the separate kernels; key 0 also tests that padding is ignored */
+    uint32_t *array = malloc(3000 * sizeof(uint32_t));
+    int mismatches = 0;
+    
+    for (uint32_t size = 0; size <= 3000; size += (size < 300 ? 1 : 541)) {
+        for (uint32_t i = 0; i < size; i++) {
+            array[i] = (uint32_t)(rand() % 50) + (rand() % 2 ? 0xFFFFFF00U : 0);
+        }
+        for (uint32_t key = 0; key < 3; key++) {
+            mismatches += lfind32_stats(key, array, size, &result) !=
+                lfind32_count(key, array, size);
+            mismatches += result.first != lfind32_index(key, array, size);
+            mismatches += result.min != vmin32(array, size);
+            mismatches += result.max != vmax32(array, size);
+            mismatches += result.sum != vsum32(array, size);
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind32_stats should match the separate kernels for all sizes");
+    free(array);
+}
+
+/* Test chunked searches against lfind_substr over the whole buffer */
+void test_lfind_stream(void)
+{
+    printf("\n=== Testing lfind_stream ===\n");
+    
+    LfindStream stream;
+    const uint8_t *text = (const uint8_t *)"the quick brown fox";
+    
+    TEST_ASSERT(!lfind_stream_init(&stream, text, 0) &&
+                !lfind_stream_init(&stream, text, LFIND_STREAM_MAX_NEEDLE + 1),
+                "lfind_stream_init should reject empty and oversized needles");
+    
+    /* "brown" split over three chunks */
+    lfind_stream_init(&stream, (const uint8_t *)"brown", 5);
+    TEST_ASSERT(lfind_stream_feed(&stream, text, 11) == LFIND_STREAM_NOT_FOUND &&
+                lfind_stream_feed(&stream, text + 11, 2) == LFIND_STREAM_NOT_FOUND &&
+                lfind_stream_feed(&stream, text + 13, 6) == 10 &&
+                lfind_stream_finish(&stream) == 10 && stream.offset == 19,
+                "lfind_stream should find a match spanning three chunks");
+    
+    const uint32_t hlen = 2000;
+    uint8_t *haystack = malloc(hlen);
+    uint8_t needle[LFIND_STREAM_MAX_NEEDLE];
+    int mismatches = 0;
+    
+    srand(67);
+    for (int round = 0; round < 400; round++) {
+        uint32_t nlen = (round % 10 == 0) ? LFIND_STREAM_MAX_NEEDLE :
+            (uint32_t)(rand() % 6 + 1);
+        uint32_t len = (uint32_t)(rand() % hlen);
+        uint32_t pos = 0;
+        uint64 expected;
+        uint64 found = LFIND_STREAM_NOT_FOUND;
+        
+        /* a small alphabet, so partial matches are common */
+        for (uint32_t i = 0; i < len; i++) {
+            haystack[i] = (uint8_t)('a' + rand() % 3);
+        }
+        for (uint32_t i = 0; i < nlen; i++) {
+            needle[i] = (uint8_t)('a' + rand() % 3);
+        }
+        expected = lfind_substr(needle, nlen, haystack, len);
+        if (expected == LFIND_NOT_FOUND) {
+            expected = LFIND_STREAM_NOT_FOUND;
+        }
+        
+        lfind_stream_init(&stream, needle, nlen);
+        while (pos < len) {
+            uint32_t n = (rand() % 4 == 0) ? (uint32_t)(rand() % 200) :
+                (uint32_t)(rand() % 5);
+            
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            found = lfind_stream_feed(&stream, haystack + pos, n);
+            pos += n;
+        }
+        mismatches += lfind_stream_finish(&stream) != expected;
+        mismatches += len > 0 && found != expected;
+        mismatches += stream.offset != len;
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind_stream should match lfind_substr for random chunkings");
+    
+    free(haystack);
+}
+
+/* Test the cache-bypassing scans and the threshold that switches to them */
+void test_nt_scan(void)
+{
+    printf("\n=== Testing Non-Temporal Scans ===\n");
+    
+    const uint32_t size = 3000;
+    uint8_t *bytes = malloc(size + 64);
+    uint32_t *words = malloc((size + 16) * sizeof(uint32_t));
+    int mismatches = 0;
+    
+    srand(71);
+    for (uint32_t i = 0; i < size + 64; i++) {
+        bytes[i] = (uint8_t)(rand() % 250);
+    }
+    for (uint32_t i = 0; i < size + 16; i++) {
+        words[i] = (uint32_t)(rand() % 20000);
+    }
+    
+    /* every head misalignment, sizes around the block boundaries */
+    for (uint32_t offset = 0; offset < 16; offset++) {
+        for (uint32_t nelem = 0; nelem <= size; nelem += (nelem < 300 ? 1 : 97)) {
+            uint8_t key8 = (uint8_t)(rand() % 256);
+            uint32_t key32 = (uint32_t)(rand() % 25000);
+            
+            mismatches += lfind8_nt(key8, bytes + offset * 4 + 1, nelem) !=
+                lfind8(key8, bytes + offset * 4 + 1, nelem);
+            mismatches += lfind32_nt(key32, words + offset, nelem) !=
+                lfind32(key32, words + offset, nelem);
+            if (nelem > 0) {
+                mismatches += !lfind32_nt(words[offset + nelem - 1], words + offset, nelem);
+                mismatches += !lfind8_nt(bytes[offset * 4 + nelem], bytes + offset * 4 + 1, nelem);
+            }
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind8_nt and lfind32_nt should match the normal scans");
+    
+    for (uint32_t i = 0; i < size; i++) {
+        words[i] = 5;
+        bytes[i] = 5;
+    }
+    words[size - 1] = 6;
+    bytes[size - 1] = 6;
+    lfind_set_nt_threshold(1024);
+    lfind_set_prefetch_distance(64);
+    TEST_ASSERT(lfind32(6, words, size) && !lfind32(7, words, size) &&
+                lfind8(6, bytes, size) && !lfind8(7, bytes, size) &&
+                lfind32(6, words + size - 1, 1),
+                "lfind8 and lfind32 should give the same results above the nt threshold");
+    
+    /* an array that isn't 4-byte aligned can't use the non-temporal loads */
+    uint32_t *odd = (uint32_t *)((uint8_t *) words + 1);
+    uint32_t last;
+    
+    memcpy(&last, (uint8_t *) words + 1 + (size - 2) * sizeof(uint32_t), sizeof(last));
+    TEST_ASSERT(lfind32(last, odd, size - 1) && lfind32_nt(last, odd, size - 1) &&
+                !lfind32(7, odd, size - 1) && !lfind32_nt(7, odd, size - 1),
+                "lfind32 and lfind32_nt should handle arrays that aren't 4-byte aligned");
+    lfind_set_nt_threshold(0);
+    lfind_set_prefetch_distance(0);
+    
+    free(bytes);
+    free(words);
+}
+
+/* Test the aligned main loops of lfind8/lfind32 from every misalignment */
+void test_aligned_scans(void)
+{
+    printf("\n=== Testing Aligned Scans ===\n");
+    
+    const uint32_t size = 1500;
+    uint8_t *bytes = simd_alloc_aligned(size + 64);
+    uint32_t *words = simd_alloc_aligned((size + 16) * sizeof(uint32_t));
+    int mismatches = 0;
+    
+    TEST_ASSERT(bytes != NULL && words != NULL &&
+                ((uintptr_t)bytes % SIMD_ALIGNMENT) == 0 &&
+                ((uintptr_t)words % SIMD_ALIGNMENT) == 0,
+                "simd_alloc_aligned should return aligned buffers");
+    
+    for (uint32_t i = 0; i < size + 64; i++) {
+        bytes[i] = 1;
+    }
+    for (uint32_t i = 0; i < size + 16; i++) {
+        words[i] = 1;
+    }
+    
+    /* a single match just before, at and after the head vector's end */
+    for (uint32_t offset = 0; offset < 64; offset++) {
+        for (uint32_t nelem = 1000; nelem < 1000 + 70; nelem += 23) {
+            for (uint32_t pos = 0; pos < 140; pos++) {
+                uint32_t at = pos < 70 ? pos : nelem - (pos - 70) - 1;
+                
+                bytes[offset + at] = 2;
+                mismatches += !lfind8(2, bytes + offset, nelem);
+                bytes[offset + at] = 1;
+                if (offset < 16) {
+                    words[offset + at] = 2;
+                    mismatches += !lfind32(2, words + offset, nelem);
+                    words[offset + at] = 1;
+                }
+            }
+            mismatches += lfind8(2, bytes + offset, nelem);
+            if (offset < 16) {
+                mismatches += lfind32(2, words + offset, nelem);
+            }
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "lfind8 and lfind32 should find matches at every misalignment");
+    
+    /* the padding is readable, and zero */
+    mismatches = 0;
+    for (size_t len = 0; len < 200; len += 7) {
+        uint8_t *p = simd_alloc_aligned(len);
+        
+        for (size_t i = len; i < SIMD_ALIGN_UP(len) + LFIND_PADDING; i++) {
+            mismatches += p[i] != 0;
+        }
+        memset(p, 3, len);
+        mismatches += lfind8_padded(3, p, (uint32_t)len) != (len > 0);
+        simd_free_aligned(p);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "simd_alloc_aligned buffers should be padded with zeros");
+    
+    simd_free_aligned(bytes);
+    simd_free_aligned(words);
+}
+
+/* Test the mmap()ed file scans against the in-memory kernels */
+void test_file_scan(void)
+{
+    printf("\n=== Testing File Scans ===\n");
+    
+    const uint32_t nwords = 200000;
+    const uint32_t nbytes = nwords * sizeof(uint32_t) + 3;
+    uint8_t *data = malloc(nbytes);
+    uint32_t *words = (uint32_t *)data;
+    uint8_t *bitmap = calloc(LFIND_BITMAP_BYTES(nbytes), 1);
+    uint8_t *expected_bitmap = calloc(LFIND_BITMAP_BYTES(nbytes), 1);
+    char path[] = "/tmp/libsimd_test_XXXXXX";
+    int fd = mkstemp(path);
+    LfindPool *pool = lfind_pool_create(2);
+    LfindFileScan scan;
+    int mismatches = 0;
+    
+    TEST_ASSERT(fd >= 0, "mkstemp should create a scratch file");
+    
+    srand(73);
+    for (uint32_t i = 0; i < nbytes; i++) {
+        data[i] = (uint8_t)(rand() % 4);
+    }
+    TEST_ASSERT(write(fd, data, nbytes) == (ssize_t)nbytes,
+                "the scratch file should be written");
+    
+    /* small chunks, so that files span many kernel calls */
+    memset(&scan, 0, sizeof(scan));
+    scan.chunk_bytes = 4096;
+    scan.pool = pool;
+    for (int parallel = 0; parallel < 2; parallel++) {
+        scan.parallel = parallel;
+        for (uint32_t k = 0; k < 6; k++) {
+            uint32_t key32 = words[k * 31000];
+            uint8_t key8 = (uint8_t)k;
+            
+            scan.elem_size = 4;
+            scan.key = key32;
+            scan.op = LFIND_FILE_FIND;
+            mismatches += lfind_file_scan_fd(fd, &scan) != 1;
+            scan.key = key32 ^ 0x80000000u;
+            mismatches += lfind_file_scan(path, &scan) != 0;
+            
+            scan.key = key32;
+            scan.op = LFIND_FILE_COUNT;
+            mismatches += lfind_file_scan_fd(fd, &scan) != lfind32_count(key32, words, nwords);
+            
+            scan.op = LFIND_FILE_MASK;
+            scan.bitmap = bitmap;
+            mismatches += lfind_file_scan_fd(fd, &scan) !=
+                lfind32_mask(key32, words, nwords, expected_bitmap);
+            mismatches += memcmp(bitmap, expected_bitmap, LFIND_BITMAP_BYTES(nwords)) != 0;
+            
+            /* bytes, including the three past the last whole word */
+            scan.elem_size = 1;
+            scan.key = key8;
+            mismatches += lfind_file_scan_fd(fd, &scan) !=
+                lfind8_mask(key8, data, nbytes, expected_bitmap);
+            mismatches += memcmp(bitmap, expected_bitmap, LFIND_BITMAP_BYTES(nbytes)) != 0;
+            scan.bitmap = NULL;
+            
+            scan.op = LFIND_FILE_FIND;
+            mismatches += lfind_file_scan_fd(fd, &scan) != (k < 4);
+        }
+    }
+    TEST_ASSERT(mismatches == 0,
+                "file scans should match the in-memory kernels, across chunks and threads");
+    
+    scan.elem_size = 2;
+    errno = 0;
+    TEST_ASSERT(lfind_file_scan_fd(fd, &scan) == -1 && errno == EINVAL,
+                "file scans should reject unsupported element sizes");
+    scan.elem_size = 4;
+    TEST_ASSERT(lfind_file_scan("/nonexistent/libsimd", &scan) == -1 && errno == ENOENT,
+                "file scans should report files that can't be opened");
+    TEST_ASSERT(ftruncate(fd, 3) == 0 && lfind_file_scan_fd(fd, &scan) == 0,
+                "a file shorter than one element should be searched as empty");
+    
+    close(fd);
+    unlink(path);
+    lfind_pool_destroy(pool);
+    free(data);
+    free(bitmap);
+    free(expected_bitmap);
+}
+
+/* Test the counter instrumentation, whichever way the library was built */
+void test_perf_counters(void)
+{
+    printf("\n=== Testing Performance Counters ===\n");
+    
+    uint32_t words[100] = {0};
+    uint8_t bytes[50] = {0};
+    SimdPerfCounters counters[8];
+    
+    if (simd_perf_enable(1) < 0) {
+        TEST_ASSERT(simd_perf_read(counters, 8) == 0 && !simd_perf_set_site("probe"),
+                    "an uninstrumented library should record nothing");
+        return;
+    }
+    
+    simd_perf_reset();
+    simd_perf_set_site("probe");
+    for (int i = 0; i < 10; i++) {
+        lfind32(7, words, 100);
+    }
+    for (int i = 0; i < 3; i++) {
+        lfind8(7, bytes, 50);
+    }
+    simd_perf_set_site(NULL);
+    lfind8(7, bytes, 50);
+    simd_perf_disable();
+    lfind32(7, words, 100);
+    
+    uint32_t n = simd_perf_read(counters, 8);
+    int found = 0;
+    for (uint32_t i = 0; i < n && i < 8; i++) {
+        const SimdPerfCounters *c = &counters[i];
+        if (strcmp(c->site, "probe") == 0 && strcmp(c->kernel, "lfind32") == 0) {
+            found += c->calls == 10 && c->bytes == 4000 && c->sampled <= 10;
+        } else if (strcmp(c->site, "probe") == 0 && strcmp(c->kernel, "lfind8") == 0) {
+            found += c->calls == 3 && c->bytes == 150;
+        } else if (c->site[0] == '\0' && strcmp(c->kernel, "lfind8") == 0) {
+            found += c->calls == 1;
+        }
+    }
+    TEST_ASSERT(n == 3 && found == 3,
+                "the counters should be aggregated per site and kernel, only while enabled");
+    
+    simd_perf_reset();
+    TEST_ASSERT(simd_perf_read(counters, 8) == 0,
+                "simd_perf_reset should clear the totals");
+}
+
+/* Test the header-only scans against the exported kernels */
+void test_inline_scans(void)
+{
+    printf("\n=== Testing Inline Scans ===\n");
+    
+    const uint32_t size = 300;
+    uint8_t *a8 = malloc(size);
+    uint16_t *a16 = malloc(size * sizeof(uint16_t));
+    uint32_t *a32 = malloc(size * sizeof(uint32_t));
+    uint64 *a64 = malloc(size * sizeof(uint64));
+    int mismatches = 0;
+    
+    srand(79);
+    for (uint32_t i = 0; i < size; i++) {
+        a8[i] = (uint8_t)(rand() % 64);
+        a16[i] = (uint16_t)(rand() % 256);
+        a32[i] = (uint32_t)(rand() % 256);
+        a64[i] = (uint64)(rand() % 256);
+    }
+    
+    for (uint32_t nelem = 0; nelem <= size; nelem++) {
+        uint8_t key8 = (uint8_t)(rand() % 80);
+        uint32_t key32 = (uint32_t)(rand() % 300);
+        
+        mismatches += lfind8_inline(key8, a8, nelem) != lfind8(key8, a8, nelem);
+        mismatches += lfind8_index_inline(key8, a8, nelem) != lfind8_index(key8, a8, nelem);
+        mismatches += lfind8_count_inline(key8, a8, nelem) != lfind8_count(key8, a8, nelem);
+        mismatches += lfind16_inline(key32, a16, nelem) != lfind16(key32, a16, nelem);
+        mismatches += lfind32_inline(key32, a32, nelem) != lfind32(key32, a32, nelem);
+        mismatches += lfind32_index_inline(key32, a32, nelem) != lfind32_index(key32, a32, nelem);
+        mismatches += lfind32_count_inline(key32, a32, nelem) != lfind32_count(key32, a32, nelem);
+        mismatches += lfind64_inline(key32, a64, nelem) != lfind64(key32, a64, nelem);
+    }
+    TEST_ASSERT(mismatches == 0,
+                "inline scans should match the exported kernels");
+    
+    /* the sizes must be constants here, as in real use */
+    mismatches = 0;
+#define CHECK_N(n) \
+    for (uint32_t k = 0; k < 300; k++) { \
+        mismatches += lfind8_n((uint8_t)(k % 70), a8, n) != lfind8((uint8_t)(k % 70), a8, n); \
+        mismatches += lfind8_index_n((uint8_t)(k % 70), a8, n) != \
+            lfind8_index((uint8_t)(k % 70), a8, n); \
+        mismatches += lfind16_n(k, a16, n) != lfind16(k, a16, n); \
+        mismatches += lfind32_n(k, a32, n) != lfind32(k, a32, n); \
+        mismatches += lfind32_index_n(k, a32, n) != lfind32_index(k, a32, n); \
+        mismatches += lfind64_n(k, a64, n) != lfind64(k, a64, n); \
+        mismatches += lfind64_index_n(k, a64, n) != lfind64_index_inline(k, a64, n); \
+        mismatches += LFIND_N(k, a32, n) != lfind32(k, a32, n); \
+    }
+    CHECK_N(0)
+    CHECK_N(1)
+    CHECK_N(3)
+    CHECK_N(7)
+    CHECK_N(16)
+    CHECK_N(33)
+    CHECK_N(64)
+    CHECK_N(100)
+#undef CHECK_N
+    TEST_ASSERT(mismatches == 0,
+                "fixed-size scans should match the exported kernels");
+    
+    free(a8);
+    free(a16);
+    free(a32);
+    free(a64);
+}
+
+/* Test vector alignment and boundary conditions */
+void test_vector_alignment(void)
+{
+    printf("\n=== Testing Vector Alignment ===\n");
+    
+    /* Test arrays of different sizes to check vector boundary handling */
+    for (uint32_t size = 1; size <= 64; size++) {
+        uint8_t *test_array = malloc(size * sizeof(uint8_t));
+        
+        /* Fill with sequential values */
+        for (uint32_t i = 0; i < size; i++) {
+            test_array[i] = (uint8_t)(i % 256);
+        }
+        
+        /* Test finding first and last elements */
+        bool found_first = lfind8(0, test_array, size);
+        bool found_last = lfind8((uint8_t)((size - 1) % 256), test_array, size);
+        
+        if (!found_first || !found_last) {
+            printf("FAIL: Vector alignment issue with size %u\n", size);
+            stats.total_tests++;
+            stats.failed_tests++;
+        }
+        
+        free(test_array);
+    }
+    
+    /*
+     * lfind32 consumes four vectors per iteration, i.e. up to 64 elements
+     * with AVX-512, so also cover sizes spanning a few full blocks.
+     */
+    for (uint32_t size = 1; size <= 200; size++) {
+        uint32_t *test_array = malloc(size * sizeof(uint32_t));
+        
+        for (uint32_t i = 0; i < size; i++) {
+            test_array[i] = i + 1;
+        }
+        
+        bool found_first = lfind32(1, test_array, size);
+        bool found_last = lfind32(size, test_array, size);
+        bool found_missing = lfind32(size + 1, test_array, size);
+        
+        if (!found_first || !found_last || found_missing) {
+            printf("FAIL: lfind32 vector block issue with size %u\n", size);
+            stats.total_tests++;
+            stats.failed_tests++;
+        }
+        
+        free(test_array);
+    }
+    
+    stats.total_tests++;
+    stats.passed_tests++;
+    printf("Vector alignment tests completed successfully\n");
+}
+
+/* Test runtime kernel selection */
+void test_impl_selection(void)
+{
+    printf("\n=== Testing Kernel Selection ===\n");
+    
+    const char *name = simd_get_impl_name();
+    TEST_ASSERT(name != NULL && strcmp(name, "unresolved") != 0,
+                "simd_get_impl_name should report a resolved variant");
+    TEST_ASSERT(simd_set_impl("no-such-isa") == false,
+                "simd_set_impl should reject unknown variants");
+    TEST_ASSERT(strcmp(simd_get_impl_name(), name) == 0,
+                "simd_set_impl failure should keep the current variant");
+    TEST_ASSERT(simd_set_impl("auto") == true,
+                "simd_set_impl should accept auto");
+}
+
+/* Run every kernel test against one variant */
+void run_kernel_tests(void)
+{
+    test_lfind8_basic();
+    test_lfind8_edge_cases();
+    test_lfind8_large_array();
+    test_lfind8_le_basic();
+    test_lfind8_index();
+    test_lfind8_count_mask();
+    
+    test_lfind32_basic();
+    test_lfind32_edge_cases();
+    test_lfind32_large_array();
+    test_lfind32_index();
+    test_lfind32_count_mask();
+    
+    test_lfind16();
+    test_lfind64();
+    
+    test_lfind_any();
+    test_lfind_range();
+    test_lfind32_batch();
+    test_select();
+    test_bitmaps();
+    
+    test_bytescan();
+    test_text_scans();
+    test_lfind_substr();
+    test_lfind_stream();
+    test_sorted_search();
+    test_stree();
+    test_parallel();
+    test_tail_handling();
+    test_padded();
+    test_nt_scan();
+    test_aligned_scans();
+    test_file_scan();
+    test_reductions();
+    test_vector_alignment();
+}
+
+/* Print test summary */
+void print_test_summary(void)
+{
+    printf("\n" "================================================\n");
+    printf("Functional Test Summary:\n");
+    printf("Total tests: %d\n", stats.total_tests);
+    printf("Passed: %d\n", stats.passed_tests);
+    printf("Failed: %d\n", stats.failed_tests);
+    printf("Success rate: %.2f%%\n", 
+           stats.total_tests > 0 ? (double)stats.passed_tests / stats.total_tests * 100 : 0);
+    
+    if (stats.failed_tests == 0) {
+        printf("All functional tests PASSED!\n");
+    } else {
+        printf("WARNING: %d functional tests FAILED!\n", stats.failed_tests);
+    }
+    printf("================================================\n");
+}
+
+int main(void)
+{
+    printf("libsimd Functional Tests\n");
+    printf("========================\n");
+    
+    test_impl_selection();
+    
+    /* Run all functional tests once per variant this CPU supports */
+    const char *variants[] = {"sse2", "avx2", "avx512", "neon", "sve", "sve2"};
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        if (!simd_set_impl(variants[v])) {
+            continue;
+        }
+        printf("\n########## Kernel variant: %s ##########\n", variants[v]);
+        run_kernel_tests();
+    }
+    simd_set_impl("auto");
+    
+    /* The hash map is built once, for the baseline, not per variant */
+    test_hash_map();
+    
+    /* Arenas only allocate, so they don't depend on the variant either */
+    test_arena();
+    
+    /* Shared indexes probe with whatever variant is selected */
+    test_shared_index();
+    
+    /* The inline scans are built for this file's flags, not per variant */
+    test_inline_scans();
+    
+    /* The instrumentation is in the exported wrappers, not the kernels */
+    test_perf_counters();
     
     /* Print summary */
     print_test_summary();
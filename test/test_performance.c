@@ -2,16 +2,20 @@
  * test_performance.c - Performance tests for libsimd functions
  * 
  * This file contains performance benchmarks comparing SIMD implementations
- * against standard linear search algorithms.
+ * against standard linear search algorithms.  These are quick sanity checks
+ * run by `make check`; for per-variant numbers with controlled hit positions
+ * and percentiles, use the harness in bench/ (`make bench`).
  */
 
+/* for clock_gettime under -std=c99 */
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
-#include <sys/time.h>
 
 /* Include the SIMD headers and functions */
 #include "../simd.h"
@@ -20,6 +24,10 @@
 extern bool lfind8(uint8_t key, uint8_t *base, uint32_t nelem);
 extern bool lfind8_le(uint8_t key, uint8_t *base, uint32_t nelem);
 extern bool lfind32(uint32_t key, uint32_t *base, uint32_t nelem);
+extern bool lfind64(uint64 key, uint64 *base, uint32_t nelem);
+extern uint32_t lfind32_count(uint32_t key, uint32_t *base, uint32_t nelem);
+extern uint32_t lfind32_batch(const uint32_t *keys, uint32_t nkeys, uint32_t *base,
+                              uint32_t nelem, uint8_t *bitmap);
 
 /* Performance test configuration */
 #define SMALL_ARRAY_SIZE    10000
@@ -32,9 +40,9 @@ extern bool lfind32(uint32_t key, uint32_t *base, uint32_t nelem);
 /* Timing utilities */
 static double get_time_microseconds(void)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
 }
 
 /* Standard implementations for comparison */
@@ -58,6 +66,16 @@ static bool linear_search_uint32(uint32_t key, uint32_t *base, uint32_t nelem)
     return false;
 }
 
+static bool linear_search_uint64(uint64 key, uint64 *base, uint32_t nelem)
+{
+    for (uint32_t i = 0; i < nelem; i++) {
+        if (base[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static bool linear_search_uint8_le(uint8_t key, uint8_t *base, uint32_t nelem)
 {
     for (uint32_t i = 0; i < nelem; i++) {
@@ -232,6 +250,83 @@ perf_result_t test_lfind32_performance(uint32_t array_size, const char *test_nam
     return result;
 }
 
+/* Test lfind64 performance */
+perf_result_t test_lfind64_performance(uint32_t array_size, const char *test_name)
+{
+    perf_result_t result = {0};
+    result.test_name = test_name;
+    result.array_size = array_size;
+    
+    /* Allocate and initialize test array */
+    uint64 *test_array = malloc(array_size * sizeof(uint64));
+    if (!test_array) {
+        printf("ERROR: Failed to allocate memory for %s\n", test_name);
+        return result;
+    }
+    
+    /* Fill array with pseudo-random values */
+    srand(42); // Fixed seed for reproducible results
+    for (uint32_t i = 0; i < array_size; i++) {
+        test_array[i] = ((uint64)rand() << 32) ^ (uint64)rand() * (uint64)rand();
+    }
+    
+    /* Prepare test keys */
+    uint64 test_keys[NUM_ITERATIONS];
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        if (i % 4 == 0) {
+            /* 25% non-existing keys */
+            test_keys[i] = (((uint64)rand() << 32) ^ (uint64)rand() * (uint64)rand()) + 1;
+        } else {
+            /* 75% existing keys from array */
+            test_keys[i] = test_array[rand() % array_size];
+        }
+    }
+    
+    /* Warmup runs */
+    for (int i = 0; i < NUM_WARMUP_RUNS; i++) {
+        lfind64(test_keys[i % NUM_ITERATIONS], test_array, array_size);
+        linear_search_uint64(test_keys[i % NUM_ITERATIONS], test_array, array_size);
+    }
+    
+    /* Benchmark SIMD implementation */
+    double start_time = get_time_microseconds();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        volatile bool found = lfind64(test_keys[i], test_array, array_size);
+        (void)found; // Prevent optimization
+    }
+    double end_time = get_time_microseconds();
+    result.simd_time = end_time - start_time;
+    
+    /* Benchmark linear implementation */
+    start_time = get_time_microseconds();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        volatile bool found = linear_search_uint64(test_keys[i], test_array, array_size);
+        (void)found; // Prevent optimization
+    }
+    end_time = get_time_microseconds();
+    result.linear_time = end_time - start_time;
+    
+    /* Calculate speedup */
+    result.speedup = result.linear_time / result.simd_time;
+    
+    /* Verify correctness */
+    result.correctness_verified = true;
+    for (int i = 0; i < 100; i++) { // Sample verification
+        uint64 key = test_keys[i];
+        bool simd_result = lfind64(key, test_array, array_size);
+        bool linear_result = linear_search_uint64(key, test_array, array_size);
+        
+        if (simd_result != linear_result) {
+            result.correctness_verified = false;
+            printf("ERROR: Correctness mismatch in %s for key %llu\n", test_name, key);
+            break;
+        }
+    }
+    
+    free(test_array);
+    return result;
+}
+
 /* Print performance results */
 void print_performance_result(const perf_result_t *result)
 {
@@ -259,7 +354,7 @@ void run_performance_tests(void)
     printf("--------------------------------------------------------------------------------\n");
     
     /* lfind8 performance tests */
-    perf_result_t results[8];
+    perf_result_t results[11];
     int test_idx = 0;
     
     results[test_idx++] = test_lfind8_performance(SMALL_ARRAY_SIZE, "lfind8_small");
@@ -273,6 +368,11 @@ void run_performance_tests(void)
     results[test_idx++] = test_lfind32_performance(LARGE_ARRAY_SIZE, "lfind32_large");
     results[test_idx++] = test_lfind32_performance(XLARGE_ARRAY_SIZE, "lfind32_xlarge");
     
+    /* lfind64 performance tests */
+    results[test_idx++] = test_lfind64_performance(SMALL_ARRAY_SIZE, "lfind64_small");
+    results[test_idx++] = test_lfind64_performance(MEDIUM_ARRAY_SIZE, "lfind64_medium");
+    results[test_idx++] = test_lfind64_performance(LARGE_ARRAY_SIZE, "lfind64_large");
+    
     /* Print all results */
     for (int i = 0; i < test_idx; i++) {
         print_performance_result(&results[i]);
@@ -353,6 +453,454 @@ void test_worst_case_performance(void)
     free(array);
 }
 
+/* Compare batched probes of small buckets with one lfind32 call per key */
+void test_batch_probe_performance(void)
+{
+    printf("\n\nBatched Probe Analysis\n");
+    printf("======================\n");
+    
+    const uint32_t bucket_sizes[] = {64, 256, 1024};
+    const uint32_t nkeys = 1024;
+    uint32_t *bucket = malloc(1024 * sizeof(uint32_t));
+    uint32_t *keys = malloc(nkeys * sizeof(uint32_t));
+    uint8_t bitmap[LFIND_BITMAP_BYTES(1024)];
+    
+    srand(42);
+    for (uint32_t i = 0; i < 1024; i++) {
+        bucket[i] = (uint32_t)rand() * (uint32_t)rand();
+    }
+    
+    for (int b = 0; b < 3; b++) {
+        uint32_t size = bucket_sizes[b];
+        uint32_t loop_found = 0;
+        uint32_t batch_found = 0;
+        
+        /* mostly misses, as in a join probe */
+        for (uint32_t k = 0; k < nkeys; k++) {
+            keys[k] = (k % 8 == 0) ? bucket[rand() % size] : (uint32_t)rand() * 2u + 1;
+        }
+        
+        double start_time = get_time_microseconds();
+        for (int i = 0; i < 100; i++) {
+            for (uint32_t k = 0; k < nkeys; k++) {
+                loop_found += lfind32(keys[k], bucket, size);
+            }
+        }
+        double loop_time = get_time_microseconds() - start_time;
+        
+        start_time = get_time_microseconds();
+        for (int i = 0; i < 100; i++) {
+            batch_found += lfind32_batch(keys, nkeys, bucket, size, bitmap);
+        }
+        double batch_time = get_time_microseconds() - start_time;
+        
+        printf("Bucket of %4u, %u keys: lfind32 loop %.2f ms, lfind32_batch %.2f ms, "
+               "speedup %.2fx%s\n",
+               size, nkeys, loop_time / 1000.0, batch_time / 1000.0,
+               loop_time / batch_time,
+               loop_found == batch_found ? "" : " (MISMATCH)");
+    }
+    
+    free(bucket);
+    free(keys);
+}
+
+/* Compare the multi-threaded scan with the single-threaded kernel */
+void test_parallel_performance(void)
+{
+    printf("\n\nParallel Scan Analysis\n");
+    printf("======================\n");
+    
+    uint32_t *array = malloc(XLARGE_ARRAY_SIZE * sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < XLARGE_ARRAY_SIZE; i++) {
+        array[i] = i * 2;
+    }
+    
+    /* an odd key is never found, so both versions read the whole array */
+    double start_time = get_time_microseconds();
+    for (int i = 0; i < 20; i++) {
+        volatile bool found = lfind32(1, array, XLARGE_ARRAY_SIZE);
+        (void)found;
+    }
+    double single_time = get_time_microseconds() - start_time;
+    
+    start_time = get_time_microseconds();
+    for (int i = 0; i < 20; i++) {
+        volatile bool found = lfind32_parallel(1, array, XLARGE_ARRAY_SIZE, NULL);
+        (void)found;
+    }
+    double parallel_time = get_time_microseconds() - start_time;
+    
+    printf("lfind32 on %u elements (default pool):\n", XLARGE_ARRAY_SIZE);
+    printf("- Single-threaded: %.2f ms per call\n", single_time / 20000.0);
+    printf("- Parallel: %.2f ms per call\n", parallel_time / 20000.0);
+    printf("- Speedup: %.2fx\n", single_time / parallel_time);
+    
+    free(array);
+}
+
+/* Standard binary search for comparison */
+static uint32_t scalar_lower_bound(uint32_t key, uint32_t *base, uint32_t nelem)
+{
+    uint32_t lo = 0, hi = nelem;
+    
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if (base[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Compare lower_bound32 with a standard binary search */
+void test_sorted_search_performance(void)
+{
+    printf("\n\nSorted Search Analysis\n");
+    printf("======================\n");
+    
+    const uint32_t sizes[] = {100, 10000, 1000000};
+    const int nqueries = 1000000;
+    uint32_t *array = malloc(1000000 * sizeof(uint32_t));
+    uint32_t *queries = malloc(nqueries * sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < 1000000; i++) {
+        array[i] = i * 3;
+    }
+    
+    for (int s = 0; s < 3; s++) {
+        uint32_t size = sizes[s];
+        uint32_t simd_sum = 0;
+        uint32_t scalar_sum = 0;
+        
+        srand(42);
+        for (int q = 0; q < nqueries; q++) {
+            queries[q] = (uint32_t)(rand() % (size * 3));
+        }
+        
+        double start_time = get_time_microseconds();
+        for (int q = 0; q < nqueries; q++) {
+            simd_sum += lower_bound32(queries[q], array, size);
+        }
+        double simd_time = get_time_microseconds() - start_time;
+        
+        start_time = get_time_microseconds();
+        for (int q = 0; q < nqueries; q++) {
+            scalar_sum += scalar_lower_bound(queries[q], array, size);
+        }
+        double scalar_time = get_time_microseconds() - start_time;
+        
+        printf("%7u elements: lower_bound32 %.1f ns, binary search %.1f ns, "
+               "speedup %.2fx%s\n",
+               size, simd_time * 1000.0 / nqueries, scalar_time * 1000.0 / nqueries,
+               scalar_time / simd_time,
+               simd_sum == scalar_sum ? "" : " (MISMATCH)");
+    }
+    
+    free(array);
+    free(queries);
+}
+
+void test_stree_performance(void)
+{
+    printf("\n\nSearch Tree Analysis\n");
+    printf("====================\n");
+    
+    const uint32_t sizes[] = {10000, 1000000, 16000000};
+    const uint32_t nqueries = 1000000;
+    uint32_t *array = malloc(16000000 * sizeof(uint32_t));
+    uint32_t *queries = malloc(nqueries * sizeof(uint32_t));
+    uint32_t *results = malloc(nqueries * sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < 16000000; i++) {
+        array[i] = i * 3;
+    }
+    
+    for (int s = 0; s < 3; s++) {
+        uint32_t size = sizes[s];
+        Stree32 *tree = stree32_build(array, size);
+        uint32_t flat_sum = 0;
+        uint32_t tree_sum = 0;
+        uint32_t batch_sum = 0;
+        
+        srand(42);
+        for (uint32_t q = 0; q < nqueries; q++) {
+            queries[q] = (uint32_t)(((uint64)rand() * RAND_MAX + rand()) % ((uint64)size * 3));
+        }
+        
+        double start_time = get_time_microseconds();
+        for (uint32_t q = 0; q < nqueries; q++) {
+            flat_sum += lower_bound32(queries[q], array, size);
+        }
+        double flat_time = get_time_microseconds() - start_time;
+        
+        start_time = get_time_microseconds();
+        for (uint32_t q = 0; q < nqueries; q++) {
+            tree_sum += stree32_lower_bound(tree, queries[q]);
+        }
+        double tree_time = get_time_microseconds() - start_time;
+        
+        start_time = get_time_microseconds();
+        stree32_lower_bound_batch(tree, queries, nqueries, results);
+        double batch_time = get_time_microseconds() - start_time;
+        for (uint32_t q = 0; q < nqueries; q++) {
+            batch_sum += results[q];
+        }
+        
+        printf("%8u elements: lower_bound32 %.1f ns, stree32 %.1f ns, "
+               "stree32 batch %.1f ns%s\n",
+               size, flat_time * 1000.0 / nqueries, tree_time * 1000.0 / nqueries,
+               batch_time * 1000.0 / nqueries,
+               (flat_sum == tree_sum && flat_sum == batch_sum) ? "" : " (MISMATCH)");
+        stree32_free(tree);
+    }
+    
+    free(array);
+    free(queries);
+    free(results);
+}
+
+/* scalar linear-probing table of the same load, as a baseline for simd_hash */
+typedef struct {
+    uint64 *keys;
+    uint64 *values;
+    bool *used;
+    uint64 mask;
+} scalar_hash_t;
+
+static uint64 scalar_hash_mix(uint64 key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static void scalar_hash_insert(scalar_hash_t *h, uint64 key, uint64 value)
+{
+    uint64 pos = scalar_hash_mix(key) & h->mask;
+    
+    while (h->used[pos] && h->keys[pos] != key) {
+        pos = (pos + 1) & h->mask;
+    }
+    h->used[pos] = true;
+    h->keys[pos] = key;
+    h->values[pos] = value;
+}
+
+static bool scalar_hash_lookup(const scalar_hash_t *h, uint64 key, uint64 *value)
+{
+    uint64 pos = scalar_hash_mix(key) & h->mask;
+    
+    while (h->used[pos]) {
+        if (h->keys[pos] == key) {
+            *value = h->values[pos];
+            return true;
+        }
+        pos = (pos + 1) & h->mask;
+    }
+    return false;
+}
+
+void test_hash_map_performance(void)
+{
+    printf("\n\nHash Map Analysis\n");
+    printf("=================\n");
+    
+    /* 1M entries, at 7/8 load in both tables */
+    const uint32_t nitems = 917504;
+    const uint32_t nslots = 1048576;
+    const uint32_t nqueries = 2000000;
+    SimdHashMap *map = simd_hash_create(nitems);
+    scalar_hash_t scalar;
+    uint64 *queries = malloc(nqueries * sizeof(uint64));
+    
+    scalar.keys = malloc(nslots * sizeof(uint64));
+    scalar.values = malloc(nslots * sizeof(uint64));
+    scalar.used = calloc(nslots, sizeof(bool));
+    scalar.mask = nslots - 1;
+    
+    for (uint32_t i = 0; i < nitems; i++) {
+        simd_hash_insert(map, (uint64)i * 2, i);
+        scalar_hash_insert(&scalar, (uint64)i * 2, i);
+    }
+    
+    for (int miss = 0; miss < 2; miss++) {
+        uint64 simd_sum = 0;
+        uint64 scalar_sum = 0;
+        uint64 value;
+        
+        srand(42);
+        for (uint32_t q = 0; q < nqueries; q++) {
+            /* even keys are present, odd keys are not */
+            queries[q] = (uint64)(rand() % nitems) * 2 + (uint64)miss;
+        }
+        
+        double start_time = get_time_microseconds();
+        for (uint32_t q = 0; q < nqueries; q++) {
+            if (simd_hash_lookup(map, queries[q], &value)) {
+                simd_sum += value;
+            }
+        }
+        double simd_time = get_time_microseconds() - start_time;
+        
+        start_time = get_time_microseconds();
+        for (uint32_t q = 0; q < nqueries; q++) {
+            if (scalar_hash_lookup(&scalar, queries[q], &value)) {
+                scalar_sum += value;
+            }
+        }
+        double scalar_time = get_time_microseconds() - start_time;
+        
+        printf("%s: simd_hash %.1f ns, linear probing %.1f ns, speedup %.2fx%s\n",
+               miss ? "misses" : "hits  ",
+               simd_time * 1000.0 / nqueries, scalar_time * 1000.0 / nqueries,
+               scalar_time / simd_time,
+               simd_sum == scalar_sum ? "" : " (MISMATCH)");
+    }
+    
+    simd_hash_destroy(map);
+    free(scalar.keys);
+    free(scalar.values);
+    free(scalar.used);
+    free(queries);
+}
+
+void test_reduction_performance(void)
+{
+    printf("\n\nReduction Analysis\n");
+    printf("==================\n");
+    
+    const uint32_t size = 1000000;
+    const int iterations = 200;
+    uint32_t *array = malloc(size * sizeof(uint32_t));
+    uint8_t *bytes = malloc(size);
+    volatile uint64 sink = 0;
+    
+    srand(42);
+    for (uint32_t i = 0; i < size; i++) {
+        array[i] = (uint32_t)rand();
+        bytes[i] = (uint8_t)rand();
+    }
+    
+    /* vmin32 against a scalar loop */
+    double start_time = get_time_microseconds();
+    for (int it = 0; it < iterations; it++) {
+        sink += vmin32(array, size);
+    }
+    double simd_time = get_time_microseconds() - start_time;
+    
+    start_time = get_time_microseconds();
+    for (int it = 0; it < iterations; it++) {
+        uint32_t min = UINT32_MAX;
+        for (uint32_t i = 0; i < size; i++) {
+            min = array[i] < min ? array[i] : min;
+        }
+        sink += min;
+    }
+    double scalar_time = get_time_microseconds() - start_time;
+    printf("vmin32 (1M): %.1f us vs scalar %.1f us, speedup %.2fx\n",
+           simd_time / iterations, scalar_time / iterations, scalar_time / simd_time);
+    
+    /* vsum8 against a scalar loop */
+    start_time = get_time_microseconds();
+    for (int it = 0; it < iterations; it++) {
+        sink += vsum8(bytes, size);
+    }
+    simd_time = get_time_microseconds() - start_time;
+    
+    start_time = get_time_microseconds();
+    for (int it = 0; it < iterations; it++) {
+        uint64 sum = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            sum += bytes[i];
+        }
+        sink += sum;
+    }
+    scalar_time = get_time_microseconds() - start_time;
+    printf("vsum8 (1M): %.1f us vs scalar %.1f us, speedup %.2fx\n",
+           simd_time / iterations, scalar_time / iterations, scalar_time / simd_time);
+    
+    /* one lfind32_stats pass against the four kernels it replaces */
+    Lfind32Stats stats;
+    
+    start_time = get_time_microseconds();
+    for (int it = 0; it < iterations; it++) {
+        sink += lfind32_stats(12345, array, size, &stats) + stats.sum;
+    }
+    double fused_time = get_time_microseconds() - start_time;
+    
+    start_time = get_time_microseconds();
+    for (int it = 0; it < iterations; it++) {
+        sink += lfind32_count(12345, array, size) + vmin32(array, size) +
+            vmax32(array, size) + vsum32(array, size);
+    }
+    double separate_time = get_time_microseconds() - start_time;
+    printf("lfind32_stats (1M): %.1f us vs separate passes %.1f us, speedup %.2fx\n",
+           fused_time / iterations, separate_time / iterations, separate_time / fused_time);
+    
+    (void) sink;
+    free(array);
+    free(bytes);
+}
+
+void test_nt_scan_performance(void)
+{
+    printf("\n\nNon-Temporal Scan Analysis\n");
+    printf("==========================\n");
+    
+    /* a cold 128MB array, scanned in slices between bursts of hot lookups */
+    const uint32_t size = 32 * 1024 * 1024;
+    const uint32_t slice = 1024 * 1024;
+    const uint32_t nitems = 65536;
+    const uint32_t nlookups = 20000;
+    uint32_t *array = malloc(size * sizeof(uint32_t));
+    SimdHashMap *map = simd_hash_create(nitems);
+    volatile uint64 sink = 0;
+    
+    srand(42);
+    for (uint32_t i = 0; i < size; i++) {
+        array[i] = (uint32_t)rand() | 1;
+    }
+    for (uint32_t i = 0; i < nitems; i++) {
+        simd_hash_insert(map, i, i);
+    }
+    
+    for (int nt = 0; nt < 2; nt++) {
+        double scan_time = 0;
+        double lookup_time = 0;
+        uint64 value;
+        
+        for (uint32_t start = 0; start < size; start += slice) {
+            double start_time = get_time_microseconds();
+            sink += nt ? lfind32_nt(0, array + start, slice) :
+                lfind32(0, array + start, slice);
+            scan_time += get_time_microseconds() - start_time;
+            
+            start_time = get_time_microseconds();
+            for (uint32_t q = 0; q < nlookups; q++) {
+                if (simd_hash_lookup(map, (q * 2654435761u) % nitems, &value)) {
+                    sink += value;
+                }
+            }
+            lookup_time += get_time_microseconds() - start_time;
+        }
+        
+        printf("%s: scan %.2f GB/s, lookups after each slice %.1f ns\n",
+               nt ? "lfind32_nt" : "lfind32   ",
+               (double)size * sizeof(uint32_t) / (scan_time * 1000.0),
+               lookup_time * 1000.0 / ((double)nlookups * (size / slice)));
+    }
+    
+    (void) sink;
+    simd_hash_destroy(map);
+    free(array);
+}
+
 int main(void)
 {
     printf("libsimd Performance Tests\n");
@@ -361,16 +909,7 @@ int main(void)
     /* Check CPU features */
     printf("System Information:\n");
     printf("- Compiler: %s\n", __VERSION__);
-    #ifdef __AVX2__
-    printf("- AVX2 support: Enabled\n");
-    #else
-    printf("- AVX2 support: Disabled\n");
-    #endif
-    #ifdef __SSE4_2__
-    printf("- SSE4.2 support: Enabled\n");
-    #else
-    printf("- SSE4.2 support: Disabled\n");
-    #endif
+    printf("- Kernel variant: %s\n", simd_get_impl_name());
     
     /* Run performance tests */
     run_performance_tests();
@@ -378,6 +917,27 @@ int main(void)
     /* Run worst case analysis */
     test_worst_case_performance();
     
+    /* Run batched probe analysis */
+    test_batch_probe_performance();
+    
+    /* Run parallel scan analysis */
+    test_parallel_performance();
+    
+    /* Run sorted search analysis */
+    test_sorted_search_performance();
+    
+    /* Run search tree analysis */
+    test_stree_performance();
+    
+    /* Run hash map analysis */
+    test_hash_map_performance();
+    
+    /* Run reduction analysis */
+    test_reduction_performance();
+    
+    /* Run non-temporal scan analysis */
+    test_nt_scan_performance();
+    
     printf("\nPerformance testing completed.\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,415 @@
+/*
+ * textscan.c
+ *
+ * Validation and classification of text buffers: simd_is_ascii,
+ * simd_utf8_validate and simd_find_byte_class.  Like lfind.c this is
+ * compiled once per instruction-set variant; the exported functions live in
+ * simd_dispatch.c.
+ *
+ * UTF-8 validation follows Keiser and Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte" (2021): every error shows up in the first
+ * two bytes of a sequence, so three 16-entry table lookups, on the high and
+ * low nibble of the previous byte and the high nibble of the current one,
+ * classify each pair of adjacent bytes, and the only check that needs more
+ * context is whether a byte must be the third or fourth of a sequence.  The
+ * variant without table lookups (SSE2) validates with a scalar loop, which
+ * skips ASCII a vector at a time.
+ *
+ * Buffers are addressed by size_t, so the tail helpers in simd_inline.h,
+ * which take uint32 indexes, are not used here.
+ */
+#include "simd_internal.h"
+
+/*
+ * Load the last, partial vector of 's[i .. n-1]' like simd_load_tail8(),
+ * returning the mask of the lanes holding those bytes and setting '*start'
+ * to the offset of the byte in lane 0.  Buffers of at least one vector
+ * reload the vector ending at 's[n-1]'.
+ */
+static inline uint64
+textscan_load_tail(Vector8 *chunk, const uint8 *s, size_t i, size_t n, size_t *start)
+{
+	if (n >= sizeof(Vector8))
+	{
+		*start = n - sizeof(Vector8);
+		vector8_load(chunk, &s[*start]);
+		return ~simd_mask_prefix((uint32) (i - *start));
+	}
+
+	*start = i;
+	vector8_load_partial(chunk, &s[i], (uint32) (n - i));
+	return simd_mask_prefix((uint32) (n - i));
+}
+
+/*
+ * simd_is_ascii
+ *
+ * Return true if no byte of 'buf[0 .. n-1]' has its high bit set.
+ */
+bool
+SIMD_FN(simd_is_ascii)(const void *buf, size_t n)
+{
+	const uint8 *s = buf;
+	size_t		i = 0;
+
+	/* OR four vectors together, a high bit in any of them survives */
+	for (; n - i >= 4 * sizeof(Vector8); i += 4 * sizeof(Vector8))
+	{
+		Vector8		chunk1;
+		Vector8		chunk2;
+		Vector8		chunk3;
+		Vector8		chunk4;
+
+		vector8_load(&chunk1, &s[i]);
+		vector8_load(&chunk2, &s[i + sizeof(Vector8)]);
+		vector8_load(&chunk3, &s[i + 2 * sizeof(Vector8)]);
+		vector8_load(&chunk4, &s[i + 3 * sizeof(Vector8)]);
+		if (vector8_is_highbit_set(vector8_or(vector8_or(chunk1, chunk2),
+											  vector8_or(chunk3, chunk4))))
+			return false;
+	}
+
+	for (; n - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		Vector8		chunk;
+
+		vector8_load(&chunk, &s[i]);
+		if (vector8_is_highbit_set(chunk))
+			return false;
+	}
+
+	if (i < n)
+	{
+		Vector8		chunk;
+		size_t		start;
+		uint64		valid = textscan_load_tail(&chunk, s, i, n, &start);
+		Vector8		high;
+
+		/* lanes >= 0x80, the partial load leaves garbage past the end */
+		high = vector8_eq(vector8_max(chunk, vector8_broadcast(0x80)), chunk);
+		return (vector8_cmp_mask(high) & valid) == 0;
+	}
+
+	return true;
+}
+
+#ifdef VECTOR8_HAS_LOOKUP
+
+/*
+ * Error classes of a pair of adjacent bytes.  A pair is invalid if its
+ * three table entries share a bit; TWO_CONTS, two continuation bytes, is
+ * only an error where no earlier lead byte asks for a third or fourth byte,
+ * which utf8_check_block() flips with an XOR.
+ */
+#define UTF8_TOO_SHORT		(1 << 0)	/* lead byte not followed by a continuation */
+#define UTF8_TOO_LONG		(1 << 1)	/* continuation after ASCII */
+#define UTF8_OVERLONG_3		(1 << 2)	/* E0 80..9F */
+#define UTF8_TOO_LARGE		(1 << 3)	/* F4 90..BF, F5..FF */
+#define UTF8_SURROGATE		(1 << 4)	/* ED A0..BF */
+#define UTF8_OVERLONG_2		(1 << 5)	/* C0, C1 */
+#define UTF8_TOO_LARGE_1000	(1 << 6)	/* F5..FF 80..8F */
+#define UTF8_OVERLONG_4		(1 << 6)	/* F0 80..8F */
+#define UTF8_TWO_CONTS		(1 << 7)
+#define UTF8_CARRY			(UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+/* indexed by the high nibble of the first byte of the pair */
+static const uint8 utf8_byte1_high[16] = {
+	/* 0x0_ .. 0x7_: ASCII */
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	/* 0x8_ .. 0xB_: continuations */
+	UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+	/* 0xC_, 0xD_: two-byte leads */
+	UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+	UTF8_TOO_SHORT,
+	/* 0xE_: three-byte leads */
+	UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+	/* 0xF_: four-byte leads */
+	UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+/* indexed by the low nibble of the first byte of the pair */
+static const uint8 utf8_byte1_low[16] = {
+	UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+	UTF8_CARRY | UTF8_OVERLONG_2,
+	UTF8_CARRY,
+	UTF8_CARRY,
+	UTF8_CARRY | UTF8_TOO_LARGE,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+/* indexed by the high nibble of the second byte of the pair */
+static const uint8 utf8_byte2_high[16] = {
+	/* 0x0_ .. 0x7_: ASCII */
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	/* 0x8_ .. 0xB_: continuations */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+	UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+	UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+	UTF8_SURROGATE | UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS |
+	UTF8_SURROGATE | UTF8_TOO_LARGE,
+	/* 0xC_ .. 0xF_: leads */
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+typedef struct Utf8Luts
+{
+	Vector8		byte1_high;
+	Vector8		byte1_low;
+	Vector8		byte2_high;
+} Utf8Luts;
+
+/*
+ * Return the errors of the vector of bytes at 'p', nonzero in the lanes of
+ * the second byte of each invalid pair.  'p[-3 .. -1]' must be readable:
+ * they are the bytes before the vector, or zeros at the start of the
+ * buffer.
+ */
+static inline Vector8
+utf8_check_block(const uint8 *p, const Utf8Luts *luts)
+{
+	const Vector8 nibble = vector8_broadcast(0x0F);
+	Vector8		cur;
+	Vector8		prev1;
+	Vector8		prev2;
+	Vector8		prev3;
+	Vector8		special;
+	Vector8		must23;
+
+	vector8_load(&cur, p);
+	vector8_load(&prev1, p - 1);
+	vector8_load(&prev2, p - 2);
+	vector8_load(&prev3, p - 3);
+
+	special = vector8_and(vector8_and(vector8_lookup(luts->byte1_high,
+													 vector8_shift_right(prev1, 4)),
+									  vector8_lookup(luts->byte1_low,
+													 vector8_and(prev1, nibble))),
+						  vector8_lookup(luts->byte2_high, vector8_shift_right(cur, 4)));
+
+	/*
+	 * Bytes two or three after a three- or four-byte lead must be
+	 * continuations, where TWO_CONTS is expected rather than an error.  The
+	 * saturating subtractions leave the high bit set exactly for prev2 >=
+	 * 0xE0 and prev3 >= 0xF0.
+	 */
+	must23 = vector8_or(vector8_ssub(prev2, vector8_broadcast(0xE0 - 0x80)),
+						vector8_ssub(prev3, vector8_broadcast(0xF0 - 0x80)));
+	must23 = vector8_and(must23, vector8_broadcast(0x80));
+
+	return vector8_xor(special, must23);
+}
+
+/*
+ * Check the bytes from 's[i]' to the end of the buffer, fewer than a vector,
+ * together with the three before them, by copying them to a zero-padded
+ * block.  The zeros after the last byte are ASCII, so a sequence cut off at
+ * the end of the buffer shows up as TOO_SHORT.
+ */
+static inline Vector8
+utf8_check_tail(const uint8 *s, size_t i, size_t n, const Utf8Luts *luts)
+{
+	uint8		block[3 + sizeof(Vector8)];
+	size_t		nprev = i < 3 ? i : 3;
+
+	memset(block, 0, sizeof(block));
+	memcpy(&block[3 - nprev], &s[i - nprev], nprev);
+	memcpy(&block[3], &s[i], n - i);
+
+	return utf8_check_block(&block[3], luts);
+}
+
+/*
+ * simd_utf8_validate
+ *
+ * Return true if 'buf[0 .. n-1]' is well-formed UTF-8.
+ */
+bool
+SIMD_FN(simd_utf8_validate)(const void *buf, size_t n)
+{
+	const uint8 *s = buf;
+	Utf8Luts	luts;
+	Vector8		error = vector8_broadcast(0);
+	size_t		i = 0;
+
+	vector8_load_lut(&luts.byte1_high, utf8_byte1_high);
+	vector8_load_lut(&luts.byte1_low, utf8_byte1_low);
+	vector8_load_lut(&luts.byte2_high, utf8_byte2_high);
+
+	if (n >= sizeof(Vector8))
+	{
+		uint8		block[3 + sizeof(Vector8)];
+
+		/* the first vector has no bytes before it, check a padded copy */
+		memset(block, 0, 3);
+		memcpy(&block[3], s, sizeof(Vector8));
+		error = utf8_check_block(&block[3], &luts);
+		i = sizeof(Vector8);
+	}
+
+	for (; n - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		Vector8		chunk;
+
+		vector8_load(&chunk, &s[i]);
+		if (!vector8_is_highbit_set(chunk))
+		{
+			/*
+			 * All ASCII, so the only possible error is a sequence cut off
+			 * by it at the end of the previous vector.
+			 */
+			if (s[i - 1] >= 0xC0 || s[i - 2] >= 0xE0 || s[i - 3] >= 0xF0)
+				return false;
+			continue;
+		}
+		error = vector8_or(error, utf8_check_block(&s[i], &luts));
+	}
+
+	/* also when i == n, to catch a sequence cut off by the end */
+	error = vector8_or(error, utf8_check_tail(s, i, n, &luts));
+
+	return vector8_is_zero(error);
+}
+
+#else							/* !VECTOR8_HAS_LOOKUP */
+
+/*
+ * simd_utf8_validate
+ *
+ * Return true if 'buf[0 .. n-1]' is well-formed UTF-8.
+ */
+bool
+SIMD_FN(simd_utf8_validate)(const void *buf, size_t n)
+{
+	const uint8 *s = buf;
+	size_t		i = 0;
+
+	while (i < n)
+	{
+		uint8		c = s[i];
+		size_t		len;
+		uint8		lo = 0x80;
+		uint8		hi = 0xBF;
+		size_t		j;
+
+		if (c < 0x80)
+		{
+			Vector8		chunk;
+
+			/*
+			 * Skip ASCII a vector at a time, trying only at every vector's
+			 * worth of bytes so that mixed text doesn't pay a load per byte
+			 */
+			i++;
+			while ((i & (sizeof(Vector8) - 1)) == 0 && n - i >= sizeof(Vector8))
+			{
+				vector8_load(&chunk, &s[i]);
+				if (vector8_is_highbit_set(chunk))
+					break;
+				i += sizeof(Vector8);
+			}
+			continue;
+		}
+
+		/* the lead byte gives the length and the range of the second byte */
+		if (c < 0xC2)
+			return false;
+		else if (c < 0xE0)
+			len = 2;
+		else if (c < 0xF0)
+		{
+			len = 3;
+			if (c == 0xE0)
+				lo = 0xA0;
+			else if (c == 0xED)
+				hi = 0x9F;
+		}
+		else if (c < 0xF5)
+		{
+			len = 4;
+			if (c == 0xF0)
+				lo = 0x90;
+			else if (c == 0xF4)
+				hi = 0x8F;
+		}
+		else
+			return false;
+
+		if (n - i < len || s[i + 1] < lo || s[i + 1] > hi)
+			return false;
+		for (j = 2; j < len; j++)
+		{
+			if ((s[i + j] & 0xC0) != 0x80)
+				return false;
+		}
+		i += len;
+	}
+
+	return true;
+}
+
+#endif							/* VECTOR8_HAS_LOOKUP */
+
+/*
+ * simd_find_byte_class
+ *
+ * Return the offset of the first byte of 'buf[0 .. n-1]' that is in the
+ * class 'cls', or 'n' if there is none.
+ */
+size_t
+SIMD_FN(simd_find_byte_class)(const SimdByteClass *cls, const void *buf, size_t n)
+{
+	const uint8 *s = buf;
+	size_t		i = 0;
+
+#ifdef VECTOR8_HAS_LOOKUP
+	ByteSetLuts luts;
+
+	byteset_load_luts(&luts, cls->row0, cls->row1);
+	for (; n - i >= sizeof(Vector8); i += sizeof(Vector8))
+	{
+		Vector8		chunk;
+		uint64		mask;
+
+		vector8_load(&chunk, &s[i]);
+		mask = vector8_cmp_mask(byteset_match(chunk, &luts));
+		if (mask != 0)
+			return i + simd_mask_first_byte(mask);
+	}
+
+	if (i < n)
+	{
+		Vector8		chunk;
+		size_t		start;
+		uint64		mask;
+
+		mask = textscan_load_tail(&chunk, s, i, n, &start) &
+			vector8_cmp_mask(byteset_match(chunk, &luts));
+		if (mask != 0)
+			return start + simd_mask_first_byte(mask);
+	}
+#else
+	/* no table lookups, test each byte against the membership bitmap */
+	for (; i < n; i++)
+	{
+		if (cls->set[s[i] >> 3] & (1 << (s[i] & 7)))
+			return i;
+	}
+#endif
+
+	return n;
+}
@@ -0,0 +1,176 @@
+/*
+ * lfind_file.c
+ *
+ * Command-line front end to lfind_file_scan(): search binary column files
+ * for a value without loading them.
+ *
+ *	lfind_file [-w 1|4] [-c] [-m bitmap_file] [-j threads] [-s chunk_kb] key file...
+ *
+ * By default each file is searched for 'key' as an array of 4-byte native
+ * integers, and the exit status is 0 if any file contains it, 1 if none
+ * does and 2 on errors, like grep.  -c prints the number of matches in each
+ * file instead, and -m also writes the bitmap of matching elements to
+ * 'bitmap_file', for a single file only.  -j scans with that many worker threads
+ * besides the main one, 0 for one per CPU.  -s sets the chunk size in kB.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simd.h"
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr,
+			"usage: %s [-w 1|4] [-c] [-m bitmap_file] [-j threads] [-s chunk_kb] key file...\n",
+			progname);
+	exit(2);
+}
+
+/*
+ * Write the bitmap for 'nelem' elements to 'path'.  Returns false on
+ * failure, having reported it.
+ */
+static bool
+write_bitmap(const char *path, const uint8 *bitmap, uint64 nelem)
+{
+	FILE	   *f = fopen(path, "wb");
+	size_t		nbytes = (size_t) LFIND_BITMAP_BYTES(nelem);
+
+	if (f == NULL || fwrite(bitmap, 1, nbytes, f) != nbytes || fclose(f) != 0)
+	{
+		fprintf(stderr, "lfind_file: %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	LfindFileScan scan;
+	const char *bitmap_path = NULL;
+	bool		found = false;
+	bool		failed = false;
+	char	   *end;
+	int			c;
+
+	memset(&scan, 0, sizeof(scan));
+	scan.op = LFIND_FILE_FIND;
+	scan.elem_size = sizeof(uint32);
+
+	while ((c = getopt(argc, argv, "w:cm:j:s:")) != -1)
+	{
+		switch (c)
+		{
+			case 'w':
+				scan.elem_size = (uint32) strtoul(optarg, &end, 10);
+				if (*end != '\0' ||
+					(scan.elem_size != sizeof(uint8) && scan.elem_size != sizeof(uint32)))
+					usage(argv[0]);
+				break;
+			case 'c':
+				scan.op = LFIND_FILE_COUNT;
+				break;
+			case 'm':
+				scan.op = LFIND_FILE_MASK;
+				bitmap_path = optarg;
+				break;
+			case 'j':
+				scan.parallel = true;
+				lfind_pool_destroy(scan.pool);
+				scan.pool = lfind_pool_create((uint32) strtoul(optarg, &end, 10));
+				if (*end != '\0' || scan.pool == NULL)
+					usage(argv[0]);
+				break;
+			case 's':
+				scan.chunk_bytes = (uint32) strtoul(optarg, &end, 10) * 1024;
+				if (*end != '\0')
+					usage(argv[0]);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (argc - optind < 2)
+		usage(argv[0]);
+
+	/* one bitmap file can't hold the bitmaps of several inputs */
+	if (bitmap_path != NULL && argc - optind > 2)
+	{
+		fprintf(stderr, "lfind_file: -m takes a single input file\n");
+		return 2;
+	}
+
+	errno = 0;
+	scan.key = strtoull(argv[optind], &end, 0);
+	if (*end != '\0' || errno != 0 ||
+		scan.key > (scan.elem_size == sizeof(uint8) ? 0xFF : 0xFFFFFFFF))
+	{
+		fprintf(stderr, "lfind_file: invalid key \"%s\"\n", argv[optind]);
+		return 2;
+	}
+
+	for (optind++; optind < argc; optind++)
+	{
+		const char *path = argv[optind];
+		int			fd = open(path, O_RDONLY);
+		struct stat st;
+		uint64		nelem;
+		int64		result;
+
+		if (fd < 0 || fstat(fd, &st) != 0)
+		{
+			fprintf(stderr, "lfind_file: %s: %s\n", path, strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			failed = true;
+			continue;
+		}
+
+		/* size the bitmap from the same descriptor that gets scanned */
+		nelem = (uint64) st.st_size / scan.elem_size;
+		scan.bitmap = NULL;
+		if (scan.op == LFIND_FILE_MASK)
+		{
+			scan.bitmap = calloc(LFIND_BITMAP_BYTES(nelem) + 1, 1);
+			if (scan.bitmap == NULL)
+			{
+				fprintf(stderr, "lfind_file: out of memory\n");
+				return 2;
+			}
+		}
+
+		result = lfind_file_scan_fd(fd, &scan);
+		if (result < 0)
+		{
+			fprintf(stderr, "lfind_file: %s: %s\n", path, strerror(errno));
+			failed = true;
+		}
+		else
+		{
+			found |= result > 0;
+			if (scan.op != LFIND_FILE_FIND)
+				printf("%s: %lld\n", path, (long long) result);
+			if (scan.op == LFIND_FILE_MASK &&
+				!write_bitmap(bitmap_path, scan.bitmap, nelem))
+				failed = true;
+		}
+		free(scan.bitmap);
+		close(fd);
+	}
+
+	lfind_pool_destroy(scan.pool);
+
+	if (failed)
+		return 2;
+	return found ? 0 : 1;
+}